@@ -0,0 +1,229 @@
+/*
+ * Accuracy.h - Check the velocity methods against a double-precision direct sum
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include "Omega2D.h"
+#include "VectorHelper.h"
+#include "Kernels.h"
+#include "Points.h"
+#include "Surfaces.h"
+#include "Collection.h"
+#include "ExecEnv.h"
+#include "Influence.h"
+#include "json/json.hpp"
+
+#ifdef _WIN32
+  #include <ciso646>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+
+//
+// Add the influence of one source collection on point targets, in double precision
+//
+// This follows points_affect_points and panels_affect_points, but with every
+//   quantity promoted to double, so it can be the reference for all of them.
+//
+template <class S>
+void reference_affect_points (Collection const& _src, Points<S> const& _targ,
+                              std::vector<double>& _u, std::vector<double>& _v) {
+
+  const std::array<Vector<S>,Dimensions>& tx = _targ.get_pos();
+  const bool thick = not _targ.is_inert();
+  const Vector<S>& tr = _targ.get_rad();
+
+  std::visit([&](auto const& src) {
+    using T = std::decay_t<decltype(src)>;
+    const std::array<Vector<S>,Dimensions>& sx = src.get_pos();
+
+    if constexpr (std::is_same<T, Points<S>>::value) {
+      const Vector<S>& sr = src.get_rad();
+      const Vector<S>& ss = src.get_str();
+
+      #pragma omp parallel for
+      for (int32_t i=0; i<(int32_t)_targ.get_n(); ++i) {
+        double accumu = 0.0;
+        double accumv = 0.0;
+        for (size_t j=0; j<src.get_n(); ++j) {
+          if (thick) {
+            kernel_0v_0v<double,double>(sx[0][j], sx[1][j], sr[j], ss[j],
+                                        tx[0][i], tx[1][i], tr[i], &accumu, &accumv);
+          } else {
+            kernel_0v_0p<double,double>(sx[0][j], sx[1][j], sr[j], ss[j],
+                                        tx[0][i], tx[1][i], &accumu, &accumv);
+          }
+        }
+        _u[i] += accumu;
+        _v[i] += accumv;
+      }
+
+    } else {
+      const std::vector<Int>& si = src.get_idx();
+      const Vector<S>& vs = src.get_str();
+      const bool have_source_strengths = src.have_src_str();
+
+      #pragma omp parallel for
+      for (int32_t i=0; i<(int32_t)_targ.get_n(); ++i) {
+        double accumu = 0.0;
+        double accumv = 0.0;
+        double resultu = 0.0;
+        double resultv = 0.0;
+        for (size_t j=0; j<src.get_npanels(); ++j) {
+          const size_t jp0 = si[2*j];
+          const size_t jp1 = si[2*j+1];
+          if (have_source_strengths) {
+            kernel_1_0vs<double,double>(sx[0][jp0], sx[1][jp0], sx[0][jp1], sx[1][jp1],
+                                        vs[j], src.get_src_str()[j],
+                                        tx[0][i], tx[1][i], &resultu, &resultv);
+          } else {
+            kernel_1_0v<double,double>(sx[0][jp0], sx[1][jp0], sx[0][jp1], sx[1][jp1],
+                                       vs[j], tx[0][i], tx[1][i], &resultu, &resultv);
+          }
+          accumu += resultu;
+          accumv += resultv;
+        }
+        _u[i] += accumu;
+        _v[i] += accumv;
+      }
+    }
+  }, _src);
+}
+
+//
+// How far one method's velocities are from the reference, and what it cost
+//
+struct VelocityError {
+  std::string method;
+  double seconds = 0.0;
+  double rms = 0.0;		// of the velocity error vector, over all targets
+  double max = 0.0;
+  double rel_rms = 0.0;		// rms over the rms of the reference induced velocity
+  bool pareto = false;		// no other method is both faster and more accurate
+
+  nlohmann::json to_json() const {
+    return { {"method", method}, {"seconds", seconds}, {"rmsError", rms}, {"maxError", max},
+             {"relRmsError", rel_rms}, {"pareto", pareto} };
+  }
+};
+
+//
+// Find velocities on every point target with each method, and compare to the reference
+//
+// Sources are taken as they are (the BEM is not re-solved), and rotating bodies get
+//   their rotation strengths added just as find_vels does. Each method is timed at its
+//   best of a few repetitions, on copies of the targets.
+//
+template <class S>
+std::vector<VelocityError> check_velocity_accuracy (const std::array<double,Dimensions>& _fs,
+                                                    std::vector<Collection> const& _vort,
+                                                    std::vector<Collection> const& _bdry,
+                                                    std::vector<Collection> const& _targets,
+                                                    std::vector<ExecEnv> const& _envs,
+                                                    double& _ref_seconds) {
+  using Clock = std::chrono::steady_clock;
+  const int reps = 3;
+
+  // working copies: bodies get their rotation, and only point targets are checked
+  std::vector<Collection> bdry = _bdry;
+  for (auto &src : bdry) {
+    std::visit([=](auto& elem) { elem.add_solved_rot_strengths(1.0); }, src);
+  }
+  std::vector<Collection> targs;
+  for (auto const& t : _targets) {
+    if (std::holds_alternative<Points<S>>(t) and std::get<Points<S>>(t).get_n() > 0) targs.push_back(t);
+  }
+
+  // the reference, once
+  std::vector<std::vector<double>> refu, refv;
+  const auto rstart = Clock::now();
+  for (auto const& t : targs) {
+    Points<S> const& pts = std::get<Points<S>>(t);
+    std::vector<double> u(pts.get_n(), 0.0), v(pts.get_n(), 0.0);
+    for (auto const& src : _vort) reference_affect_points<S>(src, pts, u, v);
+    for (auto const& src : bdry) reference_affect_points<S>(src, pts, u, v);
+    refu.push_back(u);
+    refv.push_back(v);
+  }
+  _ref_seconds = std::chrono::duration<double>(Clock::now() - rstart).count();
+
+  // scale of the induced velocity, for the relative error
+  double refsq = 0.0;
+  size_t ntarg = 0;
+  const double factor = 0.5/M_PI;
+  for (size_t t=0; t<targs.size(); ++t) {
+    for (size_t i=0; i<refu[t].size(); ++i) {
+      refsq += std::pow(factor*refu[t][i], 2) + std::pow(factor*refv[t][i], 2);
+    }
+    ntarg += refu[t].size();
+  }
+  const double refrms = std::sqrt(refsq / std::max((size_t)1, ntarg));
+
+  // each method, with a float and a double accumulator
+  std::vector<VelocityError> results;
+  for (auto const& env : _envs) {
+    for (const bool dbl : {false, true}) {
+      VelocityError err;
+      err.method = env.to_string().substr(1) + (dbl ? ", double accum" : ", float accum");
+      err.seconds = 1.e+30;
+
+      std::vector<Collection> work = targs;
+      for (int r=0; r<reps; ++r) {
+        const auto start = Clock::now();
+        for (auto &targ : work) {
+          std::visit([=](auto& elem) { elem.zero_vels(); }, targ);
+          if (dbl) {
+            InfluenceVisitor<double> visitor = {env};
+            for (auto const& src : _vort) std::visit(visitor, src, targ);
+            for (auto const& src : bdry) std::visit(visitor, src, targ);
+          } else {
+            InfluenceVisitor<float> visitor = {env};
+            for (auto const& src : _vort) std::visit(visitor, src, targ);
+            for (auto const& src : bdry) std::visit(visitor, src, targ);
+          }
+          std::visit([=](auto& elem) { elem.finalize_vels(_fs); }, targ);
+        }
+        err.seconds = std::min(err.seconds, std::chrono::duration<double>(Clock::now() - start).count());
+      }
+
+      double errsq = 0.0;
+      for (size_t t=0; t<work.size(); ++t) {
+        const std::array<Vector<S>,Dimensions>& vel = std::get<Points<S>>(work[t]).get_vel();
+        for (size_t i=0; i<refu[t].size(); ++i) {
+          const double du = vel[0][i] - (_fs[0] + factor*refu[t][i]);
+          const double dv = vel[1][i] - (_fs[1] + factor*refv[t][i]);
+          const double e2 = du*du + dv*dv;
+          errsq += e2;
+          err.max = std::max(err.max, std::sqrt(e2));
+        }
+      }
+      err.rms = std::sqrt(errsq / std::max((size_t)1, ntarg));
+      err.rel_rms = (refrms > 0.0) ? err.rms / refrms : 0.0;
+      results.push_back(err);
+    }
+  }
+
+  // mark the ones that nothing else beats on both time and error
+  for (auto& a : results) {
+    a.pareto = std::none_of(results.begin(), results.end(), [&](VelocityError const& b) {
+      return (b.seconds <= a.seconds and b.rms <= a.rms) and (b.seconds < a.seconds or b.rms < a.rms);
+    });
+  }
+  std::sort(results.begin(), results.end(),
+            [](VelocityError const& a, VelocityError const& b) { return a.seconds < b.seconds; });
+
+  return results;
+}
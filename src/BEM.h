@@ -8,6 +8,10 @@
 #pragma once
 
 #include "VectorHelper.h"
+#include "ExecEnv.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "Numa.h"
 
 #include <Eigen/Dense>
 #include <Eigen/IterativeLinearSolvers>		// for BiCGSTAB and GMRES
@@ -31,7 +35,11 @@
 template <class S, class I>
 class BEM {
 public:
-  BEM() : A_is_current(false), solver_initialized(false) {};
+#ifdef USE_VC
+  BEM() : A_is_current(false), solver_initialized(false), last_time(-99.9), instrs(cpu_vc) {};
+#else
+  BEM() : A_is_current(false), solver_initialized(false), last_time(-99.9), instrs(cpu_x86) {};
+#endif
 
   bool is_A_current() { return A_is_current; }
   void just_made_A() { A_is_current = true; }
@@ -46,17 +54,38 @@ public:
   std::vector<S> getStrengths();
   Vector<S> get_str(const size_t, const size_t);
 
+  // simulation time of the last solve, to know which blocks might have moved since
+  double get_last_time() const { return last_time; }
+  void set_last_time(const double _t) { last_time = _t; }
+
+  // instruction set for the influence calculations that set up the system
+  accel_t get_instrs() const { return instrs; }
+  void set_instrs(const accel_t _a) { instrs = _a; }
+
+  // memory held between steps, memory used only during a solve, and both for a system of n rows
+  size_t get_bytes() const { return (A.size() + b.size() + strengths.size() + A.rows()) * sizeof(S); }
+  size_t get_solve_bytes() const { return A.rows() * (gmres_restart + 9) * sizeof(S); }
+  static size_t estimate_bytes(const size_t _n) { return _n * (_n + 4 + gmres_restart + 9) * sizeof(S); }
+
 protected:
 
 private:
+  // Eigen's GMRES keeps this many Krylov vectors, plus a few more work vectors
+  static constexpr size_t gmres_restart = 30;
+
   // the actual matrix equation
   Eigen::Matrix<S, Eigen::Dynamic, Eigen::Dynamic> A;
   Eigen::Matrix<S, Eigen::Dynamic, 1> b;
   Eigen::Matrix<S, Eigen::Dynamic, 1> strengths;
 
+  // the Eigen solver object - persistent from call to call
+  Eigen::GMRES<Eigen::Matrix<S, Eigen::Dynamic, Eigen::Dynamic> > solver;
+
   // is the A matrix current?
   bool A_is_current;
   bool solver_initialized;
+  double last_time;
+  accel_t instrs;
 };
 
 // remove any memory and reset flags
@@ -112,7 +141,11 @@ void BEM<S,I>::set_block(const size_t rstart, const size_t nrows,
   const size_t new_rows = std::max((size_t)(A.rows()), (size_t)(rstart+nrows));
   const size_t new_cols = std::max((size_t)(A.cols()), (size_t)(cstart+ncols));
   //std::cout << "    resizing A to " << new_rows << " rows and " << new_cols << " cols" << std::endl;
-  A.conservativeResize(new_rows, new_cols);
+  if (new_rows != (size_t)A.rows() or new_cols != (size_t)A.cols()) {
+    A.conservativeResize(new_rows, new_cols);
+    // one thread reads all of it in the solver, so spread it over every socket
+    Numa::interleave(A.data(), A.size()*sizeof(S));
+  }
 
   size_t iptr = 0;
   for (size_t j=0; j<ncols; ++j) {
@@ -165,18 +198,12 @@ void BEM<S,I>::solve() {
     std::cout << "x is " << strengths.size() << std::endl;
   }
 
-  // the Eigen solver object - persistent from call to call
-  static Eigen::GMRES<Eigen::Matrix<S, Eigen::Dynamic, Eigen::Dynamic> > solver(A);
-
   if (not solver_initialized) {
 
     // if A changes, we need to re-run this
-    auto istart = std::chrono::system_clock::now();
+    ScopedTimer itimer("factor");
     solver.compute(A);
-    auto iend = std::chrono::system_clock::now();
-
-    std::chrono::duration<double> ielapsed_seconds = iend-istart;
-    printf("    solver.init:\t[%.6f] cpu seconds\n", (float)ielapsed_seconds.count());
+    itimer.report("solver.init");
 
     solver_initialized = true;
   }
@@ -185,11 +212,10 @@ void BEM<S,I>::solve() {
   // note that solveWithGuess() can seed the solution with last step's solution!
 
   // here is the matrix solution
-  auto start = std::chrono::system_clock::now();
+  ScopedTimer timer("solve");
+  MemoryTracker::note("bem solver workspace", get_solve_bytes());
   strengths = solver.solve(b);
-  auto end = std::chrono::system_clock::now();
-  std::chrono::duration<double> elapsed_seconds = end-start;
-  printf("    solver.solve:\t[%.6f] cpu seconds\n", (float)elapsed_seconds.count());
+  timer.report("solver.solve");
 
   if (VERBOSE) {
     const size_t nr = 20;
@@ -208,15 +234,13 @@ void BEM<S,I>::solve() {
   if (VERBOSE) printf("    estimated error: %g\n", solver.error());
 
   // find L2 norm of error
-  start = std::chrono::system_clock::now();
+  ScopedTimer etimer("error");
   //assert(b.norm() != 0 && "Can't divide by 0");
   // b.norm() is 0 for first computation, so we let it be one for the error computation
   double b_norm = b.norm(); // norm() is L2 norm
   if (b_norm == 0) { b_norm = 1.0; }
   double relative_error = (A*strengths - b).norm() / b_norm;
   if (VERBOSE) printf("    L2 norm of error is %g\n", relative_error);
-  end = std::chrono::system_clock::now();
-  elapsed_seconds = end-start;
-  if (VERBOSE) printf("    solver.error:\t[%.6f] cpu seconds\n", (float)elapsed_seconds.count());
+  if (VERBOSE) etimer.report("solver.error");
 }
 
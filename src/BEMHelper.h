@@ -14,7 +14,11 @@
 #include "Coefficients.h"
 #include "RHS.h"
 #include "BEM.h"
+#include "Distributed.h"
+#include "DistributedHelper.h"
 #include "ExecEnv.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
 
 #include <cstdlib>
 #include <iostream>
@@ -36,8 +40,10 @@ void solve_bem(const double                         _time,
   // no unknowns? no problem.
   if (_bdry.size() == 0) return;
 
-  // save the simulation time from the last time we entered this function
-  static double last_time = -99.9;
+  ScopedTimer btimer("bem");
+
+  // the simulation time from the last time we entered this function
+  const double last_time = _bem.get_last_time();
 
   // if this is the first time through after a reset, recalculate the row indices
   if (not _bem.is_A_current()) {
@@ -56,37 +62,48 @@ void solve_bem(const double                         _time,
 
   // need this for dispatching velocity influence calls, template param is accumulator type,
   //   member variable is default execution environment
-#ifdef USE_VC
-  InfluenceVisitor<A> ivisitor = {ExecEnv(true, direct, cpu_vc)};
-#else
-  InfluenceVisitor<A> ivisitor = {ExecEnv(true, direct, cpu_x86)};
-#endif
+  InfluenceVisitor<A> ivisitor = {ExecEnv(true, direct, _bem.get_instrs())};
   RHSVisitor rvisitor;
 
   //
   // update rhs first
   //
 
-  std::cout << "  Solving for BEM RHS" << std::endl;
+  TaskGroup::out() << "  Solving for BEM RHS" << std::endl;
+  ScopedTimer rtimer("rhs");
 
-  // loop over boundary collections
+  // transform the collections according to prescribed motion, Body is not thread-safe
   for (auto &targ : _bdry) {
-    std::cout << "  Solving for velocities on" << to_string(targ) << std::endl;
-
-    // transform the collection according to prescribed motion
     std::visit([=](auto& elem) { elem.transform(_time); }, targ);
+  }
 
-    // zero velocities
-    std::visit([=](auto& elem) { elem.zero_vels(); }, targ);
+  // the velocities from vorticity on each boundary collection are independent
+  TaskGroup rtasks;
+  for (auto &targ : _bdry) {
+    rtasks.run([&]() {
+      TaskGroup::out() << "  Solving for velocities on" << to_string(targ) << std::endl;
 
-    // accumulate from vorticity
-    for (auto &src : _vort) {
-      std::visit(ivisitor, src, targ);
-    }
+      // zero velocities
+      std::visit([=](auto& elem) { elem.zero_vels(); }, targ);
+
+      // accumulate from vorticity
+      for (auto &src : _vort) {
+        std::visit(ivisitor, src, targ);
+      }
+    });
+  }
+  rtasks.wait();
+
+  for (auto &targ : _bdry) {
+    // with several ranks, each found the velocities from only its own vortons
+    sum_vels<S>(targ);
 
     // divide by factor and add freestream
     std::visit([=](auto& elem) { elem.finalize_vels(_fs); }, targ);
+  }
 
+  // loop over boundary collections
+  for (auto &targ : _bdry) {
     // include the effects of the motion of the parent body
     std::visit([=](auto& elem) { elem.add_body_motion(-1.0, _time); }, targ);
 
@@ -112,19 +129,21 @@ void solve_bem(const double                         _time,
       // and include the error from the previous solve
       const S last_error = surf.get_last_body_circ_error();
 
-      // finally, find the amount of circulation re-absorbed by the body
-      const S absorbed_circ = surf.get_reabsorbed();
+      // finally, find the amount of circulation re-absorbed by the body (from every rank's vortons)
+      S absorbed_circ = surf.get_reabsorbed();
+      Distributed::sum(&absorbed_circ, 1);
 
       // combine and append
-      std::cout << "    components of rhs: " << self_circ << " " << absorbed_circ << " " << last_error << std::endl;
+      TaskGroup::out() << "    components of rhs: " << self_circ << " " << absorbed_circ << " " << last_error << std::endl;
       const S tot_circ = self_circ + absorbed_circ + last_error;
       rhs.push_back(tot_circ);
-      std::cout << "    augmenting rhs with tot_circ= " << tot_circ << std::endl;
+      TaskGroup::out() << "    augmenting rhs with tot_circ= " << tot_circ << std::endl;
     }
 
     // finally, send it to the BEM
     _bem.set_rhs(tstart, tnum, rhs);
   }
+  (void) rtimer.stop();
 
   //
   // rhs is done, update A matrix now
@@ -145,13 +164,13 @@ void solve_bem(const double                         _time,
   } else {
     // if this is the first call after a reset, we need to rebuild everything
     rebuild_every_block = true;
-    std::cout << "  Solving for BEM matrix" << std::endl;
+    TaskGroup::out() << "  Solving for BEM matrix" << std::endl;
   }
 
   // actually make or remake the A matrix
   if (rebuild_every_block or rebuild_some_blocks) {
 
-    auto start = std::chrono::system_clock::now();
+    ScopedTimer timer("assembly");
 
     // need this to inform bem that we need to re-init the solver
     _bem.panels_changed();
@@ -159,8 +178,17 @@ void solve_bem(const double                         _time,
     // this is the dispatcher for Points/Surfaces on Points/Surfaces
     CoefficientVisitor cvisitor;
 
+    // the blocks to build, each is computed as a task and set in the matrix in this order
+    struct Block {
+      size_t t, s;
+      size_t tstart, tnum, sstart, snum;
+      Vector<S> coeffs;
+    };
+    std::vector<Block> blocks;
+
     // loop over boundary collections
-    for (auto &targ : _bdry) {
+    for (size_t ti=0; ti<_bdry.size(); ++ti) {
+      auto &targ = _bdry[ti];
       //std::cout << "  Solving for influence coefficients on" << to_string(targ) << std::endl;
 
       // find portion of influence matrix
@@ -168,7 +196,8 @@ void solve_bem(const double                         _time,
       const size_t tnum = std::visit([=](auto& elem) { return elem.get_num_rows(); }, targ);
 
       // assemble from all boundaries
-      for (auto &src : _bdry) {
+      for (size_t si=0; si<_bdry.size(); ++si) {
+        auto &src = _bdry[si];
 
         // should we build/rebuild this block of the A matrix?
         bool rebuild_this_block = rebuild_every_block;
@@ -183,38 +212,59 @@ void solve_bem(const double                         _time,
           // find portion of influence matrix
           const size_t sstart = std::visit([=](auto& elem) { return elem.get_first_row(); }, src);
           const size_t snum = std::visit([=](auto& elem) { return elem.get_num_rows(); }, src);
-          std::cout << "  Computing A matrix block [" << tstart << ":" << (tstart+tnum) << "] x [" << sstart << ":" << (sstart+snum) << "]" << std::endl;
-
-          // for augmentation, find the induced velocity from the source on the target
-          if (std::visit([=](auto& elem) { return elem.is_augmented(); }, src)) {
-            std::visit([=](auto& elem) { elem.zero_vels(); }, targ);
-            std::visit([=](auto& elem) { elem.zero_strengths(); }, src);
-            std::visit([=](auto& elem) { elem.add_unit_rot_strengths(); }, src);
-            std::visit(ivisitor, src, targ);
-            std::visit([=](auto& elem) { elem.zero_strengths(); }, src);
-            std::visit([=](auto& elem) { elem.finalize_vels(std::array<double,Dimensions>({0.0,0.0})); }, targ);
-          }
-
-          // solve for the coefficients in this block
-          Vector<S> coeffs = std::visit(cvisitor, src, targ);
-          assert(coeffs.size() == tnum*snum && "Number of coefficients does not match predicted");
-          // targets are rows, sources are cols
-          _bem.set_block(tstart, tnum, sstart, snum, coeffs);
+          TaskGroup::out() << "  Computing A matrix block [" << tstart << ":" << (tstart+tnum) << "] x [" << sstart << ":" << (sstart+snum) << "]" << std::endl;
+          blocks.push_back({ti, si, tstart, tnum, sstart, snum, Vector<S>()});
         }
       }
     }
 
+    // blocks only read the geometry, except that augmented sources need the velocity of
+    //   their unit rotation on the target: find that on copies, so blocks stay independent
+    TaskGroup atasks;
+    for (auto &blk : blocks) {
+      atasks.run([&]() {
+        Collection& targ = _bdry[blk.t];
+        Collection const& src = _bdry[blk.s];
+
+        if (std::visit([=](auto& elem) { return elem.is_augmented(); }, src)) {
+          Collection usrc = src;
+          Collection utarg = targ;
+          std::visit([=](auto& elem) { elem.zero_vels(); }, utarg);
+          std::visit([=](auto& elem) { elem.zero_strengths(); }, usrc);
+          std::visit([=](auto& elem) { elem.add_unit_rot_strengths(); }, usrc);
+          std::visit(ivisitor, usrc, utarg);
+          std::visit([=](auto& elem) { elem.finalize_vels(std::array<double,Dimensions>({0.0,0.0})); }, utarg);
+
+          // solve for the coefficients in this block, diagonal blocks are found by address
+          Collection const& csrc = (blk.s == blk.t) ? utarg : src;
+          blk.coeffs = std::visit(cvisitor, csrc, utarg);
+        } else {
+          blk.coeffs = std::visit(cvisitor, src, targ);
+        }
+        assert(blk.coeffs.size() == blk.tnum*blk.snum && "Number of coefficients does not match predicted");
+      });
+    }
+    atasks.wait();
+
+    for (auto &blk : blocks) {
+      // the augmented sources end with no strength, as they would have in place
+      if (std::visit([=](auto& elem) { return elem.is_augmented(); }, _bdry[blk.s])) {
+        std::visit([=](auto& elem) { elem.zero_strengths(); }, _bdry[blk.s]);
+      }
+      // targets are rows, sources are cols
+      _bem.set_block(blk.tstart, blk.tnum, blk.sstart, blk.snum, blk.coeffs);
+      blk.coeffs = Vector<S>();
+    }
+
     _bem.just_made_A();
 
-    auto end = std::chrono::system_clock::now();
-    std::chrono::duration<double> elapsed_seconds = end-start;
-    printf("    make A matrix:\t[%.4f] cpu seconds\n", (float)elapsed_seconds.count());
+    timer.report("make A matrix");
   }
 
   //
   // solve here
   //
-  std::cout << "  Solving BEM for strengths" << std::endl;
+  TaskGroup::out() << "  Solving BEM for strengths" << std::endl;
   _bem.solve();
   //
   //
@@ -231,9 +281,9 @@ void solve_bem(const double                         _time,
 
     // debug print
     if (false) {
-      std::cout << "  Solution vector contains" << std::endl;
+      TaskGroup::out() << "  Solution vector contains" << std::endl;
       for (size_t i=tstart; i<tstart+tnum; ++i) {
-        std::cout << "    " << i << " \t" << new_s[i-tstart] << std::endl;
+        TaskGroup::out() << "    " << i << " \t" << new_s[i-tstart] << std::endl;
       }
     }
 
@@ -242,6 +292,6 @@ void solve_bem(const double                         _time,
   }
 
   // save the simulation time to compare to the next call
-  last_time = _time;
+  _bem.set_last_time(_time);
 }
 
@@ -0,0 +1,437 @@
+/*
+ * BatchRunner.cpp - Run one simulation from json to completion, without a GUI
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "BatchRunner.h"
+#include "FlowFeature.h"
+#include "BoundaryFeature.h"
+#include "MeasureFeature.h"
+#include "Simulation.h"
+#include "JsonHelper.h"
+#include "RenderParams.h"
+#include "Roofline.h"
+#include "MemoryTracker.h"
+#include "ThreadPool.h"
+#include "Distributed.h"
+#include "Numa.h"
+
+#ifdef _WIN32
+  // for C++11 stuff
+  #include <ciso646>
+#endif
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <chrono>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+
+
+nlohmann::json
+BatchResult::to_json() const {
+  nlohmann::json j;
+  j["name"] = name;
+  j["dir"] = dir;
+  if (not params.is_null()) j["params"] = params;
+  j["status"] = (status == 0) ? "ok" : "error";
+  if (not error.empty()) j["error"] = error;
+  j["steps"] = nstep;
+  j["time"] = time;
+  j["particles"] = nparts;
+  j["panels"] = npanels;
+  j["fieldPoints"] = nfldpts;
+  j["threads"] = threads;
+  j["wallSeconds"] = wall_seconds;
+  j["particleSteps"] = particle_steps;
+  j["peakMemoryMB"] = to_mb(peak_bytes);
+  return j;
+}
+
+std::string
+BatchOptions::usage(const std::string _exe) {
+  std::stringstream ss;
+  ss << std::endl << "Usage:" << std::endl;
+  ss << "  " << _exe << " [options] filename.json [checkpoint.o2c]" << std::endl;
+  ss << "  " << _exe << " [options] ensemble.json" << std::endl;
+  ss << "  " << _exe << " [options] --replay run.o2ts filename.json" << std::endl << std::endl;
+  ss << "Options, which override the json file:" << std::endl;
+  ss << "  --summation direct|treecode|vic|fmm    velocity summation method" << std::endl;
+  ss << "  --accel x86|vc|opengl|cuda             instructions for the influence calculations" << std::endl;
+  ss << "  --threads N                            threads (total, for an ensemble)" << std::endl;
+  ss << "  --output-dt X                          time between output files, 0 for none" << std::endl;
+  ss << "  --diffusion vrm|pse|random|corespread|none" << std::endl;
+  ss << "  --trace FILE                           write timed phases for chrome://tracing" << std::endl;
+  ss << "  --perf-counters                        hardware counters per phase (Linux)" << std::endl;
+  ss << "  --kernel-report                        kernel rates against this node's roofline" << std::endl;
+  ss << "  --reproducible                         seed every random feature, for bitwise-identical runs" << std::endl;
+  ss << "  --pin-threads none|compact|spread      keep threads on cpus, and arrays near them" << std::endl;
+  ss << "  --memory-budget MB                     refuse to start a run that needs more (total, for an ensemble)" << std::endl;
+  ss << "  --max-steps N                          stop after this step" << std::endl;
+  ss << "  --verify-accuracy FILE                 at the end, compare velocity methods to a precise sum" << std::endl;
+  ss << "  --replay FILE                          move only the tracers, through the frames of this series" << std::endl;
+  ss << "  --help" << std::endl;
+  return ss.str();
+}
+
+//
+// read the command line, positional arguments are the input file and the checkpoint
+//
+std::string
+BatchOptions::parse(const int _argc, char const* _argv[]) {
+
+  std::vector<std::string> positional;
+  for (int i=1; i<_argc; ++i) {
+    const std::string arg = _argv[i];
+    if (arg.size() < 2 or arg.substr(0,2) != "--") {
+      positional.push_back(arg);
+      continue;
+    }
+    if (arg == "--help") return "help";
+    if (arg == "--perf-counters") {
+      perf_counters = true;
+      continue;
+    }
+    if (arg == "--kernel-report") {
+      kernel_report = true;
+      continue;
+    }
+    if (arg == "--reproducible") {
+      reproducible = true;
+      continue;
+    }
+
+    // every other option takes a value
+    if (i+1 >= _argc) return "Option " + arg + " needs a value";
+    const std::string val = _argv[++i];
+
+    try {
+      if (arg == "--summation") {
+        summation_t s;
+        if (not summation_from_string(val, s)) return "Unknown summation method " + val;
+        summation = s;
+      } else if (arg == "--accel") {
+        accel_t a;
+        if (not accel_from_string(val, a)) return "Unknown acceleration " + val;
+        accel = a;
+      } else if (arg == "--threads") {
+        threads = std::stoi(val);
+        if (threads < 1) return "Thread count must be positive";
+      } else if (arg == "--output-dt") {
+        output_dt = std::stod(val);
+        if (*output_dt < 0.0) return "Output dt can not be negative";
+      } else if (arg == "--diffusion") {
+        diffusion = val;
+      } else if (arg == "--trace") {
+        trace = val;
+      } else if (arg == "--max-steps") {
+        const long ms = std::stol(val);
+        if (ms < 0) return "Max steps can not be negative";
+        max_steps = (size_t)ms;
+      } else if (arg == "--verify-accuracy") {
+        accuracy = val;
+      } else if (arg == "--replay") {
+        replay = val;
+      } else if (arg == "--pin-threads") {
+        pin_threads = val;
+      } else if (arg == "--memory-budget") {
+        memory_budget = std::stod(val);
+        if (memory_budget <= 0.0) return "Memory budget must be positive";
+      } else {
+        return "Unknown option " + arg;
+      }
+    } catch (std::exception const&) {
+      return "Bad value " + val + " for " + arg;
+    }
+  }
+
+  if (positional.empty() or positional.size() > 2) return "Need one input file, and optionally a checkpoint";
+  input = positional[0];
+  if (positional.size() == 2) restart = positional[1];
+  if (not replay.empty() and not restart.empty()) return "A replay can not start from a checkpoint";
+
+  return validate();
+}
+
+//
+// check the overrides against what this executable can do
+//
+std::string
+BatchOptions::validate() const {
+
+  ExecEnv env;
+  if (summation) env.set_summation(*summation);
+  if (accel) env.set_instrs(*accel);
+  std::string why;
+  if (not env.is_available(why)) return "Can not run" + env.to_string() + ": " + why;
+
+  if (not diffusion.empty() and diffusion != "vrm" and diffusion != "pse" and diffusion != "random"
+      and diffusion != "corespread" and diffusion != "none") {
+    return "Unknown diffusion method " + diffusion;
+  }
+
+  if (not pin_threads.empty() and pin_threads != "none" and pin_threads != "compact"
+      and pin_threads != "spread") {
+    return "Unknown thread pinning " + pin_threads;
+  }
+
+  return "";
+}
+
+// the task pool runs collection pairs at once, with or without OpenMP; it is shared by
+//   every simulation in the process, so this is not part of apply()
+void
+BatchOptions::size_pool() const {
+  if (threads > 0) ThreadPool::get().set_num_threads(threads);
+}
+
+void
+BatchOptions::apply(Simulation& _sim) const {
+
+  ExecEnv env = _sim.get_exec_env();
+  if (summation) env.set_summation(*summation);
+  if (accel) env.set_instrs(*accel);
+  _sim.set_exec_env(env);
+
+  if (not diffusion.empty()) (void) _sim.set_diffusion_method(diffusion);
+  if (output_dt) _sim.set_output_dt(*output_dt);
+  if (not trace.empty()) _sim.set_trace_file(trace);
+  if (perf_counters) (void) _sim.set_perf_counters(true);
+  if (kernel_report) _sim.set_kernel_report(true);
+  // ranks of an MPI run must make exactly the same choices
+  if (reproducible or Distributed::is_on()) _sim.set_reproducible(true);
+  if (memory_budget > 0.0) _sim.set_memory_budget((size_t)(memory_budget * 1024.0 * 1024.0));
+  if (max_steps) _sim.set_max_steps(*max_steps);
+
+#ifdef _OPENMP
+  // thread count is per calling thread, so each ensemble member gets its own share
+  if (threads > 0) omp_set_num_threads(threads);
+#endif
+
+  // pin again, now that the thread counts are known
+  if (not pin_threads.empty()) (void) _sim.set_thread_pinning(pin_threads);
+  else if (_sim.get_thread_pinning() != "none") (void) _sim.set_thread_pinning(_sim.get_thread_pinning());
+}
+
+BatchResult
+run_batch(nlohmann::json const& _j, const std::string _outdir, BatchOptions const& _opts,
+          volatile std::sig_atomic_t const* _stop) {
+
+  auto start = std::chrono::steady_clock::now();
+  BatchResult res;
+  res.dir = _outdir;
+
+  // Set up vortex particle simulation
+  Simulation sim;
+  std::vector< std::unique_ptr<FlowFeature> > ffeatures;
+  std::vector< std::unique_ptr<BoundaryFeature> > bfeatures;
+  std::vector< std::unique_ptr<MeasureFeature> > mfeatures;
+  RenderParams rparams;
+
+  // a string to hold any error messages
+  std::string sim_err_msg;
+
+  sim.set_output_dir(_outdir);
+  // other cases may be running on other threads, with their own seeds
+  sim.claim_random_seeds();
+  parse_json(sim, ffeatures, bfeatures, mfeatures, rparams, _j);
+  _opts.apply(sim);
+
+  // say what will actually run
+#ifdef _OPENMP
+  res.threads = omp_get_max_threads();
+#else
+  res.threads = (int)ThreadPool::get().get_num_threads();
+#endif
+  std::cout << std::endl << "Execution environment:" << sim.get_exec_env().to_string() << std::endl;
+  std::cout << "  threads " << res.threads << ", diffusion " << sim.get_diffusion_method()
+            << ", output dt " << sim.get_output_dt() << std::endl;
+  if (Distributed::is_on()) {
+    std::cout << "  MPI ranks " << Distributed::size() << ", each with its own patch of the vortons" << std::endl;
+    // no rank holds all of the vortons to interpolate from
+    if (sim.using_tracer_interp()) std::cout << "  tracer velocities are summed, not interpolated, with MPI" << std::endl;
+  }
+  if (sim.get_thread_pinning() != "none") std::cout << "  " << Numa::report() << std::endl;
+
+  // the ceilings for the kernel report, once per process and before the run, if wanted
+  if (sim.wants_kernel_report()) (void) Roofline::get();
+
+  std::cout << std::endl << "Initializing simulation" << std::endl;
+
+  // initialize particle distributions
+  for (auto const& ff: ffeatures) {
+    if (ff->is_enabled()) {
+      ElementPacket<float> newpacket = ff->init_elements(sim.get_ips());
+      sim.add_elements( newpacket, active, lagrangian, ff->get_body() );
+    }
+  }
+
+  // initialize solid objects
+  for (auto const& bf : bfeatures) {
+    if (bf->is_enabled()) {
+      ElementPacket<float> newpacket = bf->init_elements(sim.get_ips());
+      const move_t newmovetype = (bf->get_body() ? bodybound : fixed);
+      sim.add_elements(newpacket, reactive, newmovetype, bf->get_body() );
+    }
+  }
+
+  // initialize measurement features
+  for (auto const& mf: mfeatures) {
+    if (mf->is_enabled()) {
+      const move_t newMoveType = (mf->get_is_lagrangian() ? lagrangian : fixed);
+      sim.add_elements( mf->init_elements(rparams.tracer_scale*sim.get_ips()), inert, newMoveType, mf->get_body(),
+                        mf->get_update_every() );
+    }
+  }
+
+  sim.set_initialized();
+
+  // check init for blow-up or errors
+  sim_err_msg = sim.check_initialization();
+
+  if (not sim_err_msg.empty()) {
+    // the initialization had some difficulty
+    std::cout << std::endl << "ERROR: " << sim_err_msg;
+    res.status = 1;
+    res.error = sim_err_msg;
+    return res;
+  }
+
+  // replace the initial elements and clock with those from the checkpoint
+  if (not _opts.restart.empty()) {
+    try {
+      sim.read_checkpoint(_opts.restart);
+    } catch (std::exception const& e) {
+      std::cout << std::endl << "ERROR: " << e.what() << std::endl;
+      res.status = 1;
+      res.error = e.what();
+      return res;
+    }
+  }
+
+
+  //
+  // Main loop
+  //
+
+  // next time to write output files, if outputDt was set (later than now, in case of a restart)
+  double next_output_time = 0.0;
+  if (sim.get_output_dt() > 0.0) {
+    next_output_time = sim.get_output_dt() * std::ceil((sim.get_time() + 0.5*sim.get_dt()) / sim.get_output_dt());
+  }
+
+  while (true) {
+
+    // check flow for blow-up or errors
+    sim_err_msg = sim.check_simulation();
+
+    if (sim_err_msg.empty()) {
+      // the last simulation step was fine, OK to continue
+      // generate new particles from emitters
+      for (auto const& ff: ffeatures) {
+        if (ff->is_enabled()) {
+          ElementPacket<float> newpacket = ff->step_elements(sim.get_ips());
+          sim.add_elements( newpacket, active, lagrangian, ff->get_body() );
+        }
+      }
+
+      for (auto const& mf: mfeatures) {
+        if (mf->is_enabled()) {
+          const move_t newMoveType = (mf->get_is_lagrangian() ? lagrangian : fixed);
+          sim.add_elements( mf->step_elements(rparams.tracer_scale*sim.get_ips()), inert, newMoveType, mf->get_body(),
+                            mf->get_update_every() );
+        }
+      }
+
+      // begin a new dynamic step: convection and diffusion
+      res.particle_steps += (double)(sim.get_nparts() + sim.get_nfldpts());
+      sim.step();
+    } else {
+      // the last step had some difficulty
+      std::cout << std::endl << "ERROR: " << sim_err_msg;
+      res.status = 1;
+      res.error = sim_err_msg;
+
+      // stop the run
+      break;
+    }
+
+    // export data files at this step? (written in the background while the next step runs)
+    if (sim.get_output_dt() > 0.0 and sim.get_time() + 0.5*sim.get_dt() >= next_output_time) {
+      if (sim.using_series()) sim.write_series();
+      else (void) sim.write_vtk();
+      if (sim.using_grid_output()) (void) sim.write_grid();
+      if (sim.using_png_output()) (void) sim.write_png(rparams);
+      next_output_time += sim.get_output_dt();
+    }
+
+    // save the full state every few steps, or if we've been told to stop (any rank may be)
+    const bool stop_requested = Distributed::any(_stop and *_stop);
+    if (sim.is_checkpoint_step() or stop_requested) {
+      std::string ckpt_err;
+      try {
+        sim.write_checkpoint();
+      } catch (std::exception const& e) {
+        ckpt_err = e.what();
+      }
+      // only the first rank writes, so every rank must learn if it failed
+      if (Distributed::any(not ckpt_err.empty())) {
+        if (ckpt_err.empty()) ckpt_err = "checkpoint failed on another rank";
+        std::cout << std::endl << "ERROR: " << ckpt_err << std::endl;
+        res.status = 1;
+        res.error = ckpt_err;
+        break;
+      }
+    }
+    if (stop_requested) {
+      std::cout << std::endl << "Received SIGTERM, stopping at step " << sim.get_nstep() << std::endl;
+      res.status = 2;
+      res.error = "stopped by signal";
+      break;
+    }
+
+    // check vs. stopping conditions
+    if (sim.test_vs_stop()) break;
+
+  } // end step
+
+  // make sure all output is on disk
+  sim.flush_output();
+  std::cout << std::endl << sim.output_report() << std::endl;
+  sim.write_profile();
+  if (Distributed::is_on()) std::cout << std::endl << Distributed::report() << std::endl;
+  if (sim.get_thread_pinning() != "none") std::cout << std::endl << Numa::report() << std::endl;
+
+  res.nstep = sim.get_nstep();
+  res.time = sim.get_time();
+  res.nparts = sim.get_nparts();
+  res.npanels = sim.get_npanels();
+  res.nfldpts = sim.get_nfldpts();
+  res.peak_bytes = sim.get_peak_memory();
+  res.phases = sim.get_phase_totals();
+
+  // how well does each velocity method do on the final state? (every rank sends its
+  //   vortons to the first, which checks and writes)
+  if (not _opts.accuracy.empty() and res.status == 0) {
+    const nlohmann::json acc = sim.check_accuracy();
+    if (Distributed::is_root()) {
+      std::ofstream out(sim.out_path(_opts.accuracy));
+      out << std::setw(2) << acc << std::endl;
+      std::cout << "Wrote " << sim.out_path(_opts.accuracy) << std::endl;
+    }
+  }
+
+  sim.reset();
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  res.wall_seconds = elapsed.count();
+  return res;
+}
@@ -0,0 +1,89 @@
+/*
+ * BatchRunner.h - Run one simulation from json to completion, without a GUI
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include "ExecEnv.h"
+#include "json/json.hpp"
+
+#include <csignal>
+#include <map>
+#include <optional>
+#include <string>
+
+class Simulation;
+
+
+//
+// Settings from the command line, which override the json input without changing it
+//
+struct BatchOptions {
+  std::string input;
+  std::string restart;
+  std::optional<summation_t> summation;
+  std::optional<accel_t> accel;
+  int threads = 0;			// 0 leaves the OpenMP default alone
+  std::optional<double> output_dt;	// 0 writes no output files
+  std::string diffusion;		// as in the "viscous" json key
+  std::string trace;			// chrome://tracing file of every timed phase
+  bool perf_counters = false;		// hardware counters per phase, Linux only
+  bool kernel_report = false;		// kernel rates against this node's roofline
+  bool reproducible = false;		// same results for any thread count
+  std::string pin_threads;		// none, compact or spread, blank leaves the json's
+  double memory_budget = 0.0;		// in MB, 0 uses most of the node
+  std::optional<size_t> max_steps;
+  std::string accuracy;			// check velocity methods at the end, results to this file
+  std::string replay;			// advect the json's tracers through this series, see Replay.h
+
+  // both return an error message, or blank if all is well
+  std::string parse(const int, char const*[]);
+  std::string validate() const;
+
+  // size the task pool, once, before any simulation exists
+  void size_pool() const;
+
+  // change a freshly-parsed simulation, and set the OpenMP thread count for this thread
+  void apply(Simulation&) const;
+
+  static std::string usage(const std::string);
+};
+
+
+//
+// What came of one batch run, for the ensemble summary
+//
+struct BatchResult {
+  std::string name;
+  std::string dir;
+  nlohmann::json params;	// the values varied for this case, if any
+  int status = 0;		// 0 is success
+  std::string error;
+  size_t nstep = 0;
+  double time = 0.0;
+  size_t nparts = 0;
+  size_t npanels = 0;
+  size_t nfldpts = 0;
+  int threads = 0;
+  double wall_seconds = 0.0;
+  double particle_steps = 0.0;	// particles and field points advanced, summed over steps
+  size_t peak_bytes = 0;
+  std::map<std::string,double> phases;	// seconds in each timed phase
+
+  nlohmann::json to_json() const;
+};
+
+//
+// Set up a simulation from a parsed json file and step it until it stops
+//
+// All output goes into _outdir (blank for the working directory), the options are
+//   applied over the json, and a checkpoint is loaded first if the options name one.
+//   The run stops early, with a checkpoint, if *_stop becomes nonzero. Nothing here is
+//   shared with other runs, so several of these may go at once on different threads.
+//
+BatchResult run_batch(nlohmann::json const&, const std::string _outdir = "",
+                      BatchOptions const& _opts = BatchOptions(),
+                      volatile std::sig_atomic_t const* _stop = nullptr);
@@ -0,0 +1,285 @@
+/*
+ * Benchmark.cpp - A fixed set of simulations for tracking performance over time
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "Benchmark.h"
+#include "Roofline.h"
+
+#ifdef _WIN32
+  // for C++11 stuff
+  #include <ciso646>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+using json = nlohmann::json;
+
+
+// every case takes this many steps, enough to get past the first-step setup
+static constexpr int bench_steps = 10;
+
+// ignore phases shorter than this when comparing, they are mostly noise
+static constexpr double min_phase_seconds = 0.02;
+// and compare only the top levels inside a step, like "step/diffusion/bem"
+static constexpr long max_phase_depth = 2;
+
+//
+// the parts every case shares
+//
+static json base_case(const double _re, const double _dt, const std::string _viscous, const double _uinf) {
+  json j;
+  j["version"] = { {"Omega2D", 1}, {"jsonInput", 1} };
+  j["flowparams"] = { {"Re", _re}, {"Uinf", {_uinf, 0.0}} };
+  j["simparams"] = { {"nominalDt", _dt}, {"maxSteps", bench_steps}, {"outputDt", 0.0}, {"viscous", _viscous},
+                     {"VRM", { {"ignoreBelow", 1.e-5}, {"relativeThresholds", true} }} };
+  j["flowstructures"] = json::array();
+  j["bodies"] = json::array();
+  return j;
+}
+
+// nominal particle spacing is sqrt(8) * sqrt(dt/Re), so this is the Re that
+//   puts about _n elements along a length, or over an area if _area is set
+static double re_for_count(const double _n, const double _size, const double _dt, const bool _area) {
+  const double ips = _area ? std::sqrt(_size / _n) : _size / _n;
+  return 8.0 * _dt / (ips*ips);
+}
+
+static json inviscid_case(const int _n) {
+  json j = base_case(100.0, 0.005, "none", 0.0);
+  j["flowstructures"].push_back({ {"type", "block of random"}, {"center", {0.0, 0.0}}, {"size", {2.0, 2.0}},
+                                  {"num", _n}, {"strength range", {-1.0, 1.0}} });
+  return j;
+}
+
+static json vrm_case(const int _n) {
+  // the blob's area out to the edge of its soft shell
+  const double area = M_PI * 0.4 * 0.4;
+  const double dt = 0.02;
+  json j = base_case(re_for_count(_n, area, dt, true), dt, "vrm", 0.0);
+  j["flowstructures"].push_back({ {"type", "vortex blob"}, {"center", {0.0, 0.0}}, {"radius", 0.3},
+                                  {"softness", 0.1}, {"strength", 1.0} });
+  return j;
+}
+
+static json bem_case(const int _n) {
+  // one panel per nominal particle spacing along a unit-diameter circle
+  const double dt = 0.02;
+  json j = base_case(re_for_count(_n, M_PI, dt, false), dt, "vrm", 1.0);
+  json mesh = { {"geometry", "circle"}, {"external", true}, {"scale", 1.0}, {"translation", {0.0, 0.0}} };
+  j["bodies"].push_back({ {"name", "ground"}, {"translation", {0.0, 0.0}}, {"rotation", 0.0},
+                          {"meshes", {mesh}} });
+  return j;
+}
+
+static json moving_case(const int _n) {
+  // two ovals of about 2.1 perimeter each
+  const double dt = 0.01;
+  json j = base_case(re_for_count(_n, 4.2, dt, false), dt, "vrm", 0.0);
+  json mesh1 = { {"geometry", "oval"}, {"external", true}, {"rotation", 0.0}, {"scale", {1.0, 0.1}},
+                 {"translation", {0.0, 0.0}} };
+  json mesh2 = mesh1;
+  mesh2["rotation"] = 90.0;
+  j["bodies"].push_back({ {"name", "left"}, {"translation", {"0.0", "0.0"}}, {"rotation", "t"},
+                          {"meshes", {mesh1}} });
+  j["bodies"].push_back({ {"name", "right"}, {"translation", {"0.6", "0.0"}}, {"rotation", "-t"},
+                          {"meshes", {mesh2}} });
+  return j;
+}
+
+static json tracers_case(const int _n) {
+  // a light inviscid vortex pair, and _n tracers on a 2x2 grid around it
+  json j = base_case(256.0, 0.02, "none", 0.0);
+  j["flowstructures"].push_back({ {"type", "vortex blob"}, {"center", {0.0, 0.5}}, {"radius", 0.3},
+                                  {"softness", 0.1}, {"strength", 1.0} });
+  j["flowstructures"].push_back({ {"type", "vortex blob"}, {"center", {0.0, -0.5}}, {"radius", 0.3},
+                                  {"softness", 0.1}, {"strength", -1.0} });
+  const double dx = 2.0 / std::sqrt((double)_n);
+  j["measurements"] = json::array();
+  j["measurements"].push_back({ {"type", "measurement grid"}, {"start", {-1.0, -1.0}}, {"end", {1.0, 1.0}},
+                                {"dx", dx}, {"lagrangian", true}, {"enabled", true} });
+  return j;
+}
+
+void
+Benchmark::make_cases(const bool _full, const std::string _outdir) {
+  cases.clear();
+  full = _full;
+
+  // the particle-only cases cost N^2 with direct summation, so they stay smaller
+  const std::vector<int> psizes = _full ? std::vector<int>({4000, 16000, 32000}) : std::vector<int>({2000, 8000});
+  const std::vector<int> bsizes = _full ? std::vector<int>({500, 1000, 2000}) : std::vector<int>({250, 500});
+  const std::vector<int> tsizes = _full ? std::vector<int>({16000, 64000, 256000}) : std::vector<int>({10000, 40000});
+
+  auto add = [&](const std::string _family, const int _n, json const& _input) {
+    EnsembleCase c;
+    c.name = _family + "_" + std::to_string(_n);
+    c.dir = _outdir.empty() ? c.name : _outdir + "/" + c.name;
+    c.input = _input;
+    c.input["description"] = "Benchmark " + c.name;
+    c.params = { {"family", _family}, {"n", _n} };
+    cases.push_back(c);
+  };
+
+  for (const int n : psizes) add("inviscid", n, inviscid_case(n));
+  for (const int n : psizes) add("vrm", n, vrm_case(n));
+  for (const int n : bsizes) add("bem", n, bem_case(n));
+  for (const int n : bsizes) add("moving", n, moving_case(n));
+  for (const int n : tsizes) add("tracers", n, tracers_case(n));
+}
+
+void
+Benchmark::select(const std::string _filter) {
+  only = _filter;
+  if (_filter.empty()) return;
+  cases.erase(std::remove_if(cases.begin(), cases.end(),
+                             [&](EnsembleCase const& c) { return c.name.find(_filter) == std::string::npos; }),
+              cases.end());
+}
+
+int
+Benchmark::run(BatchOptions const& _opts) {
+
+  auto start = std::chrono::steady_clock::now();
+
+  // measure the node first, it goes in the results so baselines from other nodes stand out
+  (void) Roofline::get();
+
+  results.assign(cases.size(), BatchResult());
+  int nfail = 0;
+  for (size_t i=0; i<cases.size(); ++i) {
+    std::filesystem::create_directories(cases[i].dir);
+    std::cout << std::endl << "Benchmark " << (i+1) << " of " << cases.size() << ": " << cases[i].name << std::endl;
+    try {
+      results[i] = run_batch(cases[i].input, cases[i].dir, _opts);
+    } catch (std::exception const& ex) {
+      results[i].status = 1;
+      results[i].error = ex.what();
+    }
+    results[i].name = cases[i].name;
+    results[i].dir = cases[i].dir;
+    results[i].params = cases[i].params;
+    if (results[i].status != 0) nfail++;
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  wall_seconds = elapsed.count();
+  return nfail;
+}
+
+json
+Benchmark::get_results() const {
+  json j;
+  Roofline const& rl = Roofline::get();
+  j["roofline"] = { {"gflops", rl.gflops}, {"gbs", rl.gbs}, {"threads", rl.threads} };
+  j["wallSeconds"] = wall_seconds;
+  // which cases were asked for, so a comparison knows which ones should be here
+  j["full"] = full;
+  j["only"] = only;
+
+  json jc = json::array();
+  for (auto const& r : results) {
+    json c = r.to_json();
+    c.erase("dir");
+    // the steps themselves, without setup and teardown
+    auto it = r.phases.find("step");
+    const double step_secs = (it == r.phases.end()) ? r.wall_seconds : it->second;
+    c["stepSeconds"] = step_secs;
+    c["particleStepsPerSecond"] = (step_secs > 0.0) ? r.particle_steps / step_secs : 0.0;
+    c["phases"] = r.phases;
+    jc.push_back(c);
+  }
+  j["cases"] = jc;
+  return j;
+}
+
+//
+// one line of the comparison, returns true if this is a regression
+//
+static bool compare_line(const std::string _what, const double _old, const double _new, const double _tol) {
+  const double change = (_old > 0.0) ? (_new - _old) / _old : 0.0;
+  const bool worse = (change > _tol);
+  std::cout << "  " << std::left << std::setw(48) << _what << std::right << std::fixed
+            << std::setw(12) << std::setprecision(4) << _old
+            << std::setw(12) << _new
+            << std::setw(9) << std::setprecision(1) << 100.0*change << "%"
+            << (worse ? "  REGRESSION" : "") << std::defaultfloat << std::setprecision(6) << std::endl;
+  return worse;
+}
+
+int
+Benchmark::compare(json const& _new, json const& _base, const double _tol) {
+
+  std::cout << std::endl << "Comparing against baseline, tolerance " << 100.0*_tol << "%" << std::endl;
+
+  // times only mean something against a baseline from a similar node
+  if (_new.count("roofline") and _base.count("roofline")) {
+    const double rf = _new["roofline"]["gflops"].get<double>() / _base["roofline"]["gflops"].get<double>();
+    const double rb = _new["roofline"]["gbs"].get<double>() / _base["roofline"]["gbs"].get<double>();
+    if (std::abs(rf - 1.0) > _tol or std::abs(rb - 1.0) > _tol) {
+      std::cout << "  Warning: this node's roofline differs from the baseline's (compute x" << rf
+                << ", bandwidth x" << rb << "), times may not be comparable" << std::endl;
+    }
+  }
+
+  std::cout << "  " << std::left << std::setw(48) << "case / measure" << std::right
+            << std::setw(12) << "baseline" << std::setw(12) << "now" << std::setw(10) << "change" << std::endl;
+
+  // the two sizes of matrix share no cases
+  if (_base.value("full", false) != _new.value("full", false)) {
+    std::cout << "  the baseline is from the " << (_base.value("full", false) ? "full" : "small")
+              << " matrix and these results are not, nothing to compare" << std::endl;
+    return 1;
+  }
+
+  // every baseline case that was asked for must have run, or it could hide a regression
+  const std::string only = _new.value("only", "");
+  int nworse = 0;
+  for (auto const& bc : _base["cases"]) {
+    const std::string name = bc["name"];
+    if (name.find(only) == std::string::npos) continue;
+    auto nc = std::find_if(_new["cases"].begin(), _new["cases"].end(),
+                           [&](json const& c) { return c["name"] == name; });
+    if (nc == _new["cases"].end()) {
+      std::cout << "  " << name << " is missing" << std::endl;
+      nworse++;
+      continue;
+    }
+
+    if ((*nc)["status"] != "ok") {
+      std::cout << "  " << name << " failed" << std::endl;
+      nworse++;
+      continue;
+    }
+
+    const double base_step = bc["stepSeconds"];
+    if (compare_line(name + " step s", base_step, (*nc)["stepSeconds"], _tol)) nworse++;
+    if (compare_line(name + " peak MB", bc["peakMemoryMB"], (*nc)["peakMemoryMB"], _tol)) nworse++;
+
+    // and each phase that took a noticeable share of the steps
+    for (auto const& [path, secs] : bc["phases"].items()) {
+      const double old_secs = secs.get<double>();
+      if (path.compare(0, 5, "step/") != 0 or std::count(path.begin(), path.end(), '/') > max_phase_depth) continue;
+      if (old_secs < min_phase_seconds or old_secs < 0.05 * base_step) continue;
+      // a phase that was renamed or removed is not a speed-up
+      if ((*nc)["phases"].count(path) == 0) {
+        std::cout << "    " << path << " is missing" << std::endl;
+        nworse++;
+        continue;
+      }
+      if (compare_line("  " + path, old_secs, (*nc)["phases"][path].get<double>(), _tol)) nworse++;
+    }
+  }
+
+  if (nworse == 0) std::cout << "No regressions" << std::endl;
+  else std::cout << nworse << " regressions" << std::endl;
+  return nworse;
+}
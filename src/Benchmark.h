@@ -0,0 +1,62 @@
+/*
+ * Benchmark.h - A fixed set of simulations for tracking performance over time
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include "BatchRunner.h"
+#include "Ensemble.h"
+#include "json/json.hpp"
+
+#include <string>
+#include <vector>
+
+
+//
+// The benchmark matrix: a few kinds of flow, each at several problem sizes
+//
+//   inviscid   - a random block of particles, no diffusion
+//   vrm        - a vortex blob diffusing with VRM
+//   bem        - flow over a circle, one fixed body
+//   moving     - two oval bodies spinning past each other
+//   tracers    - a vortex pair stirring a grid of Lagrangian tracers
+//
+// Each case is built here rather than read from a file, so the inputs change only
+//   with the code. The size N is the number of particles, panels, or tracers that
+//   the case is scaled by, and is approximate; the counts that actually ran are
+//   in the results.
+//
+// Cases run one at a time, with the whole node, and report their time in each phase,
+//   particle-steps per second, and peak memory. Results from two runs (usually this
+//   one and a baseline kept with the source) can then be compared.
+//
+class Benchmark {
+public:
+  Benchmark() = default;
+
+  // the small matrix runs in a minute or two, the full one is for release checks
+  void make_cases(const bool _full, const std::string _outdir);
+  // keep only cases whose names contain this
+  void select(const std::string);
+  size_t get_num_cases() const { return cases.size(); }
+
+  // run each case in turn, return the number that failed
+  int run(BatchOptions const& _opts = BatchOptions());
+
+  nlohmann::json get_results() const;
+
+  // print old against new for every case in both, return the number of regressions,
+  //   which are cases, phases, or memory that got worse by more than _tol (0.1 is 10%),
+  //   or baseline cases and phases that are missing from the new results
+  static int compare(nlohmann::json const& _new, nlohmann::json const& _base, const double _tol);
+
+private:
+  std::vector<EnsembleCase> cases;
+  std::vector<BatchResult> results;
+  double wall_seconds = 0.0;
+  bool full = false;
+  std::string only;
+};
@@ -508,7 +508,7 @@ SolidOval::init_elements(const float _ips) const {
   std::vector<Int>   idx(num_panels*2);
   std::vector<float> val(num_panels);
 
-  static float phi = 0.0;
+  static thread_local float phi = 0.0;
 
   // outside is to the left walking from one point to the next
   // so go CW around the circle starting at theta=0 (+x axis)
@@ -0,0 +1,161 @@
+/*
+ * Checkpoint.cpp - Binary, memory-mappable checkpoint files of the full simulation state
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "Checkpoint.h"
+
+#ifdef _WIN32
+  #include <ciso646>
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+
+static const char checkpoint_magic[8] = {'O','2','D','C','K','P','T','\0'};
+static const uint32_t checkpoint_endian = 0x01020304;
+static const size_t checkpoint_header_size = 32;
+
+//
+// write the header, metadata, and all arrays
+//
+void
+CheckpointWriter::write(const std::string _fn) {
+
+  const std::string json_str = meta.dump();
+  const uint64_t json_size = json_str.size();
+  const uint64_t data_offset = (checkpoint_header_size + json_size + checkpoint_align - 1)
+                               / checkpoint_align * checkpoint_align;
+
+  // write to a temporary file first, so that a crash mid-write leaves the old checkpoint intact
+  const std::string tmpfn = _fn + ".tmp";
+  std::FILE* fp = std::fopen(tmpfn.c_str(), "wb");
+  if (not fp) throw std::runtime_error("Could not open checkpoint file " + tmpfn);
+
+  const char zeros[checkpoint_align] = {0};
+  bool good = true;
+
+  // header
+  good &= (std::fwrite(checkpoint_magic, 1, 8, fp) == 8);
+  good &= (std::fwrite(&checkpoint_version, sizeof(uint32_t), 1, fp) == 1);
+  good &= (std::fwrite(&checkpoint_endian, sizeof(uint32_t), 1, fp) == 1);
+  good &= (std::fwrite(&json_size, sizeof(uint64_t), 1, fp) == 1);
+  good &= (std::fwrite(&data_offset, sizeof(uint64_t), 1, fp) == 1);
+
+  // metadata and padding
+  good &= (std::fwrite(json_str.data(), 1, json_size, fp) == json_size);
+  const size_t hpad = data_offset - checkpoint_header_size - json_size;
+  if (hpad > 0) good &= (std::fwrite(zeros, 1, hpad, fp) == hpad);
+
+  // arrays, in the order they were added, each padded to the alignment
+  for (auto const& a : arrays) {
+    if (a.nbytes > 0) good &= (std::fwrite(a.ptr, 1, a.nbytes, fp) == a.nbytes);
+    const size_t apad = (checkpoint_align - a.nbytes % checkpoint_align) % checkpoint_align;
+    if (apad > 0) good &= (std::fwrite(zeros, 1, apad, fp) == apad);
+  }
+
+  good &= (std::fflush(fp) == 0);
+#ifndef _WIN32
+  // make sure it's really on disk before we replace the old one
+  good &= (fsync(fileno(fp)) == 0);
+#endif
+  good &= (std::fclose(fp) == 0);
+
+  if (not good) {
+    std::remove(tmpfn.c_str());
+    throw std::runtime_error("Error writing checkpoint file " + tmpfn);
+  }
+
+#ifdef _WIN32
+  // rename will not replace an existing file on Windows
+  std::remove(_fn.c_str());
+#endif
+  if (std::rename(tmpfn.c_str(), _fn.c_str()) != 0) {
+    throw std::runtime_error("Could not rename checkpoint file to " + _fn);
+  }
+}
+
+
+//
+// open and map a checkpoint file, check the header, and parse the metadata
+//
+CheckpointReader::CheckpointReader(const std::string _fn)
+  : base(nullptr),
+    size(0),
+    data_offset(0),
+    version(0),
+    meta(),
+    is_mapped(false),
+    buffer()
+{
+#ifdef _WIN32
+  // no mmap, so just read it all in
+  std::ifstream infile(_fn, std::ios::binary | std::ios::ate);
+  if (not infile) throw std::runtime_error("Could not open checkpoint file " + _fn);
+  size = infile.tellg();
+  buffer.resize(size);
+  infile.seekg(0);
+  infile.read(buffer.data(), size);
+  base = buffer.data();
+#else
+  const int fd = open(_fn.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("Could not open checkpoint file " + _fn);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error("Could not stat checkpoint file " + _fn);
+  }
+  size = st.st_size;
+  void* addr = (size > 0) ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (addr == MAP_FAILED) throw std::runtime_error("Could not map checkpoint file " + _fn);
+  base = static_cast<const char*>(addr);
+  is_mapped = true;
+#endif
+
+  // check the header, and let go of the file if anything is wrong
+  try {
+    if (size < checkpoint_header_size or std::memcmp(base, checkpoint_magic, 8) != 0) {
+      throw std::runtime_error("File " + _fn + " is not an Omega2D checkpoint");
+    }
+    uint32_t endian;
+    uint64_t json_size, doff;
+    std::memcpy(&version, base+8, sizeof(uint32_t));
+    std::memcpy(&endian, base+12, sizeof(uint32_t));
+    std::memcpy(&json_size, base+16, sizeof(uint64_t));
+    std::memcpy(&doff, base+24, sizeof(uint64_t));
+    if (endian != checkpoint_endian) {
+      throw std::runtime_error("Checkpoint " + _fn + " was written with a different byte order");
+    }
+    if (version > checkpoint_version) {
+      throw std::runtime_error("Checkpoint " + _fn + " is version " + std::to_string(version)
+                               + ", this program reads up to " + std::to_string(checkpoint_version));
+    }
+    if (checkpoint_header_size + json_size > size or doff > size) {
+      throw std::runtime_error("Checkpoint " + _fn + " is truncated");
+    }
+    data_offset = doff;
+
+    meta = nlohmann::json::parse(base+checkpoint_header_size, base+checkpoint_header_size+json_size);
+
+  } catch (...) {
+#ifndef _WIN32
+    if (is_mapped) munmap(const_cast<char*>(base), size);
+#endif
+    throw;
+  }
+}
+
+CheckpointReader::~CheckpointReader() {
+#ifndef _WIN32
+  if (is_mapped and base) munmap(const_cast<char*>(base), size);
+#endif
+}
@@ -0,0 +1,140 @@
+/*
+ * Checkpoint.h - Binary, memory-mappable checkpoint files of the full simulation state
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include "VectorHelper.h"
+#include "json/json.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+//
+// File layout, all little-endian:
+//
+//   bytes 0-7     magic "O2DCKPT\0"
+//   bytes 8-11    uint32 format version
+//   bytes 12-15   uint32 0x01020304, to catch byte order mismatch
+//   bytes 16-23   uint64 size of the json metadata block
+//   bytes 24-31   uint64 offset to the start of the array data
+//   bytes 32-     json metadata: scalars, collection descriptions, and the
+//                 directory of arrays (name, type, count, offset)
+//   data_offset-  raw arrays, each starting on a 64-byte boundary
+//
+// Because every array is raw and aligned, a reader can mmap the file and use the
+//   arrays in place. Old versions must be readable by newer code, so only add
+//   fields to the json, and bump the version if the array layout changes.
+//
+const uint32_t checkpoint_version = 1;
+const size_t checkpoint_align = 64;
+
+// map a C++ type to the name stored in the array directory
+template <class T> struct CheckpointType;
+template <> struct CheckpointType<float>    { static constexpr const char* name = "Float32"; };
+template <> struct CheckpointType<double>   { static constexpr const char* name = "Float64"; };
+template <> struct CheckpointType<uint8_t>  { static constexpr const char* name = "UInt8"; };
+template <> struct CheckpointType<uint16_t> { static constexpr const char* name = "UInt16"; };
+template <> struct CheckpointType<int32_t>  { static constexpr const char* name = "Int32"; };
+template <> struct CheckpointType<uint32_t> { static constexpr const char* name = "UInt32"; };
+
+
+//
+// Gather metadata and pointers to arrays, then write them all at once
+//
+// The arrays are not copied, so they must not change until write() returns.
+//
+class CheckpointWriter {
+public:
+  CheckpointWriter() : meta(), arrays(), data_size(0) {}
+
+  // scalars and descriptions go here
+  nlohmann::json& get_meta() { return meta; }
+
+  // register a raw array
+  template <class T>
+  void add(const std::string _name, const T* _data, const size_t _count) {
+    if (meta["arrays"].count(_name) > 0) throw std::runtime_error("Duplicate checkpoint array " + _name);
+    const size_t nbytes = _count * sizeof(T);
+    meta["arrays"][_name] = { {"type", CheckpointType<T>::name}, {"count", _count}, {"offset", data_size} };
+    arrays.push_back({reinterpret_cast<const char*>(_data), nbytes});
+    data_size += (nbytes + checkpoint_align - 1) / checkpoint_align * checkpoint_align;
+  }
+
+  template <class T, class Alloc>
+  void add(const std::string _name, std::vector<T,Alloc> const& _vec) {
+    add(_name, _vec.data(), _vec.size());
+  }
+
+  // write to a temporary file, then rename over the target
+  void write(const std::string);
+
+private:
+  struct Array {
+    const char* ptr;
+    size_t nbytes;
+  };
+  nlohmann::json meta;
+  std::vector<Array> arrays;
+  size_t data_size;
+};
+
+
+//
+// Map a checkpoint file and expose its metadata and arrays
+//
+class CheckpointReader {
+public:
+  explicit CheckpointReader(const std::string);
+  ~CheckpointReader();
+
+  CheckpointReader(CheckpointReader const&) = delete;
+  CheckpointReader& operator=(CheckpointReader const&) = delete;
+
+  nlohmann::json const& get_meta() const { return meta; }
+  uint32_t get_version() const { return version; }
+  bool has(const std::string _name) const {
+    auto it = meta.find("arrays");
+    return it != meta.end() and it->count(_name) > 0;
+  }
+
+  // pointer to the array inside the mapping, valid for the life of this reader
+  template <class T>
+  const T* map(const std::string _name, size_t& _count) const {
+    if (not has(_name)) throw std::runtime_error("Checkpoint has no array " + _name);
+    nlohmann::json const& a = meta["arrays"][_name];
+    if (a["type"].get<std::string>() != CheckpointType<T>::name) {
+      throw std::runtime_error("Checkpoint array " + _name + " is " + a["type"].get<std::string>()
+                               + ", expected " + CheckpointType<T>::name);
+    }
+    _count = a["count"].get<size_t>();
+    const size_t off = data_offset + a["offset"].get<size_t>();
+    if (off + _count*sizeof(T) > size) throw std::runtime_error("Checkpoint array " + _name + " is truncated");
+    return reinterpret_cast<const T*>(base + off);
+  }
+
+  // copy an array out of the mapping
+  template <class T, class Alloc>
+  void get(const std::string _name, std::vector<T,Alloc>& _vec) const {
+    size_t cnt = 0;
+    const T* ptr = map<T>(_name, cnt);
+    _vec.resize(cnt);
+    if (cnt > 0) std::memcpy(_vec.data(), ptr, cnt*sizeof(T));
+  }
+
+private:
+  const char* base;
+  size_t size;
+  size_t data_offset;
+  uint32_t version;
+  nlohmann::json meta;
+  bool is_mapped;		// false if we had to read the whole file into memory
+  std::vector<char> buffer;
+};
+
@@ -12,12 +12,16 @@
 #include "Kernels.h"
 #include "Points.h"
 #include "Surfaces.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "ThreadPool.h"
 
 #ifdef USE_VC
 #include <Vc/Vc>
 #endif
 
 #include <algorithm>	// for std::transform
+#include <cstdio>
 #include <iostream>
 #include <vector>
 #include <memory>
@@ -28,23 +32,20 @@
 
 template <class S>
 Vector<S> points_on_points_coeff (Points<S> const& src, Points<S>& targ) {
-  auto start = std::chrono::system_clock::now();
+  ScopedTimer timer("points_on_points_coeff");
 
   // when we need this, copy it from Influence.h
   Vector<S> coeffs;
   float flops = 0.0;
 
-  auto end = std::chrono::system_clock::now();
-  std::chrono::duration<double> elapsed_seconds = end-start;
-  const float gflops = 1.e-9 * flops / (float)elapsed_seconds.count();
-  printf("    points_on_points_coeff: [%.4f] seconds at %.3f GFlop/s\n", (float)elapsed_seconds.count(), gflops);
+  timer.report("points_on_points_coeff", flops);
 
   return coeffs;
 }
 
 template <class S>
 Vector<S> panels_on_points_coeff (Surfaces<S> const& src, Points<S>& targ) {
-  std::cout << "    1_0 compute coefficients of" << src.to_string() << " on" << targ.to_string() << std::endl;
+  TaskGroup::out() << "    1_0 compute coefficients of" << src.to_string() << " on" << targ.to_string() << std::endl;
 
   Vector<S> coeffs;
   return coeffs;
@@ -89,7 +90,7 @@ Vector<S> panels_on_points_coeff (Surfaces<S> const& src, Points<S>& targ) {
 
 template <class S>
 Vector<S> points_on_panels_coeff (Points<S> const& src, Surfaces<S>& targ) {
-  std::cout << "    0_1 compute coefficients of" << src.to_string() << " on" << targ.to_string() << std::endl;
+  TaskGroup::out() << "    0_1 compute coefficients of" << src.to_string() << " on" << targ.to_string() << std::endl;
 
   Vector<S> coeffs;
   return coeffs;
@@ -133,13 +134,13 @@ Vector<S> points_on_panels_coeff (Points<S> const& src, Surfaces<S>& targ) {
 
 template <class S>
 Vector<S> panels_on_panels_coeff (Surfaces<S> const& src, Surfaces<S>& targ) {
-  std::cout << "    1_1 compute coefficients of" << src.to_string() << " on" << targ.to_string() << std::endl;
+  TaskGroup::out() << "    1_1 compute coefficients of" << src.to_string() << " on" << targ.to_string() << std::endl;
 
   const bool use_two_way = true;
 
   // use floats to prevent overruns
   float flops = 0.0;
-  //auto start = std::chrono::system_clock::now();
+  ScopedTimer timer("panels_on_panels_coeff");
 
   // how large of a problem do we have?
   const size_t nsrc  = src.get_npanels();
@@ -405,6 +406,14 @@ Vector<S> panels_on_panels_coeff (Surfaces<S> const& src, Surfaces<S>& targ) {
                  [fac](S elem) { return elem * fac; });
   flops += 2.0 + (float)coeffs.size();
 
+  // the augmentation below is small, so count the work up to here
+  MemoryTracker::note("bem matrix block", coeffs.capacity() * sizeof(S));
+  {
+    const double secs = timer.stop();
+    const double bytes = (double)(nsrc + ntarg) * (4.0*sizeof(S) + 2.0*sizeof(Int)) + (double)coeffs.size() * sizeof(S);
+    Profiler::count_kernel("panels_on_panels_coeff", flops, bytes, secs);
+  }
+
   // skip out if we don't augment
   if (not targ.is_augmented() and not src.is_augmented()) return coeffs;
 
@@ -416,7 +425,7 @@ Vector<S> panels_on_panels_coeff (Surfaces<S> const& src, Surfaces<S>& targ) {
   const size_t nrows = oldnrows + (targ.is_augmented() ? 1 : 0);
   const size_t ncols = oldncols + ( src.is_augmented() ? 1 : 0);
   if (targ.is_augmented() or src.is_augmented()) {
-    std::cout << "    augmenting the " << ntarg << " x " << nsrc << " block to " << nrows << " x " << ncols << std::endl;
+    TaskGroup::out() << "    augmenting the " << ntarg << " x " << nsrc << " block to " << nrows << " x " << ncols << std::endl;
   }
 
   bool debug = false;
@@ -424,12 +433,12 @@ Vector<S> panels_on_panels_coeff (Surfaces<S> const& src, Surfaces<S>& targ) {
 
   // debug print the bottom-right corner
   if (debug) {
-    std::cout << "Bottom-right corner of influence matrix:" << std::endl;
+    TaskGroup::out() << "Bottom-right corner of influence matrix:" << std::endl;
     for (size_t i=oldnrows-6; i<oldnrows; ++i) {
       for (size_t j=oldncols-6; j<oldncols; ++j) {
-        std::cout << " \t" << coeffs[oldnrows*j+i];
+        TaskGroup::out() << " \t" << coeffs[oldnrows*j+i];
       }
-      std::cout << std::endl;
+      TaskGroup::out() << std::endl;
     }
   }
 
@@ -475,12 +484,12 @@ Vector<S> panels_on_panels_coeff (Surfaces<S> const& src, Surfaces<S>& targ) {
 
   // debug print the bottom-right corner
   if (debug) {
-    std::cout << "Bottom-right corner of influence matrix:" << std::endl;
+    TaskGroup::out() << "Bottom-right corner of influence matrix:" << std::endl;
     for (size_t i=nrows-6; i<nrows; ++i) {
       for (size_t j=ncols-6; j<ncols; ++j) {
-        std::cout << " \t" << augcoeff[nrows*j+i];
+        TaskGroup::out() << " \t" << augcoeff[nrows*j+i];
       }
-      std::cout << std::endl;
+      TaskGroup::out() << std::endl;
     }
   }
 
@@ -534,12 +543,12 @@ Vector<S> panels_on_panels_coeff (Surfaces<S> const& src, Surfaces<S>& targ) {
     //  }
     //  std::cout << std::endl;
     //}
-    std::cout << "Bottom-right corner of influence matrix:" << std::endl;
+    TaskGroup::out() << "Bottom-right corner of influence matrix:" << std::endl;
     for (size_t i=nrows-6; i<nrows; ++i) {
       for (size_t j=ncols-6; j<ncols; ++j) {
-        std::cout << " \t" << augcoeff[nrows*j+i];
+        TaskGroup::out() << " \t" << augcoeff[nrows*j+i];
       }
-      std::cout << std::endl;
+      TaskGroup::out() << std::endl;
     }
   }
 
@@ -13,12 +13,21 @@
 #include "Influence.h"
 #include "BEM.h"
 #include "BEMHelper.h"
+#include "Checkpoint.h"
 #include "Reflect.h"
 #include "GuiHelper.h"
 #include "ExecEnv.h"
-
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "ThreadPool.h"
+#include "Distributed.h"
+#include "DistributedHelper.h"
+#include "TracerInterp.h"
+
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <variant>
 
@@ -51,18 +60,89 @@ public:
                   std::vector<Collection>&,
                   std::vector<Collection>&,
                   std::vector<Collection>&,
-                  BEM<S,I>&);
+                  BEM<S,I>&,
+                  const bool _clear_fldpt = false);
+
+  // wait for the tracer work of the last step, before anything reads or changes _fldpt
+  //   (but that work never adds or removes tracers, so counting them is safe without it)
+  void finish_tracers() { tracer_tasks.wait(); }
+  // after _fldpt is replaced, coasting tracers must start over
+  void forget_tracer_history() { finish_tracers(); tracer_hist.clear(); }
+  // or save and restore it, which must follow the _fldpt collections
+  void write_tracer_history(CheckpointWriter&, nlohmann::json&) const;
+  void read_tracer_history(CheckpointReader const&, nlohmann::json const&);
+
+  // execution environment
+  ExecEnv const& get_env() const { return conv_env; }
+  void set_env(ExecEnv const& _env) { conv_env = _env; }
+
+  // how tracers get their velocities while advecting, see TracerInterp
+  nlohmann::json get_tracer_velocity() const { return tracer_interp.to_json(); }
+  void set_tracer_velocity(const nlohmann::json _j) { tracer_interp.from_json(_j); }
+  bool interpolates_tracers() const { return tracer_interp.is_enabled(); }
+  // tracer velocities by that setting, once the particles' are known and the boundaries
+  //   hold the strengths of their rotation (as in a step, or a saved frame)
+  void find_tracer_vels(const std::array<double,Dimensions>&,
+                        const S,
+                        std::vector<Collection>&,
+                        std::vector<Collection>&,
+                        std::vector<Collection>&);
 
 #ifdef USE_IMGUI
   void draw_advanced();
 #endif
 
 private:
+  void find_vels_rotated(const std::array<double,Dimensions>&,
+                         std::vector<Collection>&,
+                         std::vector<Collection>&,
+                         std::vector<Collection>&);
+  void find_vels_on_own(const std::array<double,Dimensions>&,
+                        std::vector<Collection>&,
+                        std::vector<Collection>&);
+  void find_vels_on_shared(const std::array<double,Dimensions>&,
+                           std::vector<Collection>&,
+                           std::vector<Collection>&,
+                           std::vector<Collection>&);
+  void plan_tracers(std::vector<Collection>&);
+  void find_subcycled_vels(const std::array<double,Dimensions>&,
+                           const S,
+                           std::vector<Collection>&,
+                           std::vector<Collection>&,
+                           std::vector<Collection>&,
+                           const double,
+                           const bool);
+
   // local copies of particle data
   //Particles<S> temp;
 
   // execution environment for velocity summations (not BEM)
   ExecEnv conv_env;
+
+  // tracers never affect the vorticity, so their velocities and motion run beside the
+  //   rest of the step, and the last of it runs on into the next step's diffusion
+  TaskGroup tracer_tasks;
+
+  // interpolate tracer velocities from the particles' instead of summing them
+  TracerInterp tracer_interp;
+
+  // tracers that get new velocities only every few steps coast in between, as each one's
+  //   velocity along its path is a curve in time, c0 + c1*(t-t_ref) + c2*(t-t_ref)^2,
+  //   through both stages of its last update and the first stage of the one before;
+  //   there is one of these per _fldpt collection
+  struct TracerHistory {
+    size_t since = 0;		// steps coasted since the last update
+    size_t n = 0;		// tracers with a curve so far
+    size_t n_prev = 0;		// tracers in the last update
+    bool fresh = true;		// does this step find new velocities for all of them
+    bool has_first = false;	// is there a first stage waiting for the last one
+    double t_ref = 0.0;		// time of the last update's last stage
+    double t_prev = 0.0;	// time of the last update's first stage
+    double t_first = 0.0;	// time of this step's first stage
+    std::array<Vector<S>,Dimensions> c0, c1, c2, prev, first;
+  };
+  std::vector<TracerHistory> tracer_hist;
+  bool tracers_coast = false;
 };
 
 
@@ -78,41 +158,404 @@ void Convection<S,A,I>::find_vels(const std::array<double,Dimensions>& _fs,
   //if (_targets.size() > 0) std::cout << std::endl << "Solving for velocities" << std::endl;
   //if (_targets.size() > 0) std::cout << std::endl;
 
+  // add vortex and source strengths to account for rotating bodies
+  for (auto &src : _bdry) {
+    std::visit([=](auto& elem) { elem.add_solved_rot_strengths(1.0); }, src);
+  }
+
+  find_vels_rotated(_fs, _vort, _bdry, _targets);
+
+  // remove vortex and source strengths due to rotation
+  for (auto &src : _bdry) {
+    std::visit([=](auto& elem) { elem.add_solved_rot_strengths(-1.0); }, src);
+  }
+}
+
+//
+// the same, but the boundaries already hold the strengths of their rotation
+//
+template <class S, class A, class I>
+void Convection<S,A,I>::find_vels_rotated(const std::array<double,Dimensions>& _fs,
+                                          std::vector<Collection>&             _vort,
+                                          std::vector<Collection>&             _bdry,
+                                          std::vector<Collection>&             _targets) {
+
   // need this for dispatching velocity influence calls, template param is accumulator type
   // should the solution_t be an argument to the constructor?
   // member variable is passed-in execution environment
   InfluenceVisitor<A> visitor = {conv_env};
+  ScopedTimer timer("velocity");
 
-  // add vortex and source strengths to account for rotating bodies
-  for (auto &src : _bdry) {
-    std::visit([=](auto& elem) { elem.add_solved_rot_strengths(1.0); }, src);
+  // with several ranks, each holds only its own vortons
+  if (Distributed::is_on()) {
+    if (&_targets == &_vort) find_vels_on_own(_fs, _vort, _bdry);
+    else find_vels_on_shared(_fs, _vort, _bdry, _targets);
+    return;
   }
 
-  // find the influence on every field point/tracer element
+  // find the influence on every field point/tracer element, one task per target collection;
+  //   each target's sources stay in order, so the sums do not depend on the threads
+  TaskGroup tasks;
   for (auto &targ : _targets) {
-    std::cout << "  Solving for velocities on" << to_string(targ) << std::endl;
+    tasks.run([&]() {
+      TaskGroup::out() << "  Solving for velocities on" << to_string(targ) << std::endl;
+
+      // zero velocities
+      std::visit([=](auto& elem) { elem.zero_vels(); }, targ);
+
+      // accumulate from vorticity
+      for (auto &src : _vort) {
+        std::visit(visitor, src, targ);
+      }
+
+      // accumulate from boundaries
+      for (auto &src : _bdry) {
+        // call the Influence routine for these collections
+        std::visit(visitor, src, targ);
+      }
+
+      // add freestream and divide by 2pi
+      std::visit([=](auto& elem) { elem.finalize_vels(_fs); }, targ);
+    });
+  }
+  tasks.wait();
+}
 
-    // zero velocities
+//
+// velocities on this rank's vortons: every rank's vortons pass by as blocks of
+//   sources around the ring of ranks, and the next block arrives during each sum
+//
+template <class S, class A, class I>
+void Convection<S,A,I>::find_vels_on_own(const std::array<double,Dimensions>& _fs,
+                                         std::vector<Collection>&             _vort,
+                                         std::vector<Collection>&             _bdry) {
+
+  InfluenceVisitor<A> visitor = {conv_env};
+
+  for (auto &targ : _vort) {
     std::visit([=](auto& elem) { elem.zero_vels(); }, targ);
+  }
 
-    // accumulate from vorticity
-    for (auto &src : _vort) {
-      std::visit(visitor, src, targ);
+  // the boundaries are on every rank
+  const auto start = std::chrono::steady_clock::now();
+  TaskGroup btasks;
+  for (auto &targ : _vort) {
+    btasks.run([&]() {
+      for (auto &src : _bdry) std::visit(visitor, src, targ);
+    });
+  }
+  btasks.wait();
+
+  // only this thread may talk to the other ranks, so tasks just do the sums
+  std::vector<S> block = pack_particles<S>(_vort);
+  std::vector<S> next;
+  Collection src = Points<S>(std::vector<S>(), active, lagrangian, nullptr);
+  for (int turn=0; turn<Distributed::size(); ++turn) {
+    if (turn+1 < Distributed::size()) Distributed::shift_start(block, next);
+    fill_particles(std::get<Points<S>>(src), block);
+
+    TaskGroup tasks;
+    for (auto &targ : _vort) {
+      tasks.run([&]() { std::visit(visitor, src, targ); });
     }
+    tasks.wait();
 
-    // accumulate from boundaries
-    for (auto &src : _bdry) {
-      // call the Influence routine for these collections
-      std::visit(visitor, src, targ);
-    }
+    Distributed::shift_finish();
+    std::swap(block, next);
+  }
 
-    // add freestream and divide by 2pi
+  size_t nown = 0;
+  for (auto &targ : _vort) {
     std::visit([=](auto& elem) { elem.finalize_vels(_fs); }, targ);
+    nown += std::visit([=](auto& elem) { return elem.get_n(); }, targ);
   }
+  Distributed::record_time(nown, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
 
-  // remove vortex and source strengths due to rotation
-  for (auto &src : _bdry) {
-    std::visit([=](auto& elem) { elem.add_solved_rot_strengths(-1.0); }, src);
+//
+// velocities on elements that every rank holds (panels, tracers): each adds the
+//   influence of its own vortons, and those are summed over ranks
+//
+template <class S, class A, class I>
+void Convection<S,A,I>::find_vels_on_shared(const std::array<double,Dimensions>& _fs,
+                                            std::vector<Collection>&             _vort,
+                                            std::vector<Collection>&             _bdry,
+                                            std::vector<Collection>&             _targets) {
+
+  InfluenceVisitor<A> visitor = {conv_env};
+
+  TaskGroup tasks;
+  for (auto &targ : _targets) {
+    tasks.run([&]() {
+      TaskGroup::out() << "  Solving for velocities on" << to_string(targ) << std::endl;
+      std::visit([=](auto& elem) { elem.zero_vels(); }, targ);
+      for (auto &src : _vort) std::visit(visitor, src, targ);
+    });
+  }
+  tasks.wait();
+
+  for (auto &targ : _targets) sum_vels<S>(targ);
+
+  // the boundaries are the same everywhere, so all ranks add them after the sum
+  TaskGroup btasks;
+  for (auto &targ : _targets) {
+    btasks.run([&]() {
+      for (auto &src : _bdry) std::visit(visitor, src, targ);
+      std::visit([=](auto& elem) { elem.finalize_vels(_fs); }, targ);
+    });
+  }
+  btasks.wait();
+}
+
+//
+// velocities on the tracers, with the boundaries already rotating and the particles'
+//   velocities already found, by interpolation where possible
+//
+template <class S, class A, class I>
+void Convection<S,A,I>::find_tracer_vels(const std::array<double,Dimensions>& _fs,
+                                         const S                              _ips,
+                                         std::vector<Collection>&             _vort,
+                                         std::vector<Collection>&             _bdry,
+                                         std::vector<Collection>&             _targets) {
+
+  // a rank holds only some of the vortons, so it cannot interpolate between them
+  if (not tracer_interp.is_enabled() or Distributed::is_on()) {
+    find_vels_rotated(_fs, _vort, _bdry, _targets);
+    return;
+  }
+
+  // the ones that could not be interpolated get the full sum
+  TracerInterp::Subset rest = tracer_interp.interpolate(_vort, _bdry, _targets, (float)_ips);
+  find_vels_rotated(_fs, _vort, _bdry, rest.pts);
+  TracerInterp::scatter(rest, _targets);
+
+  // now and then, compare some of the others to it too
+  TracerInterp::Subset sample = tracer_interp.check_sample();
+  if (sample.pts.empty()) return;
+  find_vels_rotated(_fs, _vort, _bdry, sample.pts);
+  if (not tracer_interp.compare(sample, _targets)) {
+    find_vels_rotated(_fs, _vort, _bdry, _targets);
+  }
+}
+
+//
+// decide, once per step, which tracer collections get new velocities
+//
+template <class S, class A, class I>
+void Convection<S,A,I>::plan_tracers(std::vector<Collection>& _targets) {
+  tracer_hist.resize(_targets.size());
+  tracers_coast = false;
+  for (size_t i=0; i<_targets.size(); ++i) {
+    TracerHistory& h = tracer_hist[i];
+    size_t every = 1;
+    size_t n = 0;
+    if (std::holds_alternative<Points<S>>(_targets[i])) {
+      every = std::get<Points<S>>(_targets[i]).get_update_every();
+      n = std::get<Points<S>>(_targets[i]).get_n();
+    }
+
+    // if some were taken away, the rest no longer line up with their curves
+    if (every < 2 or n < h.n) {
+      h = TracerHistory();
+      if (every < 2) continue;
+    }
+
+    // the first time, or after an update is due
+    h.fresh = (h.n == 0 or h.since+1 >= every);
+    if (h.fresh) h.since = 0;
+    else h.since++;
+    if (not h.fresh) tracers_coast = true;
+  }
+}
+
+//
+// velocities on the tracers at one stage of a step: new ones for those updated this
+//   step, and for any newborn tracers; the curve in time for the others
+//
+template <class S, class A, class I>
+void Convection<S,A,I>::find_subcycled_vels(const std::array<double,Dimensions>& _fs,
+                                            const S                              _ips,
+                                            std::vector<Collection>&             _vort,
+                                            std::vector<Collection>&             _bdry,
+                                            std::vector<Collection>&             _targets,
+                                            const double                         _t,
+                                            const bool                           _last) {
+
+  // the usual case: every tracer gets new velocities
+  if (not tracers_coast) {
+    find_tracer_vels(_fs, _ips, _vort, _bdry, _targets);
+  } else {
+    // borrow the whole collections that need new velocities, and copy the newborns
+    std::vector<Collection> need;
+    std::vector<size_t> from;
+    for (size_t i=0; i<_targets.size(); ++i) {
+      TracerHistory const& h = tracer_hist[i];
+      if (h.fresh) {
+        need.push_back(std::move(_targets[i]));
+        from.push_back(i);
+      } else {
+        Points<S> const& pts = std::get<Points<S>>(_targets[i]);
+        if (pts.get_n() == h.n) continue;
+        std::vector<S> xy(2*(pts.get_n()-h.n));
+        for (size_t j=h.n; j<pts.get_n(); ++j) {
+          xy[2*(j-h.n)]   = pts.get_pos()[0][j];
+          xy[2*(j-h.n)+1] = pts.get_pos()[1][j];
+        }
+        need.push_back(Points<S>(xy, inert, fixed, nullptr));
+        from.push_back(i);
+      }
+    }
+
+    find_tracer_vels(_fs, _ips, _vort, _bdry, need);
+
+    // give them back
+    for (size_t k=0; k<need.size(); ++k) {
+      const size_t i = from[k];
+      TracerHistory const& h = tracer_hist[i];
+      if (h.fresh) {
+        _targets[i] = std::move(need[k]);
+      } else {
+        std::array<Vector<S>,Dimensions> const& newvel = std::get<Points<S>>(need[k]).get_vel();
+        Points<S>& pts = std::get<Points<S>>(_targets[i]);
+        for (size_t d=0; d<Dimensions; ++d) {
+          std::copy(newvel[d].begin(), newvel[d].end(), pts.get_vel()[d].begin()+h.n);
+        }
+      }
+    }
+
+    // and the rest coast
+    for (size_t i=0; i<_targets.size(); ++i) {
+      TracerHistory const& h = tracer_hist[i];
+      if (h.fresh) continue;
+      Points<S>& pts = std::get<Points<S>>(_targets[i]);
+      const S dt = (S)(_t - h.t_ref);
+      for (size_t d=0; d<Dimensions; ++d) {
+        Vector<S>& u = pts.get_vel()[d];
+        #pragma omp parallel for
+        for (int32_t j=0; j<(int32_t)h.n; ++j) u[j] = h.c0[d][j] + dt * (h.c1[d][j] + dt * h.c2[d][j]);
+      }
+    }
+  }
+
+  // keep the new velocities, and after the last stage, fit each tracer's curve
+  for (size_t i=0; i<_targets.size(); ++i) {
+    if (not std::holds_alternative<Points<S>>(_targets[i])) continue;
+    Points<S> const& pts = std::get<Points<S>>(_targets[i]);
+    if (pts.get_update_every() < 2) continue;
+    TracerHistory& h = tracer_hist[i];
+    const size_t n = pts.get_n();
+    const size_t i0 = h.fresh ? 0 : h.n;
+
+    if (not _last) {
+      h.t_first = _t;
+      h.has_first = true;
+      for (size_t d=0; d<Dimensions; ++d) {
+        h.first[d].assign(pts.get_vel()[d].begin()+i0, pts.get_vel()[d].end());
+      }
+      continue;
+    }
+
+    // the curve goes through both stages of this update and, for those that were there,
+    //   the first stage of the last one; a first stage is on each tracer's path, while a
+    //   last stage sees the tracer where the first one put it, so keep the first ones
+    //   (a zero-length step has no first stage)
+    const bool use_first = h.has_first and h.t_first < _t;
+    const double t_on = use_first ? h.t_first : _t;
+    const size_t np = (h.fresh and h.t_prev < t_on) ? h.n_prev : 0;
+    if (h.fresh) h.t_ref = _t;
+    for (size_t d=0; d<Dimensions; ++d) {
+      Vector<S> const& u = pts.get_vel()[d];
+      Vector<S> const& on = use_first ? h.first[d] : u;
+      const size_t ion = use_first ? i0 : 0;
+      h.c0[d].resize(n);
+      h.c1[d].resize(n);
+      h.c2[d].resize(n);
+      for (size_t j=i0; j<n; ++j) {
+        // oldest first, at times relative to t_ref
+        std::array<double,3> x, y;
+        size_t ns = 0;
+        if (j < np) { x[ns] = h.t_prev - h.t_ref;  y[ns++] = h.prev[d][j]; }
+        x[ns] = t_on - h.t_ref;  y[ns++] = on[j-ion];
+        if (use_first) { x[ns] = _t - h.t_ref;  y[ns++] = u[j]; }
+
+        double a0 = y[0], a1 = 0.0, a2 = 0.0;
+        if (ns > 1) {
+          const double d01 = (y[1] - y[0]) / (x[1] - x[0]);
+          if (ns > 2) a2 = ((y[2] - y[1]) / (x[2] - x[1]) - d01) / (x[2] - x[0]);
+          a1 = d01 - a2 * (x[0] + x[1]);
+          a0 = y[0] - x[0] * (a1 + a2 * x[0]);
+        }
+        h.c0[d][j] = (S)a0;
+        h.c1[d][j] = (S)a1;
+        h.c2[d][j] = (S)a2;
+      }
+
+      // and this update's first stage is the one before, for the next
+      if (h.fresh) {
+        if (use_first) h.prev[d] = std::move(h.first[d]);
+        else h.prev[d].assign(u.begin(), u.end());
+      }
+      h.first[d].clear();
+    }
+    if (h.fresh) {
+      h.t_prev = t_on;
+      h.n_prev = n;
+    }
+    h.has_first = false;
+    h.n = n;
+  }
+
+  if (_last and not tracer_hist.empty()) {
+    size_t bytes = 0;
+    for (auto const& h : tracer_hist) bytes += 4 * Dimensions * h.c0[0].capacity() * sizeof(S);
+    MemoryTracker::note("tracer history", bytes);
+  }
+}
+
+//
+// coasting tracers carry their curves through a restart
+//
+template <class S, class A, class I>
+void Convection<S,A,I>::write_tracer_history(CheckpointWriter& _cw, nlohmann::json& _j) const {
+  nlohmann::json jlist = nlohmann::json::array();
+  for (size_t i=0; i<tracer_hist.size(); ++i) {
+    TracerHistory const& h = tracer_hist[i];
+    const std::string pfx = "tracerHistory." + std::to_string(i) + ".";
+    jlist.push_back({ {"since", h.since}, {"n", h.n}, {"nPrev", h.n_prev},
+                      {"tRef", h.t_ref}, {"tPrev", h.t_prev} });
+    if (h.n == 0) continue;
+    for (size_t d=0; d<Dimensions; ++d) {
+      _cw.add(pfx + "c0" + std::to_string(d), h.c0[d]);
+      _cw.add(pfx + "c1" + std::to_string(d), h.c1[d]);
+      _cw.add(pfx + "c2" + std::to_string(d), h.c2[d]);
+      _cw.add(pfx + "prev" + std::to_string(d), h.prev[d]);
+    }
+  }
+  _j["tracerHistory"] = jlist;
+}
+
+template <class S, class A, class I>
+void Convection<S,A,I>::read_tracer_history(CheckpointReader const& _cr, nlohmann::json const& _j) {
+  forget_tracer_history();
+  // older checkpoints have none, so those tracers start over
+  if (_j.find("tracerHistory") == _j.end()) return;
+  nlohmann::json const& jlist = _j["tracerHistory"];
+  tracer_hist.resize(jlist.size());
+  for (size_t i=0; i<jlist.size(); ++i) {
+    TracerHistory& h = tracer_hist[i];
+    const std::string pfx = "tracerHistory." + std::to_string(i) + ".";
+    h.since = jlist[i]["since"].get<size_t>();
+    h.n = jlist[i]["n"].get<size_t>();
+    h.n_prev = jlist[i]["nPrev"].get<size_t>();
+    h.t_ref = jlist[i]["tRef"].get<double>();
+    h.t_prev = jlist[i]["tPrev"].get<double>();
+    if (h.n == 0) continue;
+    for (size_t d=0; d<Dimensions; ++d) {
+      _cr.get(pfx + "c0" + std::to_string(d), h.c0[d]);
+      _cr.get(pfx + "c1" + std::to_string(d), h.c1[d]);
+      _cr.get(pfx + "c2" + std::to_string(d), h.c2[d]);
+      _cr.get(pfx + "prev" + std::to_string(d), h.prev[d]);
+    }
   }
 }
 
@@ -129,7 +572,9 @@ void Convection<S,A,I>::advect_1st(const double                         _time,
                                    std::vector<Collection>&             _fldpt,
                                    BEM<S,I>&                            _bem) {
 
-  std::cout << "Inside Convection::advect_1st with dt=" << _dt << std::endl;
+  TaskGroup::out() << "Inside Convection::advect_1st with dt=" << _dt << std::endl;
+  ScopedTimer timer("convection");
+  finish_tracers();
 
   // part A - unknowns
 
@@ -142,7 +587,21 @@ void Convection<S,A,I>::advect_1st(const double                         _time,
   // part B - knowns
 
   find_vels(_fs, _vort, _bdry, _vort);
-  find_vels(_fs, _vort, _bdry, _fldpt);
+
+  // tracers can use the particles' velocities, and may coast; but a zero-length step
+  //   only finds velocities, so it is not one of their updates
+  for (auto &src : _bdry) {
+    std::visit([=](auto& elem) { elem.add_solved_rot_strengths(1.0); }, src);
+  }
+  if (_dt > 0.0) {
+    plan_tracers(_fldpt);
+    find_subcycled_vels(_fs, _ips, _vort, _bdry, _fldpt, _time, true);
+  } else {
+    find_tracer_vels(_fs, _ips, _vort, _bdry, _fldpt);
+  }
+  for (auto &src : _bdry) {
+    std::visit([=](auto& elem) { elem.add_solved_rot_strengths(-1.0); }, src);
+  }
 
   // part C - convection here
 
@@ -172,11 +631,17 @@ void Convection<S,A,I>::advect_2nd(const double                         _time,
                                    std::vector<Collection>&             _vort,
                                    std::vector<Collection>&             _bdry,
                                    std::vector<Collection>&             _fldpt,
-                                   BEM<S,I>&                            _bem) {
+                                   BEM<S,I>&                            _bem,
+                                   const bool                           _clear_fldpt) {
+
+  TaskGroup::out() << "Inside Convection::advect_2nd with dt=" << _dt << std::endl;
+  ScopedTimer timer("convection");
 
-  std::cout << "Inside Convection::advect_2nd with dt=" << _dt << std::endl;
+  // the tracers may still be moving from the last step
+  finish_tracers();
 
   // take the first Euler step ---------
+  ScopedTimer stage1("stage1");
 
   // push away particles inside or too close to the body
   assert(M_PI != 0); // Can't divide by 0
@@ -186,40 +651,106 @@ void Convection<S,A,I>::advect_2nd(const double                         _time,
 
   // find the derivatives
   find_vels(_fs, _vort, _bdry, _vort);
-  find_vels(_fs, _vort, _bdry, _fldpt);
+
+  // the tracers see the vortons as they are now, and they do not move until the end of
+  //   this step; but the bodies go on to t+dt, so the tracers get their own copy, with
+  //   the rotation already in it
+  auto tracer_bdry = std::make_shared<std::vector<Collection>>(_bdry);
+  for (auto &src : *tracer_bdry) {
+    std::visit([=](auto& elem) { elem.add_solved_rot_strengths(1.0); }, src);
+  }
+  auto interim_fldpt = std::make_shared<std::vector<Collection>>();
+
+  // find their derivatives and advect them into an intermediate system, during the second BEM
+  auto tracer_stage1 = [=, &_vort, &_fldpt]() {
+    ScopedTimer tracers("tracers");
+    plan_tracers(_fldpt);
+    find_subcycled_vels(_fs, _ips, _vort, *tracer_bdry, _fldpt, _time, false);
+
+    *interim_fldpt = _fldpt;
+    for (auto &coll : *interim_fldpt) {
+      std::visit([=](auto& elem) { elem.move(_time, _dt); }, coll);
+    }
+
+    size_t interim_bytes = 0;
+    for (auto const& coll : *interim_fldpt) interim_bytes += std::visit([](auto const& elem) { return elem.get_bytes(); }, coll);
+    MemoryTracker::note("rk2 tracer copies", interim_bytes);
+  };
+  // but ranks must all make their calls to share velocities in the same order
+  if (Distributed::is_on()) tracer_stage1();
+  else tracer_tasks.run(tracer_stage1);
 
   // advect into an intermediate system
-  std::vector<Collection> interim_vort = _vort;
-  for (auto &coll : interim_vort) {
+  auto interim_vort = std::make_shared<std::vector<Collection>>(_vort);
+  for (auto &coll : *interim_vort) {
     std::visit([=](auto& elem) { elem.move(_time, _dt); }, coll);
   }
   // now _vort has its original positions and the velocities evaluated there
   // and interm_vort has the positions at t+dt
 
-  // do the same for fldpt
-  std::vector<Collection> interim_fldpt = _fldpt;
-  for (auto &coll : interim_fldpt) {
-    std::visit([=](auto& elem) { elem.move(_time, _dt); }, coll);
-  }
+  (void) stage1.stop();
+
+  // that copy doubles the particle memory for the rest of the step
+  size_t interim_bytes = 0;
+  for (auto const& coll : *interim_vort) interim_bytes += std::visit([](auto const& elem) { return elem.get_bytes(); }, coll);
+  MemoryTracker::note("rk2 copies", interim_bytes);
 
   // begin the 2nd step ---------
+  ScopedTimer stage2("stage2");
 
   // push away particles inside or too close to the body
-  clear_inner_layer<S>(1, _bdry, interim_vort, 0.5/std::sqrt(2.0*M_PI), _ips);
+  clear_inner_layer<S>(1, _bdry, *interim_vort, 0.5/std::sqrt(2.0*M_PI), _ips);
   // perform the second BEM
-  solve_bem<S,A,I>(_time + _dt, _fs, interim_vort, _bdry, _bem);
+  solve_bem<S,A,I>(_time + _dt, _fs, *interim_vort, _bdry, _bem);
 
   // find the derivatives
   //find_vels(_fs, interim_vort, interim_bdry, interim_fldpt);
-  find_vels(_fs, interim_vort, _bdry, interim_vort);
-  find_vels(_fs, interim_vort, _bdry, interim_fldpt);
+  find_vels(_fs, *interim_vort, _bdry, *interim_vort);
 
   // _vort still has its original positions and the velocities evaluated there
   // but interm_vort now has the velocities at t+dt
 
+  // the tracers' first stage read _vort, which moves next
+  tracer_tasks.wait();
+
+  // their second stage needs the bodies at t+dt, so copy them again; then it can run on
+  //   into the next step, as the tracers' motion changes nothing but the tracers (and only
+  //   their positions and velocities, never their number)
+  tracer_bdry = std::make_shared<std::vector<Collection>>(_bdry);
+  for (auto &src : *tracer_bdry) {
+    std::visit([=](auto& elem) { elem.add_solved_rot_strengths(1.0); }, src);
+  }
+
+  auto tracer_stage2 = [=, &_fldpt]() {
+    ScopedTimer tracers("tracers");
+    find_subcycled_vels(_fs, _ips, *interim_vort, *tracer_bdry, *interim_fldpt, _time+_dt, true);
+
+    // advect using the combination of both velocities
+    auto v1p = _fldpt.begin();
+    auto v2p = interim_fldpt->begin();
+    for (size_t i = 0; i < _fldpt.size(); ++i) {
+      Collection& c1 = *v1p;
+      Collection& c2 = *v2p;
+      // switch based on what type is actually held in the std::variant
+      if (std::holds_alternative<Points<float>>(c1) and std::holds_alternative<Points<float>>(c2)) {
+        Points<float>& p1 = std::get<Points<float>>(c1);
+        Points<float>& p2 = std::get<Points<float>>(c2);
+        p1.move(_time, _dt, 0.5, p1, 0.5, p2);
+      }
+      ++v1p;
+      ++v2p;
+    }
+
+    // push field points out of objects; they carry no strength, so the copy can take
+    //   the (zero) reabsorbed circulation
+    if (_clear_fldpt) clear_inner_layer<S>(1, *tracer_bdry, _fldpt, (S)0.0, (S)(0.5*_ips));
+  };
+  if (Distributed::is_on()) tracer_stage2();
+  else tracer_tasks.run(tracer_stage2);
+
   // advect using the combination of both velocities
   auto v1p = _vort.begin();
-  auto v2p = interim_vort.begin();
+  auto v2p = interim_vort->begin();
   for (size_t i = 0; i < _vort.size(); ++i) {
     Collection& c1 = *v1p;
     Collection& c2 = *v2p;
@@ -232,21 +763,6 @@ void Convection<S,A,I>::advect_2nd(const double                         _time,
     ++v1p;
     ++v2p;
   }
-
-  v1p = _fldpt.begin();
-  v2p = interim_fldpt.begin();
-  for (size_t i = 0; i < _fldpt.size(); ++i) {
-    Collection& c1 = *v1p;
-    Collection& c2 = *v2p;
-    // switch based on what type is actually held in the std::variant
-    if (std::holds_alternative<Points<float>>(c1) and std::holds_alternative<Points<float>>(c2)) {
-      Points<float>& p1 = std::get<Points<float>>(c1);
-      Points<float>& p2 = std::get<Points<float>>(c2);
-      p1.move(_time, _dt, 0.5, p1, 0.5, p2);
-    }
-    ++v1p;
-    ++v2p;
-  }
 }
 
 
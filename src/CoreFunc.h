@@ -127,6 +127,18 @@ static inline void core_func (const S distsq, const S sr, const S tr,
   *bbb = S(-2.0) * (*r2) * (*r2);
 }
 template <class S> size_t flops_tv_grads () { return 9; }
+
+//
+// vorticity of a unit-circulation particle at distance-squared distsq, for splatting
+//
+// all of these are (1/pi) d/du of u*core_func(u), with u the distance squared
+//
+template <class S>
+static inline S core_vort (const S distsq, const S sr) {
+  const S r2 = sr*sr;
+  const S d2 = distsq + r2;
+  return S(M_1_PI) * r2 / (d2*d2);
+}
 #endif
 
 
@@ -202,6 +214,13 @@ template <class S> size_t flops_tv_nograds () { return 9; }
 // exponential core - with gradients
 //
 // not done
+
+// vorticity of a unit-circulation particle, a Gaussian
+template <class S>
+static inline S core_vort (const S distsq, const S sr) {
+  const S corefac = S(1.0) / (sr*sr);
+  return S(M_1_PI) * corefac * std::exp(-distsq*corefac);
+}
 #endif
 
 
@@ -225,6 +244,14 @@ static inline S core_func (const S distsq, const S sr, const S tr) {
   return (d2 + r2) / (d2*d2);
 }
 template <class S> size_t flops_tv_nograds () { return 7; }
+
+// vorticity of a unit-circulation particle
+template <class S>
+static inline S core_vort (const S distsq, const S sr) {
+  const S r2 = sr*sr;
+  const S d2 = distsq + r2;
+  return S(2.0*M_1_PI) * r2*r2 / (d2*d2*d2);
+}
 #endif
 
 
@@ -247,6 +274,14 @@ static inline S core_func (const S distsq, const S sr, const S tr) {
   return my_rsqrt(distsq*distsq + r2*r2 + o2*o2);
 }
 template <class S> size_t flops_tv_nograds () { return 9; }
+
+// vorticity of a unit-circulation particle
+template <class S>
+static inline S core_vort (const S distsq, const S sr) {
+  const S r2 = sr*sr;
+  const S d4 = distsq*distsq + r2*r2;
+  return S(M_1_PI) * r2*r2 / (d4*std::sqrt(d4));
+}
 #endif
 
 
@@ -269,5 +304,13 @@ static inline S core_func (const S distsq, const S sr, const S tr) {
   return my_rcbrt(distsq*distsq*distsq + r2*r2*r2 + o2*o2*o2);
 }
 template <class S> size_t flops_tv_nograds () { return 12; }
+
+// vorticity of a unit-circulation particle
+template <class S>
+static inline S core_vort (const S distsq, const S sr) {
+  const S r2 = sr*sr;
+  const S d6 = distsq*distsq*distsq + r2*r2*r2;
+  return S(M_1_PI) * r2*r2*r2 / (d6*std::cbrt(d6));
+}
 #endif
 
@@ -9,6 +9,8 @@
 
 #include "Core.h"
 #include "VectorHelper.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
 
 #include <cassert>
 #include <chrono>
@@ -66,10 +68,10 @@ void CoreSpread<ST>::diffuse_all(const std::array<Vector<ST>,2>& pos,
   assert(str.size()==rad.size() && "Input arrays are not uniform size");
   const size_t n = rad.size();
 
-  std::cout << "  Running CoreSpread with n " << n << std::endl;
+  TaskGroup::out() << "  Running CoreSpread with n " << n << std::endl;
 
   // start timer
-  auto start = std::chrono::system_clock::now();
+  ScopedTimer timer("corespread");
 
   const ST core_second_mom = get_core_second_mom<ST>(core_func);
 
@@ -81,9 +83,7 @@ void CoreSpread<ST>::diffuse_all(const std::array<Vector<ST>,2>& pos,
   }
 
   // finish timer and report
-  auto end = std::chrono::system_clock::now();
-  std::chrono::duration<double> elapsed_seconds = end-start;
-  printf("    corespread.diffuse_all:\t[%.4f] seconds\n", (float)elapsed_seconds.count());
+  timer.report("corespread.diffuse_all");
 }
 
 //
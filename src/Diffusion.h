@@ -21,11 +21,17 @@
 #include "CoreSpread.h"
 #include "BEM.h"
 #include "GuiHelper.h"
+#include "Profiler.h"
+#include "Reproducible.h"
+#include "Distributed.h"
+#include "DistributedHelper.h"
+#include "ThreadPool.h"
 
 #include "json/json.hpp"
 
 #include <cstdlib>
 #include <iostream>
+#include <limits>
 #include <vector>
 
 
@@ -74,6 +80,10 @@ public:
   S get_nom_sep(const double _dt, const S _re) { return nom_sep_scaled * std::sqrt(_dt/_re); }
   S get_particle_overlap() const { return particle_overlap; }
 
+  // particle diffusion method by name, as in the "viscous" json key
+  bool set_method(const std::string);
+  std::string get_method() const;
+
   // take a full diffusion step
   void step(const double,
             const double,
@@ -162,7 +172,8 @@ void Diffusion<S,A,I>::step(const double                _time,
   if (curr_pd_type==pd_core) merge_thresh = 0.02;
   else merge_thresh = 0.2;
 
-  std::cout << "Inside Diffusion::step with dt=" << _dt << std::endl;
+  TaskGroup::out() << "Inside Diffusion::step with dt=" << _dt << std::endl;
+  ScopedTimer timer("diffusion");
 
   // ensure that we have a current h_nu
   assert((S)_re != 0); // Can't divide by 0
@@ -206,6 +217,9 @@ void Diffusion<S,A,I>::step(const double                _time,
         // generate particles just above the surface
         std::vector<S> new_pts = surf.represent_as_particles(0.01*(S)h_nu, _vdelta);
 
+        // every rank made these, but keeps only its own
+        keep_own(new_pts);
+
         // add those particles to the main particle list
         if (_vort.size() == 0) {
           // no collections yet? make a new collection
@@ -228,6 +242,17 @@ void Diffusion<S,A,I>::step(const double                _time,
   //
   // diffuse strength among existing particles
   //
+  // each collection is a task, but the random walks draw from seeds given out in call
+  //   order, so reproducible runs take those one at a time
+  const bool one_at_a_time = (curr_pd_type==pd_rvm and Reproducible::is_on());
+  TaskGroup tasks;
+
+  // with several ranks, each diffuses its own vortons among copies of the other ranks'
+  //   that are close enough to take or give strength, one collection at a time
+  const bool use_halo = Distributed::is_on() and (curr_pd_type==pd_vrm or curr_pd_type==pd_pse);
+  const S halo_cutoff = use_halo ? ((curr_pd_type==pd_pse) ? (S)5.1 : (S)2.5/particle_overlap) * largest_radius<S>(_vort)
+                                 : (S)0.0;
+
   // loop over active vorticity
   for (auto &coll : _vort) {
 
@@ -235,10 +260,19 @@ void Diffusion<S,A,I>::step(const double                _time,
     if (std::visit([=](auto& elem) { return elem.is_inert(); }, coll)) continue;
 
     // run this step if the collection is Points
-    if (std::holds_alternative<Points<S>>(coll)) {
+    if (not std::holds_alternative<Points<S>>(coll)) continue;
+
+    // and weak vortons are weak against the strongest on any rank
+    const S peak = use_halo ? (S)Distributed::largest(std::get<Points<S>>(coll).get_max_str()) : (S)0.0;
+    ParticleHalo<S> halo;
+    if (use_halo) halo = add_halo(std::get<Points<S>>(coll), halo_cutoff);
+    const size_t nown = use_halo ? halo.nown : std::numeric_limits<size_t>::max();
+
+    auto diffuse_one = [&, nown, peak]() {
 
       Points<S>& pts = std::get<Points<S>>(coll);
-      std::cout << "    computing diffusion among " << pts.get_n() << " particles" << std::endl;
+      if (pts.get_n() == 0) return;
+      TaskGroup::out() << "    computing diffusion among " << pts.get_n() << " particles" << std::endl;
 
       if (curr_pd_type==pd_vrm) {
         // vectors are not passed as const, because they may be extended with new particles
@@ -248,7 +282,7 @@ void Diffusion<S,A,I>::step(const double                _time,
                         pts.get_str(),
                         pts.get_rad(),
                         h_nu, core_func,
-                        particle_overlap);
+                        particle_overlap, nown, peak);
 
         // resize the rest of the arrays
         pts.resize(pts.get_rad().size());
@@ -261,7 +295,7 @@ void Diffusion<S,A,I>::step(const double                _time,
                         pts.get_str(),
                         pts.get_rad(),
                         h_nu, core_func,
-                        particle_overlap);
+                        particle_overlap, nown, peak);
 
         // resize the rest of the arrays
         pts.resize(pts.get_rad().size());
@@ -280,8 +314,14 @@ void Diffusion<S,A,I>::step(const double                _time,
                         pts.get_rad(),
                         h_nu);
       }
-    }
+    };
+
+    if (one_at_a_time or use_halo) diffuse_one();
+    else tasks.run(diffuse_one);
+
+    if (use_halo) finish_halo(std::get<Points<S>>(coll), halo);
   }
+  tasks.wait();
 
 
   //
@@ -324,6 +364,9 @@ void Diffusion<S,A,I>::step(const double                _time,
         //   diffusion from a flat plate
         std::vector<S> new_pts = surf.represent_as_particles(h_nu*std::sqrt(4.0/M_PI), _vdelta);
 
+        // every rank made these, but keeps only its own
+        keep_own(new_pts);
+
         // add those particles to the main particle list
         if (_vort.size() == 0) {
           // no collections yet? make a new collection
@@ -456,6 +499,39 @@ void Diffusion<S,A,I>::draw_advanced() {
 }
 #endif
 
+//
+// select the particle diffusion method, returns false (and turns diffusion off) if unknown
+//
+template <class S, class A, class I>
+bool Diffusion<S,A,I>::set_method(const std::string _name) {
+  if (_name == "vrm") {
+    set_diffuse(true);
+    pd_type = pd_vrm;
+  } else if (_name == "pse") {
+    set_diffuse(true);
+    pd_type = pd_pse;
+  } else if (_name == "random") {
+    set_diffuse(true);
+    pd_type = pd_rvm;
+  } else if (_name == "corespread") {
+    set_diffuse(true);
+    pd_type = pd_core;
+  } else {
+    set_diffuse(false);
+    return (_name == "none");
+  }
+  return true;
+}
+
+template <class S, class A, class I>
+std::string Diffusion<S,A,I>::get_method() const {
+  if (not get_diffuse()) return "none";
+  if (pd_type == pd_core) return "corespread";
+  if (pd_type == pd_rvm) return "random";
+  if (pd_type == pd_pse) return "pse";
+  return "vrm";
+}
+
 //
 // read/write parameters to json
 //
@@ -465,27 +541,12 @@ template <class S, class A, class I>
 void Diffusion<S,A,I>::from_json(const nlohmann::json j) {
 
   if (j.find("viscous") != j.end()) {
-    std::string viscous = j["viscous"];
-    if (viscous == "vrm") {
-      set_diffuse(true);
-      pd_type = pd_vrm;
-    } else if (viscous == "pse") {
-      set_diffuse(true);
-      pd_type = pd_pse;
-    } else if (viscous == "random") {
-      set_diffuse(true);
-      pd_type = pd_rvm;
-    } else if (viscous == "corespread") {
-      set_diffuse(true);
-      pd_type = pd_core;
-    } else {
-      // "none" or unsupported
-      set_diffuse(false);
-    }
+    // "none" or unsupported turns diffusion off
+    (void) set_method(j["viscous"]);
   } else {
     set_diffuse(false);
   }
-  std::cout << "  setting is_viscous= " << get_diffuse() << std::endl;
+  TaskGroup::out() << "  setting is_viscous= " << get_diffuse() << std::endl;
 
   // regardless, load some settings as they were
   vrm.from_json(j);
@@ -496,7 +557,7 @@ void Diffusion<S,A,I>::from_json(const nlohmann::json j) {
   if (j.find("adaptiveSize") != j.end()) {
     if (j["adaptiveSize"]) {
       set_amr(true);
-      std::cout << "  enabling amr" << std::endl;
+      TaskGroup::out() << "  enabling amr" << std::endl;
     }
   }
 #endif
@@ -507,17 +568,7 @@ template <class S, class A, class I>
 void Diffusion<S,A,I>::add_to_json(nlohmann::json& j) const {
   //nlohmann::json j;
 
-  if (not get_diffuse()) {
-    j["viscous"] = "none";
-  } else if (pd_type == pd_core) {
-    j["viscous"] = "corespread";
-  } else if (pd_type == pd_rvm) {
-    j["viscous"] = "random";
-  } else if (pd_type == pd_pse) {
-    j["viscous"] = "pse";
-  } else if (pd_type == pd_vrm) {
-    j["viscous"] = "vrm";
-  }
+  j["viscous"] = get_method();
 
 #ifdef PLUGIN_AVRM
   j["adaptiveSize"] = adaptive_radii;
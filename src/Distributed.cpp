@@ -0,0 +1,461 @@
+/*
+ * Distributed.cpp - Spread the particles of one simulation over several MPI ranks
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "Distributed.h"
+
+#ifdef _WIN32
+  #include <ciso646>
+#endif
+
+#ifdef USE_MPI
+  #include <mpi.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <utility>
+
+
+static int my_rank = 0;
+static int num_ranks = 1;
+#ifdef USE_MPI
+static bool started = false;
+// the sends and receives of a ring shift in flight
+static MPI_Request shift_reqs[2];
+static int num_shift_reqs = 0;
+#endif
+static int solo_depth = 0;
+
+// the fraction of all particles that each rank should own, the same on every rank
+static std::vector<double> shares = {1.0};
+
+// the first key of each rank's range, with one past the last at the end
+static std::vector<uint64_t> splits = {0, std::numeric_limits<uint64_t>::max()};
+
+// the frame that keys are made in
+static double frame_x0 = 0.0;
+static double frame_y0 = 0.0;
+static double frame_scale = 1.0;
+static constexpr uint32_t key_cells = 0x7fffffffu;
+
+// the extents of this many runs of each rank's particles find the halo
+static constexpr size_t halo_boxes = 16;
+
+// steps with fewer targets than this are too quick to time well, so they do not move the shares
+static constexpr size_t min_timed_targets = 1000;
+
+// for the report
+static size_t num_timed = 0;
+static double sum_imbalance = 0.0;
+static size_t num_exchanged = 0;
+
+void
+Distributed::init() {
+#ifdef USE_MPI
+  int already = 0;
+  MPI_Initialized(&already);
+  if (already) return;
+
+  // only the thread that steps the simulation makes MPI calls
+  int provided = 0;
+  MPI_Init_thread(nullptr, nullptr, MPI_THREAD_FUNNELED, &provided);
+  started = true;
+  MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
+  shares.assign(num_ranks, 1.0 / num_ranks);
+  splits.assign(num_ranks+1, std::numeric_limits<uint64_t>::max());
+  splits[0] = 0;
+
+  // every rank would print the same thing
+  if (my_rank > 0) {
+#ifdef _WIN32
+    (void) std::freopen("NUL", "w", stdout);
+#else
+    (void) std::freopen("/dev/null", "w", stdout);
+#endif
+  }
+
+  if (num_ranks > 1) std::cout << "Running on " << num_ranks << " MPI ranks" << std::endl;
+#endif
+}
+
+void
+Distributed::finalize() {
+#ifdef USE_MPI
+  if (not started) return;
+  MPI_Finalize();
+  started = false;
+#endif
+}
+
+int Distributed::rank() { return my_rank; }
+int Distributed::size() { return num_ranks; }
+bool Distributed::is_on() { return (num_ranks > 1 and solo_depth == 0); }
+
+Distributed::Solo::Solo() { solo_depth++; }
+Distributed::Solo::~Solo() { solo_depth--; }
+
+void
+Distributed::set_frame(float _xmin, float _xmax, float _ymin, float _ymax) {
+#ifdef USE_MPI
+  if (is_on()) {
+    float box[4] = {-_xmin, _xmax, -_ymin, _ymax};
+    MPI_Allreduce(MPI_IN_PLACE, box, 4, MPI_FLOAT, MPI_MAX, MPI_COMM_WORLD);
+    _xmin = -box[0];
+    _xmax = box[1];
+    _ymin = -box[2];
+    _ymax = box[3];
+  }
+#endif
+  // no particles anywhere
+  if (_xmin > _xmax or _ymin > _ymax) {
+    _xmin = _ymin = 0.0;
+    _xmax = _ymax = 1.0;
+  }
+
+  // a little larger, so the edges are inside
+  const double width = 1.01 * std::max((double)_xmax - (double)_xmin, (double)_ymax - (double)_ymin) + 1.e-6;
+  frame_x0 = 0.5 * ((double)_xmin + (double)_xmax - width);
+  frame_y0 = 0.5 * ((double)_ymin + (double)_ymax - width);
+  frame_scale = (double)key_cells / width;
+}
+
+// put a zero bit above each of the 32 bits
+static uint64_t spread_bits(uint64_t _v) {
+  _v = (_v | (_v << 16)) & 0x0000ffff0000ffffull;
+  _v = (_v | (_v << 8))  & 0x00ff00ff00ff00ffull;
+  _v = (_v | (_v << 4))  & 0x0f0f0f0f0f0f0f0full;
+  _v = (_v | (_v << 2))  & 0x3333333333333333ull;
+  _v = (_v | (_v << 1))  & 0x5555555555555555ull;
+  return _v;
+}
+
+uint64_t
+Distributed::key(const float _x, const float _y) {
+  // anything outside the frame goes to its edge
+  const double qx = std::clamp(((double)_x - frame_x0) * frame_scale, 0.0, (double)key_cells);
+  const double qy = std::clamp(((double)_y - frame_y0) * frame_scale, 0.0, (double)key_cells);
+  return spread_bits((uint64_t)qx) | (spread_bits((uint64_t)qy) << 1);
+}
+
+int
+Distributed::owner(const uint64_t _key) {
+  return (int)(std::upper_bound(splits.begin()+1, splits.end()-1, _key) - (splits.begin()+1));
+}
+
+void
+Distributed::split_keys(std::vector<uint64_t> const& _sorted, const bool _replicated) {
+  if (not is_on()) return;
+
+  // keys with the number of particles each stands for
+  std::vector<std::pair<uint64_t,double>> samples;
+  if (_replicated) {
+    samples.reserve(_sorted.size());
+    for (auto const& k : _sorted) samples.emplace_back(k, 1.0);
+  } else {
+#ifdef USE_MPI
+    // evenly spaced samples of this rank's keys are close to its quantiles
+    const size_t n = _sorted.size();
+    const size_t m = std::min(n, (size_t)256);
+    std::vector<uint64_t> mykeys(m);
+    for (size_t k=0; k<m; ++k) mykeys[k] = _sorted[(2*k+1)*n/(2*m)];
+
+    int mycount = (int)m;
+    std::vector<int> counts(num_ranks), displs(num_ranks, 0);
+    MPI_Allgather(&mycount, 1, MPI_INT, counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    const double myweight = (m > 0) ? (double)n / (double)m : 0.0;
+    std::vector<double> weights(num_ranks);
+    MPI_Allgather(&myweight, 1, MPI_DOUBLE, weights.data(), 1, MPI_DOUBLE, MPI_COMM_WORLD);
+    for (int r=1; r<num_ranks; ++r) displs[r] = displs[r-1] + counts[r-1];
+    std::vector<uint64_t> allkeys(displs[num_ranks-1] + counts[num_ranks-1]);
+    MPI_Allgatherv(mykeys.data(), mycount, MPI_UINT64_T,
+                   allkeys.data(), counts.data(), displs.data(), MPI_UINT64_T, MPI_COMM_WORLD);
+
+    samples.reserve(allkeys.size());
+    for (int r=0; r<num_ranks; ++r) {
+      for (int k=0; k<counts[r]; ++k) samples.emplace_back(allkeys[displs[r]+k], weights[r]);
+    }
+#endif
+  }
+  std::sort(samples.begin(), samples.end());
+
+  double total = 0.0;
+  for (auto const& s : samples) total += s.second;
+
+  // each split is where the running total passes the shares of the ranks below it
+  double below = 0.0;
+  double target = 0.0;
+  size_t next = 0;
+  for (int r=1; r<num_ranks; ++r) {
+    target += shares[r-1] * total;
+    while (next < samples.size() and below + 0.5*samples[next].second <= target) {
+      below += samples[next].second;
+      next++;
+    }
+    splits[r] = (next < samples.size()) ? samples[next].first : std::numeric_limits<uint64_t>::max();
+  }
+}
+
+std::vector<float>
+Distributed::exchange(std::vector<std::vector<float>> const& _out, std::vector<size_t>& _counts) {
+  _counts.assign(num_ranks, 0);
+#ifdef USE_MPI
+  if (is_on()) {
+    std::vector<int> scounts(num_ranks), sdispls(num_ranks, 0), rcounts(num_ranks), rdispls(num_ranks, 0);
+    for (int r=0; r<num_ranks; ++r) scounts[r] = (int)_out[r].size();
+    MPI_Alltoall(scounts.data(), 1, MPI_INT, rcounts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    for (int r=1; r<num_ranks; ++r) {
+      sdispls[r] = sdispls[r-1] + scounts[r-1];
+      rdispls[r] = rdispls[r-1] + rcounts[r-1];
+    }
+
+    std::vector<float> sendbuf(sdispls[num_ranks-1] + scounts[num_ranks-1]);
+    for (int r=0; r<num_ranks; ++r) std::copy(_out[r].begin(), _out[r].end(), sendbuf.begin()+sdispls[r]);
+    std::vector<float> recvbuf(rdispls[num_ranks-1] + rcounts[num_ranks-1]);
+    MPI_Alltoallv(sendbuf.data(), scounts.data(), sdispls.data(), MPI_FLOAT,
+                  recvbuf.data(), rcounts.data(), rdispls.data(), MPI_FLOAT, MPI_COMM_WORLD);
+
+    for (int r=0; r<num_ranks; ++r) {
+      _counts[r] = (size_t)rcounts[r];
+      if (r != my_rank) num_exchanged += (size_t)rcounts[r];
+    }
+    return recvbuf;
+  }
+#endif
+  _counts[my_rank] = _out[my_rank].size();
+  return _out[my_rank];
+}
+
+void
+Distributed::shift_start(std::vector<float> const& _send, std::vector<float>& _recv) {
+#ifdef USE_MPI
+  if (is_on()) {
+    const int next = (my_rank + 1) % num_ranks;
+    const int prev = (my_rank + num_ranks - 1) % num_ranks;
+
+    // the sizes first, so the block can be received as the work goes on
+    int sendcount = (int)_send.size();
+    int recvcount = 0;
+    MPI_Sendrecv(&sendcount, 1, MPI_INT, next, 0, &recvcount, 1, MPI_INT, prev, 0,
+                 MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    _recv.resize(recvcount);
+    MPI_Irecv(_recv.data(), recvcount, MPI_FLOAT, prev, 1, MPI_COMM_WORLD, &shift_reqs[0]);
+    MPI_Isend(_send.data(), sendcount, MPI_FLOAT, next, 1, MPI_COMM_WORLD, &shift_reqs[1]);
+    num_shift_reqs = 2;
+    return;
+  }
+#endif
+  _recv = _send;
+}
+
+void
+Distributed::shift_finish() {
+#ifdef USE_MPI
+  if (num_shift_reqs == 0) return;
+  MPI_Waitall(num_shift_reqs, shift_reqs, MPI_STATUSES_IGNORE);
+  num_shift_reqs = 0;
+#endif
+}
+
+Distributed::Halo
+Distributed::find_halo(float const* _x, float const* _y, const size_t _n, const float _cutoff) {
+  Halo h;
+  h.sent.resize(num_ranks);
+  h.lowest.assign(_n, my_rank);
+#ifdef USE_MPI
+  if (not is_on()) return h;
+
+  // the extents of runs of this rank's particles, which are mostly in key order, so
+  //   each run is a compact patch (an empty run is inside out)
+  std::vector<float> mine(4*halo_boxes);
+  for (size_t b=0; b<halo_boxes; ++b) {
+    float box[4] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest(),
+                    std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()};
+    for (size_t i=b*_n/halo_boxes; i<(b+1)*_n/halo_boxes; ++i) {
+      box[0] = std::min(box[0], _x[i]);
+      box[1] = std::max(box[1], _x[i]);
+      box[2] = std::min(box[2], _y[i]);
+      box[3] = std::max(box[3], _y[i]);
+    }
+    std::copy(box, box+4, mine.begin()+4*b);
+  }
+  std::vector<float> all(4*halo_boxes*num_ranks);
+  MPI_Allgather(mine.data(), 4*halo_boxes, MPI_FLOAT, all.data(), 4*halo_boxes, MPI_FLOAT, MPI_COMM_WORLD);
+
+  auto overlaps = [](float const* a, float const* b, const float _pad) {
+    return (a[0] <= b[1]+_pad and b[0] <= a[1]+_pad and a[2] <= b[3]+_pad and b[2] <= a[3]+_pad);
+  };
+
+  // only the runs of ours that come near a run of theirs need their particles tested
+  for (int q=0; q<num_ranks; ++q) {
+    if (q == my_rank) continue;
+    float const* theirs = all.data() + 4*halo_boxes*q;
+    for (size_t b=0; b<halo_boxes; ++b) {
+      float const* ourbox = mine.data() + 4*b;
+      std::vector<size_t> near;
+      for (size_t c=0; c<halo_boxes; ++c) {
+        if (overlaps(ourbox, theirs+4*c, _cutoff)) near.push_back(c);
+      }
+      if (near.empty()) continue;
+
+      for (size_t i=b*_n/halo_boxes; i<(b+1)*_n/halo_boxes; ++i) {
+        for (auto const& c : near) {
+          float const* tb = theirs + 4*c;
+          if (_x[i] >= tb[0]-_cutoff and _x[i] <= tb[1]+_cutoff and
+              _y[i] >= tb[2]-_cutoff and _y[i] <= tb[3]+_cutoff) {
+            h.sent[q].push_back(i);
+            h.lowest[i] = std::min(h.lowest[i], q);
+            break;
+          }
+        }
+      }
+    }
+  }
+#else
+  (void) _x;
+  (void) _y;
+  (void) _cutoff;
+#endif
+  return h;
+}
+
+// every rank's values in rank order, added up in double
+template <class T>
+static void ordered_sum(T* _v, const size_t _n) {
+#ifdef USE_MPI
+  if (not Distributed::is_on() or _n == 0) return;
+  std::vector<double> mine(_v, _v+_n);
+  std::vector<double> all(_n*num_ranks);
+  MPI_Allgather(mine.data(), (int)_n, MPI_DOUBLE, all.data(), (int)_n, MPI_DOUBLE, MPI_COMM_WORLD);
+  for (size_t i=0; i<_n; ++i) {
+    double sum = 0.0;
+    for (int r=0; r<num_ranks; ++r) sum += all[r*_n+i];
+    _v[i] = (T)sum;
+  }
+#else
+  (void) _v;
+  (void) _n;
+#endif
+}
+
+void Distributed::sum(float* _v, const size_t _n) { ordered_sum(_v, _n); }
+void Distributed::sum(double* _v, const size_t _n) { ordered_sum(_v, _n); }
+
+double
+Distributed::largest(const double _val) {
+#ifdef USE_MPI
+  if (not is_on()) return _val;
+  double val = _val;
+  MPI_Allreduce(MPI_IN_PLACE, &val, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  return val;
+#else
+  return _val;
+#endif
+}
+
+std::vector<float>
+Distributed::gather(std::vector<float> const& _v) {
+#ifdef USE_MPI
+  if (is_on()) {
+    int mycount = (int)_v.size();
+    std::vector<int> counts(num_ranks), displs(num_ranks, 0);
+    MPI_Gather(&mycount, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    std::vector<float> all;
+    if (my_rank == 0) {
+      for (int r=1; r<num_ranks; ++r) displs[r] = displs[r-1] + counts[r-1];
+      all.resize(displs[num_ranks-1] + counts[num_ranks-1]);
+    }
+    MPI_Gatherv(_v.data(), mycount, MPI_FLOAT, all.data(), counts.data(), displs.data(), MPI_FLOAT,
+                0, MPI_COMM_WORLD);
+    return all;
+  }
+#endif
+  return _v;
+}
+
+void
+Distributed::record_time(const size_t _count, const double _seconds) {
+#ifdef USE_MPI
+  if (not is_on()) return;
+  const double mine[2] = {(double)_count, _seconds};
+  std::vector<double> all(2*num_ranks);
+  MPI_Allgather(mine, 2, MPI_DOUBLE, all.data(), 2, MPI_DOUBLE, MPI_COMM_WORLD);
+
+  size_t total = 0;
+  double maxsecs = 0.0, sumsecs = 0.0, sumrate = 0.0;
+  std::vector<double> rates(num_ranks);
+  for (int r=0; r<num_ranks; ++r) {
+    total += (size_t)all[2*r];
+    maxsecs = std::max(maxsecs, all[2*r+1]);
+    sumsecs += all[2*r+1];
+    rates[r] = all[2*r] / std::max(1.e-9, all[2*r+1]);
+    sumrate += rates[r];
+  }
+  if (total < min_timed_targets or sumrate <= 0.0) return;
+
+  num_timed++;
+  sum_imbalance += maxsecs / std::max(1.e-9, sumsecs / num_ranks) - 1.0;
+
+  // lean toward the measured rates, but not all the way, as one step can be noisy
+  for (int r=0; r<num_ranks; ++r) shares[r] = 0.5*shares[r] + 0.5*rates[r]/sumrate;
+#else
+  (void) _count;
+  (void) _seconds;
+#endif
+}
+
+bool
+Distributed::agree(const uint64_t _val) {
+#ifdef USE_MPI
+  if (not is_on()) return true;
+  // the largest value and the largest complement, which is the complement of the smallest
+  uint64_t both[2] = {_val, ~_val};
+  MPI_Allreduce(MPI_IN_PLACE, both, 2, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+  return both[0] == ~both[1];
+#else
+  (void) _val;
+  return true;
+#endif
+}
+
+bool
+Distributed::any(const bool _val) {
+#ifdef USE_MPI
+  if (not is_on()) return _val;
+  int flag = _val ? 1 : 0;
+  MPI_Allreduce(MPI_IN_PLACE, &flag, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  return (flag != 0);
+#else
+  return _val;
+#endif
+}
+
+void
+Distributed::abort(const std::string _msg) {
+  std::cerr << std::endl << "ERROR on rank " << my_rank << ": " << _msg << std::endl;
+#ifdef USE_MPI
+  if (started) MPI_Abort(MPI_COMM_WORLD, 1);
+#endif
+  std::exit(1);
+}
+
+std::string
+Distributed::report() {
+  if (num_ranks < 2) return "";
+  std::ostringstream ss;
+  ss << "Particles on " << num_ranks << " ranks, " << num_timed << " timed velocity sums";
+  if (num_timed > 0) ss << ", mean imbalance " << (100.0 * sum_imbalance / num_timed) << "%";
+  ss << std::endl << "  values rank 0 took from other ranks in migrations and halos: " << num_exchanged;
+  ss << std::endl << "  final shares:";
+  for (auto const& s : shares) ss << " " << s;
+  return ss.str();
+}
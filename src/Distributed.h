@@ -0,0 +1,112 @@
+/*
+ * Distributed.h - Spread the particles of one simulation over several MPI ranks
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+//
+// One simulation run by several processes at once, possibly on several nodes
+//
+// Each rank owns the vortex particles whose Morton keys fall in its range of keys. The
+//   keys interleave the bits of each particle's position in a square frame around every
+//   rank's particles, so a range of keys is a compact patch of the flow. After each step's
+//   advection the frame and the splits between ranges are found again and particles
+//   migrate to their new owners; the splits follow each rank's measured speed on the
+//   velocity sums, so a slower node owns fewer particles.
+//
+// The velocity sums are direct, and need no ghost sources or far-field summaries: each
+//   rank's particles go around a ring of the ranks as a block of sources, one hop per
+//   turn, while every rank sums the block it holds onto its own particles. Diffusion
+//   and merging only need neighbours, so each rank takes copies (a halo) of the other
+//   ranks' particles near its own, and sends back what it did to them.
+//
+// The boundaries, their BEM system and the tracers are small, and every rank holds all
+//   of them. Their velocities from the particles are summed over ranks, in rank order,
+//   so every rank has the same bits; each step checks that the ranks still agree. That
+//   needs reproducible mode, as random choices (like new particles from emitters) must
+//   be the same on every rank. Particles that every rank makes (initial particles, and
+//   those from emitters and shedding) are kept only by their owner.
+//
+// Results depend on the number of ranks, as sums and merges happen in another order,
+//   and PSE can add the same new particle at the edge of the vorticity on both sides of
+//   a split (merging later removes most of them). Only the first rank writes files or
+//   prints; output and checkpoints gather the particles to it, so it needs memory for
+//   all of them at those times.
+//
+// Without USE_MPI, or when started without mpirun, there is one rank and all of this
+//   does nothing.
+//
+class Distributed {
+public:
+  // start and stop MPI; the other ranks' output goes nowhere
+  static void init();
+  static void finalize();
+
+  static int rank();
+  static int size();
+  static bool is_on();
+  static bool is_root() { return rank() == 0; }
+
+  // while one of these exists, this rank works alone, as on particles gathered to it
+  class Solo {
+  public:
+    Solo();
+    ~Solo();
+  };
+
+  // the square that keys are made in, big enough for every rank's particles
+  static void set_frame(float _xmin, float _xmax, float _ymin, float _ymax);
+  static uint64_t key(const float _x, const float _y);
+  // which rank owns this key
+  static int owner(const uint64_t _key);
+  // place the splits between the ranks' ranges of keys, given this rank's keys in order
+  //   (or every key, the same on every rank)
+  static void split_keys(std::vector<uint64_t> const& _sorted, const bool _replicated);
+
+  // send each rank its values, and get all that were sent here in rank order, with counts
+  static std::vector<float> exchange(std::vector<std::vector<float>> const& _out,
+                                     std::vector<size_t>& _counts);
+
+  // pass a block to the next rank around the ring and take one from the last, while
+  //   this rank works on the one it has
+  static void shift_start(std::vector<float> const& _send, std::vector<float>& _recv);
+  static void shift_finish();
+
+  // this rank's particles close enough to another rank's to be needed there
+  struct Halo {
+    std::vector<std::vector<size_t>> sent;	// own particles for each rank
+    std::vector<int> lowest;			// lowest rank to hold each own particle
+  };
+  static Halo find_halo(float const* _x, float const* _y, const size_t _n, const float _cutoff);
+
+  // add up values from every rank, in rank order, so every rank gets the same bits
+  static void sum(float*, const size_t);
+  static void sum(double*, const size_t);
+  static double largest(const double);
+
+  // every rank's values in rank order, on the first rank (others get nothing)
+  static std::vector<float> gather(std::vector<float> const&);
+
+  // learn from how long each rank's velocity sums took
+  static void record_time(const size_t _count, const double _seconds);
+
+  // true on every rank if this value is the same on every rank
+  static bool agree(const uint64_t);
+  // true on every rank if it is true on any
+  static bool any(const bool);
+
+  // stop every rank, with a message from this one
+  [[noreturn]] static void abort(const std::string);
+
+  // how the work was shared, for the end of the run
+  static std::string report();
+};
@@ -0,0 +1,370 @@
+/*
+ * DistributedHelper.h - non-class glue between the particle collections and Distributed
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include "Omega2D.h"
+#include "Collection.h"
+#include "Distributed.h"
+#include "ElementPacket.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+
+//
+// set a collection of vortons to the given x, y, s, r values
+//
+template <class S>
+void fill_particles(Points<S>& _pts, std::vector<S> const& _xysr) {
+  const size_t n = _xysr.size() / 4;
+  _pts.resize(n);
+  std::array<Vector<S>,Dimensions>& x = _pts.get_pos();
+  Vector<S>& s = _pts.get_str();
+  Vector<S>& r = _pts.get_rad();
+  for (size_t i=0; i<n; ++i) {
+    x[0][i] = _xysr[4*i];
+    x[1][i] = _xysr[4*i+1];
+    s[i]    = _xysr[4*i+2];
+    r[i]    = _xysr[4*i+3];
+  }
+}
+
+//
+// all of this rank's vortons, as x, y, s, r
+//
+template <class S>
+std::vector<S> pack_particles(std::vector<Collection> const& _vort) {
+  std::vector<S> xysr;
+  for (auto const& coll : _vort) {
+    if (not std::holds_alternative<Points<S>>(coll)) continue;
+    Points<S> const& pts = std::get<Points<S>>(coll);
+    if (pts.is_inert()) continue;
+    const size_t n = pts.get_n();
+    const size_t first = xysr.size();
+    xysr.resize(first + 4*n);
+    for (size_t i=0; i<n; ++i) {
+      xysr[first+4*i]   = pts.get_pos()[0][i];
+      xysr[first+4*i+1] = pts.get_pos()[1][i];
+      xysr[first+4*i+2] = pts.get_str()[i];
+      xysr[first+4*i+3] = pts.get_rad()[i];
+    }
+  }
+  return xysr;
+}
+
+//
+// add up the velocities that every rank put on a collection that they all hold
+//
+template <class S>
+void sum_vels(Collection& _targ) {
+  if (not Distributed::is_on()) return;
+  if (std::holds_alternative<Surfaces<S>>(_targ)) {
+    Surfaces<S>& surf = std::get<Surfaces<S>>(_targ);
+    // velocities at the panel centers, and at the nodes
+    for (size_t d=0; d<Dimensions; ++d) Distributed::sum(surf.get_vel()[d].data(), surf.get_vel()[d].size());
+    std::array<Vector<S>,Dimensions>& nodevel = static_cast<ElementBase<S>&>(surf).get_vel();
+    for (size_t d=0; d<Dimensions; ++d) Distributed::sum(nodevel[d].data(), nodevel[d].size());
+  } else {
+    Points<S>& pts = std::get<Points<S>>(_targ);
+    for (size_t d=0; d<Dimensions; ++d) Distributed::sum(pts.get_vel()[d].data(), pts.get_n());
+  }
+}
+
+//
+// the largest vorton radius on any rank
+//
+template <class S>
+S largest_radius(std::vector<Collection> const& _vort) {
+  S rmax = 0.0;
+  for (auto const& coll : _vort) {
+    if (not std::holds_alternative<Points<S>>(coll)) continue;
+    Points<S> const& pts = std::get<Points<S>>(coll);
+    if (pts.is_inert()) continue;
+    for (auto const& r : pts.get_rad()) rmax = std::max(rmax, r);
+  }
+  return (S)Distributed::largest((double)rmax);
+}
+
+//
+// drop the new vortons that another rank owns, from x, y, s, r or from a packet
+//
+template <class S>
+void keep_own(std::vector<S>& _xysr) {
+  if (not Distributed::is_on()) return;
+  size_t copyto = 0;
+  for (size_t i=0; i<_xysr.size()/4; ++i) {
+    if (Distributed::owner(Distributed::key(_xysr[4*i], _xysr[4*i+1])) != Distributed::rank()) continue;
+    std::copy(_xysr.begin()+4*i, _xysr.begin()+4*i+4, _xysr.begin()+4*copyto);
+    copyto++;
+  }
+  _xysr.resize(4*copyto);
+}
+
+template <class S>
+void keep_own(ElementPacket<S>& _elems) {
+  if (not Distributed::is_on()) return;
+  // count from the positions, as empty packets can carry a placeholder nelem
+  size_t copyto = 0;
+  for (size_t i=0; i<_elems.x.size()/2; ++i) {
+    if (Distributed::owner(Distributed::key(_elems.x[2*i], _elems.x[2*i+1])) != Distributed::rank()) continue;
+    _elems.x[2*copyto]   = _elems.x[2*i];
+    _elems.x[2*copyto+1] = _elems.x[2*i+1];
+    _elems.val[copyto]   = _elems.val[i];
+    copyto++;
+  }
+  _elems.x.resize(2*copyto);
+  _elems.val.resize(copyto);
+  _elems.nelem = copyto;
+}
+
+//
+// give every vorton to the rank that owns its place, in key order on each rank;
+//   replicated means that every rank holds all of them now, as before the first step
+//
+template <class S>
+void split_particles(std::vector<Collection>& _vort, const bool _replicated) {
+  if (not Distributed::is_on()) return;
+  ScopedTimer timer("migrate");
+
+  // only free vortons can move between ranks
+  for (auto const& coll : _vort) {
+    if (std::holds_alternative<Points<S>>(coll)) {
+      Points<S> const& pts = std::get<Points<S>>(coll);
+      if (not pts.is_inert() and pts.get_movet() == lagrangian and not pts.get_body_ptr()) continue;
+    }
+    Distributed::abort("MPI runs can only spread free vortons over ranks, not panels or attached points");
+  }
+
+  // the frame around every rank's vortons
+  float box[4] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest(),
+                  std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()};
+  for (auto const& coll : _vort) {
+    Points<S> const& pts = std::get<Points<S>>(coll);
+    for (size_t i=0; i<pts.get_n(); ++i) {
+      box[0] = std::min(box[0], pts.get_pos()[0][i]);
+      box[1] = std::max(box[1], pts.get_pos()[0][i]);
+      box[2] = std::min(box[2], pts.get_pos()[1][i]);
+      box[3] = std::max(box[3], pts.get_pos()[1][i]);
+    }
+  }
+  Distributed::set_frame(box[0], box[1], box[2], box[3]);
+
+  // every vorton's key, and the splits between the ranks' ranges
+  std::vector<std::vector<uint64_t>> keys(_vort.size());
+  std::vector<uint64_t> sorted;
+  for (size_t c=0; c<_vort.size(); ++c) {
+    Points<S> const& pts = std::get<Points<S>>(_vort[c]);
+    keys[c].resize(pts.get_n());
+    for (size_t i=0; i<pts.get_n(); ++i) keys[c][i] = Distributed::key(pts.get_pos()[0][i], pts.get_pos()[1][i]);
+    sorted.insert(sorted.end(), keys[c].begin(), keys[c].end());
+  }
+  std::sort(sorted.begin(), sorted.end());
+  Distributed::split_keys(sorted, _replicated);
+  sorted = std::vector<uint64_t>();
+
+  for (size_t c=0; c<_vort.size(); ++c) {
+    Points<S>& pts = std::get<Points<S>>(_vort[c]);
+    std::vector<size_t> order(pts.get_n());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[c][a] < keys[c][b]; });
+
+    // send each one to its owner (or, if all ranks have them, keep only ours)
+    std::vector<std::vector<S>> out(Distributed::size());
+    for (auto const& i : order) {
+      const int q = Distributed::owner(keys[c][i]);
+      if (_replicated and q != Distributed::rank()) continue;
+      out[q].insert(out[q].end(), {pts.get_pos()[0][i], pts.get_pos()[1][i], pts.get_str()[i], pts.get_rad()[i]});
+    }
+    keys[c] = std::vector<uint64_t>();
+    std::vector<size_t> counts;
+    std::vector<S> in = Distributed::exchange(out, counts);
+    out.clear();
+
+    // each rank's arrive in key order, so put the lot in key order
+    const size_t n = in.size() / 4;
+    std::vector<uint64_t> inkeys(n);
+    for (size_t i=0; i<n; ++i) inkeys[i] = Distributed::key(in[4*i], in[4*i+1]);
+    order.resize(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return inkeys[a] < inkeys[b]; });
+    std::vector<S> xysr(4*n);
+    for (size_t i=0; i<n; ++i) std::copy(in.begin()+4*order[i], in.begin()+4*order[i]+4, xysr.begin()+4*i);
+
+    fill_particles(pts, xysr);
+  }
+}
+
+//
+// every rank's vortons, with their velocities, on the first rank (the others get nothing)
+//
+template <class S>
+std::vector<Collection> gather_particles(std::vector<Collection> const& _vort) {
+  std::vector<Collection> all;
+  for (auto const& coll : _vort) {
+    Points<S> const& pts = std::get<Points<S>>(coll);
+    std::vector<S> mine(6*pts.get_n());
+    for (size_t i=0; i<pts.get_n(); ++i) {
+      mine[6*i]   = pts.get_pos()[0][i];
+      mine[6*i+1] = pts.get_pos()[1][i];
+      mine[6*i+2] = pts.get_str()[i];
+      mine[6*i+3] = pts.get_rad()[i];
+      mine[6*i+4] = pts.get_vel()[0][i];
+      mine[6*i+5] = pts.get_vel()[1][i];
+    }
+    std::vector<S> every = Distributed::gather(mine);
+    if (not Distributed::is_root()) continue;
+
+    // a copy keeps the collection's settings, and the same code draws and writes it
+    const size_t n = every.size() / 6;
+    Points<S> full = pts;
+    full.resize(n);
+    for (size_t i=0; i<n; ++i) {
+      full.get_pos()[0][i] = every[6*i];
+      full.get_pos()[1][i] = every[6*i+1];
+      full.get_str()[i]    = every[6*i+2];
+      full.get_rad()[i]    = every[6*i+3];
+      full.get_vel()[0][i] = every[6*i+4];
+      full.get_vel()[1][i] = every[6*i+5];
+    }
+    all.push_back(std::move(full));
+  }
+  return all;
+}
+
+
+//
+// copies of other ranks' vortons near this rank's, for diffusion and merging
+//
+template <class S>
+struct ParticleHalo {
+  size_t nown = 0;		// this rank's vortons, which come before the copies
+  Distributed::Halo sent;	// which of them went to each rank
+  std::vector<size_t> got;	// how many copies came from each rank, in rank order
+  std::vector<S> str;		// the copies' strengths as they came
+  std::vector<bool> frozen;	// vortons that another rank may merge, so this one may not
+};
+
+//
+// append copies of the other ranks' vortons within the cutoff of ours; each vorton may
+//   be changed by only the lowest rank that holds it, so the others freeze it
+//
+template <class S>
+ParticleHalo<S> add_halo(Points<S>& _pts, const S _cutoff) {
+  ParticleHalo<S> h;
+  h.nown = _pts.get_n();
+  std::array<Vector<S>,Dimensions>& x = _pts.get_pos();
+  Vector<S>& s = _pts.get_str();
+  Vector<S>& r = _pts.get_rad();
+  h.sent = Distributed::find_halo(x[0].data(), x[1].data(), h.nown, _cutoff);
+
+  std::vector<std::vector<S>> out(Distributed::size());
+  for (size_t q=0; q<out.size(); ++q) {
+    for (auto const& i : h.sent.sent[q]) {
+      out[q].insert(out[q].end(), {x[0][i], x[1][i], s[i], r[i], (S)h.sent.lowest[i]});
+    }
+  }
+  std::vector<size_t> counts;
+  std::vector<S> in = Distributed::exchange(out, counts);
+  h.got.resize(counts.size());
+  for (size_t q=0; q<counts.size(); ++q) h.got[q] = counts[q] / 5;
+
+  const size_t ncopies = in.size() / 5;
+  _pts.resize(h.nown + ncopies);
+  h.str.resize(ncopies);
+  h.frozen.resize(h.nown + ncopies);
+  for (size_t i=0; i<h.nown; ++i) h.frozen[i] = (h.sent.lowest[i] != Distributed::rank());
+  for (size_t k=0; k<ncopies; ++k) {
+    const size_t i = h.nown + k;
+    x[0][i] = in[5*k];
+    x[1][i] = in[5*k+1];
+    s[i]    = in[5*k+2];
+    r[i]    = in[5*k+3];
+    h.str[k] = in[5*k+2];
+    h.frozen[i] = ((int)in[5*k+4] != Distributed::rank());
+  }
+  return h;
+}
+
+//
+// send back what happened to the copies, apply what happened to ours, and drop the
+//   copies; every rank adds to a vorton's strength, but only the lowest rank holding
+//   it moves or removes it; erased is which of the vortons from before (own and
+//   copies) are gone, and any made since come after the survivors
+//
+template <class S>
+void finish_halo(Points<S>& _pts, ParticleHalo<S> const& _h, std::vector<bool> const* _erased = nullptr) {
+  const size_t n0 = _h.nown + _h.str.size();
+  constexpr size_t gone = std::numeric_limits<size_t>::max();
+
+  // where each of those is now
+  std::vector<size_t> now(n0);
+  size_t nkept = 0;
+  for (size_t j=0; j<n0; ++j) now[j] = (_erased and (*_erased)[j]) ? gone : nkept++;
+
+  std::array<Vector<S>,Dimensions>& x = _pts.get_pos();
+  Vector<S>& s = _pts.get_str();
+  Vector<S>& r = _pts.get_rad();
+
+  // each copy goes back as its change in strength, where it is, its radius, and if it is gone
+  std::vector<std::vector<S>> out(Distributed::size());
+  size_t j = _h.nown;
+  for (size_t q=0; q<out.size(); ++q) {
+    for (size_t k=0; k<_h.got[q]; ++k, ++j) {
+      const S before = _h.str[j-_h.nown];
+      if (now[j] == gone) {
+        out[q].insert(out[q].end(), {-before, (S)0.0, (S)0.0, (S)0.0, (S)1.0});
+      } else {
+        const size_t i = now[j];
+        out[q].insert(out[q].end(), {s[i]-before, x[0][i], x[1][i], r[i], (S)0.0});
+      }
+    }
+  }
+  std::vector<size_t> counts;
+  std::vector<S> in = Distributed::exchange(out, counts);
+  out.clear();
+
+  std::vector<bool> dropped(_h.nown, false);
+  size_t k = 0;
+  for (size_t q=0; q<counts.size(); ++q) {
+    assert(counts[q] == 5*_h.sent.sent[q].size() && "Halo records do not match the copies sent");
+    for (auto const& own : _h.sent.sent[q]) {
+      S const* rec = in.data() + 5*(k++);
+      // merged away here, so no other rank could change it
+      if (now[own] == gone) continue;
+      const size_t i = now[own];
+      s[i] += rec[0];
+      if ((int)q == _h.sent.lowest[own]) {
+        x[0][i] = rec[1];
+        x[1][i] = rec[2];
+        r[i] = rec[3];
+        if (rec[4] > (S)0.5) dropped[own] = true;
+      }
+    }
+  }
+
+  // keep our survivors and anything new, in that order
+  const size_t n = _pts.get_n();
+  size_t copyto = 0;
+  auto keep = [&](const size_t _from) {
+    x[0][copyto] = x[0][_from];
+    x[1][copyto] = x[1][_from];
+    s[copyto] = s[_from];
+    r[copyto] = r[_from];
+    copyto++;
+  };
+  for (size_t i=0; i<_h.nown; ++i) {
+    if (now[i] != gone and not dropped[i]) keep(now[i]);
+  }
+  for (size_t i=nkept; i<n; ++i) keep(i);
+  _pts.resize(copyto);
+}
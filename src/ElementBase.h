@@ -11,6 +11,9 @@
 #include "Omega2D.h"
 #include "Body.h"
 #include "ElementPacket.h"
+#include "Checkpoint.h"
+#include "Numa.h"
+#include "ThreadPool.h"
 
 #include <iostream>
 #include <vector>
@@ -67,7 +70,7 @@ public:
     // this initialization is specific to Points - so should we do it there?
     for (size_t d=0; d<Dimensions; ++d) {
       // extend with more space for new values
-      x[d].resize(n+nnew);
+      numa_resize(x[d], n+nnew);
       // copy new values to end of vector
       for (size_t i=0; i<nnew; ++i) {
         x[d][n+i] = _in[nper*i+d];
@@ -77,7 +80,7 @@ public:
     // strength
     if (s) {
       // must dereference s to get the actual vector
-      (*s).resize(n+nnew);
+      numa_resize(*s, n+nnew);
       for (size_t i=0; i<nnew; ++i) {
         (*s)[n+i] = _in[nper*i+2];
       }
@@ -85,7 +88,7 @@ public:
 
     // extend the other vectors as well
     for (size_t d=0; d<Dimensions; ++d) {
-      u[d].resize(n+nnew);
+      numa_resize(u[d], n+nnew);
     }
     //if (dsdt) {
     //  for (size_t d=0; d<Dimensions; ++d) {
@@ -110,7 +113,7 @@ public:
     // add node coordinates
     for (size_t d=0; d<Dimensions; ++d) {
       // extend with more space for new values
-      x[d].resize(n+nnew);
+      numa_resize(x[d], n+nnew);
       // copy new values to end of vector
       for (size_t i=0; i<nnew; ++i) {
         x[d][n+i] = _in.x[Dimensions*i+d];
@@ -122,7 +125,7 @@ public:
       assert(_in.val.size() >= nnew && "Input ElementPacket does not have enough values in val");
       const size_t nper = _in.val.size() / nnew;
       // must dereference s to get the actual vector
-      (*s).resize(n+nnew);
+      numa_resize(*s, n+nnew);
       for (size_t i=0; i<nnew; ++i) {
         (*s)[n+i] = _in.val[nper*i+0];
       }
@@ -130,7 +133,7 @@ public:
 
     // extend the other vectors as well
     for (size_t d=0; d<Dimensions; ++d) {
-      u[d].resize(n+nnew);
+      numa_resize(u[d], n+nnew);
     }
 
     // finally, update n
@@ -148,7 +151,7 @@ public:
     // positions first
     for (size_t d=0; d<Dimensions; ++d) {
       const size_t thisn = x[d].size();
-      x[d].resize(_nnew);
+      numa_resize(x[d], _nnew);
       for (size_t i=thisn; i<_nnew; ++i) {
         x[d][i] = 0.0;
       }
@@ -157,7 +160,7 @@ public:
     // strength
     if (s) {
       const size_t thisn = (*s).size();
-      (*s).resize(_nnew);
+      numa_resize(*s, _nnew);
       for (size_t i=thisn; i<_nnew; ++i) {
         (*s)[i] = 0.0;
       }
@@ -165,7 +168,7 @@ public:
 
     // and finally velocity (no need to set it)
     for (size_t d=0; d<Dimensions; ++d) {
-      u[d].resize(_nnew);
+      numa_resize(u[d], _nnew);
     }
 
     // lastly, update n
@@ -213,7 +216,7 @@ public:
       const S st = std::sin(theta);
       const S ct = std::cos(theta);
 
-      std::cout << "    transforming body at time " << (S)_time << " to " << (S)thispos[0] << " " << (S)thispos[1]
+      TaskGroup::out() << "    transforming body at time " << (S)_time << " to " << (S)thispos[0] << " " << (S)thispos[1]
                 << " and theta " << theta << " omega " << B->get_rotvel() << std::endl;
 
       // and do the transform
@@ -228,7 +231,7 @@ public:
   // time is the starting time, time+dt is the ending time
   void move(const double _time, const double _dt) {
     if (M == lagrangian) {
-      std::cout << "  Moving" << to_string() << std::endl;
+      TaskGroup::out() << "  Moving" << to_string() << std::endl;
 
       // update positions
       for (size_t d=0; d<Dimensions; ++d) {
@@ -251,7 +254,7 @@ public:
     // must confirm that incoming time derivates include velocity
     // if this has vels, then lets advect it
     if (M == lagrangian) {
-      std::cout << "  Moving" << to_string() << std::endl;
+      TaskGroup::out() << "  Moving" << to_string() << std::endl;
 
       // update positions
       for (size_t d=0; d<Dimensions; ++d) {
@@ -270,6 +273,8 @@ public:
   // find the new peak strength magnitude
   S get_max_str() {
     if (s) {
+      // a rank of an MPI run can hold none of them
+      if (s->empty()) return 0.0;
       // we have strengths, go through and check them
       const S this_max = *std::max_element(std::begin(*s), std::end(*s));
       const S this_min = *std::min_element(std::begin(*s), std::end(*s));
@@ -307,6 +312,50 @@ public:
     return 0.0;
   }
 
+  // save the full state to a checkpoint, all array names start with _pfx
+  void write_checkpoint(CheckpointWriter& _cw, nlohmann::json& _j, const std::string _pfx) const {
+    _j["n"] = n;
+    for (size_t d=0; d<Dimensions; ++d) {
+      _cw.add(_pfx + "x" + std::to_string(d), x[d]);
+      _cw.add(_pfx + "u" + std::to_string(d), u[d]);
+      if (ux) _cw.add(_pfx + "ux" + std::to_string(d), (*ux)[d]);
+    }
+    if (s) _cw.add(_pfx + "s", *s);
+  }
+
+  // and read it back, E, M, and B must already be set
+  void read_checkpoint(CheckpointReader const& _cr, nlohmann::json const& _j, const std::string _pfx) {
+    n = _j["n"].get<size_t>();
+    for (size_t d=0; d<Dimensions; ++d) {
+      _cr.get(_pfx + "x" + std::to_string(d), x[d]);
+      _cr.get(_pfx + "u" + std::to_string(d), u[d]);
+      assert(x[d].size() == n && "Checkpoint position array has wrong size");
+    }
+    if (_cr.has(_pfx + "ux0")) {
+      std::array<Vector<S>,Dimensions> newux;
+      for (size_t d=0; d<Dimensions; ++d) _cr.get(_pfx + "ux" + std::to_string(d), newux[d]);
+      ux = std::move(newux);
+    } else {
+      ux.reset();
+    }
+    if (_cr.has(_pfx + "s")) {
+      Vector<S> news;
+      _cr.get(_pfx + "s", news);
+      s = std::move(news);
+    } else {
+      s.reset();
+    }
+  }
+
+  // bytes held by the element arrays, for memory accounting
+  size_t get_bytes() const {
+    size_t bytes = 0;
+    for (size_t d=0; d<Dimensions; ++d) bytes += (x[d].capacity() + u[d].capacity()) * sizeof(S);
+    if (s) bytes += s->capacity() * sizeof(S);
+    if (ux) for (size_t d=0; d<Dimensions; ++d) bytes += (*ux)[d].capacity() * sizeof(S);
+    return bytes;
+  }
+
   std::string to_string() const {
     std::string mystr;
     if (E == active) {
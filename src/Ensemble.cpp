@@ -0,0 +1,249 @@
+/*
+ * Ensemble.cpp - Run many batch simulations at once, for parameter sweeps
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "Ensemble.h"
+#include "Roofline.h"
+#include "MemoryTracker.h"
+
+#ifdef _WIN32
+  // for C++11 stuff
+  #include <ciso646>
+#endif
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+
+
+bool
+Ensemble::is_ensemble(nlohmann::json const& _j) {
+  return _j.find("ensemble") != _j.end();
+}
+
+//
+// expand one "vary" entry into its list of values
+//
+static std::vector<nlohmann::json>
+expand_values(std::string const& _key, nlohmann::json const& _v) {
+  std::vector<nlohmann::json> vals;
+  if (_v.is_array()) {
+    for (auto const& v : _v) vals.push_back(v);
+  } else if (_v.is_object()) {
+    const double first = _v.value("start", 0.0);
+    const double last = _v.value("end", first);
+    const int count = _v.value("count", 1);
+    if (count < 1) throw std::runtime_error("Ensemble range for " + _key + " needs a positive count");
+    for (int i=0; i<count; ++i) {
+      vals.push_back((count == 1) ? first : first + (last-first)*(double)i/(double)(count-1));
+    }
+  } else {
+    vals.push_back(_v);
+  }
+  if (vals.empty()) throw std::runtime_error("Ensemble has no values for " + _key);
+  return vals;
+}
+
+//
+// read the sweep specification and make every case
+//
+void
+Ensemble::from_json(nlohmann::json const& _j, const std::string _fn) {
+
+  if (not is_ensemble(_j)) throw std::runtime_error("No ensemble object in input");
+  nlohmann::json const& e = _j["ensemble"];
+
+  // file names in the sweep are relative to the sweep file itself
+  const std::filesystem::path here = std::filesystem::path(_fn).parent_path();
+  auto read_input = [&here](std::string const& _name) {
+    std::filesystem::path p(_name);
+    if (p.is_relative()) p = here / p;
+    std::ifstream in(p);
+    if (not in.is_open()) throw std::runtime_error("Could not open ensemble input " + p.string());
+    nlohmann::json j;
+    in >> j;
+    return j;
+  };
+
+  concurrent = e.value("concurrent", (size_t)0);
+  threads = e.value("threads", (size_t)0);
+  output_dir = e.value("outputDir", output_dir);
+  summary_file = e.value("summary", summary_file);
+
+  cases.clear();
+  auto add_case = [this](nlohmann::json const& _in, nlohmann::json const& _params) {
+    std::stringstream name;
+    name << "case_" << std::setfill('0') << std::setw(3) << cases.size();
+    cases.push_back({name.str(), output_dir + "/" + name.str(), _in, _params});
+  };
+
+  if (e.find("files") != e.end()) {
+    // a plain list of inputs
+    for (auto const& f : e["files"]) {
+      nlohmann::json params;
+      params["file"] = f;
+      add_case(read_input(f.get<std::string>()), params);
+    }
+
+  } else if (e.find("base") != e.end()) {
+    const nlohmann::json base = e["base"].is_string() ? read_input(e["base"].get<std::string>()) : e["base"];
+
+    // every combination of the varied values
+    std::vector<std::string> keys;
+    std::vector<std::vector<nlohmann::json>> vals;
+    if (e.find("vary") != e.end()) {
+      for (auto const& [key, v] : e["vary"].items()) {
+        keys.push_back(key);
+        vals.push_back(expand_values(key, v));
+      }
+    }
+
+    std::vector<size_t> counter(keys.size(), 0);
+    while (true) {
+      nlohmann::json thiscase = base;
+      nlohmann::json params = nlohmann::json::object();
+      for (size_t k=0; k<keys.size(); ++k) {
+        thiscase[nlohmann::json::json_pointer(keys[k])] = vals[k][counter[k]];
+        params[keys[k]] = vals[k][counter[k]];
+      }
+      add_case(thiscase, params);
+
+      // increment the odometer, last key fastest, and stop when it rolls over
+      bool carry = true;
+      for (size_t k=keys.size(); k>0 and carry; --k) {
+        carry = (++counter[k-1] == vals[k-1].size());
+        if (carry) counter[k-1] = 0;
+      }
+      if (carry) break;
+    }
+
+  } else {
+    throw std::runtime_error("Ensemble needs either \"base\" or \"files\"");
+  }
+
+  std::cout << "Ensemble has " << cases.size() << " cases, writing to " << output_dir << std::endl;
+}
+
+size_t
+Ensemble::get_num_threads(BatchOptions const& _opts) const {
+  const size_t hw = std::max((unsigned int)1, std::thread::hardware_concurrency());
+  return (_opts.threads > 0) ? (size_t)_opts.threads : ((threads > 0) ? threads : hw);
+}
+
+//
+// run all cases, a few at a time, each with its share of the threads
+//
+int
+Ensemble::run(BatchOptions const& _opts, volatile std::sig_atomic_t const* _stop) {
+
+  auto start = std::chrono::steady_clock::now();
+
+  const size_t nthreads = get_num_threads(_opts);
+  const size_t nconc = std::max((size_t)1, std::min(cases.size(), (concurrent > 0) ? concurrent : nthreads));
+  const int per_case = (int)std::max((size_t)1, nthreads / nconc);
+  // the budget, given or most of the node, is shared by the cases running at once
+  const double total_mb = (_opts.memory_budget > 0.0) ? _opts.memory_budget
+                        : 0.8 * (double)MemoryTracker::get_physical_bytes() / (1024.0 * 1024.0);
+  const double per_case_mb = total_mb / (double)nconc;
+  std::cout << "Running " << nconc << " at once with " << per_case << " threads and "
+            << std::fixed << std::setprecision(0) << per_case_mb << std::defaultfloat
+            << " MB each" << std::endl;
+
+  // every case gets the same overrides, but only its share of the threads
+  BatchOptions case_opts = _opts;
+  case_opts.restart.clear();
+  case_opts.threads = per_case;
+  case_opts.memory_budget = per_case_mb;
+  // the cases would all pin their first threads to the same cpus
+  case_opts.pin_threads = "none";
+
+  for (auto const& c : cases) {
+    std::filesystem::create_directories(c.dir);
+    // keep the exact input next to its results
+    std::ofstream out(c.dir + "/input.json");
+    out << std::setw(2) << c.input << std::endl;
+  }
+
+  // measure the node while it is quiet, if the cases will report their kernels against it
+  if (_opts.kernel_report or _opts.perf_counters or not _opts.trace.empty()) (void) Roofline::get();
+
+  // each worker takes the next case until there are none left
+  results.assign(cases.size(), BatchResult());
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    while (true) {
+      const size_t i = next++;
+      if (i >= cases.size()) break;
+      if (_stop and *_stop) {
+        results[i].name = cases[i].name;
+        results[i].dir = cases[i].dir;
+        results[i].params = cases[i].params;
+        results[i].status = 2;
+        results[i].error = "not started";
+        continue;
+      }
+      std::cout << "Starting " << cases[i].name << std::endl;
+      try {
+        results[i] = run_batch(cases[i].input, cases[i].dir, case_opts, _stop);
+      } catch (std::exception const& ex) {
+        results[i].status = 1;
+        results[i].error = ex.what();
+      }
+      results[i].name = cases[i].name;
+      results[i].dir = cases[i].dir;
+      results[i].params = cases[i].params;
+      std::cout << "Finished " << cases[i].name << " in " << results[i].wall_seconds << " s" << std::endl;
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (size_t t=0; t<nconc; ++t) pool.emplace_back(worker);
+  for (auto& t : pool) t.join();
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  wall_seconds = elapsed.count();
+
+  // the combined summary, on disk and on screen
+  {
+    std::ofstream out(output_dir + "/" + summary_file);
+    out << std::setw(2) << get_summary() << std::endl;
+  }
+
+  int nfail = 0;
+  std::cout << std::endl << "Ensemble summary (" << output_dir << "/" << summary_file << ")" << std::endl;
+  for (auto const& r : results) {
+    std::cout << "  " << r.name << "  " << std::setw(6) << (r.status == 0 ? "ok" : "error")
+              << "  steps " << std::setw(6) << r.nstep
+              << "  parts " << std::setw(8) << r.nparts
+              << "  wall " << std::setw(9) << std::fixed << std::setprecision(2) << r.wall_seconds
+              << std::defaultfloat << std::setprecision(6);
+    if (not r.params.is_null()) std::cout << "  " << r.params.dump();
+    if (not r.error.empty()) std::cout << "  (" << r.error << ")";
+    std::cout << std::endl;
+    if (r.status != 0) nfail++;
+  }
+  std::cout << "  " << cases.size() << " cases in " << wall_seconds << " s" << std::endl;
+
+  return nfail;
+}
+
+nlohmann::json
+Ensemble::get_summary() const {
+  nlohmann::json j;
+  j["outputDir"] = output_dir;
+  j["wallSeconds"] = wall_seconds;
+  nlohmann::json jc = nlohmann::json::array();
+  for (auto const& r : results) jc.push_back(r.to_json());
+  j["cases"] = jc;
+  return j;
+}
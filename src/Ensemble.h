@@ -0,0 +1,72 @@
+/*
+ * Ensemble.h - Run many batch simulations at once, for parameter sweeps
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include "BatchRunner.h"
+#include "json/json.hpp"
+
+#include <csignal>
+#include <string>
+#include <vector>
+
+
+//
+// One member of an ensemble: its full json input, and where its output goes
+//
+struct EnsembleCase {
+  std::string name;
+  std::string dir;
+  nlohmann::json input;
+  nlohmann::json params;
+};
+
+//
+// An ensemble is given in a json file with a top-level "ensemble" object:
+//
+//   "ensemble" : {
+//     "base" : "cylinder.json",		// a file name, or the simulation json itself
+//     "vary" : { "/flowparams/Re" : [100, 200, 400],
+//                "/simparams/nominalDt" : { "start" : 0.01, "end" : 0.04, "count" : 4 } },
+//     "files" : [ "a.json", "b.json" ],	// or instead, a list of complete inputs
+//     "concurrent" : 4,			// simulations in flight at once
+//     "threads" : 16,				// split evenly among those
+//     "outputDir" : "sweep",			// each case writes to its own directory here
+//     "summary" : "summary.json"
+//   }
+//
+// Each "vary" key is a json pointer into the base input, and every combination of
+//   the listed values becomes one case. Relative file names are taken from the
+//   directory of the ensemble file.
+//
+class Ensemble {
+public:
+  Ensemble() = default;
+
+  static bool is_ensemble(nlohmann::json const&);
+  void from_json(nlohmann::json const&, const std::string _fn = "");
+
+  size_t get_num_cases() const { return cases.size(); }
+
+  // threads for all cases together, from the options if given, else from the json
+  size_t get_num_threads(BatchOptions const&) const;
+
+  // run everything with the same overrides, return the number of cases that failed
+  int run(BatchOptions const& _opts = BatchOptions(),
+          volatile std::sig_atomic_t const* _stop = nullptr);
+
+  nlohmann::json get_summary() const;
+
+private:
+  std::vector<EnsembleCase> cases;
+  std::vector<BatchResult> results;
+  size_t concurrent = 0;		// 0 means pick from the hardware
+  size_t threads = 0;
+  std::string output_dir = "ensemble";
+  std::string summary_file = "summary.json";
+  double wall_seconds = 0.0;
+};
@@ -62,9 +62,41 @@ public:
   void set_internal(const bool _isint) { m_internal = _isint; };
   bool is_internal() const { return m_internal; };
   void set_summation(const summation_t _newsumm) { m_summ = _newsumm; };
+  summation_t get_summation() const { return m_summ; };
   void set_instrs(const accel_t _newaccel) { m_accel = _newaccel; };
   accel_t get_instrs() const { return m_accel; };
 
+  // can this executable actually run this environment? if not, say why
+  bool is_available(std::string& _why) const {
+    if (not m_internal) {
+#ifdef EXTERNAL_VEL_SOLVE
+      return true;
+#else
+      _why = "no external solver was compiled in";
+      return false;
+#endif
+    }
+    if (m_summ != direct) {
+      _why = "only direct summation is supported internally";
+      return false;
+    }
+    if (m_accel == cpu_vc) {
+#ifndef USE_VC
+      _why = "Vc acceleration was not compiled in (USE_VC)";
+      return false;
+#endif
+    } else if (m_accel == gpu_opengl) {
+#ifndef USE_OGL_COMPUTE
+      _why = "OpenGL compute was not compiled in (USE_OGL_COMPUTE)";
+      return false;
+#endif
+    } else if (m_accel == gpu_cuda) {
+      _why = "CUDA is not supported internally";
+      return false;
+    }
+    return true;
+  }
+
   std::string to_string() const {
     std::string mystr;
     if (m_internal) {
@@ -94,3 +126,24 @@ protected:
   accel_t m_accel;
 };
 
+
+//
+// names for the command line
+//
+inline bool summation_from_string(const std::string _s, summation_t& _summ) {
+  if (_s == "direct") _summ = direct;
+  else if (_s == "barneshut" or _s == "treecode") _summ = barneshut;
+  else if (_s == "vic") _summ = vic;
+  else if (_s == "fmm") _summ = fmm;
+  else return false;
+  return true;
+}
+
+inline bool accel_from_string(const std::string _s, accel_t& _accel) {
+  if (_s == "x86" or _s == "cpu_x86") _accel = cpu_x86;
+  else if (_s == "vc" or _s == "cpu_vc") _accel = cpu_vc;
+  else if (_s == "opengl" or _s == "gpu_opengl") _accel = gpu_opengl;
+  else if (_s == "cuda" or _s == "gpu_cuda") _accel = gpu_cuda;
+  else return false;
+  return true;
+}
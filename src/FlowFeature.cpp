@@ -8,6 +8,7 @@
 
 #include "BoundaryFeature.h"
 #include "FlowFeature.h"
+#include "Reproducible.h"
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_glfw.h"
 #include "imgui/imgui_impl_opengl3.h"
@@ -17,6 +18,7 @@
 #include <iostream>
 #include <sstream>
 #include <random>
+#include <atomic>
 
 // write out any object of parent type FlowFeature by dispatching to appropriate "debug" method
 std::ostream& operator<<(std::ostream& os, FlowFeature const& ff) {
@@ -687,10 +689,11 @@ bool UniformBlock::draw_info_gui(const std::string action, const float ips) {
 ElementPacket<float>
 BlockOfRandom::init_elements(float _ips) const {
   // set up the random number generator
-  static std::random_device rd;  //Will be used to obtain a seed for the random number engine
-  static std::mt19937 gen(rd()); //Standard mersenne_twister_engine seeded with rd()
-  static std::uniform_real_distribution<> loc_dist(-1.0, 1.0);
-  static std::uniform_real_distribution<> str_dist(0.0, 1.0);
+  static thread_local std::random_device rd;  //Will be used to obtain a seed for the random number engine
+  static thread_local std::mt19937 gen(rd()); //Standard mersenne_twister_engine seeded with rd()
+  static thread_local std::uniform_real_distribution<> loc_dist(-1.0, 1.0);
+  static thread_local std::uniform_real_distribution<> str_dist(0.0, 1.0);
+  Reproducible::reseed(gen, "block of random");
 
   std::vector<float> x(2*m_num);
   std::vector<Int> idx;
@@ -758,7 +761,7 @@ BlockOfRandom::to_json() const {
 }
 
 struct RandomGenerator {
-  static int instances;
+  static std::atomic<int> instances;
   //static std::random_device m_rd; //Will be used to obtain a seed for the random number engine
   std::mt19937 m_gen; //Standard mersenne_twister_engine seeded with rd()
   std::uniform_real_distribution<float> m_dist;
@@ -773,7 +776,7 @@ struct RandomGenerator {
   float operator()() { return m_lb + (m_ub-m_lb)*m_dist(m_gen); }
 };
 
-int RandomGenerator::instances = 0;
+std::atomic<int> RandomGenerator::instances(0);
 
 void BlockOfRandom::generate_draw_geom() {
   std::unique_ptr<SolidRect> tmp = std::make_unique<SolidRect>(nullptr, true, m_x, m_y, m_xsize*2, m_ysize*2);
@@ -0,0 +1,157 @@
+/*
+ * FrameExporter.cpp - Read back and save frames to png without stalling the render loop
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "FrameExporter.h"
+#include "miniz.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+
+FrameExporter::FrameExporter(const size_t _nbuffers, const size_t _nthreads)
+  : nbuffers(std::max((size_t)1, _nbuffers)),
+    slots(),
+    next_slot(0),
+    inflight(),
+    workers(),
+    next_worker(0) {
+
+  // each worker is one thread with its own short queue
+  for (size_t i=0; i<std::max((size_t)1, _nthreads); ++i) {
+    workers.emplace_back(std::make_unique<OutputWriter>(2));
+  }
+}
+
+FrameExporter::~FrameExporter() {
+  // the GL context may be gone by now, so only wait for the writers
+  for (auto& w : workers) w->flush();
+}
+
+//
+// queue up a readback of the current frame
+//
+void
+FrameExporter::request(std::string const& _fn) {
+
+  // make the ring of buffers
+  if (slots.empty()) {
+    slots.resize(nbuffers);
+    for (auto& s : slots) {
+      glGenBuffers(1, &s.pbo);
+      s.fence = 0;
+      s.width = 0;
+      s.height = 0;
+    }
+  }
+
+  // recycle the oldest buffer if they're all busy
+  if (inflight.size() == slots.size()) {
+    retire(slots[inflight.front()]);
+    inflight.pop_front();
+  }
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+
+  // same size rules as saveFramePNG
+  Slot& s = slots[next_slot];
+  s.width  = (viewport[2]/4) * 4;
+  s.height = (viewport[3]/4) * 4;
+  s.file_name = _fn;
+  const GLsizeiptr nbytes = (GLsizeiptr)s.width * s.height * 3;
+
+  // this returns immediately, the copy into the buffer happens on the GPU
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+  glBufferData(GL_PIXEL_PACK_BUFFER, nbytes, nullptr, GL_STREAM_READ);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadBuffer(GL_BACK);
+  glReadPixels(0, 0, s.width, s.height, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  inflight.push_back(next_slot);
+  next_slot = (next_slot + 1) % slots.size();
+}
+
+//
+// pass finished frames along, in the order they were requested
+//
+void
+FrameExporter::poll(const bool _wait) {
+  while (not inflight.empty()) {
+    Slot& s = slots[inflight.front()];
+    if (not _wait) {
+      const GLenum status = glClientWaitSync(s.fence, 0, 0);
+      if (status != GL_ALREADY_SIGNALED and status != GL_CONDITION_SATISFIED) break;
+    }
+    retire(s);
+    inflight.pop_front();
+  }
+}
+
+//
+// copy one frame out of its buffer and give it to a worker to compress and write
+//
+void
+FrameExporter::retire(Slot& _s) {
+  const size_t nbytes = (size_t)_s.width * _s.height * 3;
+  std::vector<uint8_t> pixels(nbytes);
+
+  // mapping waits on the GPU if it isn't finished yet
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, _s.pbo);
+  void* ptr = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, nbytes, GL_MAP_READ_BIT);
+  const bool mapped = (ptr != nullptr);
+  if (mapped) {
+    std::memcpy(pixels.data(), ptr, nbytes);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glDeleteSync(_s.fence);
+  _s.fence = 0;
+
+  if (not mapped) {
+    std::cerr << "Could not read back frame for " << _s.file_name << std::endl;
+    return;
+  }
+
+  // round-robin among the workers; if this one is full, we wait here
+  workers[next_worker]->submit([pixels=std::move(pixels), w=_s.width, h=_s.height, fn=_s.file_name]() {
+    size_t png_data_size = 0;
+    void *pPNG_data = tdefl_write_image_to_png_file_in_memory_ex(pixels.data(), w, h, 3,
+                                                                 &png_data_size, MZ_BEST_COMPRESSION, MZ_TRUE);
+    if (pPNG_data) {
+      std::FILE *pFile = std::fopen(fn.c_str(), "wb");
+      if (pFile) {
+        std::fwrite(pPNG_data, 1, png_data_size, pFile);
+        std::fclose(pFile);
+        std::printf("Wrote %s\n", fn.c_str());
+      } else {
+        std::fprintf(stderr, "Could not open %s for writing\n", fn.c_str());
+      }
+    } else {
+      std::fprintf(stderr, "tdefl_write_image_to_png_file_in_memory_ex() failed!\n");
+    }
+    mz_free(pPNG_data);
+  });
+  next_worker = (next_worker + 1) % workers.size();
+}
+
+//
+// drain everything, call this while the context is still current
+//
+void
+FrameExporter::finish() {
+  poll(true);
+  for (auto& s : slots) glDeleteBuffers(1, &s.pbo);
+  slots.clear();
+  next_slot = 0;
+  for (auto& w : workers) w->flush();
+}
+
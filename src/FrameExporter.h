@@ -0,0 +1,79 @@
+/*
+ * FrameExporter.h - Read back and save frames to png without stalling the render loop
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#ifdef _WIN32
+  // for glad
+  #ifndef APIENTRY
+    #define APIENTRY __stdcall
+  #endif
+  // for C++11 stuff that Windows can't get right
+  #include <ciso646>
+#endif
+#include "glad.h"
+
+#include "OutputWriter.h"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+//
+// Asynchronous replacement for saveFramePNG
+//
+// request() starts a glReadPixels into one of a ring of pixel buffer objects and
+//   returns right away; the copy to host memory happens once the GPU signals that
+//   it's done (usually a frame or two later), and the png compression and disk
+//   write are then run on a small pool of worker threads.
+//
+// File names are fixed at request time, so frames keep their sequence numbers no
+//   matter which worker finishes first. If every buffer is in flight, the oldest
+//   one is waited on, and if the workers fall behind their queues block, so the
+//   memory held in frames waiting to be written stays bounded.
+//
+// All GL calls must come from the thread that owns the context.
+//
+class FrameExporter {
+public:
+  explicit FrameExporter(const size_t _nbuffers = 3, const size_t _nthreads = 2);
+  ~FrameExporter();
+
+  FrameExporter(FrameExporter const&) = delete;
+  FrameExporter& operator=(FrameExporter const&) = delete;
+
+  // start reading back the current draw buffer, to be saved as the given file
+  void request(std::string const&);
+  // hand any finished readbacks to the workers, waiting for them if asked
+  void poll(const bool _wait = false);
+  // wait for every frame to be on disk, and release the GL buffers
+  void finish();
+
+  size_t get_num_pending() const { return inflight.size(); }
+
+private:
+  // one pixel buffer object and the frame it's receiving
+  struct Slot {
+    GLuint pbo;
+    GLsync fence;
+    std::string file_name;
+    int width, height;
+  };
+
+  void retire(Slot&);
+
+  const size_t nbuffers;
+  std::vector<Slot> slots;		// created on first use, when a context surely exists
+  size_t next_slot;
+  std::deque<size_t> inflight;		// slots waiting on the GPU, oldest first
+
+  std::vector<std::unique_ptr<OutputWriter>> workers;
+  size_t next_worker;
+};
+
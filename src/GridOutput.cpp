@@ -0,0 +1,340 @@
+/*
+ * GridOutput.cpp - Vorticity, velocity, and streamfunction on a regular grid
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "GridOutput.h"
+#include "CoreFunc.h"
+#include "Points.h"
+#include "Surfaces.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+
+#include <unsupported/Eigen/FFT>
+
+#ifdef _WIN32
+  #include <ciso646>
+#endif
+
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+
+using cplx = std::complex<double>;
+
+// particles are spread out to this many core radii
+static const double splat_cutoff = 4.0;
+
+// mean of ln(r) over a unit square centered on the origin
+static const double mean_log_unit_cell = -1.0611754056889242;
+
+
+void
+GridOutput::from_json(const nlohmann::json j) {
+  const std::vector<float> s = j["start"];
+  start = {{s[0], s[1]}};
+  const std::vector<float> e = j["end"];
+  end = {{e[0], e[1]}};
+  dx = j["dx"];
+  enabled = j.value("enabled", true);
+  if (not (dx > 0.0f) or end[0] <= start[0] or end[1] <= start[1]) {
+    std::cout << "  grid output needs end > start and dx > 0, disabling" << std::endl;
+    enabled = false;
+  }
+}
+
+nlohmann::json
+GridOutput::to_json() const {
+  nlohmann::json j;
+  j["start"] = {start[0], start[1]};
+  j["end"] = {end[0], end[1]};
+  j["dx"] = dx;
+  j["enabled"] = enabled;
+  return j;
+}
+
+//
+// smallest size >= _n with no prime factors above 5, which the fft handles well
+//
+static size_t
+fft_friendly_size(const size_t _n) {
+  for (size_t m=_n; ; ++m) {
+    size_t r = m;
+    for (const size_t p : {2, 3, 5}) while (r % p == 0) r /= p;
+    if (r == 1) return m;
+  }
+}
+
+//
+// 2D transform in place, x fastest; rows and then columns are done in parallel
+//
+static void
+fft2d(std::vector<cplx>& _a, const size_t _nx, const size_t _ny, const bool _inverse) {
+
+  #pragma omp parallel
+  {
+    Eigen::FFT<double> fft;
+    std::vector<cplx> in, out;
+
+    #pragma omp for
+    for (int32_t j=0; j<(int32_t)_ny; ++j) {
+      in.assign(_a.begin()+j*_nx, _a.begin()+(j+1)*_nx);
+      if (_inverse) fft.inv(out, in);
+      else fft.fwd(out, in);
+      std::copy(out.begin(), out.end(), _a.begin()+j*_nx);
+    }
+
+    in.resize(_ny);
+    #pragma omp for
+    for (int32_t i=0; i<(int32_t)_nx; ++i) {
+      for (size_t j=0; j<_ny; ++j) in[j] = _a[j*_nx+i];
+      if (_inverse) fft.inv(out, in);
+      else fft.fwd(out, in);
+      for (size_t j=0; j<_ny; ++j) _a[j*_nx+i] = out[j];
+    }
+  }
+}
+
+//
+// set the grid size from the bounds and spacing
+//
+void
+GridOutput::resize() {
+  const std::array<size_t,Dimensions> newn = {{ 1 + (size_t)std::lround((end[0]-start[0])/dx),
+                                                1 + (size_t)std::lround((end[1]-start[1])/dx) }};
+  if (newn == n and not kpsi.empty()) return;
+
+  n = newn;
+  // twice as large, so the periodic convolution is a free-space one on the real grid
+  npad = {{ fft_friendly_size(2*n[0]), fft_friendly_size(2*n[1]) }};
+  w.resize(n[0]*n[1]);
+  psi.resize(n[0]*n[1]);
+  for (size_t d=0; d<Dimensions; ++d) u[d].resize(n[0]*n[1]);
+  make_kernels();
+}
+
+size_t
+GridOutput::get_bytes() const {
+  size_t bytes = (kpsi.capacity() + kx.capacity() + ky.capacity()) * sizeof(cplx);
+  bytes += (w.capacity() + psi.capacity() + u[0].capacity() + u[1].capacity()) * sizeof(float);
+  return bytes;
+}
+
+size_t
+GridOutput::estimate_bytes() const {
+  if (not enabled) return 0;
+  const size_t nx = 1 + (size_t)std::lround((end[0]-start[0])/dx);
+  const size_t ny = 1 + (size_t)std::lround((end[1]-start[1])/dx);
+  const size_t np = fft_friendly_size(2*nx) * fft_friendly_size(2*ny);
+  // three kernels and four fields kept, plus up to four padded work arrays during compute
+  return (3 + 4) * np * sizeof(cplx) + 4 * nx * ny * sizeof(float);
+}
+
+//
+// sample and transform the Green's functions of streamfunction and velocity,
+//   each scaled by the cell area so that convolution with nodal values integrates
+//
+void
+GridOutput::make_kernels() {
+  const size_t np = npad[0]*npad[1];
+  kpsi.assign(np, cplx(0.0));
+  kx.assign(np, cplx(0.0));
+  ky.assign(np, cplx(0.0));
+
+  const double h = dx;
+  const double area = h*h;
+  const double fac = area / (2.0*M_PI);
+
+  #pragma omp parallel for
+  for (int32_t j=0; j<(int32_t)npad[1]; ++j) {
+    const double y = h * ((j <= (int32_t)npad[1]/2) ? j : j-(int32_t)npad[1]);
+    for (size_t i=0; i<npad[0]; ++i) {
+      const double x = h * ((i <= npad[0]/2) ? (double)i : (double)i-(double)npad[0]);
+      const double r2 = x*x + y*y;
+      const size_t k = j*npad[0] + i;
+      if (r2 > 0.0) {
+        kpsi[k] = -fac * 0.5 * std::log(r2);
+        kx[k] = fac * x / r2;
+        ky[k] = fac * y / r2;
+      } else {
+        // the log singularity averaged over its own cell; velocity is zero by symmetry
+        kpsi[k] = -fac * (std::log(h) + mean_log_unit_cell);
+      }
+    }
+  }
+
+  fft2d(kpsi, npad[0], npad[1], false);
+  fft2d(kx, npad[0], npad[1], false);
+  fft2d(ky, npad[0], npad[1], false);
+}
+
+
+//
+// splat, convolve, and add the freestream
+//
+void
+GridOutput::compute(std::vector<Collection> const& _vort, std::vector<Collection> const& _bdry,
+                    const std::array<double,Dimensions> _fs) {
+
+  if (not enabled) return;
+  ScopedTimer timer("grid");
+
+  resize();
+  const double h = dx;
+  const size_t nx = n[0];
+  const size_t ny = n[1];
+
+  //
+  // gather every element as a blob with a vortex and a source strength
+  //
+  struct Blob {
+    double x, y, r, vs, ss;
+  };
+  std::vector<Blob> blobs;
+  bool have_sources = false;
+
+  for (auto const& coll : _vort) {
+    if (std::holds_alternative<Points<float>>(coll)) {
+      Points<float> const& pts = std::get<Points<float>>(coll);
+      if (pts.is_inert()) continue;
+      const auto& x = pts.get_pos();
+      const auto& r = pts.get_rad();
+      const auto& s = pts.get_str();
+      for (size_t i=0; i<pts.get_n(); ++i) {
+        blobs.push_back({x[0][i], x[1][i], std::max((double)r[i], h), s[i], 0.0});
+      }
+    }
+  }
+  for (auto const& coll : _bdry) {
+    if (std::holds_alternative<Surfaces<float>>(coll)) {
+      Surfaces<float> const& surf = std::get<Surfaces<float>>(coll);
+      if (surf.is_inert()) continue;
+      const auto& x = surf.get_pos();
+      const auto& idx = surf.get_idx();
+      const auto& len = surf.get_area();
+      const auto& vs = surf.get_vort_str();
+      const bool has_ss = surf.have_src_str();
+      have_sources |= has_ss;
+      for (size_t i=0; i<surf.get_npanels(); ++i) {
+        const size_t i0 = idx[2*i];
+        const size_t i1 = idx[2*i+1];
+        blobs.push_back({0.5*(x[0][i0]+x[0][i1]), 0.5*(x[1][i0]+x[1][i1]),
+                         std::max((double)len[i], h),
+                         vs[i]*len[i], has_ss ? surf.get_src_str()[i]*len[i] : 0.0});
+      }
+    }
+  }
+
+  //
+  // each blob's weights must sum to exactly one over the nodes it touches
+  //
+  std::vector<double> norm(blobs.size(), 0.0);
+  #pragma omp parallel for schedule(dynamic,256)
+  for (int32_t b=0; b<(int32_t)blobs.size(); ++b) {
+    Blob const& bl = blobs[b];
+    const double cut = splat_cutoff * bl.r;
+    // sum as if the grid had no edges: the part of a core that lies outside is lost
+    double sum = 0.0;
+    const int32_t ni = (int32_t)std::floor(cut/h);
+    const double fx = (bl.x-start[0])/h - std::floor((bl.x-start[0])/h);
+    const double fy = (bl.y-start[1])/h - std::floor((bl.y-start[1])/h);
+    for (int32_t jj=-ni; jj<=ni+1; ++jj) {
+      const double dy = h*(jj - fy);
+      for (int32_t ii=-ni; ii<=ni+1; ++ii) {
+        const double ddx = h*(ii - fx);
+        const double d2 = ddx*ddx + dy*dy;
+        if (d2 <= cut*cut) sum += core_vort<double>(d2, bl.r);
+      }
+    }
+    norm[b] = (sum > 0.0) ? 1.0 / (sum*h*h) : 0.0;
+  }
+
+  //
+  // sort by y, then each row of nodes gathers from the blobs that reach it, so
+  //   threads never write to the same node
+  //
+  std::vector<uint32_t> order(blobs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&blobs](uint32_t a, uint32_t b) { return blobs[a].y < blobs[b].y; });
+  std::vector<double> sorted_y(blobs.size());
+  double maxcut = 0.0;
+  for (size_t b=0; b<blobs.size(); ++b) {
+    sorted_y[b] = blobs[order[b]].y;
+    maxcut = std::max(maxcut, splat_cutoff * blobs[b].r);
+  }
+
+  const size_t np = npad[0]*npad[1];
+  std::vector<cplx> wpad(np, cplx(0.0));
+  std::vector<cplx> qpad(have_sources ? np : 0, cplx(0.0));
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int32_t j=0; j<(int32_t)ny; ++j) {
+    const double ny_y = start[1] + j*h;
+    auto first = std::lower_bound(sorted_y.begin(), sorted_y.end(), ny_y - maxcut);
+    auto last = std::upper_bound(sorted_y.begin(), sorted_y.end(), ny_y + maxcut);
+    for (auto it = first; it != last; ++it) {
+      Blob const& bl = blobs[order[it - sorted_y.begin()]];
+      const double cut = splat_cutoff * bl.r;
+      const double dy = ny_y - bl.y;
+      if (std::abs(dy) > cut) continue;
+      const double wfac = norm[order[it - sorted_y.begin()]];
+      const int32_t i0 = std::max(0, (int32_t)std::ceil((bl.x-cut-start[0])/h));
+      const int32_t i1 = std::min((int32_t)nx-1, (int32_t)std::floor((bl.x+cut-start[0])/h));
+      for (int32_t i=i0; i<=i1; ++i) {
+        const double ddx = start[0] + i*h - bl.x;
+        const double d2 = ddx*ddx + dy*dy;
+        if (d2 > cut*cut) continue;
+        const double wt = wfac * core_vort<double>(d2, bl.r);
+        wpad[j*npad[0]+i] += wt * bl.vs;
+        if (have_sources) qpad[j*npad[0]+i] += wt * bl.ss;
+      }
+    }
+  }
+
+  for (size_t j=0; j<ny; ++j) {
+    for (size_t i=0; i<nx; ++i) w[j*nx+i] = (float)wpad[j*npad[0]+i].real();
+  }
+
+  //
+  // convolve in Fourier space
+  //
+  fft2d(wpad, npad[0], npad[1], false);
+  if (have_sources) fft2d(qpad, npad[0], npad[1], false);
+
+  std::vector<cplx> upad(np), vpad(np);
+  MemoryTracker::note("grid workspace", (wpad.capacity() + qpad.capacity() + upad.capacity() + vpad.capacity()) * sizeof(cplx));
+  #pragma omp parallel for
+  for (int32_t k=0; k<(int32_t)np; ++k) {
+    // vortex: u = -Ky*w, v = Kx*w; source: u = Kx*q, v = Ky*q
+    upad[k] = -ky[k] * wpad[k];
+    vpad[k] = kx[k] * wpad[k];
+    if (have_sources) {
+      upad[k] += kx[k] * qpad[k];
+      vpad[k] += ky[k] * qpad[k];
+    }
+    wpad[k] *= kpsi[k];
+  }
+  fft2d(wpad, npad[0], npad[1], true);
+  fft2d(upad, npad[0], npad[1], true);
+  fft2d(vpad, npad[0], npad[1], true);
+
+  #pragma omp parallel for
+  for (int32_t j=0; j<(int32_t)ny; ++j) {
+    const double y = start[1] + j*h;
+    for (size_t i=0; i<nx; ++i) {
+      const double x = start[0] + i*h;
+      const size_t k = j*npad[0] + i;
+      psi[j*nx+i]  = (float)(wpad[k].real() + _fs[0]*y - _fs[1]*x);
+      u[0][j*nx+i] = (float)(upad[k].real() + _fs[0]);
+      u[1][j*nx+i] = (float)(vpad[k].real() + _fs[1]);
+    }
+  }
+
+  const std::chrono::duration<double> elapsed_seconds(timer.stop());
+  printf("    grid output of %zu elements onto %zu x %zu nodes:\t[%.4f] seconds\n",
+         blobs.size(), nx, ny, (float)elapsed_seconds.count());
+}
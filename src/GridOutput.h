@@ -0,0 +1,89 @@
+/*
+ * GridOutput.h - Vorticity, velocity, and streamfunction on a regular grid
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include "Omega2D.h"
+#include "VectorHelper.h"
+#include "Collection.h"
+#include "json/json.hpp"
+
+#include <complex>
+#include <string>
+#include <vector>
+#include <array>
+
+//
+// Rasterize the flow onto a uniform grid for post-processing
+//
+// Every vortex particle (and every panel, as a point element at its center) is spread
+//   onto the grid nodes with the vorticity distribution of the compiled-in core function,
+//   normalized so that each one deposits exactly its circulation. Particles with cores
+//   smaller than the grid spacing are spread with a core of one grid spacing instead.
+//
+// Velocity and streamfunction come from a free-space convolution of the gridded vorticity
+//   (and panel source strength) with the 2D Green's functions, done with zero-padded FFTs
+//   (Hockney's method), so the cost is O(M log M) in the number of grid nodes M instead
+//   of the O(N M) of a measurement grid sent through the influence calculation.
+//
+class GridOutput {
+public:
+  GridOutput()
+    : enabled(false),
+      start({{-1.0f, -1.0f}}),
+      end({{1.0f, 1.0f}}),
+      dx(0.05f),
+      n({{0, 0}}),
+      npad({{0, 0}}),
+      kpsi(), kx(), ky(),
+      w(), psi(), u()
+    {}
+
+  bool is_enabled() const { return enabled; }
+  void from_json(const nlohmann::json);
+  nlohmann::json to_json() const;
+
+  // grid geometry
+  size_t get_nx() const { return n[0]; }
+  size_t get_ny() const { return n[1]; }
+  std::array<float,Dimensions> get_origin() const { return start; }
+  float get_dx() const { return dx; }
+
+  // bytes held for the fields and kernels, and the most that compute() will use, from the settings
+  size_t get_bytes() const;
+  size_t estimate_bytes() const;
+
+  // find all three fields from the current vortex and boundary collections
+  void compute(std::vector<Collection> const&, std::vector<Collection> const&,
+               const std::array<double,Dimensions>);
+
+  // results, node-centered, x fastest
+  Vector<float> const& get_vort() const { return w; }
+  Vector<float> const& get_psi() const { return psi; }
+  std::array<Vector<float>,Dimensions> const& get_vel() const { return u; }
+
+private:
+  void resize();
+  void make_kernels();
+
+  bool enabled;
+  std::array<float,Dimensions> start;
+  std::array<float,Dimensions> end;
+  float dx;
+
+  // grid nodes, and size of the zero-padded fft arrays
+  std::array<size_t,Dimensions> n;
+  std::array<size_t,Dimensions> npad;
+
+  // transformed Green's functions, kept until the grid changes
+  std::vector<std::complex<double>> kpsi, kx, ky;
+
+  // the fields
+  Vector<float> w;
+  Vector<float> psi;
+  std::array<Vector<float>,Dimensions> u;
+};
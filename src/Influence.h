@@ -13,6 +13,8 @@
 #include "Points.h"
 #include "Surfaces.h"
 #include "ExecEnv.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
 
 #ifdef EXTERNAL_VEL_SOLVE
 extern "C" float external_vel_solver_f_(int*, const float*, const float*, const float*, const float*,
@@ -25,6 +27,7 @@ extern "C" float external_vel_solver_d_(int*, const double*, const double*, cons
 #include <Vc/Vc>
 #endif
 
+#include <cstdio>
 #include <iostream>
 #include <vector>
 #include <memory>
@@ -40,8 +43,8 @@ extern "C" float external_vel_solver_d_(int*, const double*, const double*, cons
 template <class S, class A>
 void points_affect_points (Points<S> const& src, Points<S>& targ, ExecEnv& env) {
 
-  std::cout << "    in ptpt with" << env.to_string() << std::endl;
-  auto start = std::chrono::system_clock::now();
+  TaskGroup::out() << "    in ptpt with" << env.to_string() << std::endl;
+  ScopedTimer timer("points_affect_points");
   float flops = (float)targ.get_n();
 
   // get references to use locally
@@ -54,17 +57,15 @@ void points_affect_points (Points<S> const& src, Points<S>& targ, ExecEnv& env)
 
 #ifdef EXTERNAL_VEL_SOLVE
   if (not env.is_internal()) {
-    std::cout << "    external influence of" << src.to_string() << " on" << targ.to_string() << std::endl;
+    TaskGroup::out() << "    external influence of" << src.to_string() << " on" << targ.to_string() << std::endl;
     int ns = src.get_n();
     int nt = targ.get_n();
 
     flops = external_vel_solver_f_(&ns, sx[0].data(), sx[1].data(),    ss.data(),    sr.data(), 
                                    &nt, tx[0].data(), tx[1].data(), tu[0].data(), tu[1].data());
 
-    auto end = std::chrono::system_clock::now();
-    std::chrono::duration<double> elapsed_seconds = end-start;
-    const float gflops = 1.e-9 * flops / (float)elapsed_seconds.count();
-    printf("    points_affect_points: [%.4f] seconds at %.3f GFlop/s\n", (float)elapsed_seconds.count(), gflops);
+    timer.report("points_affect_points", flops);
+    Profiler::count_kernel("points_affect_points external", flops, sizeof(S) * (4.0*ns + 6.0*nt), timer.stop());
 
     return;
   }
@@ -84,7 +85,7 @@ void points_affect_points (Points<S> const& src, Points<S>& targ, ExecEnv& env)
   // targets are field points, with no core radius ===============================================
   //
   if (targ.is_inert()) {
-    std::cout << "    0v_0p compute influence of" << src.to_string() << " on" << targ.to_string() << std::endl;
+    TaskGroup::out() << "    0v_0p compute influence of" << src.to_string() << " on" << targ.to_string() << std::endl;
     // targets are field points
 
 #ifdef USE_VC
@@ -139,7 +140,7 @@ void points_affect_points (Points<S> const& src, Points<S>& targ, ExecEnv& env)
   // targets are particles, with a core radius ===================================================
   //
   } else {
-    std::cout << "    0v_0v compute influence of" << src.to_string() << " on" << targ.to_string() << std::endl;
+    TaskGroup::out() << "    0v_0v compute influence of" << src.to_string() << " on" << targ.to_string() << std::endl;
     // targets are particles
     const Vector<S>&				tr = targ.get_rad();
 
@@ -202,10 +203,12 @@ void points_affect_points (Points<S> const& src, Points<S>& targ, ExecEnv& env)
   //
   }
 
-  auto end = std::chrono::system_clock::now();
-  std::chrono::duration<double> elapsed_seconds = end-start;
-  const float gflops = 1.e-9 * flops / (float)elapsed_seconds.count();
-  printf("    points_affect_points: [%.4f] seconds at %.3f GFlop/s\n", (float)elapsed_seconds.count(), gflops);
+  timer.report("points_affect_points", flops);
+
+  // sources are read once, targets read positions (and radii) and update velocities
+  const double bytes = sizeof(S) * (4.0*src.get_n() + (targ.is_inert() ? 6.0 : 7.0)*targ.get_n());
+  Profiler::count_kernel(targ.is_inert() ? "points_affect_points 0v_0p" : "points_affect_points 0v_0v",
+                         flops, bytes, timer.stop());
 }
 
 
@@ -215,9 +218,9 @@ void points_affect_points (Points<S> const& src, Points<S>& targ, ExecEnv& env)
 template <class S, class A>
 void panels_affect_points (Surfaces<S> const& src, Points<S>& targ, ExecEnv& env) {
 
-  std::cout << "    in panpt with" << env.to_string() << std::endl;
-  std::cout << "    1_0 compute influence of" << src.to_string() << " on" << targ.to_string() << std::endl;
-  auto start = std::chrono::system_clock::now();
+  TaskGroup::out() << "    in panpt with" << env.to_string() << std::endl;
+  TaskGroup::out() << "    1_0 compute influence of" << src.to_string() << " on" << targ.to_string() << std::endl;
+  ScopedTimer timer("panels_affect_points");
   float flops = (float)targ.get_n();
 
   // get references to use locally
@@ -385,10 +388,13 @@ void panels_affect_points (Surfaces<S> const& src, Points<S>& targ, ExecEnv& env
     flops *= 2.0 + (float)flops_1_0v<S,A>() * (float)src.get_npanels();
   }
 
-  auto end = std::chrono::system_clock::now();
-  std::chrono::duration<double> elapsed_seconds = end-start;
-  const float gflops = 1.e-9 * flops / (float)elapsed_seconds.count();
-  printf("    panels_affect_points: [%.4f] seconds at %.3f GFlop/s\n", (float)elapsed_seconds.count(), gflops);
+  timer.report("panels_affect_points", flops);
+
+  // panels read two nodes, two indices, and their strengths; targets as above
+  const double bytes = (double)src.get_npanels() * ((have_source_strengths ? 6.0 : 5.0)*sizeof(S) + 2.0*sizeof(Int))
+                     + sizeof(S) * (targ.is_inert() ? 6.0 : 7.0) * targ.get_n();
+  Profiler::count_kernel(have_source_strengths ? "panels_affect_points 1_0vs" : "panels_affect_points 1_0v",
+                         flops, bytes, timer.stop());
 }
 
 
@@ -398,9 +404,9 @@ void panels_affect_points (Surfaces<S> const& src, Points<S>& targ, ExecEnv& env
 template <class S, class A>
 void points_affect_panels (Points<S> const& src, Surfaces<S>& targ, ExecEnv& env) {
 
-  std::cout << "    in ptpan with" << env.to_string() << std::endl;
-  std::cout << "    0_1 compute influence of" << src.to_string() << " on" << targ.to_string() << std::endl;
-  auto start = std::chrono::system_clock::now();
+  TaskGroup::out() << "    in ptpan with" << env.to_string() << std::endl;
+  TaskGroup::out() << "    0_1 compute influence of" << src.to_string() << " on" << targ.to_string() << std::endl;
+  ScopedTimer timer("points_affect_panels");
   float flops = (float)targ.get_npanels();
 
   // get references to use locally
@@ -510,7 +516,7 @@ void points_affect_panels (Points<S> const& src, Surfaces<S>& targ, ExecEnv& env
           kernel_0v_0v<S,A>(sx[0][j], sx[1][j], 0.5*0.189737, vs[j], 
                             0.5*(tx[0][ip0]+tx[0][ip1]), 0.5*(tx[1][ip0]+tx[1][ip1]), 0.5*0.189737,
                             &testu, &testv);
-          std::cout << " pp vel " << testu << " " << testv << std::endl;
+          TaskGroup::out() << " pp vel " << testu << " " << testv << std::endl;
         }
       }
 
@@ -528,16 +534,18 @@ void points_affect_panels (Points<S> const& src, Surfaces<S>& targ, ExecEnv& env
 
   flops *= 11.0 + (float)flops_1_0v<S,A>() * (float)src.get_n();
 
-  auto end = std::chrono::system_clock::now();
-  std::chrono::duration<double> elapsed_seconds = end-start;
-  const float gflops = 1.e-9 * flops / (float)elapsed_seconds.count();
-  printf("    points_affect_panels: [%.4f] seconds at %.3f GFlop/s\n", (float)elapsed_seconds.count(), gflops);
+  timer.report("points_affect_panels", flops);
+
+  // points read once; panels read two nodes, two indices, and a length, then update velocities
+  const double bytes = sizeof(S) * 3.0*src.get_n()
+                     + (double)targ.get_npanels() * (9.0*sizeof(S) + 2.0*sizeof(Int));
+  Profiler::count_kernel("points_affect_panels", flops, bytes, timer.stop());
 }
 
 
 template <class S, class A>
 void panels_affect_panels (Surfaces<S> const& src, Surfaces<S>& targ, ExecEnv& env) {
-  std::cout << "    1_1 compute influence of" << src.to_string() << " on" << targ.to_string() << std::endl;
+  TaskGroup::out() << "    1_1 compute influence of" << src.to_string() << " on" << targ.to_string() << std::endl;
 
   // run panels_affect_points instead
 
@@ -86,6 +86,75 @@ void parse_json(Simulation& sim,
       sim.set_quit_on_stop(qos);
       std::cout << "  quit on stop? " << qos << std::endl;
     }
+    if (params.find("seriesFile") != params.end()) {
+      std::string tsfile = params["seriesFile"];
+      sim.set_series_file_name(tsfile);
+      std::cout << "  time series file name= " << tsfile << std::endl;
+    }
+    if (params.find("seriesCompress") != params.end()) {
+      bool tscomp = params["seriesCompress"];
+      sim.set_series_compress(tscomp);
+      std::cout << "  compress time series? " << tscomp << std::endl;
+    }
+    if (params.find("pngOutput") != params.end()) {
+      bool pngout = params["pngOutput"];
+      sim.set_png_output(pngout);
+      std::cout << "  write png images? " << pngout << std::endl;
+    }
+    if (params.find("traceFile") != params.end()) {
+      std::string tfn = params["traceFile"];
+      sim.set_trace_file(tfn);
+      std::cout << "  trace file " << tfn << std::endl;
+    }
+    if (params.find("perfCounters") != params.end()) {
+      bool pc = params["perfCounters"];
+      std::cout << "  hardware counters? " << pc << std::endl;
+      (void) sim.set_perf_counters(pc);
+    }
+    if (params.find("kernelReport") != params.end()) {
+      bool kr = params["kernelReport"];
+      std::cout << "  kernel report? " << kr << std::endl;
+      sim.set_kernel_report(kr);
+    }
+    if (params.find("reproducible") != params.end()) {
+      bool rep = params["reproducible"];
+      sim.set_reproducible(rep);
+      std::cout << "  reproducible? " << rep << std::endl;
+    }
+    if (params.find("pinThreads") != params.end()) {
+      std::string pin = params["pinThreads"];
+      if (sim.set_thread_pinning(pin)) std::cout << "  thread pinning " << pin << std::endl;
+      else std::cout << "  unknown thread pinning " << pin << ", ignoring" << std::endl;
+    }
+    if (params.find("memoryBudget") != params.end()) {
+      double mb = params["memoryBudget"];
+      sim.set_memory_budget((size_t)(mb * 1024.0 * 1024.0));
+      std::cout << "  memory budget " << mb << " MB" << std::endl;
+    }
+    if (params.find("gridOutput") != params.end()) {
+      sim.set_grid_output(params["gridOutput"]);
+      std::cout << "  grid output " << params["gridOutput"] << std::endl;
+    }
+    if (params.find("tracerVelocity") != params.end()) {
+      sim.set_tracer_velocity(params["tracerVelocity"]);
+      std::cout << "  tracer velocity " << params["tracerVelocity"] << std::endl;
+    }
+    if (params.find("outputError") != params.end()) {
+      ErrorBound eb;
+      eb.from_json(params["outputError"]);
+      sim.set_output_error(eb);
+      std::cout << "  " << (eb.is_relative() ? "relative" : "absolute") << " output error bound= " << eb.get_value() << std::endl;
+    }
+    if (params.find("checkpointFile") != params.end()) {
+      std::string cfile = params["checkpointFile"];
+      sim.set_checkpoint_file_name(cfile);
+      std::cout << "  checkpoint file name= " << cfile << std::endl;
+    }
+    if (params.find("checkpointSteps") != params.end()) {
+      size_t csteps = params["checkpointSteps"];
+      sim.set_checkpoint_interval(csteps);
+      std::cout << "  checkpoint every " << csteps << " steps" << std::endl;
+    }
   }
 
   // must do this first, as we need to set viscous before reading Re
@@ -233,7 +302,45 @@ void write_json(Simulation& sim,
 
   const std::string sfile = sim.get_status_file_name();
   if (not sfile.empty()) {
-    j["runtime"] = { {"statusFile", sfile} };
+    j["runtime"]["statusFile"] = sfile;
+  }
+  if (sim.using_series()) {
+    j["runtime"]["seriesFile"] = sim.get_series_file_name();
+    j["runtime"]["seriesCompress"] = sim.get_series_compress();
+  }
+  if (sim.using_png_output()) {
+    j["runtime"]["pngOutput"] = true;
+  }
+  if (not sim.get_trace_file().empty()) {
+    j["runtime"]["traceFile"] = sim.get_trace_file();
+  }
+  if (sim.using_perf_counters()) {
+    j["runtime"]["perfCounters"] = true;
+  }
+  if (sim.get_kernel_report()) {
+    j["runtime"]["kernelReport"] = true;
+  }
+  if (sim.is_reproducible()) {
+    j["runtime"]["reproducible"] = true;
+  }
+  if (sim.get_thread_pinning() != "none") {
+    j["runtime"]["pinThreads"] = sim.get_thread_pinning();
+  }
+  if (sim.has_memory_budget()) {
+    j["runtime"]["memoryBudget"] = to_mb(sim.get_memory_budget());
+  }
+  if (sim.using_grid_output()) {
+    j["runtime"]["gridOutput"] = sim.get_grid_output();
+  }
+  if (sim.using_tracer_interp()) {
+    j["runtime"]["tracerVelocity"] = sim.get_tracer_velocity();
+  }
+  if (sim.get_output_error().is_enabled()) {
+    j["runtime"]["outputError"] = sim.get_output_error().to_json();
+  }
+  if (sim.get_checkpoint_interval() > 0) {
+    j["runtime"]["checkpointFile"] = sim.get_checkpoint_file_name();
+    j["runtime"]["checkpointSteps"] = sim.get_checkpoint_interval();
   }
 
   j["flowparams"] = sim.flow_to_json();
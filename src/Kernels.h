@@ -17,6 +17,7 @@
 #include <Vc/Vc>
 #endif
 
+#include <cassert>
 #include <cmath>
 
 
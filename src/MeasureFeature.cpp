@@ -8,6 +8,7 @@
 
 #include "BoundaryFeature.h"
 #include "MeasureFeature.h"
+#include "Reproducible.h"
 #include "imgui/imgui.h"
 
 #include <algorithm>
@@ -104,9 +105,10 @@ bool MeasureFeature::draw_creation_gui(std::vector<std::unique_ptr<MeasureFeatur
 
 float MeasureFeature::jitter(const float _z, const float _ips) const {
   // set up the random number generator
-  static std::random_device rd;  //Will be used to obtain a seed for the random number engine
-  static std::mt19937 gen(rd()); //Standard mersenne_twister_engine seeded with rd()
-  static std::uniform_real_distribution<float> dist(-0.5, 0.5);
+  static thread_local std::random_device rd;  //Will be used to obtain a seed for the random number engine
+  static thread_local std::mt19937 gen(rd()); //Standard mersenne_twister_engine seeded with rd()
+  static thread_local std::uniform_real_distribution<float> dist(-0.5, 0.5);
+  Reproducible::reseed(gen, "jitter");
   // emits one per step, jittered slightly
   return _z+_ips*dist(gen);
 }
@@ -172,6 +174,7 @@ SinglePoint::from_json(const nlohmann::json j) {
   m_enabled = j.value("enabled", true);
   m_is_lagrangian = j.value("lagrangian", m_is_lagrangian);
   m_emits = j.value("emits", m_emits);
+  m_update_every = j.value("updateEvery", m_update_every);
 }
 
 nlohmann::json
@@ -182,6 +185,7 @@ SinglePoint::to_json() const {
   j["enabled"] = m_enabled;
   j["lagrangian"] = m_is_lagrangian;
   j["emits"] = m_emits;
+  if (m_update_every > 1) j["updateEvery"] = m_update_every;
   return j;
 }
 
@@ -221,9 +225,10 @@ ElementPacket<float>
 MeasurementBlob::init_elements(float _ips) const {
 
   // set up the random number generator
-  static std::random_device rd;  //Will be used to obtain a seed for the random number engine
-  static std::mt19937 gen(rd()); //Standard mersenne_twister_engine seeded with rd()
-  static std::uniform_real_distribution<float> zmean_dist(-0.5, 0.5);
+  static thread_local std::random_device rd;  //Will be used to obtain a seed for the random number engine
+  static thread_local std::mt19937 gen(rd()); //Standard mersenne_twister_engine seeded with rd()
+  static thread_local std::uniform_real_distribution<float> zmean_dist(-0.5, 0.5);
+  Reproducible::reseed(gen, "measurement blob");
 
   // create a new vector to pass on
   std::vector<float> x;
@@ -302,6 +307,7 @@ MeasurementBlob::from_json(const nlohmann::json j) {
   m_enabled = j.value("enabled", true);
   m_is_lagrangian = j.value("lagrangian", m_is_lagrangian);
   m_emits = j.value("emits", m_emits);
+  m_update_every = j.value("updateEvery", m_update_every);
 }
 
 nlohmann::json
@@ -313,6 +319,7 @@ MeasurementBlob::to_json() const {
   j["enabled"] = m_enabled;
   j["lagrangian"] = m_is_lagrangian;
   j["emits"] = m_emits;
+  if (m_update_every > 1) j["updateEvery"] = m_update_every;
   return j;
 }
 
@@ -370,7 +377,7 @@ MeasurementLine::init_elements(float _ips) const {
     x.emplace_back((1.0-frac)*m_y + frac*m_yf);
   }
   
-  ElementPacket<float> packet({x, idx, vals, (size_t)(2*ilen), (uint8_t)0});
+  ElementPacket<float> packet({x, idx, vals, (size_t)ilen, (uint8_t)0});
   if (packet.verify(packet.x.size(), Dimensions)) {
     return packet;
   } else {
@@ -426,6 +433,7 @@ MeasurementLine::from_json(const nlohmann::json j) {
   m_enabled = j.value("enabled", true);
   m_is_lagrangian = j.value("lagrangian", m_is_lagrangian);
   m_emits = j.value("emits", m_emits);
+  m_update_every = j.value("updateEvery", m_update_every);
 }
 
 nlohmann::json
@@ -438,6 +446,7 @@ MeasurementLine::to_json() const {
   j["enabled"] = m_enabled;
   j["lagrangian"] = m_is_lagrangian;
   j["emits"] = m_emits;
+  if (m_update_every > 1) j["updateEvery"] = m_update_every;
   return j;
 }
 
@@ -536,6 +545,7 @@ GridPoints::from_json(const nlohmann::json j) {
   m_enabled = j.value("enabled", true);
   m_is_lagrangian = j.value("lagrangian", m_is_lagrangian);
   m_emits= j.value("emits", m_emits);
+  m_update_every = j.value("updateEvery", m_update_every);
 }
 
 nlohmann::json
@@ -548,6 +558,7 @@ GridPoints::to_json() const {
   j["enabled"] = m_enabled;
   j["lagrangian"] = m_is_lagrangian;
   j["emits"] = m_emits;
+  if (m_update_every > 1) j["updateEvery"] = m_update_every;
   return j;
 }
 
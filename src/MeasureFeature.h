@@ -34,6 +34,7 @@ public:
       m_y(_y),
       m_is_lagrangian(_moves),
       m_emits(_emits),
+      m_update_every(1),
       m_bp(_bp)
     {}
   virtual ~MeasureFeature() {}
@@ -41,6 +42,8 @@ public:
 
   bool moves() const { return m_is_lagrangian; }
   bool emits() const { return m_emits; }
+  // steps between new tracer velocities, with time-extrapolated ones in between
+  size_t get_update_every() const { return m_update_every; }
   float jitter(const float, const float) const;
   ElementPacket<float> get_draw_packet() const { return m_draw; }
   bool get_is_lagrangian() { return m_is_lagrangian; }
@@ -63,6 +66,7 @@ protected:
   float m_y;
   bool m_is_lagrangian;
   bool m_emits;
+  size_t m_update_every;
   std::shared_ptr<Body> m_bp;
   ElementPacket<float> m_draw;
 };
@@ -0,0 +1,132 @@
+/*
+ * MemoryTracker.cpp - Account for the large arrays held by one simulation
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "MemoryTracker.h"
+
+#ifdef _WIN32
+  #include <ciso646>
+#endif
+
+#ifdef __unix__
+  #include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+
+static thread_local MemoryTracker* current_tracker = nullptr;
+
+MemoryTracker* MemoryTracker::get_current() { return current_tracker; }
+void MemoryTracker::set_current(MemoryTracker* _m) { current_tracker = _m; }
+
+void
+MemoryTracker::note(const char* _name, const size_t _bytes) {
+  MemoryTracker* mt = get_current();
+  if (not mt) return;
+  std::lock_guard<std::mutex> lock(mt->mtx);
+  Entry& e = mt->entries[_name];
+  e.workspace = true;
+  e.current = _bytes;
+  e.peak = std::max(e.peak, _bytes);
+  e.in_step = std::max(e.in_step, _bytes);
+}
+
+void
+MemoryTracker::set(const std::string _name, const size_t _bytes, const size_t _peak) {
+  std::lock_guard<std::mutex> lock(mtx);
+  Entry& e = entries[_name];
+  e.current = _bytes;
+  e.peak = std::max(e.peak, std::max(_bytes, _peak));
+}
+
+void
+MemoryTracker::end_step() {
+  std::lock_guard<std::mutex> lock(mtx);
+  size_t step_total = 0;
+  for (auto& [name, e] : entries) {
+    if (e.workspace) {
+      step_total += e.in_step;
+      e.in_step = 0;
+    } else {
+      step_total += e.current;
+    }
+  }
+  peak_total = std::max(peak_total, step_total);
+}
+
+size_t
+MemoryTracker::get_total() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  size_t total = 0;
+  for (auto const& [name, e] : entries) {
+    if (not e.workspace) total += e.current;
+  }
+  return total;
+}
+
+size_t
+MemoryTracker::get_peak() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  return peak_total;
+}
+
+void
+MemoryTracker::reset() {
+  std::lock_guard<std::mutex> lock(mtx);
+  entries.clear();
+  peak_total = 0;
+}
+
+//
+// one line per part, workspaces marked, and the process as the OS sees it
+//
+std::string
+MemoryTracker::report() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  std::ostringstream tab;
+  if (entries.empty()) return "";
+
+  tab << std::left << std::setw(32) << "memory" << std::right
+      << std::setw(14) << "current MB" << std::setw(14) << "peak MB" << std::endl;
+  tab << std::fixed << std::setprecision(3);
+  for (auto const& [name, e] : entries) {
+    tab << std::left << std::setw(32) << (e.workspace ? name + " (workspace)" : name) << std::right
+        << std::setw(14) << (e.workspace ? 0.0 : to_mb(e.current)) << std::setw(14) << to_mb(e.peak) << std::endl;
+  }
+  tab << std::left << std::setw(32) << "peak in any step" << std::right
+      << std::setw(14) << "" << std::setw(14) << to_mb(peak_total) << std::endl;
+  const size_t rss = get_resident_bytes();
+  if (rss > 0) {
+    tab << std::left << std::setw(32) << "process resident" << std::right
+        << std::setw(14) << to_mb(rss) << std::endl;
+  }
+  return tab.str();
+}
+
+size_t
+MemoryTracker::get_physical_bytes() {
+#if defined(__unix__) && defined(_SC_PHYS_PAGES)
+  const long pages = sysconf(_SC_PHYS_PAGES);
+  const long pagesize = sysconf(_SC_PAGESIZE);
+  if (pages > 0 and pagesize > 0) return (size_t)pages * (size_t)pagesize;
+#endif
+  return 0;
+}
+
+size_t
+MemoryTracker::get_resident_bytes() {
+#ifdef __linux__
+  // second field of statm is resident pages
+  std::ifstream statm("/proc/self/statm");
+  size_t total = 0, resident = 0;
+  if (statm >> total >> resident) return resident * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+  return 0;
+}
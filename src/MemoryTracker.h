@@ -0,0 +1,66 @@
+/*
+ * MemoryTracker.h - Account for the large arrays held by one simulation
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+
+
+//
+// Current and peak bytes for each named part of a simulation
+//
+// Standing memory (element arrays, the BEM matrix) is set by the simulation once per
+//   step. Workspaces that only live inside a call (trees, scratch matrices, copies for
+//   a Runge-Kutta stage) are noted by the code that makes them, on whatever thread has
+//   this tracker as its current one, and count toward the peak of the step they were in.
+//
+class MemoryTracker {
+public:
+  MemoryTracker() = default;
+
+  // the tracker that workspace notes on this thread go to, or nullptr
+  static MemoryTracker* get_current();
+  static void set_current(MemoryTracker*);
+
+  // a workspace of this size exists right now, on the current tracker if there is one
+  static void note(const char*, const size_t);
+
+  // standing memory of one part, replacing its last value, and its peak if known better elsewhere
+  void set(const std::string, const size_t, const size_t _peak = 0);
+
+  // close out a step: its peak is the standing total plus the largest of each workspace
+  void end_step();
+
+  size_t get_total() const;
+  size_t get_peak() const;
+  std::string report() const;
+
+  void reset();
+
+  // physical memory of this node, or 0 if it can not be found
+  static size_t get_physical_bytes();
+  // resident set size of this process, or 0 if unknown
+  static size_t get_resident_bytes();
+
+private:
+  struct Entry {
+    size_t current = 0;
+    size_t peak = 0;
+    size_t in_step = 0;		// largest seen since the last end_step, for workspaces
+    bool workspace = false;
+  };
+
+  mutable std::mutex mtx;
+  std::map<std::string, Entry> entries;
+  size_t peak_total = 0;
+};
+
+// sizes in megabytes, for printing
+inline double to_mb(const size_t _bytes) { return (double)_bytes / (1024.0*1024.0); }
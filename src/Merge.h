@@ -9,7 +9,12 @@
 
 #include "Omega2D.h"
 #include "VectorHelper.h"
+#include "Distributed.h"
+#include "DistributedHelper.h"
 #include "nanoflann.hpp"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "ThreadPool.h"
 
 #include <Eigen/Dense>
 
@@ -29,13 +34,18 @@
 //
 // templated on storage class S (typically float or double)
 //
+// frozen particles neither merge nor take others in, and erased (if given) returns
+//   which of the original particles were removed
+//
 template <class S>
 size_t merge_close_particles(std::array<Vector<S>,2>& pos,
                              Vector<S>&               str,
                              Vector<S>&               rad,
                              const S                  particle_overlap,
                              const S                  threshold,
-                             const bool               adapt_radii) {
+                             const bool               adapt_radii,
+                             std::vector<bool> const* frozen = nullptr,
+                             std::vector<bool>*       erased = nullptr) {
 
   // make sure all vector sizes are identical
   assert(pos[0].size()==pos[1].size() && "Input array sizes do not match");
@@ -43,10 +53,10 @@ size_t merge_close_particles(std::array<Vector<S>,2>& pos,
   assert(str.size()==rad.size() && "Input array sizes do not match");
   const size_t n = rad.size();
 
-  std::cout << "  Merging close particles with n " << n << std::endl;
+  TaskGroup::out() << "  Merging close particles with n " << n << std::endl;
 
   // start timer
-  auto start = std::chrono::system_clock::now();
+  ScopedTimer timer("merge");
 
   // reference or generate the local set of vectors
   Vector<S>& x = pos[0];
@@ -66,6 +76,7 @@ size_t merge_close_particles(std::array<Vector<S>,2>& pos,
   typedef nanoflann::KDTreeEigenMatrixAdaptor< EigenMatType >  my_kd_tree_t;
   my_kd_tree_t mat_index(Dimensions, std::cref(xp));
   mat_index.index->buildIndex();
+  MemoryTracker::note("kd-tree", xp.size()*sizeof(S) + mat_index.index->usedMemory(*mat_index.index));
 
   std::vector<std::pair<EigenIndexType,S> > ret_matches;
   ret_matches.reserve(16);
@@ -94,7 +105,7 @@ size_t merge_close_particles(std::array<Vector<S>,2>& pos,
 
   // now, for every particle, search for a co-located and identical-radius particle!
   for (size_t i=0; i<n; ++i) {
-    if (not erase_me[i]) {
+    if (not erase_me[i] and not (frozen and (*frozen)[i])) {
 
       // nominal separation for this particle
       const S nom_sep = r[i] / particle_overlap;
@@ -110,7 +121,7 @@ size_t merge_close_particles(std::array<Vector<S>,2>& pos,
       if (nMatches > 1) {
         for (size_t j=0; j<ret_matches.size(); ++j) {
           const size_t iother = (size_t)ret_matches[j].first;
-          if (i != iother and not erase_me[iother]) {
+          if (i != iother and not erase_me[iother] and not (frozen and (*frozen)[iother])) {
             // make sure distance is also less than target particle's threshold
             // note that distance returned from radiusSearch is already squared
             const S dist = std::sqrt(ret_matches[j].second);
@@ -155,6 +166,7 @@ size_t merge_close_particles(std::array<Vector<S>,2>& pos,
 
   // how many to be erased?
   const size_t num_removed = std::count (erase_me.begin(), erase_me.end(), true);
+  if (erased) *erased = erase_me;
 
   if (num_removed > 0) {
 
@@ -178,13 +190,11 @@ size_t merge_close_particles(std::array<Vector<S>,2>& pos,
     r.resize(new_n);
     s.resize(new_n);
 
-    std::cout << "    merge removed " << num_removed << " particles" << std::endl;
+    TaskGroup::out() << "    merge removed " << num_removed << " particles" << std::endl;
   }
 
   // finish timer and report
-  auto end = std::chrono::system_clock::now();
-  std::chrono::duration<double> elapsed_seconds = end-start;
-  printf("    merging time:\t[%.4f] seconds\n", (float)elapsed_seconds.count());
+  timer.report("merging time");
 
   return num_removed;
 }
@@ -201,6 +211,9 @@ void merge_operation(std::vector<Collection>& _vort,
 
   const size_t maxiters = 1;
 
+  // with several ranks, each merges its own vortons and copies of the others' close by
+  const S cutoff = Distributed::is_on() ? largest_radius<S>(_vort) / _overlap : (S)0.0;
+
   for (auto &coll : _vort) {
 
     // if inert, no need to merge (keep all tracer particles)
@@ -216,6 +229,24 @@ void merge_operation(std::vector<Collection>& _vort,
       // perform possibly multiple iterations
       for (size_t iter=0; iter<maxiters; ++iter) {
 
+        if (Distributed::is_on()) {
+          ParticleHalo<S> halo = add_halo(pts, cutoff);
+          std::vector<bool> erased(pts.get_n(), false);
+          if (pts.get_n() > 0) {
+            (void) merge_close_particles(pts.get_pos(),
+                                         pts.get_str(),
+                                         pts.get_rad(),
+                                         _overlap,
+                                         _thresh,
+                                         _isadapt,
+                                         &halo.frozen,
+                                         &erased);
+            pts.resize(pts.get_rad().size());
+          }
+          finish_halo(pts, halo, &erased);
+          continue;
+        }
+
         // last two arguments are: relative distance, allow variable core radii
         (void) merge_close_particles(pts.get_pos(),
                                      pts.get_str(),
@@ -0,0 +1,306 @@
+/*
+ * Numa.cpp - Thread pinning and memory placement on multi-socket nodes
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "Numa.h"
+#include "ThreadPool.h"
+
+#ifdef _WIN32
+  #include <ciso646>
+#endif
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+#ifdef __linux__
+  #include <sched.h>
+  #include <unistd.h>
+#endif
+
+#ifdef USE_NUMA
+  #include <numa.h>
+  #include <numaif.h>
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+
+enum pin_t {
+  pin_none = 0,
+  pin_compact = 1,
+  pin_spread = 2
+};
+
+static pin_t pin_mode = pin_none;
+static std::atomic<size_t> pin_gen(0);
+
+// arrays smaller than this stay wherever they were first touched
+static constexpr size_t min_placed_bytes = 1 << 20;
+
+// for the report
+static std::mutex stats_mtx;
+static size_t num_placed = 0;
+static std::map<int,size_t> placed_bytes;
+static size_t interleaved_bytes = 0;
+static size_t num_failed = 0;
+
+//
+// the cpus this process may use, and the node of each, found once before any pinning
+//
+struct Topology {
+  std::vector<int> cpus;
+  std::vector<int> nodes;
+  int num_nodes = 1;
+
+  Topology() {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+      for (int c=0; c<CPU_SETSIZE; ++c) if (CPU_ISSET(c, &set)) cpus.push_back(c);
+    }
+#endif
+    if (cpus.empty()) cpus.push_back(0);
+
+#ifdef USE_NUMA
+    if (numa_available() >= 0) {
+      num_nodes = numa_max_node() + 1;
+      for (auto const c : cpus) nodes.push_back(std::max(0, numa_node_of_cpu(c)));
+    }
+#endif
+    if (nodes.size() != cpus.size()) nodes.assign(cpus.size(), 0);
+  }
+
+  // the cpus in the order that thread k takes the k-th
+  std::vector<size_t> order(const pin_t _mode) const {
+    // group the cpus by node, keeping their order within each
+    std::vector<std::vector<size_t>> by_node(num_nodes);
+    for (size_t i=0; i<cpus.size(); ++i) by_node[nodes[i]].push_back(i);
+
+    std::vector<size_t> list;
+    if (_mode == pin_spread) {
+      // one from each node in turn
+      for (size_t k=0; list.size() < cpus.size(); ++k) {
+        for (auto const& bn : by_node) if (k < bn.size()) list.push_back(bn[k]);
+      }
+    } else {
+      for (auto const& bn : by_node) list.insert(list.end(), bn.begin(), bn.end());
+    }
+    return list;
+  }
+};
+
+static Topology const& topology() {
+  static Topology topo;
+  return topo;
+}
+
+// index into the topology's cpus of the one that thread _k runs on
+static size_t slot_of_thread(const size_t _k) {
+  Topology const& topo = topology();
+  static std::vector<size_t> compact = topo.order(pin_compact);
+  static std::vector<size_t> spread = topo.order(pin_spread);
+  std::vector<size_t> const& list = (pin_mode == pin_spread) ? spread : compact;
+  return list[_k % list.size()];
+}
+
+static int num_omp_threads() {
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+// the pool's threads, the caller as thread 0 and worker i as thread i+1, pinned the same way
+static size_t num_pool_threads() {
+  return ThreadPool::get().get_num_threads();
+}
+
+// the threads that work on the big arrays: the OpenMP team in an OpenMP build, else the pool
+static size_t num_working_threads() {
+  return std::max((size_t)num_omp_threads(), num_pool_threads());
+}
+
+// pin the calling thread to the cpu of thread _k, or free it for pin_none
+static void pin_this_thread(const size_t _k) {
+#ifdef __linux__
+  Topology const& topo = topology();
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (pin_mode == pin_none) {
+    for (auto const c : topo.cpus) CPU_SET(c, &set);
+  } else {
+    CPU_SET(topo.cpus[slot_of_thread(_k)], &set);
+  }
+  (void) sched_setaffinity(0, sizeof(set), &set);
+#else
+  (void) _k;
+#endif
+}
+
+bool
+Numa::set_pinning(const std::string _mode) {
+  if (_mode == "none") pin_mode = pin_none;
+  else if (_mode == "compact") pin_mode = pin_compact;
+  else if (_mode == "spread") pin_mode = pin_spread;
+  else return false;
+  return true;
+}
+
+std::string
+Numa::get_pinning() {
+  if (pin_mode == pin_compact) return "compact";
+  if (pin_mode == pin_spread) return "spread";
+  return "none";
+}
+
+void
+Numa::apply() {
+  // nothing was ever pinned, so nothing needs freeing
+  if (pin_mode == pin_none and pin_gen == 0) return;
+
+  (void) topology();
+#ifdef _OPENMP
+  #pragma omp parallel
+  pin_this_thread(omp_get_thread_num());
+#else
+  pin_this_thread(0);
+#endif
+  pin_gen++;
+}
+
+size_t Numa::generation() { return pin_gen; }
+
+void
+Numa::pin_pool_thread(const size_t _index) {
+  if (pin_gen == 0) return;
+  // the calling thread runs tasks too, as thread 0
+  pin_this_thread(_index+1);
+}
+
+bool
+Numa::is_placing() {
+#ifdef USE_NUMA
+  return pin_mode != pin_none and topology().num_nodes > 1;
+#else
+  return false;
+#endif
+}
+
+#ifdef USE_NUMA
+// set the policy of these whole pages, and move any that were already touched
+static bool bind_pages(const uintptr_t _start, const uintptr_t _end, const int _policy,
+                       std::vector<int> const& _nodes) {
+  if (_end <= _start) return true;
+  const size_t nbits = 8 * sizeof(unsigned long);
+  std::vector<unsigned long> mask(topology().num_nodes / nbits + 1, 0);
+  for (auto const n : _nodes) mask[n / nbits] |= (1ul << (n % nbits));
+  return mbind((void*)_start, _end - _start, _policy, mask.data(), mask.size()*nbits + 1,
+               MPOL_MF_MOVE) == 0;
+}
+#endif
+
+void
+Numa::place(void* _ptr, const size_t _used, const size_t _capacity) {
+  if (not is_placing() or _ptr == nullptr or _capacity < min_placed_bytes) return;
+#ifdef USE_NUMA
+  Topology const& topo = topology();
+  const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+  const uintptr_t base = (uintptr_t)_ptr;
+  const uintptr_t first = base & ~(page-1);
+  const uintptr_t last = (base + _capacity + page-1) & ~(page-1);
+
+  // the k-th chunk of the used part goes with thread k, as in a static schedule
+  const size_t nthreads = num_working_threads();
+  uintptr_t start = first;
+  bool ok = true;
+  std::map<int,size_t> bytes;
+  for (size_t k=0; k<nthreads; ++k) {
+    uintptr_t end = (base + (_used * (k+1)) / nthreads) & ~(page-1);
+    // the unused tail goes where the last chunk will grow into it
+    if (k+1 == nthreads) end = last;
+    if (end <= start) continue;
+    const int node = topo.nodes[slot_of_thread(k)];
+    ok = bind_pages(start, end, MPOL_PREFERRED, {node}) and ok;
+    bytes[node] += end - start;
+    start = end;
+  }
+
+  std::lock_guard<std::mutex> lock(stats_mtx);
+  num_placed++;
+  for (auto const& b : bytes) placed_bytes[b.first] += b.second;
+  if (not ok) num_failed++;
+#else
+  (void) _used;
+#endif
+}
+
+void
+Numa::interleave(void* _ptr, const size_t _bytes) {
+  if (not is_placing() or _ptr == nullptr or _bytes < min_placed_bytes) return;
+#ifdef USE_NUMA
+  const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+  const uintptr_t first = (uintptr_t)_ptr & ~(page-1);
+  const uintptr_t last = ((uintptr_t)_ptr + _bytes + page-1) & ~(page-1);
+  std::vector<int> all(topology().num_nodes);
+  for (int n=0; n<(int)all.size(); ++n) all[n] = n;
+  const bool ok = bind_pages(first, last, MPOL_INTERLEAVE, all);
+
+  std::lock_guard<std::mutex> lock(stats_mtx);
+  interleaved_bytes += last - first;
+  if (not ok) num_failed++;
+#endif
+}
+
+std::string
+Numa::report() {
+  Topology const& topo = topology();
+  std::ostringstream ss;
+  ss << "NUMA: " << topo.num_nodes << " node" << (topo.num_nodes==1 ? "" : "s") << ", "
+     << topo.cpus.size() << " cpu" << (topo.cpus.size()==1 ? "" : "s")
+     << ", pinning " << get_pinning();
+#ifndef USE_NUMA
+  ss << " (built without libnuma, arrays are not placed)";
+#endif
+
+  if (pin_mode != pin_none) {
+    // how many threads landed on each node, and the first few cpus
+    auto list_threads = [&](const std::string _name, const size_t _n) {
+      std::map<int,size_t> per_node;
+      ss << std::endl << "  " << _name << " threads on cpus";
+      for (size_t k=0; k<_n; ++k) {
+        const size_t slot = slot_of_thread(k);
+        per_node[topo.nodes[slot]]++;
+        if (k < 16) ss << " " << topo.cpus[slot];
+      }
+      if (_n > 16) ss << " ...";
+      ss << std::endl << "  " << _name << " threads per node:";
+      for (auto const& p : per_node) ss << " " << p.first << ":" << p.second;
+    };
+    list_threads("pool", num_pool_threads());
+#ifdef _OPENMP
+    list_threads("OpenMP", (size_t)num_omp_threads());
+#endif
+    ss << std::endl << "  arrays are placed in " << num_working_threads() << " chunks";
+  }
+
+  std::lock_guard<std::mutex> lock(stats_mtx);
+  if (num_placed > 0 or interleaved_bytes > 0) {
+    ss << std::endl << "  placed " << num_placed << " arrays, MB per node:";
+    for (auto const& b : placed_bytes) ss << " " << b.first << ":" << (b.second / (1024.0*1024.0));
+    ss << ", interleaved " << (interleaved_bytes / (1024.0*1024.0)) << " MB";
+    if (num_failed > 0) ss << ", " << num_failed << " could not be moved";
+  }
+  return ss.str();
+}
@@ -0,0 +1,74 @@
+/*
+ * Numa.h - Thread pinning and memory placement on multi-socket nodes
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <algorithm>
+
+
+//
+// Where the threads run and where the big arrays live
+//
+// The influence loops split their targets evenly and in order over the OpenMP threads,
+//   so thread k always reads and writes the k-th chunk of each target array. With the
+//   threads pinned, each chunk can be put on the memory of the socket running its thread,
+//   and the stray reads across the socket link are only those of the source arrays.
+//   Without OpenMP the pool's threads do that work, a collection or a block at a time,
+//   so a chunk has no single owner; the arrays are still cut into one chunk per pool
+//   thread (pinned like OpenMP thread k), which spreads them over the sockets in use.
+//   The boundary matrix is read by one thread at a time, so its pages are spread over
+//   all of the sockets instead, to use all of their memory bandwidth.
+//
+// Pinning works on Linux; placement also needs libnuma (USE_NUMA) and more than one
+//   node. Otherwise this does nothing and costs nothing.
+//
+class Numa {
+public:
+  // "none", "compact" (fill one socket first) or "spread" (alternate sockets);
+  //   returns false for anything else
+  static bool set_pinning(const std::string);
+  static std::string get_pinning();
+
+  // pin the OpenMP threads of the calling thread, and have the pool's workers follow
+  static void apply();
+  // called by each pool worker, which knows whether it is behind by the generation
+  static size_t generation();
+  static void pin_pool_thread(const size_t);
+
+  // true if arrays should be placed as they grow
+  static bool is_placing();
+  // put each thread's chunk of the first _used bytes on its node, the rest on the last
+  static void place(void*, const size_t _used, const size_t _capacity);
+  // spread these pages over every node
+  static void interleave(void*, const size_t);
+
+  // nodes, pinning, and how much was placed
+  static std::string report();
+};
+
+
+//
+// resize a vector, and if it needs new memory, place that memory before any of it is
+//   touched, so the copy and the new zeros fault their pages in where they belong
+//
+template <class V>
+void numa_resize(V& _v, const size_t _n) {
+  if (Numa::is_placing() and _n > _v.capacity()) {
+    // grow as the vector would, so placement happens only once in a while
+    V grown(_v.get_allocator());
+    grown.reserve(std::max(_n, 2*_v.size()));
+    Numa::place(grown.data(), _n*sizeof(typename V::value_type),
+                grown.capacity()*sizeof(typename V::value_type));
+    grown.insert(grown.end(), _v.begin(), _v.end());
+    grown.resize(_n);
+    _v.swap(grown);
+  } else {
+    _v.resize(_n);
+  }
+}
@@ -0,0 +1,195 @@
+/*
+ * OutputWriter.cpp - Class to run file output jobs on a background thread
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "OutputWriter.h"
+#include "Profiler.h"
+#include "Distributed.h"
+
+#ifdef _WIN32
+  #include <ciso646>
+#endif
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <cassert>
+#include <algorithm>
+#include <exception>
+
+OutputWriter::OutputWriter(const size_t _maxq)
+  : max_queue(_maxq > 0 ? _maxq : 1),
+    queue(),
+    busy(false),
+    stopping(false),
+    max_depth(0),
+    num_written(0),
+    last_latency(0.0),
+    total_latency(0.0),
+    max_latency(0.0),
+    blocked_time(0.0),
+    queued_bytes(0),
+    max_queued_bytes(0),
+    worker(&OutputWriter::run, this)
+{}
+
+// finish everything that was queued, then stop the thread
+OutputWriter::~OutputWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+  }
+  cv_work.notify_all();
+  if (worker.joinable()) worker.join();
+}
+
+void
+OutputWriter::submit(Job _job, const size_t _bytes) {
+  assert(_job && "Submitting an empty output job");
+
+  // ranks of one MPI run all make the same files, so only the first writes them
+  if (not Distributed::is_root()) return;
+  const auto start = std::chrono::steady_clock::now();
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+
+    // wait for room in the queue (the job being run counts against the limit)
+    cv_space.wait(lock, [this]{ return queue.size() + (busy ? 1 : 0) < max_queue; });
+
+    const auto now = std::chrono::steady_clock::now();
+    blocked_time += std::chrono::duration<double>(now - start).count();
+
+    queue.push_back({std::move(_job), now, _bytes});
+    max_depth = std::max(max_depth, queue.size() + (busy ? 1 : 0));
+    queued_bytes += _bytes;
+    max_queued_bytes = std::max(max_queued_bytes, queued_bytes);
+  }
+  cv_work.notify_one();
+}
+
+void
+OutputWriter::flush() {
+  std::unique_lock<std::mutex> lock(mtx);
+  cv_space.wait(lock, [this]{ return queue.empty() and not busy; });
+}
+
+// the worker thread's loop
+void
+OutputWriter::run() {
+  while (true) {
+    Entry entry;
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv_work.wait(lock, [this]{ return stopping or not queue.empty(); });
+      if (queue.empty()) break;		// only happens when stopping
+      entry = std::move(queue.front());
+      queue.pop_front();
+      busy = true;
+    }
+
+    // do the actual encoding and writing outside of the lock
+    try {
+      ScopedTimer timer("output");
+      entry.job();
+    } catch (std::exception const& e) {
+      std::cerr << "ERROR in output writer: " << e.what() << std::endl;
+    }
+    // and let go of its snapshot before saying it is done
+    entry.job = nullptr;
+
+    const double lat = std::chrono::duration<double>(std::chrono::steady_clock::now() - entry.submitted).count();
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      busy = false;
+      num_written++;
+      queued_bytes -= entry.bytes;
+      last_latency = lat;
+      total_latency += lat;
+      max_latency = std::max(max_latency, lat);
+    }
+    cv_space.notify_all();
+  }
+}
+
+//
+// statistics, all are safe to call from any thread
+//
+size_t
+OutputWriter::get_queue_depth() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return queue.size() + (busy ? 1 : 0);
+}
+
+size_t
+OutputWriter::get_max_queue_depth() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return max_depth;
+}
+
+// change the queue limit, a smaller one holds fewer snapshots at once
+void
+OutputWriter::set_max_queue_size(const size_t _maxq) {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    max_queue = (_maxq > 0 ? _maxq : 1);
+  }
+  cv_space.notify_all();
+}
+
+size_t
+OutputWriter::get_queued_bytes() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return queued_bytes;
+}
+
+size_t
+OutputWriter::get_max_queued_bytes() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return max_queued_bytes;
+}
+
+size_t
+OutputWriter::get_num_written() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return num_written;
+}
+
+double
+OutputWriter::get_last_latency() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return last_latency;
+}
+
+double
+OutputWriter::get_mean_latency() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return (num_written > 0) ? total_latency / (double)num_written : 0.0;
+}
+
+double
+OutputWriter::get_max_latency() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return max_latency;
+}
+
+double
+OutputWriter::get_blocked_time() {
+  std::lock_guard<std::mutex> lock(mtx);
+  return blocked_time;
+}
+
+// one-line summary for the console
+std::string
+OutputWriter::report() {
+  std::lock_guard<std::mutex> lock(mtx);
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(4);
+  out << "Output writer: " << num_written << " jobs, queue depth " << (queue.size() + (busy ? 1 : 0))
+      << " (max " << max_depth << " of " << max_queue << "), latency mean "
+      << ((num_written > 0) ? total_latency / (double)num_written : 0.0)
+      << " s, max " << max_latency << " s, caller blocked " << blocked_time << " s";
+  return out.str();
+}
@@ -0,0 +1,91 @@
+/*
+ * OutputWriter.h - Class to run file output jobs on a background thread
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <string>
+
+
+//
+// A single background thread which runs output jobs in the order they were submitted
+//
+// Callers must hand over a job which owns everything it needs (a snapshot of the
+//   element arrays, a composed line of text), so the simulation may continue to
+//   step while the previous output is still being encoded and written.
+//
+// The queue is bounded: if the disk can't keep up, submit() blocks until a slot
+//   opens, so memory held in snapshots can not grow without bound.
+//
+class OutputWriter {
+public:
+  using Job = std::function<void()>;
+
+  explicit OutputWriter(const size_t _maxq = 4);
+  ~OutputWriter();
+
+  // no copying or moving, the thread holds a pointer to this
+  OutputWriter(OutputWriter const&) = delete;
+  OutputWriter& operator=(OutputWriter const&) = delete;
+
+  // add a job to the back of the queue, blocks if the queue is full; the size is
+  //   of any snapshot the job holds, for memory accounting
+  void submit(Job, const size_t _bytes = 0);
+  // wait until all queued jobs have finished
+  void flush();
+
+  // statistics
+  size_t get_queue_depth();
+  size_t get_max_queue_depth();
+  size_t get_max_queue_size() const { return max_queue; }
+  void set_max_queue_size(const size_t);
+  size_t get_queued_bytes();
+  size_t get_max_queued_bytes();
+  size_t get_num_written();
+  double get_last_latency();
+  double get_mean_latency();
+  double get_max_latency();
+  double get_blocked_time();
+  std::string report();
+
+private:
+  void run();
+
+  // a job, its submission time, and the size of its snapshot
+  struct Entry {
+    Job job;
+    std::chrono::steady_clock::time_point submitted;
+    size_t bytes;
+  };
+
+  size_t max_queue;
+  std::deque<Entry> queue;
+  bool busy;				// worker is running a job now
+  bool stopping;
+  std::mutex mtx;
+  std::condition_variable cv_work;	// signals the worker
+  std::condition_variable cv_space;	// signals submitters and flushers
+
+  // latency is from submission to completion, in seconds
+  size_t max_depth;
+  size_t num_written;
+  double last_latency;
+  double total_latency;
+  double max_latency;
+  double blocked_time;			// time callers spent waiting for a free slot
+  size_t queued_bytes;			// held by waiting and running jobs
+  size_t max_queued_bytes;
+
+  // must be last, so that everything above exists before the thread starts
+  std::thread worker;
+};
+
@@ -10,7 +10,10 @@
 #include "Core.h"
 #include "VectorHelper.h"
 #include "nanoflann.hpp"
+#include "Profiler.h"
+#include "MemoryTracker.h"
 #include "json/json.hpp"
+#include "ThreadPool.h"
 
 #include <Eigen/Dense>
 
@@ -21,6 +24,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
+#include <limits>
 #include <vector>
 
 
@@ -43,12 +47,16 @@ public:
   const bool get_volumes() const { return use_volumes; }
 
   // all-to-all diffuse; can change array sizes
+  // particles from the given count on are only neighbours, and keep their strengths;
+  //   relative thresholds use the last value if it is stronger than any particle here
   void diffuse_all(std::array<Vector<ST>,2>&,
                    Vector<ST>&,
                    Vector<ST>&,
                    const ST,
                    const CoreType,
-                   const ST);
+                   const ST,
+                   const size_t _nown = std::numeric_limits<size_t>::max(),
+                   const ST _peak = 0.0);
 
   void from_json(const nlohmann::json);
   void add_to_json(nlohmann::json&) const;
@@ -66,6 +74,8 @@ protected:
                                 Vector<ST>&,
                                 Vector<ST>&,
                                 Vector<ST>&,
+                                const ST,
+                                const size_t,
                                 const ST);
 
   // find particle volumes
@@ -111,7 +121,7 @@ PSE<ST,CT>::PSE() {
 template <class ST, class CT>
 void PSE<ST,CT>::initialize_sites() {
 
-  std::cout << "Creating one ring of " << num_sites << " insertion sites" << std::endl;
+  TaskGroup::out() << "Creating one ring of " << num_sites << " insertion sites" << std::endl;
 
   // one ring only
   if (false) {
@@ -141,7 +151,8 @@ void PSE<ST,CT>::initialize_sites() {
 
 //
 // Using a strength heuristic, add new particles to the boundary of the
-// particle distribution; this is very similar to what VRM does
+// particle distribution; this is very similar to what VRM does; only the
+// first nown particles are checked
 //
 // templated on storage class ST (typically float or double)
 //
@@ -150,10 +161,12 @@ size_t PSE<ST,CT>::add_new_boundary_parts(Vector<ST>& x,
                                           Vector<ST>& y,
                                           Vector<ST>& r,
                                           Vector<ST>& s,
-                                          const ST particle_overlap) {
+                                          const ST particle_overlap,
+                                          const size_t nown,
+                                          const ST peak) {
 
   // start timer
-  auto start = std::chrono::system_clock::now();
+  ScopedTimer timer("buffer");
 
   // make sure all vector sizes are identical
   assert(x.size()==y.size());
@@ -161,7 +174,7 @@ size_t PSE<ST,CT>::add_new_boundary_parts(Vector<ST>& x,
   assert(x.size()==s.size());
   size_t n = x.size();
 
-  std::cout << "  Adding buffer particles with n " << n << std::endl;
+  TaskGroup::out() << "  Adding buffer particles with n " << n << std::endl;
 
   // convert particle positions into something nanoflann can understand
   Eigen::Matrix<ST, Eigen::Dynamic, 2> xp;
@@ -174,7 +187,10 @@ size_t PSE<ST,CT>::add_new_boundary_parts(Vector<ST>& x,
   typedef typename EigenMatType::Index EigenIndexType;
   typedef nanoflann::KDTreeEigenMatrixAdaptor< EigenMatType >  my_kd_tree_t;
   my_kd_tree_t mat_index(Dimensions, std::cref(xp));
-  if (use_tree) mat_index.index->buildIndex();
+  if (use_tree) {
+    mat_index.index->buildIndex();
+    MemoryTracker::note("kd-tree", xp.size()*sizeof(ST) + mat_index.index->usedMemory(*mat_index.index));
+  }
 
   std::vector<std::pair<EigenIndexType,ST> > ret_matches;
   ret_matches.reserve(max_near);
@@ -184,14 +200,14 @@ size_t PSE<ST,CT>::add_new_boundary_parts(Vector<ST>& x,
   // what is maximum strength of all particles?
   const ST maxStr = s[std::max_element(s.begin(), s.end()) - s.begin()];
   const ST minStr = s[std::min_element(s.begin(), s.end()) - s.begin()];
-  const ST maxAbsStr = std::max(maxStr, -1.f*minStr);
-  std::cout << "    maxAbsStr " << maxAbsStr << std::endl;
+  const ST maxAbsStr = std::max({maxStr, -1.f*minStr, peak});
+  TaskGroup::out() << "    maxAbsStr " << maxAbsStr << std::endl;
 
   //
   // check each strong-enough particle for an appropriate number of neighbors
   //
   const int32_t initial_n = n;
-  for (int32_t i=0; i<initial_n; ++i) {
+  for (int32_t i=0; i<(int32_t)nown; ++i) {
 
     // if current particle strength is very small, skip out
     if ((thresholds_are_relative && (std::abs(s[i]) < maxAbsStr * ignore_thresh)) or
@@ -249,12 +265,10 @@ size_t PSE<ST,CT>::add_new_boundary_parts(Vector<ST>& x,
     }
   }
 
-  std::cout << "    added " << (n - initial_n) << " buffer particles" << std::endl;
+  TaskGroup::out() << "    added " << (n - initial_n) << " buffer particles" << std::endl;
 
   // finish timer and report
-  auto end = std::chrono::system_clock::now();
-  std::chrono::duration<double> elapsed_seconds = end-start;
-  printf("    buffering time:\t\t[%.4f] cpu seconds\n", (float)elapsed_seconds.count());
+  timer.report("buffering time");
 
   return (n - initial_n);
 }
@@ -312,7 +326,9 @@ void PSE<ST,CT>::diffuse_all(std::array<Vector<ST>,2>& pos,
                              Vector<ST>& rad,
                              const ST h_nu,
                              const CoreType core_func,
-                             const ST particle_overlap) {
+                             const ST particle_overlap,
+                             const size_t _nown,
+                             const ST _peak) {
 
   // make sure all vector sizes are identical
   assert(pos[0].size()==pos[1].size() && "Input arrays are not uniform size");
@@ -322,7 +338,7 @@ void PSE<ST,CT>::diffuse_all(std::array<Vector<ST>,2>& pos,
   //std::cout << "  Running PSE with n " << n << std::endl;
 
   // start timer
-  auto start = std::chrono::system_clock::now();
+  ScopedTimer timer("pse");
 
   // reference or generate the local set of vectors
   Vector<ST>& x = pos[0];
@@ -334,7 +350,9 @@ void PSE<ST,CT>::diffuse_all(std::array<Vector<ST>,2>& pos,
   //
   // first step is to add buffer particles where we need them
   //
-  (void) add_new_boundary_parts(x,y,r,s,particle_overlap);
+  const size_t initial_n = x.size();
+  const size_t nown = std::min(_nown, initial_n);
+  (void) add_new_boundary_parts(x,y,r,s,particle_overlap,nown,_peak);
   size_t n = x.size();
 
   // generate and zero out delta vector
@@ -360,7 +378,10 @@ void PSE<ST,CT>::diffuse_all(std::array<Vector<ST>,2>& pos,
   typedef typename EigenMatType::Index EigenIndexType;
   typedef nanoflann::KDTreeEigenMatrixAdaptor< EigenMatType >  my_kd_tree_t;
   my_kd_tree_t mat_index(Dimensions, std::cref(xp));
-  if (use_tree) mat_index.index->buildIndex();
+  if (use_tree) {
+    mat_index.index->buildIndex();
+    MemoryTracker::note("kd-tree", xp.size()*sizeof(ST) + mat_index.index->usedMemory(*mat_index.index));
+  }
 
   std::vector<std::pair<EigenIndexType,ST> > ret_matches;
   ret_matches.reserve(max_near);
@@ -376,7 +397,7 @@ void PSE<ST,CT>::diffuse_all(std::array<Vector<ST>,2>& pos,
   vol.resize(n);
 
   if (use_volumes) {
-    std::cout << "  Find volumes with n " << n << std::endl;
+    TaskGroup::out() << "  Find volumes with n " << n << std::endl;
 
     // loop over every particle
     for (size_t i=0; i<n; ++i) {
@@ -459,7 +480,7 @@ void PSE<ST,CT>::diffuse_all(std::array<Vector<ST>,2>& pos,
   // finally, perform the PSE operation
   //
 
-  std::cout << "  Running PSE with n " << n << std::endl;
+  TaskGroup::out() << "  Running PSE with n " << n << std::endl;
 
   // zero out delta vector
   std::fill(ds.begin(), ds.end(), 0.0);
@@ -476,6 +497,9 @@ void PSE<ST,CT>::diffuse_all(std::array<Vector<ST>,2>& pos,
   size_t maxneibs = 0;
   for (size_t i=0; i<n; ++i) {
 
+    // the neighbours' owners find their changes
+    if (i >= nown and i < initial_n) continue;
+
     // find the nearest neighbor particles
     //std::cout << "\nDiffusing particle " << i << " with strength " << s[i] << std::endl;
 
@@ -603,8 +627,8 @@ void PSE<ST,CT>::diffuse_all(std::array<Vector<ST>,2>& pos,
 
   } // end loop over all current particles
 
-  std::cout << "    neighbors: min/avg/max " << minneibs << "/" << ((ST)nneibs / (ST)n) << "/" << maxneibs << std::endl;
-  std::cout << "    after PSE, n is " << x.size() << std::endl;
+  TaskGroup::out() << "    neighbors: min/avg/max " << minneibs << "/" << ((ST)nneibs / (ST)n) << "/" << maxneibs << std::endl;
+  TaskGroup::out() << "    after PSE, n is " << x.size() << std::endl;
 
   // apply the changes to the master vectors
   assert(n==s.size() and ds.size()==s.size() && "Array size mismatch in PSE");
@@ -614,9 +638,7 @@ void PSE<ST,CT>::diffuse_all(std::array<Vector<ST>,2>& pos,
   }
 
   // finish timer and report
-  auto end = std::chrono::system_clock::now();
-  std::chrono::duration<double> elapsed_seconds = end-start;
-  printf("    pse.diffuse_all:\t[%.4f] seconds\n", (float)elapsed_seconds.count());
+  timer.report("pse.diffuse_all");
 }
 
 //
@@ -632,17 +654,17 @@ void PSE<ST,CT>::from_json(const nlohmann::json simj) {
 
     if (j.find("ignoreBelow") != j.end()) {
       ignore_thresh = j["ignoreBelow"];
-      std::cout << "  setting ignore_thresh= " << ignore_thresh << std::endl;
+      TaskGroup::out() << "  setting ignore_thresh= " << ignore_thresh << std::endl;
     }
 
     if (j.find("relativeThresholds") != j.end()) {
       thresholds_are_relative = j["relativeThresholds"];
-      std::cout << "  setting thresholds_are_relative= " << thresholds_are_relative << std::endl;
+      TaskGroup::out() << "  setting thresholds_are_relative= " << thresholds_are_relative << std::endl;
     }
 
     if (j.find("useVolumes") != j.end()) {
       use_volumes = j["useVolumes"];
-      std::cout << "  setting use_volumes= " << use_volumes << std::endl;
+      TaskGroup::out() << "  setting use_volumes= " << use_volumes << std::endl;
     }
   }
 }
@@ -0,0 +1,151 @@
+/*
+ * PerfCounters.cpp - Hardware performance counters for the calling thread, on Linux
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "PerfCounters.h"
+
+#ifdef _WIN32
+  #include <ciso646>
+#endif
+
+#ifdef __linux__
+  #include <linux/perf_event.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+  #include <cerrno>
+  #include <cstring>
+  #include <fstream>
+#endif
+
+
+PerfCounters::PerfCounters() {
+  fds.fill(-1);
+}
+
+PerfCounters::~PerfCounters() {
+  close();
+}
+
+const char*
+PerfCounters::name(const Counter _c) {
+  switch (_c) {
+    case cycles:        return "cycles";
+    case instructions:  return "instructions";
+    case cache_misses:  return "cache-misses";
+    case branch_misses: return "branch-misses";
+    case fp_scalar:     return "fp-scalar";
+    case fp_packed:     return "fp-packed";
+    default:            return "unknown";
+  }
+}
+
+#ifdef __linux__
+
+// glibc has no wrapper for this one
+static int perf_open(struct perf_event_attr& _attr, const int _group) {
+  return (int)syscall(__NR_perf_event_open, &_attr, 0, -1, _group, 0);
+}
+
+static bool is_intel() {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.compare(0, 9, "vendor_id") == 0) return (line.find("GenuineIntel") != std::string::npos);
+  }
+  return false;
+}
+
+bool
+PerfCounters::open(std::string& _why) {
+  close();
+
+  // type and config for each counter
+  const std::array<std::pair<uint32_t,uint64_t>, num_counters> events = {{
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    // FP_ARITH_INST_RETIRED, scalar single+double, and packed of every width
+    {PERF_TYPE_RAW, 0x03C7},
+    {PERF_TYPE_RAW, 0xFCC7} }};
+  const bool intel = is_intel();
+
+  for (int i=0; i<num_counters; ++i) {
+    if ((i == fp_scalar or i == fp_packed) and not intel) continue;
+
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[i].first;
+    attr.config = events[i].second;
+    attr.disabled = (i == cycles) ? 1 : 0;	// the leader starts the whole group
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    fds[i] = perf_open(attr, (i == cycles) ? -1 : fds[cycles]);
+    if (fds[i] < 0) {
+      // without the basic counters there is nothing to report
+      if (i < fp_scalar) {
+        _why = std::string("perf_event_open failed for ") + name((Counter)i) + ": " + std::strerror(errno);
+        if (errno == EACCES or errno == EPERM) {
+          _why += " (check /proc/sys/kernel/perf_event_paranoid)";
+        }
+        close();
+        return false;
+      }
+    }
+  }
+
+  ioctl(fds[cycles], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(fds[cycles], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  return true;
+}
+
+PerfCounters::Values
+PerfCounters::read() const {
+  Values vals;
+  vals.fill(0.0);
+  for (int i=0; i<num_counters; ++i) {
+    if (fds[i] < 0) continue;
+    uint64_t buf[3] = {0, 0, 0};
+    if (::read(fds[i], buf, sizeof(buf)) != (ssize_t)sizeof(buf)) continue;
+    // value, time enabled, time running
+    vals[i] = (buf[2] > 0 and buf[2] < buf[1]) ? (double)buf[0] * (double)buf[1] / (double)buf[2] : (double)buf[0];
+  }
+  return vals;
+}
+
+void
+PerfCounters::close() {
+  // members first, then the leader
+  for (int i=num_counters-1; i>=0; --i) {
+    if (fds[i] >= 0) ::close(fds[i]);
+    fds[i] = -1;
+  }
+}
+
+#else
+
+bool
+PerfCounters::open(std::string& _why) {
+  _why = "hardware counters are only supported on Linux";
+  return false;
+}
+
+PerfCounters::Values
+PerfCounters::read() const {
+  Values vals;
+  vals.fill(0.0);
+  return vals;
+}
+
+void
+PerfCounters::close() {}
+
+#endif
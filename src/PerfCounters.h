@@ -0,0 +1,47 @@
+/*
+ * PerfCounters.h - Hardware performance counters for the calling thread, on Linux
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+
+//
+// One group of hardware counters, opened with perf_event_open on the calling thread
+//
+// The counters also follow any threads created by this one after they are opened (like
+//   an OpenMP pool started on the first parallel region), and reads return the sum.
+//   User-space events only, so this works with the default perf_event_paranoid of 2.
+//   The two floating-point events are Intel-specific and are skipped where missing.
+//
+class PerfCounters {
+public:
+  enum Counter { cycles=0, instructions, cache_misses, branch_misses, fp_scalar, fp_packed, num_counters };
+  using Values = std::array<double, num_counters>;
+
+  PerfCounters();
+  ~PerfCounters();
+
+  PerfCounters(PerfCounters const&) = delete;
+  PerfCounters& operator=(PerfCounters const&) = delete;
+
+  // open and start the counters, on failure say why
+  bool open(std::string&);
+  bool is_open() const { return fds[cycles] >= 0; }
+  bool has(const Counter _c) const { return fds[_c] >= 0; }
+
+  // current totals, scaled up if the kernel had to multiplex the counters
+  Values read() const;
+
+  static const char* name(const Counter);
+
+private:
+  void close();
+  std::array<int, num_counters> fds;
+};
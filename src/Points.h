@@ -10,6 +10,7 @@
 #include "Omega2D.h"
 #include "VectorHelper.h"
 #include "ElementBase.h"
+#include "ThreadPool.h"
 
 #ifdef USE_GL
 #include "GlState.h"
@@ -41,11 +42,12 @@ public:
          const move_t _m,
          std::shared_ptr<Body> _bp)
     : ElementBase<S>(0, _e, _m, _bp),
-      max_strength(-1.0) {
+      max_strength(-1.0),
+      update_every(1) {
 
     const size_t nper = (_e == inert) ? 2 : 4;
-    std::cout << "  new collection with " << (_in.size()/nper);
-    std::cout << ((_e == inert) ? " tracers" : " vortons") << std::endl;
+    TaskGroup::out() << "  new collection with " << (_in.size()/nper);
+    TaskGroup::out() << ((_e == inert) ? " tracers" : " vortons") << std::endl;
 
     // need to reset the base class n
     this->n = _in.size()/nper;
@@ -55,7 +57,7 @@ public:
 
     // this initialization specific to Points
     for (size_t d=0; d<Dimensions; ++d) {
-      this->x[d].resize(this->n);
+      numa_resize(this->x[d], this->n);
       for (size_t i=0; i<this->n; ++i) {
         this->x[d][i] = _in[nper*i+d];
       }
@@ -71,7 +73,7 @@ public:
 
     } else {
       // active vortons need a radius
-      r.resize(this->n);
+      numa_resize(r, this->n);
       for (size_t i=0; i<this->n; ++i) {
         r[i] = _in[4*i+3];
       }
@@ -79,7 +81,7 @@ public:
       // optional strength in base class
       // need to assign it a vector first!
       Vector<S> new_s;
-      new_s.resize(this->n);
+      numa_resize(new_s, this->n);
       for (size_t i=0; i<this->n; ++i) {
         new_s[i] = _in[4*i+2];
       }
@@ -88,7 +90,7 @@ public:
 
     // velocity in base class
     for (size_t d=0; d<Dimensions; ++d) {
-      this->u[d].resize(this->n);
+      numa_resize(this->u[d], this->n);
     }
   }
 
@@ -99,7 +101,8 @@ public:
          std::shared_ptr<Body> _bp,
          const float _vd)
     : ElementBase<S>(0, _e, _m, _bp),
-      max_strength(-1.0) {
+      max_strength(-1.0),
+      update_every(1) {
 
     // ensure that this packet really is Points
     assert(_in.idx.size() == 0 && "Input ElementPacket is not Points");
@@ -111,8 +114,8 @@ public:
     else assert(_in.val.size() == _in.nelem && "Input ElementPacket with vortons has incorrect size val array");
 
     // tell the world that we're legit
-    std::cout << "  new collection with " << (_in.nelem);
-    std::cout << ((_e == inert) ? " tracer" : " vortex") << " elems" << std::endl;
+    TaskGroup::out() << "  new collection with " << (_in.nelem);
+    TaskGroup::out() << ((_e == inert) ? " tracer" : " vortex") << " elems" << std::endl;
     //std::cout << "  contains " << std::endl;
     //for (size_t i=0; i<_in.nelem; ++i) {
     //  std::cout << "    " << _in.x[2*i] << " " << _in.x[2*i+1] << " " << _in.val[2*i] << " " << _in.val[2*i+1] << std::endl;
@@ -123,7 +126,7 @@ public:
 
     // this initialization specific to Points - is it, though?
     for (size_t d=0; d<Dimensions; ++d) {
-      this->x[d].resize(this->n);
+      numa_resize(this->x[d], this->n);
       for (size_t i=0; i<this->n; ++i) {
         this->x[d][i] = _in.x[Dimensions*i+d];
       }
@@ -139,21 +142,21 @@ public:
 
     } else {
       // active vortons need radius
-      r.resize(this->n);
+      numa_resize(r, this->n);
       std::fill(r.begin(), r.end(), _vd);
 
       // optional strength in base class
       // need to assign it a vector first!
       // This needs to be modeled after 3D code
       Vector<S> new_s;
-      new_s.resize(this->n);
+      numa_resize(new_s, this->n);
       std::copy(_in.val.begin(), _in.val.end(), new_s.begin());
       this->s = std::move(new_s);
     }
 
     // velocity in base class
     for (size_t d=0; d<Dimensions; ++d) {
-      this->u[d].resize(this->n);
+      numa_resize(this->u[d], this->n);
     }
   }
 
@@ -181,7 +184,7 @@ public:
     assert(_in.size() % nper == 0 && "Input array size is not a multiple of 2 or 4");
 
     const size_t nnew = _in.size()/nper;
-    std::cout << "  adding " << nnew << " particles to collection..." << std::endl;
+    TaskGroup::out() << "  adding " << nnew << " particles to collection..." << std::endl;
 
     // must explicitly call the method in the base class first
     ElementBase<S>::add_new(_in);
@@ -192,7 +195,7 @@ public:
 
     } else {
       // active points need radius
-      r.resize(nold+nnew);
+      numa_resize(r, nold+nnew);
       for (size_t i=0; i<nnew; ++i) {
         r[nold+i] = _in[4*i+3];
       }
@@ -201,7 +204,7 @@ public:
     // save the new untransformed positions if we have a Body pointer
     if (this->B) {
       for (size_t d=0; d<Dimensions; ++d) {
-        (*this->ux)[d].resize(nold+nnew);
+        numa_resize((*this->ux)[d], nold+nnew);
         for (size_t i=nold; i<nold+nnew; ++i) {
           (*this->ux)[d][i] = this->x[d][i];
         }
@@ -223,7 +226,7 @@ public:
     // remember old size and incoming size (note that Points nelems = nnodes)
     const size_t nold = this->n;
     const size_t nnew = _in.nelem;
-    std::cout << "  adding " << nnew << " particles to collection..." << std::endl;
+    TaskGroup::out() << "  adding " << nnew << " particles to collection..." << std::endl;
 
     // must explicitly call the method in the base class first - this pulls out positions and strengths
     ElementBase<S>::add_new(_in);
@@ -233,14 +236,14 @@ public:
       // no radius needed
 
     } else {
-      r.resize(nold+nnew);
+      numa_resize(r, nold+nnew);
       std::fill(r.begin()+nold, r.end(), _vd);
     }
 
     // save the new untransformed positions if we have a Body pointer
     if (this->B) {
       for (size_t d=0; d<Dimensions; ++d) {
-        (*this->ux)[d].resize(nold+nnew);
+        numa_resize((*this->ux)[d], nold+nnew);
         for (size_t i=nold; i<nold+nnew; ++i) {
           (*this->ux)[d][i] = this->x[d][i];
         }
@@ -263,7 +266,7 @@ public:
       // no radii
     } else {
       const size_t thisrn = r.size();
-      r.resize(_nnew);
+      numa_resize(r, _nnew);
       for (size_t i=thisrn; i<_nnew; ++i) {
         r[i] = 1.0;
       }
@@ -350,6 +353,9 @@ public:
     }
   }
 
+  // the smoothed peak strength magnitude, which sets the brightness when drawing
+  float get_max_strength() const { return max_strength; }
+
   // find the new peak strength magnitude
   void update_max_str() {
     S thismax = ElementBase<S>::get_max_str();
@@ -423,7 +429,7 @@ public:
               float*              _defcolor) {
 
     //std::cout << "inside Points.initGL" << std::endl;
-    std::cout << "inside Points.initGL with E=" << this->E << " and M=" << this->M << std::endl;
+    TaskGroup::out() << "inside Points.initGL with E=" << this->E << " and M=" << this->M << std::endl;
 
     // generate the opengl state object with space for 4 vbos and 2 shader programs
     mgl = std::make_shared<GlState>(4,2);
@@ -644,6 +650,27 @@ public:
   }
 #endif
 
+  // checkpoint the radii along with the base state
+  void write_checkpoint(CheckpointWriter& _cw, nlohmann::json& _j, const std::string _pfx) const {
+    ElementBase<S>::write_checkpoint(_cw, _j, _pfx);
+    _cw.add(_pfx + "r", r);
+    if (update_every > 1) _j["updateEvery"] = update_every;
+  }
+
+  void read_checkpoint(CheckpointReader const& _cr, nlohmann::json const& _j, const std::string _pfx) {
+    ElementBase<S>::read_checkpoint(_cr, _j, _pfx);
+    _cr.get(_pfx + "r", r);
+    update_every = _j.value("updateEvery", (size_t)1);
+  }
+
+  size_t get_bytes() const {
+    return ElementBase<S>::get_bytes() + r.capacity() * sizeof(S);
+  }
+
+  // tracers may get new velocities only every few steps, and coast in between
+  size_t get_update_every() const { return update_every; }
+  void set_update_every(const size_t _n) { update_every = std::max((size_t)1, _n); }
+
   std::string to_string() const {
     std::string retstr = " " + std::to_string(this->n) + ElementBase<S>::to_string() + " Points";
     return retstr;
@@ -659,5 +686,6 @@ private:
   std::shared_ptr<GlState> mgl;
 #endif
   float max_strength;
+  size_t update_every;
 };
 
@@ -0,0 +1,435 @@
+/*
+ * Profiler.cpp - Nested phase timers, with summary tables and Chrome trace output
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+#ifdef _WIN32
+  #include <ciso646>
+#endif
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+
+
+static thread_local Profiler* current_profiler = nullptr;
+
+// phases opened on this thread with nothing open nest under this path, which belongs
+//   to another thread when this one is running work handed to it
+static thread_local std::string current_base;
+static thread_local std::thread::id current_owner;
+
+Profiler* Profiler::get_current() { return current_profiler; }
+void Profiler::set_current(Profiler* _p) { current_profiler = _p; }
+
+Profiler::Context
+Profiler::get_context() {
+  Context ctx;
+  ctx.prof = current_profiler;
+  ctx.path = current_base;
+  ctx.owner = (current_owner == std::thread::id()) ? std::this_thread::get_id() : current_owner;
+  if (ctx.prof) {
+    std::lock_guard<std::mutex> lock(ctx.prof->mtx);
+    ThreadState& ts = ctx.prof->this_thread();
+    if (not ts.stack.empty()) {
+      ctx.path = ts.stack.back().path;
+      ctx.owner = std::this_thread::get_id();
+    }
+  }
+  return ctx;
+}
+
+Profiler::Context
+Profiler::set_context(Context const& _ctx) {
+  Context prev = {current_profiler, current_base, current_owner};
+  current_profiler = _ctx.prof;
+  current_base = _ctx.path;
+  current_owner = (_ctx.owner == std::this_thread::get_id()) ? std::thread::id() : _ctx.owner;
+  return prev;
+}
+
+// the full path of a phase opened on this thread, inside the innermost open one if any
+static std::string child_path(std::string const* _open, const char* _name) {
+  if (_open) return *_open + "/" + _name;
+  if (not current_base.empty()) return current_base + "/" + _name;
+  return std::string(_name);
+}
+
+Profiler::Profiler()
+  : mtx(),
+    epoch(Clock::now()),
+    threads(),
+    stats(),
+    last_root(),
+    kernels(),
+    counting(false),
+    have_fp(false),
+    tracing(false),
+    events(),
+    max_events(2000000)
+  {}
+
+// find or make the state for the calling thread, call with the lock held
+Profiler::ThreadState&
+Profiler::this_thread() {
+  const auto id = std::this_thread::get_id();
+  auto it = threads.find(id);
+  if (it == threads.end()) {
+    it = threads.emplace(id, ThreadState()).first;
+    it->second.tid = (int)threads.size() - 1;
+  }
+  // counters have to be opened by the thread they count
+  if (counting and not it->second.counters) {
+    it->second.counters = std::make_unique<PerfCounters>();
+    std::string why;
+    if (not it->second.counters->open(why)) {
+      std::cout << "  hardware counters unavailable on thread " << it->second.tid << ": " << why << std::endl;
+    }
+  }
+  return it->second;
+}
+
+void
+Profiler::begin(const char* _name) {
+  const auto now = Clock::now();
+  std::lock_guard<std::mutex> lock(mtx);
+  ThreadState& ts = this_thread();
+  std::string path = child_path(ts.stack.empty() ? nullptr : &ts.stack.back().path, _name);
+  PerfCounters::Values counts = {};
+  if (ts.counters and ts.counters->is_open()) counts = ts.counters->read();
+  ts.stack.push_back({std::move(path), now, counts});
+}
+
+// fold one timed phase into the statistics, call with the lock held
+void
+Profiler::record(ThreadState& _ts, std::string const& _path, const double _secs, const size_t _calls) {
+  Stats& st = stats[_path];
+  st.calls += _calls;
+  st.total += _secs;
+  if (_calls == 1) {
+    st.min = std::min(st.min, _secs);
+    st.max = std::max(st.max, _secs);
+  }
+  st.by_thread[_ts.tid] += _secs;
+
+  // time in a borrowed context counts toward the owner's root
+  auto owner = threads.end();
+  if (current_owner != std::thread::id()) owner = threads.find(current_owner);
+  if (owner != threads.end()) owner->second.in_root[_path] += _secs;
+  else _ts.in_root[_path] += _secs;
+}
+
+double
+Profiler::end() {
+  const auto now = Clock::now();
+  std::lock_guard<std::mutex> lock(mtx);
+  ThreadState& ts = this_thread();
+  if (ts.stack.empty()) return 0.0;
+
+  Open op = std::move(ts.stack.back());
+  ts.stack.pop_back();
+  const double secs = std::chrono::duration<double>(now - op.start).count();
+  record(ts, op.path, secs, 1);
+
+  if (ts.counters and ts.counters->is_open()) {
+    const PerfCounters::Values counts = ts.counters->read();
+    Stats& st = stats[op.path];
+    st.counted = true;
+    for (size_t i=0; i<counts.size(); ++i) st.counts[i] += counts[i] - op.counts[i];
+  }
+
+  if (tracing and events.size() < max_events) {
+    const size_t slash = op.path.find_last_of('/');
+    events.push_back({(slash == std::string::npos) ? op.path : op.path.substr(slash+1), ts.tid,
+                      std::chrono::duration<double,std::micro>(op.start - epoch).count(), 1.e+6*secs});
+  }
+
+  // closing a root phase: roll up the per-root numbers
+  if (ts.stack.empty() and current_base.empty()) {
+    for (auto const& [path, t] : ts.in_root) {
+      Stats& st = stats[path];
+      st.roots++;
+      st.root_min = std::min(st.root_min, t);
+      st.root_max = std::max(st.root_max, t);
+      st.last_root = t;
+    }
+    ts.in_root.clear();
+    last_root = op.path;
+  }
+  return secs;
+}
+
+void
+Profiler::add(const char* _name, const double _secs, const size_t _calls) {
+  std::lock_guard<std::mutex> lock(mtx);
+  ThreadState& ts = this_thread();
+  const std::string path = child_path(ts.stack.empty() ? nullptr : &ts.stack.back().path, _name);
+  record(ts, path, _secs, _calls);
+}
+
+void
+Profiler::count_kernel(const char* _name, const double _flops, const double _bytes, const double _secs) {
+  Profiler* prof = get_current();
+  if (not prof) return;
+  std::lock_guard<std::mutex> lock(prof->mtx);
+  KernelStats& ks = prof->kernels[_name];
+  ks.calls++;
+  ks.flops += _flops;
+  ks.bytes += _bytes;
+  ks.secs += _secs;
+  // the OpenMP threads this call could use, which is its share when run as a task
+#ifdef _OPENMP
+  ks.thread_secs += _secs * omp_get_max_threads();
+#else
+  ks.thread_secs += _secs;
+#endif
+}
+
+bool
+Profiler::set_counters(const bool _on) {
+  std::lock_guard<std::mutex> lock(mtx);
+  counting = false;
+  if (not _on) return true;
+
+  // try them here first, so a denied request is reported once and up front
+  PerfCounters test;
+  std::string why;
+  if (not test.open(why)) {
+    std::cout << "Hardware counters are off: " << why << std::endl;
+    return false;
+  }
+  have_fp = test.has(PerfCounters::fp_packed) and test.has(PerfCounters::fp_scalar);
+  counting = true;
+  return true;
+}
+
+void
+Profiler::set_tracing(const bool _on) {
+  std::lock_guard<std::mutex> lock(mtx);
+  tracing = _on;
+}
+
+void
+Profiler::reset() {
+  std::lock_guard<std::mutex> lock(mtx);
+  epoch = Clock::now();
+  threads.clear();
+  stats.clear();
+  last_root.clear();
+  kernels.clear();
+  events.clear();
+}
+
+//
+// write the Chrome trace-event format: complete events, one row per thread
+//
+bool
+Profiler::write_trace(const std::string _fn) const {
+  std::lock_guard<std::mutex> lock(mtx);
+
+  std::FILE* fp = std::fopen(_fn.c_str(), "w");
+  if (not fp) return false;
+
+  std::fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  bool first = true;
+  for (auto const& [id, ts] : threads) {
+    std::fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                 first ? "" : ",\n", ts.tid, ts.tid);
+    first = false;
+  }
+  for (auto const& ev : events) {
+    std::fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"omega2d\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                 first ? "" : ",\n", ev.name.c_str(), ev.tid, ev.ts, ev.dur);
+    first = false;
+  }
+  std::fprintf(fp, "\n]}\n");
+  const bool good = (std::ferror(fp) == 0);
+  std::fclose(fp);
+
+  if (events.size() >= max_events) {
+    std::printf("  trace was truncated at %ld events\n", (long)max_events);
+  }
+  return good;
+}
+
+std::map<std::string,double>
+Profiler::get_totals() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  std::map<std::string,double> totals;
+  for (auto const& [path, st] : stats) totals[path] = st.total;
+  return totals;
+}
+
+//
+// the children of the latest root, like "step 0.512 s: diffusion 0.201, convection 0.298"
+//
+std::string
+Profiler::last_root_summary() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  std::ostringstream line;
+  auto it = stats.find(last_root);
+  if (it == stats.end()) return "";
+  line << std::fixed << std::setprecision(4) << last_root << " " << it->second.last_root << " s:";
+  const std::string pfx = last_root + "/";
+  bool first = true;
+  for (auto const& [path, st] : stats) {
+    if (path.compare(0, pfx.size(), pfx) != 0) continue;
+    if (path.find('/', pfx.size()) != std::string::npos) continue;
+    line << (first ? " " : ", ") << path.substr(pfx.size()) << " " << st.last_root;
+    first = false;
+  }
+  return line.str();
+}
+
+//
+// whole-run table, children indented below their parents
+//
+std::string
+Profiler::summary() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  std::ostringstream tab;
+  if (stats.empty()) return "";
+
+  tab << std::left << std::setw(40) << "phase" << std::right
+      << std::setw(8) << "calls" << std::setw(12) << "total s" << std::setw(8) << "%par"
+      << std::setw(12) << "mean s" << std::setw(12) << "max s"
+      << std::setw(12) << "root mean" << std::setw(12) << "root max" << "  threads" << std::endl;
+
+  tab << std::fixed;
+  for (auto const& [path, st] : stats) {
+    const size_t depth = std::count(path.begin(), path.end(), '/');
+    const size_t slash = path.find_last_of('/');
+    const std::string name = std::string(2*depth, ' ') + ((slash == std::string::npos) ? path : path.substr(slash+1));
+
+    // percent of the parent phase's time
+    double pct = 100.0;
+    if (slash != std::string::npos) {
+      auto parent = stats.find(path.substr(0, slash));
+      if (parent != stats.end() and parent->second.total > 0.0) pct = 100.0 * st.total / parent->second.total;
+    }
+
+    tab << std::left << std::setw(40) << name << std::right
+        << std::setw(8) << st.calls
+        << std::setw(12) << std::setprecision(4) << st.total
+        << std::setw(8) << std::setprecision(1) << pct
+        << std::setw(12) << std::setprecision(6) << st.total / std::max((size_t)1, st.calls)
+        << std::setw(12) << ((st.max > 0.0) ? st.max : st.total / std::max((size_t)1, st.calls))
+        << std::setw(12) << st.total / std::max((size_t)1, st.roots)
+        << std::setw(12) << st.root_max << " ";
+
+    // the share of each thread, if more than one did this
+    for (auto const& [tid, t] : st.by_thread) {
+      tab << " " << tid;
+      if (st.by_thread.size() > 1) tab << ":" << std::setprecision(0) << 100.0*t/st.total << "%";
+    }
+    tab << std::endl;
+  }
+  return tab.str();
+}
+
+//
+// achieved rates of each kernel against the roofline: a kernel whose arithmetic intensity
+//   is below the ridge point can at best run at the memory bandwidth; the roofline was
+//   measured on all of its threads, so each kernel's ceiling is scaled to the threads
+//   its calls had, which keeps tasks running side by side from passing 100%
+//
+std::string
+Profiler::kernel_summary(Roofline const& _rl) const {
+  std::lock_guard<std::mutex> lock(mtx);
+  std::ostringstream tab;
+  if (kernels.empty()) return "";
+
+  tab << std::left << std::setw(28) << "kernel" << std::right
+      << std::setw(8) << "calls" << std::setw(9) << "threads" << std::setw(12) << "seconds" << std::setw(12) << "GFLOP"
+      << std::setw(12) << "GFLOP/s" << std::setw(10) << "GB/s" << std::setw(12) << "flop/byte"
+      << std::setw(12) << "ceiling" << std::setw(8) << "%ceil" << "  bound" << std::endl;
+
+  tab << std::fixed;
+  for (auto const& [name, ks] : kernels) {
+    const double gflops = (ks.secs > 0.0) ? 1.e-9 * ks.flops / ks.secs : 0.0;
+    const double gbs = (ks.secs > 0.0) ? 1.e-9 * ks.bytes / ks.secs : 0.0;
+    const double intensity = (ks.bytes > 0.0) ? ks.flops / ks.bytes : 0.0;
+    const double nthreads = (ks.secs > 0.0) ? ks.thread_secs / ks.secs : 1.0;
+    const double ceiling = _rl.attainable(intensity) * nthreads / std::max(1, _rl.threads);
+
+    tab << std::left << std::setw(28) << name << std::right
+        << std::setw(8) << ks.calls
+        << std::setw(9) << std::setprecision(1) << nthreads
+        << std::setw(12) << std::setprecision(4) << ks.secs
+        << std::setw(12) << std::setprecision(3) << 1.e-9 * ks.flops
+        << std::setw(12) << gflops
+        << std::setw(10) << gbs
+        << std::setw(12) << std::setprecision(1) << intensity
+        << std::setw(12) << std::setprecision(3) << ceiling
+        << std::setw(8) << std::setprecision(1) << ((ceiling > 0.0) ? 100.0*gflops/ceiling : 0.0)
+        << "  " << ((intensity < _rl.ridge()) ? "memory" : "compute") << std::endl;
+  }
+  return tab.str();
+}
+
+//
+// rates derived from the hardware counters of each phase that had them
+//
+std::string
+Profiler::counter_summary() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  std::ostringstream tab;
+  if (not counting) return "";
+
+  tab << std::left << std::setw(40) << "phase" << std::right
+      << std::setw(12) << "Ginstr" << std::setw(8) << "IPC"
+      << std::setw(14) << "cache/kinstr" << std::setw(14) << "branch/kinstr";
+  if (have_fp) tab << std::setw(10) << "%packed";
+  tab << std::endl;
+
+  tab << std::fixed;
+  for (auto const& [path, st] : stats) {
+    if (not st.counted) continue;
+    const size_t depth = std::count(path.begin(), path.end(), '/');
+    const size_t slash = path.find_last_of('/');
+    const std::string name = std::string(2*depth, ' ') + ((slash == std::string::npos) ? path : path.substr(slash+1));
+
+    const double instr = st.counts[PerfCounters::instructions];
+    const double cyc = st.counts[PerfCounters::cycles];
+    const double kinstr = std::max(1.0, 1.e-3 * instr);
+    tab << std::left << std::setw(40) << name << std::right
+        << std::setw(12) << std::setprecision(3) << 1.e-9 * instr
+        << std::setw(8) << std::setprecision(2) << ((cyc > 0.0) ? instr / cyc : 0.0)
+        << std::setw(14) << std::setprecision(3) << st.counts[PerfCounters::cache_misses] / kinstr
+        << std::setw(14) << st.counts[PerfCounters::branch_misses] / kinstr;
+    if (have_fp) {
+      const double fp = st.counts[PerfCounters::fp_packed] + st.counts[PerfCounters::fp_scalar];
+      tab << std::setw(10) << std::setprecision(1) << ((fp > 0.0) ? 100.0 * st.counts[PerfCounters::fp_packed] / fp : 0.0);
+    }
+    tab << std::endl;
+  }
+  return tab.str();
+}
+
+
+//
+// the one-line timing report that kernels and diffusion steps print
+//
+void
+ScopedTimer::report(const char* _label, const double _flops) {
+  const double secs = stop();
+  char line[160];
+  if (_flops < 0.0) {
+    std::snprintf(line, sizeof(line), "    %s:\t[%.4f] seconds\n", _label, secs);
+  } else {
+    std::snprintf(line, sizeof(line), "    %s:\t[%.4f] seconds at %.3f GFlop/s\n", _label, secs,
+                  1.e-9 * _flops / std::max(secs, 1.e-9));
+  }
+  TaskGroup::out() << line;
+}
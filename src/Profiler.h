@@ -0,0 +1,190 @@
+/*
+ * Profiler.h - Nested phase timers, with summary tables and Chrome trace output
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include "Roofline.h"
+#include "PerfCounters.h"
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+//
+// A registry of named, nested phases
+//
+// Timers anywhere in the code report to the profiler set as "current" for the calling
+//   thread, so each Simulation can own one and several can run at once; on threads
+//   with no current profiler the timers do nothing. Phases nest by call order, and each
+//   is keyed by its full path, like "step/convection/bem/solve". Work handed to another
+//   thread can carry the context it was made in, so its phases nest there too.
+//
+// Statistics are kept per call and per root phase (usually one step), with each
+//   thread's share recorded, and if tracing is on every phase is also saved as an
+//   event for chrome://tracing or Perfetto.
+//
+// Compute kernels also report their analytical flop and byte counts, so that their
+//   achieved rates can be placed against the roofline of this node, scaled to the
+//   threads that each call had. That report is only made when asked for, because
+//   measuring the roofline takes a few seconds and a few hundred MB.
+//
+// Optionally, each thread that times phases opens its own hardware counters, and
+//   every phase then also accumulates cycles, instructions, cache and branch misses.
+//
+class Profiler {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  Profiler();
+
+  // the profiler that timers on this thread report to, or nullptr
+  static Profiler* get_current();
+  static void set_current(Profiler*);
+
+  // the current profiler, the phase that new phases here would nest in, and the thread
+  //   that owns that phase; setting it on another thread returns what it replaced
+  struct Context {
+    Profiler* prof = nullptr;
+    std::string path;
+    std::thread::id owner;
+  };
+  static Context get_context();
+  static Context set_context(Context const&);
+
+  // open and close a phase on the calling thread, end returns its duration in seconds
+  void begin(const char*);
+  double end();
+
+  // add a sub-phase that the caller timed itself, such as a sum over an inner loop
+  void add(const char*, const double, const size_t);
+
+  // work done by one call of a kernel, to the current profiler if there is one
+  static void count_kernel(const char*, const double _flops, const double _bytes, const double _secs);
+
+  // hardware counters, returns false (and prints why) if they can not be used here
+  bool set_counters(const bool);
+  bool is_counting() const { return counting; }
+
+  // trace events take memory, so they are only kept if asked
+  void set_tracing(const bool);
+  bool is_tracing() const { return tracing; }
+  bool write_trace(const std::string) const;
+
+  // one line for the most recent root phase, and a table for everything
+  std::string last_root_summary() const;
+  std::string summary() const;
+  std::string kernel_summary(Roofline const&) const;
+  std::string counter_summary() const;
+
+  // total seconds in each phase, by full path, for machine-readable reports
+  std::map<std::string,double> get_totals() const;
+
+  void reset();
+
+private:
+  struct Open {
+    std::string path;
+    Clock::time_point start;
+    PerfCounters::Values counts;
+  };
+
+  struct ThreadState {
+    int tid;
+    std::vector<Open> stack;
+    std::map<std::string,double> in_root;	// time spent in each phase during this root
+    std::unique_ptr<PerfCounters> counters;	// opened on this thread, if counting
+  };
+
+  struct Stats {
+    size_t calls = 0;
+    double total = 0.0;
+    double min = 1.e+30;
+    double max = 0.0;
+    // per root: number of roots this ran in, and min/max of its time in one root
+    size_t roots = 0;
+    double root_min = 1.e+30;
+    double root_max = 0.0;
+    double last_root = 0.0;
+    std::map<int,double> by_thread;
+    bool counted = false;
+    PerfCounters::Values counts = {};
+  };
+
+  struct KernelStats {
+    size_t calls = 0;
+    double flops = 0.0;
+    double bytes = 0.0;		// compulsory traffic: each input read once, each output written once
+    double secs = 0.0;
+    double thread_secs = 0.0;	// secs times the threads each call had
+  };
+
+  struct Event {
+    std::string name;
+    int tid;
+    double ts, dur;		// microseconds since the epoch
+  };
+
+  ThreadState& this_thread();
+  void record(ThreadState&, std::string const&, const double, const size_t);
+
+  mutable std::mutex mtx;
+  Clock::time_point epoch;
+  std::map<std::thread::id, ThreadState> threads;
+  std::map<std::string, Stats> stats;
+  std::string last_root;
+  std::map<std::string, KernelStats> kernels;
+
+  bool counting;
+  bool have_fp;			// the floating-point events opened too
+
+  bool tracing;
+  std::vector<Event> events;
+  size_t max_events;
+};
+
+
+//
+// Times the enclosing scope as one phase of the current profiler
+//
+class ScopedTimer {
+public:
+  explicit ScopedTimer(const char* _name)
+    : prof(Profiler::get_current()),
+      start(Profiler::Clock::now()),
+      seconds(-1.0) {
+    if (prof) prof->begin(_name);
+  }
+
+  ~ScopedTimer() { (void) stop(); }
+
+  ScopedTimer(ScopedTimer const&) = delete;
+  ScopedTimer& operator=(ScopedTimer const&) = delete;
+
+  // close the phase early, returns seconds; works with or without a profiler
+  double stop() {
+    if (seconds < 0.0) {
+      if (prof) seconds = prof->end();
+      else seconds = std::chrono::duration<double>(Profiler::Clock::now() - start).count();
+    }
+    return seconds;
+  }
+
+  // close the phase and print its time on the task's output, like
+  //   "    label:	[0.1234] seconds", and its rate if given the flops it did
+  void report(const char* _label, const double _flops = -1.0);
+
+private:
+  Profiler* prof;
+  Profiler::Clock::time_point start;
+  double seconds;
+};
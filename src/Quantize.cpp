@@ -0,0 +1,125 @@
+/*
+ * Quantize.cpp - Bounded-error lossy encoding of output arrays
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "Quantize.h"
+#include "miniz.h"
+
+#ifdef _WIN32
+  #include <ciso646>
+#endif
+
+#include <cstring>
+#include <algorithm>
+
+// stored ahead of the deflated stream: grid spacing, and whether the indices are differenced
+static const size_t quant_header_size = 16;
+
+// indices beyond this lose exactness in a double
+static const double max_quant_index = 4503599627370496.0;	// 2^52
+
+//
+// Encode an array of floats so that every value comes back within the bound
+//
+std::vector<char>
+quantize_encode(const float* _in, const size_t _n, const double _bound,
+                const bool _delta, const int _level) {
+
+  std::vector<char> out;
+  if (not (_bound > 0.0) or _n == 0) return out;
+
+  // leave room for the rounding back to float, which can add up to half an ulp
+  float maxabs = 0.0f;
+  for (size_t i=0; i<_n; ++i) maxabs = std::max(maxabs, std::abs(_in[i]));
+  const double ulp = (double)std::nextafter(maxabs, INFINITY) - (double)maxabs;
+  const double step = 2.0 * _bound - ulp;
+  if (not (step > 0.0)) return out;
+
+  // find the grid indices and make sure each one reconstructs within the bound
+  std::vector<int64_t> q(_n);
+  int nbad = 0;
+  #pragma omp parallel for reduction(+:nbad)
+  for (int64_t i=0; i<(int64_t)_n; ++i) {
+    const double k = std::nearbyint((double)_in[i] / step);
+    if (not std::isfinite(k) or std::abs(k) > max_quant_index) {
+      nbad++;
+      continue;
+    }
+    q[i] = (int64_t)k;
+    const float back = (float)(step * (double)q[i]);
+    if (std::abs((double)back - (double)_in[i]) > _bound) nbad++;
+  }
+  if (nbad > 0) return out;
+
+  // zigzag and varint: small magnitudes (and differences) take one byte
+  std::vector<unsigned char> packed;
+  packed.reserve(_n * 2);
+  int64_t last = 0;
+  for (size_t i=0; i<_n; ++i) {
+    const int64_t v = _delta ? q[i] - last : q[i];
+    last = q[i];
+    uint64_t z = ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+    while (z >= 0x80) {
+      packed.push_back((unsigned char)(z | 0x80));
+      z >>= 7;
+    }
+    packed.push_back((unsigned char)z);
+  }
+
+  // entropy-code that
+  mz_ulong csize = mz_compressBound(packed.size());
+  out.resize(quant_header_size + csize);
+  const uint64_t udelta = _delta ? 1 : 0;
+  std::memcpy(out.data(), &step, 8);
+  std::memcpy(out.data()+8, &udelta, 8);
+  const int status = mz_compress2((unsigned char*)out.data()+quant_header_size, &csize,
+                                  packed.data(), packed.size(), _level);
+  if (status != MZ_OK) {
+    out.clear();
+    return out;
+  }
+  out.resize(quant_header_size + csize);
+  return out;
+}
+
+//
+// And back to floats, returns false if the stream is damaged
+//
+bool
+quantize_decode(const char* _in, const size_t _len, float* _out, const size_t _n) {
+
+  if (_len < quant_header_size) return false;
+  double step;
+  uint64_t udelta;
+  std::memcpy(&step, _in, 8);
+  std::memcpy(&udelta, _in+8, 8);
+
+  // each index takes at most 10 bytes as a varint
+  std::vector<unsigned char> packed(10*_n + 1);
+  mz_ulong usize = packed.size();
+  const int status = mz_uncompress(packed.data(), &usize,
+                                   (const unsigned char*)_in+quant_header_size, _len-quant_header_size);
+  if (status != MZ_OK) return false;
+
+  size_t pos = 0;
+  int64_t last = 0;
+  for (size_t i=0; i<_n; ++i) {
+    uint64_t z = 0;
+    int shift = 0;
+    while (true) {
+      if (pos >= usize or shift > 63) return false;
+      const unsigned char b = packed[pos++];
+      z |= (uint64_t)(b & 0x7F) << shift;
+      if (b < 0x80) break;
+      shift += 7;
+    }
+    const int64_t v = (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+    const int64_t k = (udelta != 0) ? last + v : v;
+    last = k;
+    _out[i] = (float)(step * (double)k);
+  }
+  return pos == usize;
+}
@@ -0,0 +1,134 @@
+/*
+ * Quantize.h - Bounded-error lossy encoding of output arrays
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include "VectorHelper.h"
+#include "json/json.hpp"
+
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <array>
+#include <numeric>
+#include <algorithm>
+
+//
+// Analysis rarely needs full float32 precision in the output files, so every value
+//   may be moved to the nearest multiple of twice the error bound. The bound is either
+//   absolute, or relative to the range (max-min) of each array.
+//
+class ErrorBound {
+public:
+  ErrorBound() : relative(false), value(0.0) {}
+  ErrorBound(const bool _rel, const double _val) : relative(_rel), value(_val) {}
+
+  bool is_enabled() const { return value > 0.0; }
+  bool is_relative() const { return relative; }
+  double get_value() const { return value; }
+
+  // the absolute bound to use for one array (0 means keep it exact)
+  template <class S, class Alloc>
+  double for_array(std::vector<S,Alloc> const& _vec) const {
+    if (not relative or _vec.empty()) return value;
+    auto [vmin, vmax] = std::minmax_element(_vec.begin(), _vec.end());
+    return value * ((double)*vmax - (double)*vmin);
+  }
+
+  // runtime "outputError": {"absolute": 1.e-5} or {"relative": 1.e-4}
+  void from_json(nlohmann::json const& _j) {
+    if (_j.find("relative") != _j.end()) {
+      relative = true;
+      value = _j["relative"];
+    } else if (_j.find("absolute") != _j.end()) {
+      relative = false;
+      value = _j["absolute"];
+    }
+  }
+  nlohmann::json to_json() const {
+    nlohmann::json j;
+    j[relative ? "relative" : "absolute"] = value;
+    return j;
+  }
+
+private:
+  bool relative;
+  double value;
+};
+
+
+//
+// Order the points along a Morton (Z-order) curve, so that neighbors in the
+//   arrays are neighbors in space and their values differ by little
+//
+template <class S>
+std::vector<uint32_t> morton_order(std::array<Vector<S>,2> const& _x) {
+  const size_t n = _x[0].size();
+  std::vector<uint32_t> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  if (n < 2) return order;
+
+  // spread the bits of a 16-bit integer into the even bits of a 32-bit one
+  auto spread = [](uint32_t v) {
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+  };
+
+  auto [xmin, xmax] = std::minmax_element(_x[0].begin(), _x[0].end());
+  auto [ymin, ymax] = std::minmax_element(_x[1].begin(), _x[1].end());
+  const double span = std::max((double)*xmax - (double)*xmin, (double)*ymax - (double)*ymin);
+  const double scale = (span > 0.0) ? 65535.0 / span : 0.0;
+
+  std::vector<uint32_t> key(n);
+  #pragma omp parallel for
+  for (int32_t i=0; i<(int32_t)n; ++i) {
+    const uint32_t ix = (uint32_t)((_x[0][i] - *xmin) * scale);
+    const uint32_t iy = (uint32_t)((_x[1][i] - *ymin) * scale);
+    key[i] = spread(ix) | (spread(iy) << 1);
+  }
+
+  std::stable_sort(order.begin(), order.end(), [&key](uint32_t a, uint32_t b) { return key[a] < key[b]; });
+  return order;
+}
+
+// make a reordered copy of an array
+template <class S, class Alloc>
+std::vector<S,Alloc> permute(std::vector<S,Alloc> const& _vec, std::vector<uint32_t> const& _order) {
+  std::vector<S,Alloc> out(_order.size());
+  for (size_t i=0; i<_order.size(); ++i) out[i] = _vec[_order[i]];
+  return out;
+}
+
+//
+// Move each value to the nearest point on the quantization grid, in place, keeping
+//   any value that would land farther than the bound away after rounding to float;
+//   the trailing mantissa bits become regular, so zlib does much better on the result
+//
+template <class S, class Alloc>
+void snap_to_bound(std::vector<S,Alloc>& _vec, const double _bound) {
+  if (not (_bound > 0.0)) return;
+  const double step = 2.0 * _bound;
+  #pragma omp parallel for
+  for (int32_t i=0; i<(int32_t)_vec.size(); ++i) {
+    const double q = step * std::nearbyint((double)_vec[i] / step);
+    const S snapped = (S)q;
+    if (std::abs((double)snapped - (double)_vec[i]) <= _bound) _vec[i] = snapped;
+  }
+}
+
+//
+// Compact form for the binary outputs: integer grid indices, optionally differenced
+//   from the previous value, zigzag- and varint-coded, then deflated with miniz.
+//   Returns an empty vector if the array can not meet the bound this way (non-finite
+//   values, or a bound so small that the indices would overflow).
+//
+std::vector<char> quantize_encode(const float*, const size_t, const double, const bool, const int);
+bool quantize_decode(const char*, const size_t, float*, const size_t);
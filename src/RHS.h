@@ -11,6 +11,7 @@
 #include "VectorHelper.h"
 #include "Points.h"
 #include "Surfaces.h"
+#include "ThreadPool.h"
 
 #include <iostream>
 #include <vector>
@@ -19,7 +20,7 @@
 
 template <class S>
 std::vector<S> vels_to_rhs_points (Points<S> const& targ) {
-  std::cout << "    NOT converting vels to RHS vector for " << targ.to_string() << std::endl;
+  TaskGroup::out() << "    NOT converting vels to RHS vector for " << targ.to_string() << std::endl;
 
   //auto start = std::chrono::system_clock::now();
   //float flops = 0.0;
@@ -39,7 +40,7 @@ std::vector<S> vels_to_rhs_points (Points<S> const& targ) {
 
 template <class S>
 std::vector<S> vels_to_rhs_panels (Surfaces<S> const& targ) {
-  std::cout << "    convert vels to RHS vector for" << targ.to_string() << std::endl;
+  TaskGroup::out() << "    convert vels to RHS vector for" << targ.to_string() << std::endl;
 
   // pull references to the element arrays
   const std::array<Vector<S>,Dimensions>& tu = targ.get_vel();
@@ -9,6 +9,10 @@
 
 #include "Core.h"
 #include "VectorHelper.h"
+#include "Distributed.h"
+#include "Profiler.h"
+#include "Reproducible.h"
+#include "ThreadPool.h"
 
 #include <cassert>
 #include <chrono>
@@ -64,14 +68,16 @@ void RVM<ST>::diffuse_all(std::array<Vector<ST>,2>& pos,
   assert(str.size()==rad.size() && "Input arrays are not uniform size");
   const size_t n = rad.size();
 
-  std::cout << "  Running RVM with n " << n << std::endl;
+  TaskGroup::out() << "  Running RVM with n " << n << std::endl;
 
   // start timer
-  auto start = std::chrono::system_clock::now();
+  ScopedTimer timer("rvm");
 
   // init the random number generator
   std::random_device rd{};
   std::mt19937 gen{rd()};
+  // each rank walks its own particles, so it needs its own numbers
+  Reproducible::reseed(gen, "rvm", (uint32_t)Distributed::rank());
 
   // create a normal distribution rng with mean 0 and std deviation h_nu
   std::normal_distribution<ST> diffuse{0.0, h_nu};
@@ -85,9 +91,7 @@ void RVM<ST>::diffuse_all(std::array<Vector<ST>,2>& pos,
   }
 
   // finish timer and report
-  auto end = std::chrono::system_clock::now();
-  std::chrono::duration<double> elapsed_seconds = end-start;
-  printf("    rvm.diffuse_all:\t[%.4f] seconds\n", (float)elapsed_seconds.count());
+  timer.report("rvm.diffuse_all");
 }
 
 //
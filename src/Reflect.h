@@ -10,8 +10,12 @@
 #include "Omega2D.h"
 #include "Points.h"
 #include "Surfaces.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
 
+#include <cstdio>
 #include <cstdlib>
+#include <iostream>
 #include <limits>
 #include <vector>
 #include <cmath>
@@ -106,8 +110,8 @@ template <class S>
 void reflect_panp2 (Surfaces<S> const& _src, Points<S>& _targ) {
 
   //std::cout << "  inside reflect(Surfaces, Points)" << std::endl;
-  std::cout << "  Reflecting" << _targ.to_string() << " from near" << _src.to_string() << std::endl;
-  auto start = std::chrono::system_clock::now();
+  TaskGroup::out() << "  Reflecting" << _targ.to_string() << " from near" << _src.to_string() << std::endl;
+  ScopedTimer timer("reflect_panp2");
 
   // get handles for the vectors
   std::array<Vector<S>,Dimensions> const& sx = _src.get_pos();
@@ -179,12 +183,12 @@ void reflect_panp2 (Surfaces<S> const& _src, Points<S>& _targ) {
 
     // dump out the hits
     if (false) {
-      std::cout << "point " << i << " is " << tx[0][i] << " " << tx[1][i] << std::endl;
+      TaskGroup::out() << "point " << i << " is " << tx[0][i] << " " << tx[1][i] << std::endl;
       for (auto & ahit: hits) {
         if (ahit.disttype == node) {
-          std::cout << "  node " << ahit.jidx << " is " << std::sqrt(ahit.distsq) << std::endl;
+          TaskGroup::out() << "  node " << ahit.jidx << " is " << std::sqrt(ahit.distsq) << std::endl;
         } else {
-          std::cout << "  panel " << ahit.jidx << " is " << std::sqrt(ahit.distsq) << std::endl;
+          TaskGroup::out() << "  panel " << ahit.jidx << " is " << std::sqrt(ahit.distsq) << std::endl;
         }
       }
     }
@@ -254,13 +258,14 @@ void reflect_panp2 (Surfaces<S> const& _src, Points<S>& _targ) {
     }
   }
 
-  std::cout << "    reflected " << num_reflected << " particles" << std::endl;
+  TaskGroup::out() << "    reflected " << num_reflected << " particles" << std::endl;
   const S flops = _targ.get_n() * (62.0 + 27.0*_src.get_npanels());
 
-  auto end = std::chrono::system_clock::now();
-  std::chrono::duration<double> elapsed_seconds = end-start;
-  const float gflops = 1.e-9 * flops / (float)elapsed_seconds.count();
-  printf("    reflect_panp2:\t[%.4f] seconds at %.3f GFlop/s\n", (float)elapsed_seconds.count(), gflops);
+  timer.report("reflect_panp2", flops);
+
+  // panels read their nodes and indices, particles read and write their positions
+  const double bytes = (double)_src.get_npanels() * (4.0*sizeof(S) + 2.0*sizeof(Int)) + sizeof(S) * 4.0*_targ.get_n();
+  Profiler::count_kernel("reflect_panp2", flops, bytes, timer.stop());
 }
 
 
@@ -361,7 +366,7 @@ std::vector<std::tuple<S,S,S>> init_cut_tables (const S _dx) {
 // use the cut tables - assume _pos is normalized by vdelta
 //
 template <class S>
-std::pair<S,S> get_cut_entry (std::vector<std::tuple<S,S,S>>& ct, const S _pos) {
+std::pair<S,S> get_cut_entry (std::vector<std::tuple<S,S,S>> const& ct, const S _pos) {
   // set defaults (change nothing)
   S smult = 1.0;
   S dshift = 0.0;
@@ -409,15 +414,11 @@ S clear_inner_panp2 (const int _method,
                      const S _cutoff_mult,
                      const S _ips) {
 
-  std::cout << "  Clearing" << _targ.to_string() << " from near" << _src.to_string() << std::endl;
-  auto start = std::chrono::system_clock::now();
+  TaskGroup::out() << "  Clearing" << _targ.to_string() << " from near" << _src.to_string() << std::endl;
+  ScopedTimer timer("clear_inner_panp2");
 
-  static bool made_cut_tables = false;
-  static std::vector<std::tuple<S,S,S>> ct;
-  if (not made_cut_tables) {
-    ct = init_cut_tables<S>((S)0.1);
-    made_cut_tables = true;
-  }
+  // made once and shared by every simulation in this process
+  static const std::vector<std::tuple<S,S,S>> ct = init_cut_tables<S>((S)0.1);
 
   // get handles for the vectors
   std::array<Vector<S>,Dimensions> const& sx = _src.get_pos();
@@ -450,11 +451,13 @@ S clear_inner_panp2 (const int _method,
   if (_method==0 and not are_fldpts) {
     S this_circ = 0.0;
     for (int32_t i=0; i<(int32_t)_targ.get_n(); ++i) this_circ += ts[i];
-    std::cout << "    circulation before: " << this_circ << std::endl;
+    TaskGroup::out() << "    circulation before: " << this_circ << std::endl;
   }
 
   size_t num_cropped = 0;
   S circ_removed = 0.0;
+  // the removed circulation is kept per particle and added in order, for any thread count
+  std::vector<S> removed;
   //const S eps = 10.0*std::numeric_limits<S>::epsilon();
 
   // create array of flags - any moved particle will be tested again
@@ -464,7 +467,9 @@ S clear_inner_panp2 (const int _method,
   // iterate more than once to make sure particles get cleared from corners
   while (std::any_of(untested.begin(), untested.end(), [](bool x){return x;})) {
 
-    #pragma omp parallel for reduction(+:num_cropped,circ_removed)
+    if (_method == 0 and not are_fldpts) removed.assign(_targ.get_n(), 0.0);
+
+    #pragma omp parallel for reduction(+:num_cropped)
     for (int32_t i=0; i<(int32_t)_targ.get_n(); ++i) {
 
       if (untested[i]) {
@@ -506,14 +511,14 @@ S clear_inner_panp2 (const int _method,
 
         // dump out the hits
         if (false) {
-          std::cout << "point " << i << " is " << tx[0][i] << " " << tx[1][i] << std::endl;
+          TaskGroup::out() << "point " << i << " is " << tx[0][i] << " " << tx[1][i] << std::endl;
           for (auto & ahit: hits) {
             if (ahit.disttype == node) {
-              std::cout << "  node " << ahit.jidx << " dist " << std::sqrt(ahit.distsq) << std::endl;
-              std::cout << "    cp is " << ahit.cpx << " " << ahit.cpy << std::endl;
+              TaskGroup::out() << "  node " << ahit.jidx << " dist " << std::sqrt(ahit.distsq) << std::endl;
+              TaskGroup::out() << "    cp is " << ahit.cpx << " " << ahit.cpy << std::endl;
             } else {
-              std::cout << "  panel " << ahit.jidx << " dist " << std::sqrt(ahit.distsq) << std::endl;
-              std::cout << "    cp is " << ahit.cpx << " " << ahit.cpy << std::endl;
+              TaskGroup::out() << "  panel " << ahit.jidx << " dist " << std::sqrt(ahit.distsq) << std::endl;
+              TaskGroup::out() << "    cp is " << ahit.cpx << " " << ahit.cpy << std::endl;
             }
           }
         }
@@ -576,7 +581,7 @@ S clear_inner_panp2 (const int _method,
               const std::pair<S,S> entry = get_cut_entry(ct, dotp/this_radius);
 
               // ensure that this "reabsorbed" circulation is accounted for in BEM
-              circ_removed += ts[i] * (1.0-std::get<0>(entry));
+              removed[i] = ts[i] * (1.0-std::get<0>(entry));
 
               // modify the particle in question
               ts[i] *= std::get<0>(entry);
@@ -610,30 +615,33 @@ S clear_inner_panp2 (const int _method,
 
       } // end if (untested)
     } // end loop over particles
+
+    for (auto const& r : removed) circ_removed += r;
   } // end loop over iterations
 
   // we did not resize the x array, so we don't need to touch the u array
 
   if (_method == 0) {
-    std::cout << "    cropped " << num_cropped << " particles" << std::endl;
+    TaskGroup::out() << "    cropped " << num_cropped << " particles" << std::endl;
   } else if (_method == 1) {
-    std::cout << "    pushed " << num_cropped << " particles" << std::endl;
+    TaskGroup::out() << "    pushed " << num_cropped << " particles" << std::endl;
   }
 
   if (_method==0 and not are_fldpts) {
     S this_circ = 0.0;
     for (int32_t i=0; i<(int32_t)_targ.get_n(); ++i) this_circ += ts[i];
-    std::cout << "    circulation after: " << this_circ << std::endl;
-    std::cout << "    removed: " << circ_removed << std::endl;
+    TaskGroup::out() << "    circulation after: " << this_circ << std::endl;
+    TaskGroup::out() << "    removed: " << circ_removed << std::endl;
   }
 
   // flops count here is taken from reflect - might be different here
   const S flops = (_targ.get_n()+num_cropped) * (62.0 + 27.0*_src.get_npanels());
 
-  auto end = std::chrono::system_clock::now();
-  std::chrono::duration<double> elapsed_seconds = end-start;
-  const float gflops = 1.e-9 * flops / (float)elapsed_seconds.count();
-  printf("    clear_inner_panp2:\t[%.4f] seconds at %.3f GFlop/s\n", (float)elapsed_seconds.count(), gflops);
+  timer.report("clear_inner_panp2", flops);
+
+  // as above, but particles also read and write their strengths
+  const double bytes = (double)_src.get_npanels() * (4.0*sizeof(S) + 2.0*sizeof(Int)) + sizeof(S) * 6.0*_targ.get_n();
+  Profiler::count_kernel("clear_inner_panp2", flops, bytes, timer.stop());
 
   return circ_removed;
 }
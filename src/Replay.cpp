@@ -0,0 +1,280 @@
+/*
+ * Replay.cpp - Advect new tracers through the saved frames of a finished run
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "Replay.h"
+#include "FlowFeature.h"
+#include "BoundaryFeature.h"
+#include "MeasureFeature.h"
+#include "Simulation.h"
+#include "JsonHelper.h"
+#include "RenderParams.h"
+#include "TimeSeries.h"
+#include "VtkXmlHelper.h"
+#include "Convection.h"
+#include "Reflect.h"
+#include "ThreadPool.h"
+
+#ifdef _WIN32
+  #include <ciso646>
+#endif
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <vector>
+
+
+//
+// The velocity of a finished run at any time between its first and last frames
+//
+class FrozenFlow {
+public:
+  FrozenFlow(const std::string _fn, std::array<double,Dimensions> const& _fs, ExecEnv const& _env,
+             nlohmann::json const& _tracer_vel, const double _ips)
+    : reader(_fn), fs(_fs), ips(_ips), conv(), frames(), nloaded(0) {
+    for (auto const& entry : reader.get_index()) times.push_back(entry.time);
+    if (times.empty()) throw std::runtime_error("Series " + _fn + " has no frames");
+    if (not std::is_sorted(times.begin(), times.end())) {
+      throw std::runtime_error("Frames in series " + _fn + " are not in time order");
+    }
+    conv.set_env(_env);
+    // frames keep their particles' velocities, so tracers can be interpolated from them
+    conv.set_tracer_velocity(_tracer_vel);
+  }
+
+  size_t get_num_frames() const { return times.size(); }
+  double get_start_time() const { return times.front(); }
+  double get_end_time() const { return times.back(); }
+  size_t get_num_loaded() const { return nloaded; }
+
+  // velocities on every target at _t, blended from the frames before and after it
+  void find_vels(const double _t, std::vector<Collection>& _targets) {
+    size_t i0, i1;
+    double w;
+    bracket(_t, i0, i1, w);
+    Frame& f0 = load(i0);
+    if (i1 == i0 or w <= 0.0) {
+      conv.find_tracer_vels(fs, ips, f0.vort, f0.bdry, _targets);
+      return;
+    }
+    Frame& f1 = load(i1);
+    if (w >= 1.0) {
+      conv.find_tracer_vels(fs, ips, f1.vort, f1.bdry, _targets);
+      return;
+    }
+
+    // the earlier frame's velocities, then the later one's, then the blend
+    conv.find_tracer_vels(fs, ips, f0.vort, f0.bdry, _targets);
+    std::vector<std::array<Vector<S>,Dimensions>> early;
+    for (auto const& coll : _targets) early.push_back(std::get<Points<S>>(coll).get_vel());
+    conv.find_tracer_vels(fs, ips, f1.vort, f1.bdry, _targets);
+    for (size_t t=0; t<_targets.size(); ++t) {
+      std::array<Vector<S>,Dimensions>& u = std::get<Points<S>>(_targets[t]).get_vel();
+      for (size_t d=0; d<Dimensions; ++d) {
+        for (size_t i=0; i<u[d].size(); ++i) u[d][i] = (S)((1.0-w)*early[t][d][i] + w*u[d][i]);
+      }
+    }
+  }
+
+  // the panels of the frame nearest _t, which tracers must stay out of
+  std::vector<Collection>& get_bdry(const double _t) {
+    size_t i0, i1;
+    double w;
+    bracket(_t, i0, i1, w);
+    return load(w < 0.5 ? i0 : i1).bdry;
+  }
+
+private:
+  typedef STORE S;
+
+  struct Frame {
+    std::vector<Collection> vort, bdry;
+  };
+
+  // the frames on either side of _t, and how far along from the first to the second;
+  //   before the first frame or after the last, the flow stays as it was there
+  void bracket(const double _t, size_t& _i0, size_t& _i1, double& _w) const {
+    const size_t after = std::upper_bound(times.begin(), times.end(), _t) - times.begin();
+    if (after == 0) {
+      _i0 = _i1 = 0;
+      _w = 0.0;
+    } else if (after == times.size()) {
+      _i0 = _i1 = times.size()-1;
+      _w = 0.0;
+    } else {
+      _i0 = after-1;
+      _i1 = after;
+      _w = (_t - times[_i0]) / (times[_i1] - times[_i0]);
+    }
+  }
+
+  // read and rebuild a frame, keeping only the few that time has not passed yet
+  Frame& load(const size_t _i) {
+    auto found = frames.find(_i);
+    if (found != frames.end()) return found->second;
+
+    while (not frames.empty() and frames.begin()->first+1 < _i) frames.erase(frames.begin());
+
+    TimeSeriesFrame frame = reader.read_frame(_i);
+    std::cout << "  Loading frame " << _i << " from step " << frame.get_step()
+              << " at time " << frame.get_time() << std::endl;
+    Frame& f = frames[_i];
+    f.vort = collections_from_frame<S>(frame, "vort");
+    // with no bodies to ask, panels bring the strength of their rotation with them
+    f.bdry = collections_from_frame<S>(frame, "bdry", true);
+    nloaded++;
+    return f;
+  }
+
+  TimeSeriesReader reader;
+  std::vector<double> times;
+  std::array<double,Dimensions> fs;
+  S ips;
+  Convection<STORE,ACCUM,Int> conv;
+  std::map<size_t,Frame> frames;
+  size_t nloaded;
+};
+
+
+BatchResult
+run_replay(nlohmann::json const& _j, const std::string _series, BatchOptions const& _opts,
+           volatile std::sig_atomic_t const* _stop) {
+
+  auto start = std::chrono::steady_clock::now();
+  BatchResult res;
+
+  // the simulation is only read for its settings and measurement features
+  Simulation sim;
+  std::vector< std::unique_ptr<FlowFeature> > ffeatures;
+  std::vector< std::unique_ptr<BoundaryFeature> > bfeatures;
+  std::vector< std::unique_ptr<MeasureFeature> > mfeatures;
+  RenderParams rparams;
+  sim.claim_random_seeds();
+  parse_json(sim, ffeatures, bfeatures, mfeatures, rparams, _j);
+  _opts.apply(sim);
+
+#ifdef _OPENMP
+  res.threads = omp_get_max_threads();
+#else
+  res.threads = (int)ThreadPool::get().get_num_threads();
+#endif
+
+  try {
+    const double dt = sim.get_dt();
+    const double ips = sim.get_ips();
+    const float* fsp = sim.addr_fs();
+    FrozenFlow flow(_series, {fsp[0], fsp[1]}, sim.get_exec_env(), sim.get_tracer_velocity(), ips);
+    double end_time = flow.get_end_time();
+    if (sim.using_end_time()) end_time = std::min(end_time, (double)sim.get_end_time());
+
+    std::cout << std::endl << "Replaying " << _series << ", " << flow.get_num_frames()
+              << " frames from time " << flow.get_start_time() << " to " << flow.get_end_time() << std::endl;
+    std::cout << "Execution environment:" << sim.get_exec_env().to_string() << std::endl;
+    std::cout << "  threads " << res.threads << ", dt " << dt << ", output dt " << sim.get_output_dt()
+              << ", until time " << end_time << std::endl;
+
+    // new tracers, from a packet that may hold none (an empty one says it has some)
+    auto add_tracers = [&](Collection& _coll, ElementPacket<float> const& _packet) {
+      if (_packet.x.empty() or _packet.ndim != 0) return;
+      std::get<Points<float>>(_coll).add_new(_packet, sim.get_vdelta());
+    };
+
+    // one collection per tracer set, so each is its own target in the sums
+    std::vector<Collection> tracers;
+    std::vector<MeasureFeature*> sources;
+    for (auto const& mf : mfeatures) {
+      if (not mf->is_enabled()) continue;
+      const move_t mt = (mf->get_is_lagrangian() ? lagrangian : fixed);
+      tracers.push_back(Points<float>(std::vector<float>(), inert, mt, nullptr));
+      add_tracers(tracers.back(), mf->init_elements(rparams.tracer_scale*ips));
+      sources.push_back(mf.get());
+    }
+    if (tracers.empty()) throw std::runtime_error("No enabled measurement features to replay");
+    std::cout << "  " << tracers.size() << " tracer sets" << std::endl;
+
+    // output files go where the simulation's would, with the velocities just found
+    const std::string pfx = sim.out_path("");
+    auto write_output = [&](const size_t _step, const double _t) {
+      std::vector<std::string> files;
+      write_vtk_files<float>(tracers, _step, _t, files, sim.get_output_error(), pfx);
+    };
+
+    double t = flow.get_start_time();
+    size_t step = 0;
+    double next_output_time = t;
+    while (t + 0.5*dt < end_time) {
+      std::cout << std::endl << "Replay step " << step << " at time " << t << std::endl;
+
+      // new tracers from the emitters
+      for (size_t s=0; s<tracers.size(); ++s) {
+        add_tracers(tracers[s], sources[s]->step_elements(rparams.tracer_scale*ips));
+      }
+
+      // second-order Runge-Kutta, as the simulation moves its tracers, and the first
+      //   stage's velocities are also those of any output now
+      size_t ntracers = 0;
+      for (auto const& coll : tracers) ntracers += std::get<Points<float>>(coll).get_n();
+      flow.find_vels(t, tracers);
+      if (sim.get_output_dt() > 0.0 and t + 0.5*dt >= next_output_time) {
+        write_output(step, t);
+        next_output_time += sim.get_output_dt();
+      }
+      std::vector<Collection> interim = tracers;
+      for (auto &coll : interim) {
+        std::visit([=](auto& elem) { elem.move(t, dt); }, coll);
+      }
+      flow.find_vels(t+dt, interim);
+      for (size_t s=0; s<tracers.size(); ++s) {
+        Points<float>& p1 = std::get<Points<float>>(tracers[s]);
+        Points<float>& p2 = std::get<Points<float>>(interim[s]);
+        p1.move(t, dt, 0.5, p1, 0.5, p2);
+      }
+      clear_inner_layer<STORE>(1, flow.get_bdry(t+dt), tracers, (STORE)0.0, (STORE)(0.5*ips));
+
+      res.particle_steps += (double)ntracers;
+      t += dt;
+      step++;
+
+      if (_stop and *_stop) {
+        std::cout << std::endl << "Received SIGTERM, stopping at replay step " << step << std::endl;
+        res.status = 2;
+        res.error = "stopped by signal";
+        break;
+      }
+      if (sim.using_max_steps() and step >= sim.get_max_steps()) break;
+    }
+
+    // and where they all ended up
+    if (sim.get_output_dt() > 0.0 and res.status == 0) {
+      flow.find_vels(t, tracers);
+      write_output(step, t);
+    }
+
+    res.nstep = step;
+    res.time = t;
+    for (auto const& coll : tracers) res.nfldpts += std::get<Points<float>>(coll).get_n();
+    std::cout << std::endl << "Replayed " << step << " steps of " << res.nfldpts << " tracers in "
+              << tracers.size() << " sets, reading " << flow.get_num_loaded() << " frames" << std::endl;
+
+  } catch (std::exception const& e) {
+    std::cout << std::endl << "ERROR: " << e.what() << std::endl;
+    res.status = 1;
+    res.error = e.what();
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  res.wall_seconds = elapsed.count();
+  printf("  replay took %g seconds\n", res.wall_seconds);
+  return res;
+}
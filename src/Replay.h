@@ -0,0 +1,40 @@
+/*
+ * Replay.h - Advect new tracers through the saved frames of a finished run
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include "BatchRunner.h"
+#include "json/json.hpp"
+
+#include <csignal>
+#include <string>
+
+
+//
+// Frozen-flow tracers from a time series (see TimeSeries.h) of a run that is done
+//
+// The series holds the particles and the solved panel strengths at every output step,
+//   which is all that is needed for the velocity anywhere, so tracers can be sent
+//   through that flow long after the run, without solving anything again. The velocity
+//   at a time between two frames is a blend of the velocities found from each, weighted
+//   by how near that time is to them.
+//
+// The json is that of a simulation: its freestream, time step, ending time, output,
+//   execution environment, and tracer velocity are used, and each enabled measurement
+//   feature becomes its own tracer set; its flow and boundary features are ignored,
+//   because the frames already hold what came of them. Every tracer set is a separate
+//   target of each velocity summation, so they are all found at once on the task pool.
+//   Frames keep their particles' velocities too, so tracers can be interpolated from
+//   them (see TracerInterp.h) without a sum over the particles.
+//
+// Panels on bodies also bring the strength of each body's rotation from their frame, so
+//   tracers near rotating bodies see the same velocities that the run did. Series written
+//   before frames kept that strength are refused if they have panels on bodies.
+//
+BatchResult run_replay(nlohmann::json const&, const std::string _series,
+                       BatchOptions const& _opts = BatchOptions(),
+                       volatile std::sig_atomic_t const* _stop = nullptr);
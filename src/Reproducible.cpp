@@ -0,0 +1,69 @@
+/*
+ * Reproducible.cpp - Settings and helpers for runs that repeat bit-for-bit
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "Reproducible.h"
+
+#ifdef _WIN32
+  #include <ciso646>
+#endif
+
+#include <vector>
+
+
+// which simulation's settings the calling thread uses
+static thread_local Reproducible* current_settings = nullptr;
+
+// every seed starts from this
+static constexpr uint32_t base_seed = 20200813;
+
+Reproducible* Reproducible::get_current() { return current_settings; }
+void Reproducible::set_current(Reproducible* _r) { current_settings = _r; }
+
+void
+Reproducible::set(const bool _on) {
+  std::lock_guard<std::mutex> lock(mtx);
+  if (_on == on) return;
+  on = _on;
+  site_calls.clear();
+}
+
+bool
+Reproducible::is_on() {
+  Reproducible* r = get_current();
+  return (r and r->on);
+}
+
+void
+Reproducible::reseed(std::mt19937& _gen, const char* _site, const uint32_t _stream) {
+  Reproducible* r = get_current();
+  if (not r or not r->on) return;
+
+  uint32_t call = 0;
+  {
+    std::lock_guard<std::mutex> lock(r->mtx);
+    call = r->site_calls[_site]++;
+  }
+
+  // fold the site name into the seed, so sites do not share a sequence
+  std::vector<uint32_t> key = {base_seed, call};
+  for (char const* c=_site; *c; ++c) key.push_back((uint32_t)(unsigned char)*c);
+  if (_stream > 0) key.push_back(_stream);
+  std::seed_seq seq(key.begin(), key.end());
+  _gen.seed(seq);
+}
+
+std::map<std::string, uint32_t>
+Reproducible::get_counts() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  return site_calls;
+}
+
+void
+Reproducible::set_counts(std::map<std::string, uint32_t> const& _counts) {
+  std::lock_guard<std::mutex> lock(mtx);
+  site_calls = _counts;
+}
@@ -0,0 +1,64 @@
+/*
+ * Reproducible.h - Settings and helpers for runs that repeat bit-for-bit
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+
+
+//
+// The switch for bitwise-reproducible runs of one simulation
+//
+// Every parallel loop in a step computes each target on its own, in a fixed order over
+//   the sources, and the few sums over targets are added in order afterwards, so results
+//   do not depend on the thread count whether or not this is on. What is left are the
+//   random numbers: with this on, every random number generator is reseeded from a fixed
+//   seed, the name of its use site, and how often it has been used, and the random walks
+//   of the diffusion run one collection at a time.
+//
+// Each simulation owns one of these, and makes it current on the threads that work for
+//   it (as with its Profiler), so simulations running at once keep their own counts.
+//   The counts go into checkpoints, so a restart draws what the full run would have.
+//
+// The cost is a reseed per call of each random feature, which is not a measurable part
+//   of a step (see the benchmark suite). It is off by default.
+//
+class Reproducible {
+public:
+  Reproducible() = default;
+
+  // the settings that random features on this thread use, or nullptr (which is off)
+  static Reproducible* get_current();
+  static void set_current(Reproducible*);
+
+  // turning it on or off starts every site over
+  void set(const bool);
+  bool get() const { return on; }
+
+  // is the current one on
+  static bool is_on();
+
+  // if the current one is on, reseed this generator for the next use of this site,
+  //   otherwise leave it alone; a site used on every MPI rank for different elements
+  //   draws from one stream per rank
+  static void reseed(std::mt19937&, const char* _site, const uint32_t _stream = 0);
+
+  // uses of each site so far
+  std::map<std::string, uint32_t> get_counts() const;
+  void set_counts(std::map<std::string, uint32_t> const&);
+
+private:
+  std::atomic<bool> on{false};
+  mutable std::mutex mtx;
+  std::map<std::string, uint32_t> site_calls;
+};
+
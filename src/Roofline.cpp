@@ -0,0 +1,143 @@
+/*
+ * Roofline.cpp - Measure the peak compute rate and memory bandwidth of this node
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "Roofline.h"
+
+#ifdef _WIN32
+  #include <ciso646>
+#endif
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+
+// independent accumulators per thread: enough for several chains of the widest vectors
+static constexpr int32_t num_accum = 128;
+static constexpr int32_t fma_reps = 200000;
+
+// triad arrays of 8M doubles, well past any last-level cache
+static constexpr int32_t triad_n = 1 << 23;
+static constexpr int triad_trials = 5;
+
+// keeps the compiler from discarding the benchmark loops
+static volatile double sink = 0.0;
+
+//
+// time num_accum*fma_reps fused multiply-adds on each thread
+//
+static double measure_fma (int& _nthreads) {
+  _nthreads = 1;
+  double best = 0.0;
+
+  for (int trial=0; trial<3; ++trial) {
+    const auto start = std::chrono::steady_clock::now();
+    double total = 0.0;
+
+    #pragma omp parallel reduction(+:total)
+    {
+      float acc[num_accum];
+      for (int32_t k=0; k<num_accum; ++k) acc[k] = 1.0f + 1.e-3f*k;
+      const float mult = 0.999999f;
+      const float add = 1.e-7f;
+
+      for (int32_t r=0; r<fma_reps; ++r) {
+        for (int32_t k=0; k<num_accum; ++k) {
+#ifdef FP_FAST_FMAF
+          acc[k] = std::fma(acc[k], mult, add);
+#else
+          acc[k] = acc[k] * mult + add;
+#endif
+        }
+      }
+      for (int32_t k=0; k<num_accum; ++k) total += acc[k];
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    sink = sink + total;
+
+#ifdef _OPENMP
+    _nthreads = omp_get_max_threads();
+#endif
+    const double flops = 2.0 * (double)num_accum * (double)fma_reps * (double)_nthreads;
+    best = std::max(best, 1.e-9 * flops / elapsed.count());
+  }
+  return best;
+}
+
+//
+// STREAM triad, a = b + s*c, counting 3 words per element as STREAM does
+//
+static double measure_triad () {
+  std::vector<double> a(triad_n), b(triad_n), c(triad_n);
+
+  // touch in parallel, so pages land near the threads that will use them
+  #pragma omp parallel for
+  for (int32_t i=0; i<triad_n; ++i) {
+    a[i] = 0.0;
+    b[i] = 1.0;
+    c[i] = 2.0;
+  }
+
+  const double scale = 3.0;
+  double best = 0.0;
+  for (int trial=0; trial<triad_trials; ++trial) {
+    const auto start = std::chrono::steady_clock::now();
+    #pragma omp parallel for
+    for (int32_t i=0; i<triad_n; ++i) {
+      a[i] = b[i] + scale*c[i];
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::max(best, 1.e-9 * 3.0 * sizeof(double) * (double)triad_n / elapsed.count());
+  }
+  sink = sink + a[triad_n/2];
+  return best;
+}
+
+Roofline
+Roofline::measure() {
+  Roofline rl;
+  const auto start = std::chrono::steady_clock::now();
+  rl.gflops = measure_fma(rl.threads);
+  rl.gbs = measure_triad();
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  rl.seconds = elapsed.count();
+  return rl;
+}
+
+Roofline const&
+Roofline::get() {
+  static const Roofline rl = []() {
+    std::cout << "Measuring roofline" << std::endl;
+    Roofline r = Roofline::measure();
+    std::cout << "  " << r.to_string() << std::endl;
+    return r;
+  }();
+  return rl;
+}
+
+double
+Roofline::attainable(const double _intensity) const {
+  return std::min(gflops, _intensity * gbs);
+}
+
+std::string
+Roofline::to_string() const {
+  std::ostringstream ss;
+  ss.precision(4);
+  ss << "peak " << gflops << " GFLOP/s (float FMA), triad " << gbs << " GB/s, ridge at "
+     << ridge() << " flop/byte, on " << threads << " threads";
+  return ss.str();
+}
@@ -0,0 +1,38 @@
+/*
+ * Roofline.h - Measure the peak compute rate and memory bandwidth of this node
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include <string>
+
+
+//
+// The two ceilings of a roofline model, from short microbenchmarks
+//
+// Compute is a float fused multiply-add loop on every thread, and bandwidth is the
+//   STREAM triad on arrays far larger than cache. Both use the OpenMP thread count
+//   at the time of the first call, and neither is a guaranteed peak, just what
+//   compiled code on this node can reach. A kernel that ran on fewer threads is held
+//   to that share of both ceilings.
+//
+struct Roofline {
+  double gflops = 0.0;		// float FMA rate, GFLOP/s
+  double gbs = 0.0;		// triad bandwidth, GB/s
+  int threads = 1;
+  double seconds = 0.0;		// time taken to measure
+
+  // measured once per process, on the first call
+  static Roofline const& get();
+  static Roofline measure();
+
+  // flops per byte where the two ceilings meet
+  double ridge() const { return (gbs > 0.0) ? gflops / gbs : 0.0; }
+  // best rate possible at a given arithmetic intensity
+  double attainable(const double _intensity) const;
+
+  std::string to_string() const;
+};
@@ -11,17 +11,48 @@
 #include "BEMHelper.h"
 #include "VtkXmlHelper.h"
 #include "GuiHelper.h"
+#include "SoftRender.h"
+#include "Accuracy.h"
+#include "Reproducible.h"
+#include "Distributed.h"
+#include "DistributedHelper.h"
+#include "Numa.h"
 
 #include <cassert>
 #include <cmath>
 #include <cfenv> // Catch fp exceptions
 #include <limits>
+#include <sstream>
 #include <variant>
 
 #ifdef _WIN32
 #pragma STDC FENV_ACCESS ON // For fp exceptions
 #endif
 
+// total bytes in the element arrays of a list of collections
+static size_t collection_bytes(std::vector<Collection> const& _colls) {
+  size_t bytes = 0;
+  for (auto const& coll : _colls) bytes += std::visit([](auto const& elem) { return elem.get_bytes(); }, coll);
+  return bytes;
+}
+
+// a hash of the positions (and strengths, of particles) of some collections, to compare across ranks
+static uint64_t collection_hash(std::vector<Collection> const& _colls, uint64_t _hash) {
+  auto add = [&_hash](void const* _data, const size_t _bytes) {
+    unsigned char const* c = static_cast<unsigned char const*>(_data);
+    for (size_t i=0; i<_bytes; ++i) _hash = (_hash ^ c[i]) * 1099511628211ull;
+  };
+  for (auto const& coll : _colls) {
+    std::visit([&](auto const& elem) {
+      const size_t n = elem.get_n();
+      add(&n, sizeof(n));
+      for (size_t d=0; d<Dimensions; ++d) add(elem.get_pos()[d].data(), n*sizeof(float));
+      if (elem.get_elemt() == active) add(elem.get_str().data(), elem.get_str().size()*sizeof(float));
+    }, coll);
+  }
+  return _hash;
+}
+
 // constructor
 Simulation::Simulation()
   : re(100.0),
@@ -32,9 +63,27 @@ Simulation::Simulation()
     bdry(),
     fldpt(),
     bem(),
+    output_bem_key(),
     diff(),
     conv(),
+    prof(),
+    trace_file(),
+    kernel_report(false),
+    mem(),
+    memory_budget(0),
+    repro(),
+    writer(),
     sf(),
+    last_force_time(0.0),
+    last_impulse{0.0},
+    series_file(),
+    series_compress(true),
+    series(),
+    png_output(false),
+    output_dir(),
+    start_step(0),
+    checkpoint_file("checkpoint.o2c"),
+    checkpoint_steps(0),
     description(),
     time(0.0),
     output_dt(0.0),
@@ -47,8 +96,16 @@ Simulation::Simulation()
     quit_on_stop(false),
     sim_is_initialized(false),
     step_has_started(false),
-    step_is_finished(false)
-  {}
+    step_is_finished(false),
+    stop_reported(false),
+    vort_split(false)
+  {
+    // status lines are written on the background thread, in order with the vtk files
+    sf.set_writer(&writer);
+
+    // and the writer's jobs are timed with everything else from this simulation
+    writer.submit([this](){ Profiler::set_current(&prof); });
+  }
 
 // addresses for use in imgui
 float* Simulation::addr_re() { return &re; }
@@ -86,6 +143,85 @@ void Simulation::set_quit_on_stop(const bool qos) { quit_on_stop = qos; }
 void Simulation::set_status_file_name(const std::string _fn) { sf.set_filename(_fn); }
 std::string Simulation::get_status_file_name() { return sf.get_filename(); }
 
+// the bem uses the same instructions as the velocity evaluations
+ExecEnv Simulation::get_exec_env() const { return conv.get_env(); }
+void Simulation::set_exec_env(ExecEnv const& _env) {
+  conv.set_env(_env);
+  bem.set_instrs(_env.get_instrs());
+}
+std::string Simulation::get_diffusion_method() const { return diff.get_method(); }
+bool Simulation::set_diffusion_method(const std::string _name) { return diff.set_method(_name); }
+
+// all output files go here, if set
+void Simulation::set_output_dir(const std::string _dir) {
+  output_dir = _dir;
+  sf.set_prefix(out_path(""));
+}
+std::string Simulation::get_output_dir() const { return output_dir; }
+void Simulation::set_trace_file(const std::string _fn) {
+  trace_file = _fn;
+  prof.set_tracing(not _fn.empty());
+}
+std::string Simulation::get_trace_file() const { return trace_file; }
+bool Simulation::set_perf_counters(const bool _on) { return prof.set_counters(_on); }
+bool Simulation::using_perf_counters() const { return prof.is_counting(); }
+void Simulation::set_kernel_report(const bool _on) { kernel_report = _on; }
+bool Simulation::get_kernel_report() const { return kernel_report; }
+// asked for, or along with any other profiling
+bool Simulation::wants_kernel_report() const {
+  return kernel_report or prof.is_counting() or not trace_file.empty();
+}
+void Simulation::set_reproducible(const bool _on) { repro.set(_on); }
+bool Simulation::is_reproducible() const { return repro.get(); }
+void Simulation::claim_random_seeds() { Reproducible::set_current(&repro); }
+bool Simulation::set_thread_pinning(const std::string _mode) {
+  if (not Numa::set_pinning(_mode)) return false;
+  Numa::apply();
+  return true;
+}
+std::string Simulation::get_thread_pinning() const { return Numa::get_pinning(); }
+
+// memory budget
+void Simulation::set_memory_budget(const size_t _bytes) { memory_budget = _bytes; }
+bool Simulation::has_memory_budget() const { return (memory_budget > 0); }
+size_t Simulation::get_peak_memory() const { return mem.get_peak(); }
+size_t Simulation::get_memory_budget() const {
+  // if none was given, leave a fifth of the node for everything else
+  if (memory_budget > 0) return memory_budget;
+  return (MemoryTracker::get_physical_bytes() / 5) * 4;
+}
+
+std::string Simulation::out_path(const std::string _fn) const {
+  if (output_dir.empty()) return _fn;
+  return output_dir + "/" + _fn;
+}
+
+// time series settings
+void Simulation::set_series_file_name(const std::string _fn) { series_file = _fn; }
+std::string Simulation::get_series_file_name() const { return series_file; }
+void Simulation::set_series_compress(const bool _c) { series_compress = _c; }
+bool Simulation::get_series_compress() const { return series_compress; }
+void Simulation::set_png_output(const bool _do) { png_output = _do; }
+bool Simulation::using_png_output() const { return png_output; }
+void Simulation::set_grid_output(const nlohmann::json _j) { grid.from_json(_j); }
+nlohmann::json Simulation::get_grid_output() const { return grid.to_json(); }
+void Simulation::set_tracer_velocity(const nlohmann::json _j) { conv.set_tracer_velocity(_j); }
+nlohmann::json Simulation::get_tracer_velocity() const { return conv.get_tracer_velocity(); }
+bool Simulation::using_tracer_interp() const { return conv.interpolates_tracers(); }
+bool Simulation::using_grid_output() const { return grid.is_enabled(); }
+void Simulation::set_output_error(const ErrorBound _eb) { output_error = _eb; }
+ErrorBound Simulation::get_output_error() const { return output_error; }
+bool Simulation::using_series() const { return not series_file.empty(); }
+
+// checkpoint settings
+void Simulation::set_checkpoint_file_name(const std::string _fn) { checkpoint_file = _fn; }
+std::string Simulation::get_checkpoint_file_name() const { return checkpoint_file; }
+void Simulation::set_checkpoint_interval(const size_t _n) { checkpoint_steps = _n; }
+size_t Simulation::get_checkpoint_interval() const { return checkpoint_steps; }
+bool Simulation::is_checkpoint_step() const {
+  return (checkpoint_steps > 0 and nstep > 0 and nstep%checkpoint_steps == 0);
+}
+
 // status
 size_t Simulation::get_npanels() {
   size_t n = 0;
@@ -100,14 +236,22 @@ size_t Simulation::get_npanels() {
   return n;
 }
 
+// with the vortons spread over ranks, every rank must ask at once
 size_t Simulation::get_nparts() {
   size_t n = 0;
   for (auto &coll: vort) {
     std::visit([&n](auto& elem) { n += elem.get_n(); }, coll);
   }
+  if (vort_split) {
+    double total = (double)n;
+    Distributed::sum(&total, 1);
+    n = (size_t)total;
+  }
   return n;
 }
 
+// the tracer tasks still running from the last step move field points, but never add or
+//   remove any, so counting them need not wait for those tasks
 size_t Simulation::get_nfldpts() {
   size_t n = 0;
   for (auto &coll : fldpt) {
@@ -247,6 +391,7 @@ void Simulation::updateGL() {
   for (auto &coll : bdry) {
     std::visit([=](auto& elem) { elem.updateGL(); }, coll);
   }
+  conv.finish_tracers();
   for (auto &coll : fldpt) {
     std::visit([=](auto& elem) { elem.updateGL(); }, coll);
   }
@@ -282,17 +427,27 @@ void Simulation::reset() {
     stepfuture.get();
   }
 
+  // and for any pending output to finish, as it holds copies of the elements
+  writer.flush();
+  series.reset();
+  start_step = 0;
+
   // now reset everything else
   time = 0.0;
   nstep = 0;
+  conv.forget_tracer_history();
   vort.clear();
   bdry.clear();
   fldpt.clear();
   bem.reset();
+  output_bem_key.reset();
   sf.reset_sim();
+  prof.reset();
+  mem.reset();
   sim_is_initialized = false;
   step_has_started = false;
   step_is_finished = false;
+  vort_split = false;
 }
 
 void Simulation::clear_bodies() {
@@ -300,20 +455,41 @@ void Simulation::clear_bodies() {
 }
 
 // Write a set of vtu files for the particles and panels
-std::vector<std::string> Simulation::write_vtk(const int _index,
-                                               const bool _do_bdry,
-                                               const bool _do_flow,
-                                               const bool _do_measure) {
+void Simulation::update_output_vels(const bool _do_bdry,
+                                    const bool _do_flow,
+                                    const bool _do_measure) {
+
+  ScopedTimer timer("output_vels");
+
+  // the tracers may still be moving from the last step
+  conv.finish_tracers();
 
   // solve the BEM (before any VTK or status file output)
   //std::cout << "Updating element vels" << std::endl;
   std::array<double,2> thisfs = {fs[0], fs[1]};
   //clear_inner_layer<STORE>(1, bdry, vort, 1.0/std::sqrt(2.0*M_PI), get_ips());
-  solve_bem<STORE,ACCUM,Int>(time, thisfs, vort, bdry, bem);
+  solve_bem_for_output();
 
   if (_do_flow)    conv.find_vels(thisfs, vort, bdry, vort);
   if (_do_measure) conv.find_vels(thisfs, vort, bdry, fldpt);
   if (_do_bdry)    conv.find_vels(thisfs, vort, bdry, bdry);
+}
+
+// the status file, vtk or series, and grid output of one step all need the same solve
+void Simulation::solve_bem_for_output() {
+  const std::array<double,4> key = {(double)nstep, time, fs[0], fs[1]};
+  if (output_bem_key and *output_bem_key == key) return;
+  std::array<double,2> thisfs = {fs[0], fs[1]};
+  solve_bem<STORE,ACCUM,Int>(time, thisfs, vort, bdry, bem);
+  output_bem_key = key;
+}
+
+std::vector<std::string> Simulation::write_vtk(const int _index,
+                                               const bool _do_bdry,
+                                               const bool _do_flow,
+                                               const bool _do_measure) {
+
+  update_output_vels(_do_bdry, _do_flow, _do_measure);
 
   // may eventually want to avoid clobbering by maintaining an internal count of the
   //   number of simulations run from this execution of the GUI
@@ -327,14 +503,390 @@ std::vector<std::string> Simulation::write_vtk(const int _index,
     stepnum = (size_t)_index;
   }
 
-  // ask Vtk to write files for each collection
-  if (_do_flow)    write_vtk_files<float>(vort, stepnum, time, files);
-  if (_do_measure) write_vtk_files<float>(fldpt, stepnum, time, files);
-  if (_do_bdry)    write_vtk_files<float>(bdry, stepnum, time, files);
+  // the file names are known now, even though the files aren't written yet
+  const std::string pfx = out_path("");
+  if (_do_flow)    vtk_file_names<float>(vort, stepnum, files, pfx);
+  if (_do_measure) vtk_file_names<float>(fldpt, stepnum, files, pfx);
+  if (_do_bdry)    vtk_file_names<float>(bdry, stepnum, files, pfx);
+
+  // snapshot the collections, and let the writer thread encode and write them
+  //   while the simulation continues on to the next step
+  //   (with several ranks, the first one writes every rank's vortons)
+  std::vector<Collection> vsnap, fsnap, bsnap;
+  if (_do_flow)    vsnap = vort_split ? gather_particles<float>(vort) : vort;
+  if (_do_measure) fsnap = fldpt;
+  if (_do_bdry)    bsnap = bdry;
+
+  const size_t snapbytes = collection_bytes(vsnap) + collection_bytes(fsnap) + collection_bytes(bsnap);
+  writer.submit([vsnap=std::move(vsnap), fsnap=std::move(fsnap), bsnap=std::move(bsnap),
+                 stepnum, thistime=time, eb=output_error, pfx]() {
+    // ask Vtk to write files for each collection
+    std::vector<std::string> written;
+    write_vtk_files<float>(vsnap, stepnum, thistime, written, eb, pfx);
+    write_vtk_files<float>(fsnap, stepnum, thistime, written, eb, pfx);
+    write_vtk_files<float>(bsnap, stepnum, thistime, written, eb, pfx);
+  }, snapbytes);
 
   return files;
 }
 
+// Append all collections as one frame of the single-file time series
+void Simulation::write_series() {
+
+  assert(using_series() && "No time series file name set");
+  update_output_vels(true, true, true);
+
+  // the frame copies the arrays, so the simulation can carry on (with several ranks,
+  //   the first one writes every rank's vortons)
+  TimeSeriesFrame frame(nstep, time);
+  add_to_frame<float>(frame, vort_split ? gather_particles<float>(vort) : vort, "vort", output_error);
+  add_to_frame<float>(frame, bdry, "bdry", output_error);
+  add_to_frame<float>(frame, fldpt, "fldpt", output_error);
+
+  if (not series) series = std::make_shared<TimeSeriesWriter>(out_path(series_file), series_compress);
+
+  // the frame holds about as much as the element arrays
+  const size_t snapbytes = collection_bytes(vort) + collection_bytes(bdry) + collection_bytes(fldpt);
+  writer.submit([ts=series, frame=std::move(frame), restart=start_step]() {
+    // on the first frame, start a new file or continue from a restart
+    if (not ts->is_opened()) ts->open(restart);
+    ts->append(frame);
+    std::cout << "Wrote step " << frame.get_step() << " to " << ts->get_filename()
+              << " (" << ts->get_num_frames() << " frames, " << ts->get_bytes_written() << " bytes)" << std::endl;
+  }, snapbytes);
+}
+
+// Draw the particles and panels like the GUI would, but in software, so that batch
+//   runs can make movie frames; the png encoding happens in the background
+std::string Simulation::write_png(RenderParams const& _rparams) {
+
+  std::stringstream pngfn;
+  pngfn << out_path("img_") << std::setfill('0') << std::setw(5) << nstep << ".png";
+
+  // draw now, on the task pool, so the writer only has to encode the pixels
+  auto start = std::chrono::system_clock::now();
+  std::vector<uint8_t> rgb;
+  SoftwareRenderer sr(_rparams);
+  {
+    ScopedTimer timer("render");
+    conv.finish_tracers();
+    const float tracer_size = get_ips()*_rparams.tracer_scale;
+    sr.clear();
+    // with several ranks, the first one draws every rank's vortons
+    sr.draw(vort_split ? gather_particles<float>(vort) : vort, get_vdelta(), tracer_size);
+    sr.draw(bdry, get_vdelta(), tracer_size);
+    sr.draw(fldpt, get_vdelta(), tracer_size);
+    rgb = sr.get_rgb();
+  }
+  const size_t rgbbytes = rgb.size();
+
+  writer.submit([rgb=std::move(rgb), w=sr.get_width(), h=sr.get_height(), start, fn=pngfn.str()]() {
+    if (SoftwareRenderer::write_png(fn, rgb, w, h, MZ_BEST_SPEED)) {
+      std::chrono::duration<double> elapsed = std::chrono::system_clock::now() - start;
+      std::cout << "Wrote " << w << " x " << h << " image to " << fn
+                << " in " << elapsed.count() << " s" << std::endl;
+    } else {
+      std::cout << "Could not write image " << fn << std::endl;
+    }
+  }, rgbbytes);
+
+  return pngfn.str();
+}
+
+// Rasterize the vorticity onto the output grid, find velocity and streamfunction there,
+//   and write it all to a .vti file
+std::string Simulation::write_grid() {
+
+  assert(using_grid_output() && "Grid output is not enabled");
+
+  // boundary strengths must match the current particles, as they may for other output
+  std::array<double,2> thisfs = {fs[0], fs[1]};
+  solve_bem_for_output();
+
+  // with several ranks, the first one does this for every rank's vortons
+  if (vort_split) {
+    const std::vector<Collection> allvort = gather_particles<float>(vort);
+    if (Distributed::is_root()) grid.compute(allvort, bdry, thisfs);
+  } else {
+    grid.compute(vort, bdry, thisfs);
+  }
+
+  // the writer gets its own copies of the fields
+  writer.submit([stepnum=nstep, thistime=time, nx=grid.get_nx(), ny=grid.get_ny(),
+                 origin=grid.get_origin(), dx=grid.get_dx(),
+                 w=grid.get_vort(), u=grid.get_vel(), psi=grid.get_psi(), pfx=out_path("")]() {
+    (void) write_vti_grid<float>(stepnum, thistime, nx, ny, origin, dx, w, u, psi, pfx);
+  }, 4 * grid.get_nx() * grid.get_ny() * sizeof(float));
+
+  return vti_file_name(nstep, out_path(""));
+}
+
+// wait for all vtk and status output to reach the disk
+void Simulation::flush_output() {
+  writer.flush();
+}
+
+std::map<std::string,double> Simulation::get_phase_totals() const { return prof.get_totals(); }
+
+//
+// Velocities on every particle and field point from each available method, against a
+//   double-precision direct sum, to choose the cheapest method within an error budget
+//
+nlohmann::json Simulation::check_accuracy() {
+
+  // with several ranks, the first one checks every rank's vortons on its own
+  const size_t nparts = get_nparts();
+  std::vector<Collection> allvort;
+  if (vort_split) allvort = gather_particles<float>(vort);
+  if (not Distributed::is_root()) return nlohmann::json();
+  Distributed::Solo solo;
+  std::vector<Collection>& thisvort = vort_split ? allvort : vort;
+
+  // the check's own kernel calls would only muddle the run's profile
+  Profiler* const oldprof = Profiler::get_current();
+  Profiler::set_current(nullptr);
+
+  std::cout << std::endl << "Checking velocity accuracy at step " << nstep << std::endl;
+
+  // boundary strengths to match the current particles
+  std::array<double,2> thisfs = {fs[0], fs[1]};
+  solve_bem<STORE,ACCUM,Int>(time, thisfs, thisvort, bdry, bem);
+
+  // every method this binary has
+  std::vector<ExecEnv> envs;
+  for (const bool internal : {true, false}) {
+    for (const summation_t summ : {direct, barneshut, vic, fmm}) {
+      for (const accel_t accel : {cpu_x86, cpu_vc, gpu_opengl, gpu_cuda}) {
+        // the external solver ignores the rest, so try it only once
+        if (not internal and (summ != direct or accel != cpu_x86)) continue;
+        const ExecEnv env(internal, summ, accel);
+        std::string why;
+        if (env.is_available(why)) envs.push_back(env);
+      }
+    }
+  }
+
+  conv.finish_tracers();
+  std::vector<Collection> targets = thisvort;
+  targets.insert(targets.end(), fldpt.begin(), fldpt.end());
+
+  double ref_seconds = 0.0;
+  const std::vector<VelocityError> errs = check_velocity_accuracy<STORE>(thisfs, thisvort, bdry, targets, envs, ref_seconds);
+
+  Profiler::set_current(oldprof);
+
+  printf("  reference: double-precision direct sum in [%.4f] seconds\n", ref_seconds);
+  printf("  %-40s %10s %12s %12s %12s  %s\n", "method", "seconds", "rms error", "max error", "relative", "pareto");
+  nlohmann::json j;
+  j["step"] = nstep;
+  j["time"] = time;
+  j["particles"] = nparts;
+  j["panels"] = get_npanels();
+  j["fieldPoints"] = get_nfldpts();
+  j["referenceSeconds"] = ref_seconds;
+  j["methods"] = nlohmann::json::array();
+  for (auto const& e : errs) {
+    printf("  %-40s %10.4f %12.4e %12.4e %12.4e  %s\n", e.method.c_str(), e.seconds, e.rms, e.max, e.rel_rms,
+           e.pareto ? "*" : "");
+    j["methods"].push_back(e.to_json());
+  }
+  return j;
+}
+
+// timing table for the whole run, to the screen and the status file, and the trace if asked
+void Simulation::write_profile() {
+  writer.flush();
+
+  const std::string table = prof.summary();
+  if (table.empty()) return;
+  std::cout << std::endl << "Time spent in each phase:" << std::endl << table;
+  if (sf.is_active()) sf.write_comment(table);
+
+  // where the memory went
+  const std::string mtable = mem.report();
+  if (not mtable.empty()) {
+    std::cout << std::endl << mtable;
+    if (sf.is_active()) sf.write_comment(mtable);
+  }
+
+  // rates of the compute kernels against what this node can do
+  const std::string ktable = wants_kernel_report() ? prof.kernel_summary(Roofline::get()) : "";
+  if (not ktable.empty()) {
+    const std::string rl = "Roofline: " + Roofline::get().to_string() + "\n";
+    std::cout << std::endl << rl << ktable;
+    if (sf.is_active()) sf.write_comment(rl + ktable);
+  }
+
+  // and the hardware's view of each phase
+  const std::string ctable = prof.counter_summary();
+  if (not ctable.empty()) {
+    std::cout << std::endl << "Hardware counters per phase:" << std::endl << ctable;
+    if (sf.is_active()) sf.write_comment(ctable);
+  }
+
+  if (not trace_file.empty() and Distributed::is_root()) {
+    writer.flush();
+    if (prof.write_trace(out_path(trace_file))) {
+      std::cout << "Wrote trace to " << out_path(trace_file) << std::endl;
+    } else {
+      std::cout << "Could not write trace to " << out_path(trace_file) << std::endl;
+    }
+  }
+}
+
+// summary of the background writer: queue depth and latency
+std::string Simulation::output_report() {
+  if (series and series->get_num_frames() > 0) return writer.report() + "\n" + series->report();
+  return writer.report();
+}
+
+//
+// Write the full dynamic state to a binary checkpoint file
+//
+// This is everything that the setup json does not hold: the element arrays of every
+//   collection, the step counter and time, and the few scalars carried between steps.
+//   The BEM matrix is not saved, it is rebuilt on the first step after a restart.
+//
+void Simulation::write_checkpoint() {
+
+  // let the status file catch up, so it matches the checkpoint
+  writer.flush();
+
+  CheckpointWriter cw;
+  nlohmann::json& m = cw.get_meta();
+
+  m["program"] = "Omega2D";
+  m["description"] = description;
+  m["time"] = time;
+  m["nstep"] = nstep;
+  m["Re"] = re;
+  m["dt"] = dt;
+  m["Uinf"] = {fs[0], fs[1]};
+  m["lastForceTime"] = last_force_time;
+  m["lastImpulse"] = last_impulse;
+  m["randomSeedCounts"] = repro.get_counts();
+
+  // every collection in each of the three lists
+  auto save_list = [&](std::vector<Collection> const& _list, const std::string _name) {
+    nlohmann::json jlist = nlohmann::json::array();
+    for (size_t i=0; i<_list.size(); ++i) {
+      nlohmann::json jc;
+      jc["type"] = std::holds_alternative<Points<STORE>>(_list[i]) ? "points" : "surfaces";
+      const std::string pfx = _name + "." + std::to_string(i) + ".";
+      std::visit([&](auto const& elem) {
+        jc["elem"] = elem.get_elemt();
+        jc["move"] = elem.get_movet();
+        jc["body"] = elem.get_body_ptr() ? elem.get_body_ptr()->get_name() : "";
+        elem.write_checkpoint(cw, jc, pfx);
+      }, _list[i]);
+      jlist.push_back(jc);
+    }
+    m[_name] = jlist;
+  };
+  conv.finish_tracers();
+
+  // the first rank writes every rank's vortons, and the rest of the state is the same on all
+  std::vector<Collection> allvort;
+  if (vort_split) allvort = gather_particles<float>(vort);
+  if (not Distributed::is_root()) return;
+
+  conv.write_tracer_history(cw, m);
+  save_list(vort_split ? allvort : vort, "vort");
+  save_list(bdry, "bdry");
+  save_list(fldpt, "fldpt");
+
+  cw.write(out_path(checkpoint_file));
+  std::cout << "Wrote checkpoint at step " << nstep << " to " << out_path(checkpoint_file) << std::endl;
+}
+
+//
+// Restore the dynamic state from a checkpoint file
+//
+// The simulation must already be set up from the same json input (bodies, boundary
+//   features, parameters); this replaces the elements and advances the clock.
+//
+void Simulation::read_checkpoint(const std::string _fn) {
+
+  CheckpointReader cr(_fn);
+  nlohmann::json const& m = cr.get_meta();
+
+  if (m.value("program", "") != "Omega2D") {
+    throw std::runtime_error("File " + _fn + " is not an Omega2D checkpoint");
+  }
+  std::cout << "Reading version " << cr.get_version() << " checkpoint from " << _fn << std::endl;
+
+  // parameters come from the json input, but warn if they changed
+  const std::array<float,Dimensions> ckfs = m["Uinf"].get<std::array<float,Dimensions>>();
+  if (m["Re"].get<float>() != re or m["dt"].get<float>() != dt or ckfs[0] != fs[0] or ckfs[1] != fs[1]) {
+    std::cout << "  WARNING: Re, dt, or Uinf differ from the checkpoint, restart will not match" << std::endl;
+  }
+
+  time = m["time"].get<double>();
+  nstep = m["nstep"].get<size_t>();
+  last_force_time = m["lastForceTime"].get<double>();
+  last_impulse = m["lastImpulse"].get<std::array<float,Dimensions>>();
+  // so that random features go on with the draws they would have made
+  if (m.find("randomSeedCounts") != m.end()) {
+    repro.set_counts(m["randomSeedCounts"].get<std::map<std::string,uint32_t>>());
+  }
+
+  // find a body by name, quietly
+  auto find_body = [&](const std::string _name) {
+    std::shared_ptr<Body> bp;
+    for (auto &bptr : bodies) {
+      if (_name.compare(bptr->get_name()) == 0) bp = bptr;
+    }
+    return bp;
+  };
+
+  // read into collections that already exist, and make new ones for the rest
+  auto load_list = [&](std::vector<Collection>& _list, const std::string _name) {
+    nlohmann::json const& jlist = m[_name];
+    if (_list.size() > jlist.size()) _list.erase(_list.begin()+jlist.size(), _list.end());
+    for (size_t i=0; i<jlist.size(); ++i) {
+      nlohmann::json const& jc = jlist[i];
+      const std::string pfx = _name + "." + std::to_string(i) + ".";
+      const bool is_points = (jc["type"].get<std::string>() == "points");
+      const elem_t e = jc["elem"].get<elem_t>();
+      const move_t mv = jc["move"].get<move_t>();
+      std::shared_ptr<Body> bp = find_body(jc["body"].get<std::string>());
+
+      // does the one we have match?
+      const bool reuse = (i < _list.size() and
+                          is_points == std::holds_alternative<Points<STORE>>(_list[i]) and
+                          e == std::visit([=](auto& elem) { return elem.get_elemt(); }, _list[i]) and
+                          mv == std::visit([=](auto& elem) { return elem.get_movet(); }, _list[i]));
+      if (not reuse) {
+        Collection newc = is_points
+                          ? Collection(Points<STORE>(std::vector<STORE>(), e, mv, bp))
+                          : Collection(Surfaces<STORE>(std::vector<STORE>(), std::vector<Int>(),
+                                                       std::vector<STORE>(), e, mv, bp));
+        if (i < _list.size()) _list[i] = std::move(newc);
+        else _list.push_back(std::move(newc));
+      }
+
+      std::visit([&](auto& elem) { elem.read_checkpoint(cr, jc, pfx); }, _list[i]);
+      std::cout << "  restored" << to_string(_list[i]) << std::endl;
+    }
+  };
+  conv.read_tracer_history(cr, m);
+  load_list(vort, "vort");
+  load_list(bdry, "bdry");
+  load_list(fldpt, "fldpt");
+
+  // make sure the BEM rebuilds everything
+  bem.reset();
+  output_bem_key.reset();
+
+  // every rank read all of the vortons
+  vort_split = false;
+
+  // output that continues a previous run (like a time series) needs to know this
+  start_step = nstep;
+
+  std::cout << "Restarting at step " << nstep << " and time " << time << std::endl;
+}
+
 //
 // Check all aspects of the initialization for conditions that prevent a run from starting
 //
@@ -369,13 +921,85 @@ std::string Simulation::check_initialization() {
   }
 
   // Check for very large BEM problem
-  if (get_npanels() > 21000) {
-    retstr.append("Boundary features have too many panels, program will run out of memory. Reduce Reynolds number or increase time step or both.\n");
-  }
+  // will the BEM and everything else fit?
+  retstr.append(check_memory());
 
   return retstr;
 }
 
+//
+// Record the standing memory of every part, once per step
+//
+void Simulation::update_memory() {
+  for (size_t i=0; i<vort.size(); ++i) {
+    mem.set("vort[" + std::to_string(i) + "]", std::visit([](auto const& elem) { return elem.get_bytes(); }, vort[i]));
+  }
+  for (size_t i=0; i<bdry.size(); ++i) {
+    mem.set("bdry[" + std::to_string(i) + "]", std::visit([](auto const& elem) { return elem.get_bytes(); }, bdry[i]));
+  }
+  for (size_t i=0; i<fldpt.size(); ++i) {
+    mem.set("fldpt[" + std::to_string(i) + "]", std::visit([](auto const& elem) { return elem.get_bytes(); }, fldpt[i]));
+  }
+  mem.set("bem system", bem.get_bytes());
+  if (grid.is_enabled()) mem.set("grid output", grid.get_bytes());
+  mem.set("output snapshots", writer.get_queued_bytes(), writer.get_max_queued_bytes());
+  mem.end_step();
+}
+
+//
+// Estimate the memory this run will need before it starts, and cut back on the optional
+//   parts, or refuse, if that is more than the budget
+//
+// Element counts are those at initialization; the per-step check in check_simulation
+//   catches growth in the particle count later.
+//
+std::string Simulation::check_memory() {
+  const size_t budget = get_memory_budget();
+
+  size_t nrows = 0;
+  for (auto const& coll : bdry) nrows += std::visit([](auto const& elem) { return (size_t)elem.get_num_rows(); }, coll);
+
+  const size_t elems = collection_bytes(vort) + collection_bytes(bdry) + collection_bytes(fldpt);
+  const size_t bem_bytes = BEM<STORE,Int>::estimate_bytes(nrows);
+  // the second stage of RK2 copies the particles and field points
+  const size_t rk2 = collection_bytes(vort) + collection_bytes(fldpt);
+  // every queued output job can hold a full snapshot
+  const bool any_output = (output_dt > 0.0);
+  const size_t snapshot = any_output ? elems : 0;
+  size_t grid_bytes = grid.estimate_bytes();
+
+  auto total = [&]() { return elems + bem_bytes + rk2 + grid_bytes + writer.get_max_queue_size() * snapshot; };
+
+  std::cout << std::endl << "Memory estimate: elements " << to_mb(elems) << " MB, bem " << to_mb(bem_bytes)
+            << " MB (" << nrows << " rows), rk2 copies " << to_mb(rk2) << " MB, grid " << to_mb(grid_bytes)
+            << " MB, output " << writer.get_max_queue_size() << " x " << to_mb(snapshot) << " MB" << std::endl;
+  std::cout << "  total " << to_mb(total()) << " MB of a " << to_mb(budget) << " MB budget" << std::endl;
+
+  if (budget == 0 or total() <= budget) return "";
+
+  // first hold fewer output snapshots at once
+  if (writer.get_max_queue_size() > 1 and snapshot > 0) {
+    writer.set_max_queue_size(1);
+    std::cout << "  over budget, holding only one output snapshot at a time" << std::endl;
+  }
+  // then drop the gridded output
+  if (total() > budget and grid.is_enabled()) {
+    nlohmann::json g = grid.to_json();
+    g["enabled"] = false;
+    grid.from_json(g);
+    grid_bytes = 0;
+    std::cout << "  over budget, turning off grid output" << std::endl;
+  }
+  if (total() <= budget) return "";
+
+  // the rest can not be cut, so refuse to start
+  std::ostringstream msg;
+  msg << "Estimated memory of " << to_mb(total()) << " MB is more than the budget of " << to_mb(budget)
+      << " MB; the boundary system alone needs " << to_mb(bem_bytes) << " MB for " << nrows << " rows."
+      << " Reduce Reynolds number or increase time step or both, or raise the memory budget.\n";
+  return msg.str();
+}
+
 //
 // Check dynamic aspects of the simulation for conditions that should stop the run
 //
@@ -384,6 +1008,15 @@ std::string Simulation::check_simulation() {
 
   // Are there any dynamic problems in 2D that could blow a run?
 
+  // particles grow, so check the accounted memory against the budget every step
+  const size_t budget = get_memory_budget();
+  if (budget > 0 and mem.get_peak() > budget) {
+    std::ostringstream msg;
+    msg << "Memory use reached " << to_mb(mem.get_peak()) << " MB, more than the budget of "
+        << to_mb(budget) << " MB. Stopping before the system runs out.\n";
+    retstr.append(msg.str());
+  }
+
   return retstr;
 }
 
@@ -460,10 +1093,15 @@ void Simulation::async_first_step() {
 // initialize the system so we can start drawing things
 //
 void Simulation::first_step() {
+  Profiler::set_current(&prof);
+  MemoryTracker::set_current(&mem);
+  Reproducible::set_current(&repro);
+  ScopedTimer timer("step");
   std::cout << std::endl << "Taking step " << nstep << " at t=" << time << std::endl;
 
   // we wind up using this a lot
   std::array<double,2> thisfs = {fs[0], fs[1]};
+  output_bem_key.reset();
 
   // this is the first step, just solve BEM and return - it's time=0
 
@@ -471,7 +1109,11 @@ void Simulation::first_step() {
   conv.advect_1st(time, 0.0, thisfs, get_ips(), vort, bdry, fldpt, bem);
 
   // and write status file
+  update_memory();
   dump_stats_to_status();
+
+  (void) timer.stop();
+  std::cout << prof.last_root_summary() << std::endl;
 }
 
 //
@@ -490,10 +1132,23 @@ void Simulation::step() {
   // unsigned int current_word = 0;
   // _controlfp_s(&current_word, _EM_UNDERFLOW | _EM_OVERFLOW | _EM_INEXACT, _MCW_EM);
 
+  // steps may run on different threads, so (re)claim this one
+  Profiler::set_current(&prof);
+  MemoryTracker::set_current(&mem);
+  Reproducible::set_current(&repro);
+  ScopedTimer timer("step");
+
+  // with several ranks, each keeps only its own share of the vortons from here on
+  if (Distributed::is_on() and not vort_split) {
+    split_particles<float>(vort, true);
+    vort_split = true;
+  }
+
   std::cout << std::endl << "Taking step " << nstep << " at t=" << time << " with n=" << get_nparts() << std::endl;
 
   // we wind up using this a lot
   std::array<double,2> thisfs = {fs[0], fs[1]};
+  output_bem_key.reset();
 
   // for simplicity's sake, just run one full diffusion step here
   diff.step(time, dt, re, get_vdelta(), thisfs, vort, bdry, bem);
@@ -502,15 +1157,17 @@ void Simulation::step() {
   //diff.step(time, 0.5*dt, re, get_vdelta(), thisfs, vort, bdry, bem);
 
   // advect with no diffusion (must update BEM strengths)
+  //   this also pushes field points out of objects every few steps, and leaves the
+  //   tracers to finish moving while the step goes on
   //conv.advect_1st(time, dt, thisfs, get_ips(), vort, bdry, fldpt, bem);
-  conv.advect_2nd(time, dt, thisfs, get_ips(), vort, bdry, fldpt, bem);
+  conv.advect_2nd(time, dt, thisfs, get_ips(), vort, bdry, fldpt, bem, nstep%5 == 0);
+
+  // the vortons moved, so they may belong to other ranks now
+  if (vort_split) split_particles<float>(vort, false);
 
   // operator splitting requires another half-step diffuse (must compute new coefficients)
   //diff.step(time, 0.5*dt, re, get_vdelta(), thisfs, vort, bdry, bem);
 
-  // push field points out of objects every few steps
-  if (nstep%5 == 0) clear_inner_layer<STORE>(1, bdry, fldpt, (STORE)0.0, (STORE)(0.5*get_ips()));
-
   // update strengths for coloring purposes (eventually should be taken care of automatically)
   //vort.update_max_str();
 
@@ -520,8 +1177,21 @@ void Simulation::step() {
   // only increment step here!
   nstep++;
 
+  // the boundaries and tracers on every rank must still be the same
+  if (Distributed::is_on()) {
+    uint64_t hash = collection_hash(bdry, 14695981039346656037ull);
+    hash = collection_hash(fldpt, hash);
+    if (not Distributed::agree(hash)) {
+      Distributed::abort("ranks no longer agree after step " + std::to_string(nstep));
+    }
+  }
+
   // and write status file
+  update_memory();
   dump_stats_to_status();
+
+  (void) timer.stop();
+  std::cout << prof.last_root_summary() << std::endl;
 }
 
 //
@@ -529,29 +1199,30 @@ void Simulation::step() {
 //
 void Simulation::dump_stats_to_status() {
   if (sf.is_active()) {
+    ScopedTimer timer("status");
+
     // the basics
     sf.append_value((float)time);
     sf.append_value((int)get_nparts());
 
     // more advanced info
 
-    std::array<double,2> thisfs = {fs[0], fs[1]};
-
     // push away particles inside or too close to the body
     //clear_inner_layer<STORE>(1, bdry, vort, 1.0/std::sqrt(2.0*M_PI), get_ips());
     // solve the BEM (before any VTK or status file output)
-    solve_bem<STORE,ACCUM,Int>(time, thisfs, vort, bdry, bem);
+    solve_bem_for_output();
 
     // but do we really need to do these?
     //conv.find_vels(thisfs, vort, bdry, vort);
     //conv.find_vels(thisfs, vort, bdry, fldpt);
     //conv.find_vels(thisfs, vort, bdry, bdry);
 
-    // add up the total circulation
+    // add up the total circulation (of every rank's vortons)
     float tot_circ = 0.0;
     for (auto &src : vort) {
       tot_circ += std::visit([=](auto& elem) { return elem.get_total_circ(time); }, src);
     }
+    if (vort_split) Distributed::sum(&tot_circ, 1);
     // then add up the circulation in bodies
     for (auto &src : bdry) {
       tot_circ += std::visit([=](auto& elem) { return elem.get_total_circ(time); }, src);
@@ -563,6 +1234,10 @@ void Simulation::dump_stats_to_status() {
     std::array<float,Dimensions> impulse = calculate_simple_forces();
     for (size_t i=0; i<Dimensions; ++i) sf.append_value(impulse[i]);
 
+    // and memory, now and at the worst so far, in MB
+    sf.append_value((float)to_mb(mem.get_total()));
+    sf.append_value((float)to_mb(mem.get_peak()));
+
     // write here
     sf.write_line();
   }
@@ -572,21 +1247,20 @@ void Simulation::dump_stats_to_status() {
 std::array<float,Dimensions>
 Simulation::calculate_simple_forces() {
 
-  static double last_time = 0.0;
-  static std::array<float,Dimensions> last_impulse = {0.0};
   std::array<float,Dimensions> this_impulse = {0.0};
 
   // reset the "last" values if time is zero
   if (time < 0.1*dt) {
-    last_time = -dt;
+    last_force_time = -dt;
     last_impulse.fill(0.0);
   }
 
-  // calculate impulse from particles
+  // calculate impulse from particles (on every rank)
   for (auto &src : vort) {
     std::array<float,Dimensions> this_imp = std::visit([=](auto& elem) { return elem.get_total_impulse(); }, src);
     for (size_t i=0; i<Dimensions; ++i) this_impulse[i] += this_imp[i];
   }
+  if (vort_split) Distributed::sum(this_impulse.data(), Dimensions);
   // then add up the impulse from bodies - DO WE NEED TO RE-SOLVE BEM FIRST?
   for (auto &src : bdry) {
     std::array<float,Dimensions> this_imp = std::visit([=](auto& elem) { return elem.get_total_impulse(); }, src);
@@ -595,10 +1269,10 @@ Simulation::calculate_simple_forces() {
 
   // find the time derivative of the impulses
   std::array<float,Dimensions> forces;
-  for (size_t i=0; i<Dimensions; ++i) forces[i] = (this_impulse[i] - last_impulse[i]) / (time - last_time);
+  for (size_t i=0; i<Dimensions; ++i) forces[i] = (this_impulse[i] - last_impulse[i]) / (time - last_force_time);
 
   // save the last condition
-  last_time = time;
+  last_force_time = time;
   for (size_t i=0; i<Dimensions; ++i) last_impulse[i] = this_impulse[i];
 
   return forces;
@@ -613,6 +1287,9 @@ void Simulation::add_particles(std::vector<float> _invec) {
   // make sure we're getting full particles
   assert(_invec.size() % 4 == 0 && "Input vector not a multiple of 4");
 
+  // every rank made these, but each keeps only its own
+  if (vort_split) keep_own(_invec);
+
   // add the vdelta to each particle and pass it on
   const float thisvd = get_vdelta();
   for (size_t i=3; i<_invec.size(); i+=4) {
@@ -643,6 +1320,7 @@ void Simulation::add_fldpts(std::vector<float> _invec, const bool _moves) {
 
   // make sure we're getting full points
   assert(_invec.size() % Dimensions == 0 && "Input vector not a multiple of dimensions");
+  conv.finish_tracers();
 
   const move_t move_type = _moves ? lagrangian : fixed;
 
@@ -744,20 +1422,28 @@ void Simulation::add_boundary(std::shared_ptr<Body> _bptr, ElementPacket<float>
 // add elements (general)
 void Simulation::add_elements(const ElementPacket<float> _elems,
                               const elem_t _et, const move_t _mt,
-                              std::shared_ptr<Body> _bptr) {
+                              std::shared_ptr<Body> _bptr,
+                              const size_t _update_every) {
 
   // skip out early if nothing's here
   if (_elems.nelem == 0) return;
+  output_bem_key.reset();
 
   // now split on which Collection will receive this
   if (_et == active) {
+    // every rank made these, but each keeps only its own (and still files them, so
+    //   that all ranks have the same collections)
+    ElementPacket<float> mine = _elems;
+    if (vort_split) keep_own(mine);
+
     // it's active vorticity, add to vort
-    file_elements(vort, _elems, active, _mt, _bptr);
+    file_elements(vort, mine, active, _mt, _bptr);
     // in that routine, we will look for a match for move type, body pointer, and points/surfs/vols
   } else if (_et == reactive) {
     file_elements(bdry, _elems, reactive, _mt, _bptr);
   } else {
-    file_elements(fldpt, _elems, inert, _mt, _bptr);
+    conv.finish_tracers();
+    file_elements(fldpt, _elems, inert, _mt, _bptr, _update_every);
   }
 }
 
@@ -765,7 +1451,8 @@ void Simulation::add_elements(const ElementPacket<float> _elems,
 void Simulation::file_elements(std::vector<Collection>& _collvec,
                                const ElementPacket<float> _elems,
                                const elem_t _et, const move_t _mt,
-                               std::shared_ptr<Body> _bptr) {
+                               std::shared_ptr<Body> _bptr,
+                               const size_t _update_every) {
 
   // search the collections list for a match (same movement type, Body, elem dims)
   size_t imatch = 0;
@@ -789,6 +1476,10 @@ void Simulation::file_elements(std::vector<Collection>& _collvec,
     auto& coll = _collvec[i];
     if (std::holds_alternative<Points<float>>(coll) and _elems.ndim != 0) {
       this_match = false;
+    } else if (std::holds_alternative<Points<float>>(coll) and
+               std::get<Points<float>>(coll).get_update_every() != std::max((size_t)1, _update_every)) {
+      // tracers that coast for different numbers of steps stay apart
+      this_match = false;
     } else if (std::holds_alternative<Surfaces<float>>(coll) and _elems.ndim != 1) {
       this_match = false;
     }
@@ -804,6 +1495,7 @@ void Simulation::file_elements(std::vector<Collection>& _collvec,
     // make a new collection according to element dimension
     if (_elems.ndim == 0) {
       _collvec.push_back(Points<float>(_elems, _et, _mt, _bptr, get_vdelta()));
+      std::get<Points<float>>(_collvec.back()).set_update_every(_update_every);
     } else if (_elems.ndim == 1) {
       _collvec.push_back(Surfaces<float>(_elems, _et, _mt, _bptr));
     }
@@ -872,7 +1564,7 @@ std::shared_ptr<Body> Simulation::get_pointer_to_body(const std::string _name) {
 // check vs. step and time to see if simulation should pause/stop
 bool Simulation::test_vs_stop() {
   bool should_stop = false;
-  if (using_max_steps() and get_max_steps() == nstep) {
+  if (using_max_steps() and get_max_steps() <= nstep) {
     std::cout << "Stopping at step " << get_max_steps() << std::endl;
     should_stop = true;
   }
@@ -886,7 +1578,7 @@ bool Simulation::test_vs_stop() {
 // this is different because we have to trigger when last step is still running
 bool Simulation::test_vs_stop_async() {
   bool should_stop = false;
-  static bool already_reported = false;
+  bool& already_reported = stop_reported;
 
   if (using_max_steps() and get_max_steps() == nstep+1) {
     if (not already_reported) {
@@ -15,13 +15,18 @@
 #include "Diffusion.h"
 #include "ElementPacket.h"
 #include "StatusFile.h"
-
-#ifdef USE_GL
+#include "OutputWriter.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "Reproducible.h"
+#include "TimeSeries.h"
+#include "GridOutput.h"
 #include "RenderParams.h"
-#endif
 
 #include <string>
 #include <vector>
+#include <array>
+#include <optional>
 #include <future>
 #include <chrono>
 
@@ -82,11 +87,87 @@ public:
   void set_status_file_name(const std::string);
   std::string get_status_file_name();
 
+  // single-file time series output
+  void set_series_file_name(const std::string);
+  std::string get_series_file_name() const;
+  void set_series_compress(const bool);
+  bool get_series_compress() const;
+  bool using_series() const;
+
+  // directory for every output file (status, vtk, series, images, checkpoints), blank for here
+  void set_output_dir(const std::string);
+  std::string get_output_dir() const;
+  std::string out_path(const std::string) const;
+
+  // phase timings, optionally with a trace for chrome://tracing
+  void set_trace_file(const std::string);
+  std::string get_trace_file() const;
+  bool set_perf_counters(const bool);
+  bool using_perf_counters() const;
+  // kernel rates against the node's roofline, which takes a few seconds to measure
+  void set_kernel_report(const bool);
+  bool get_kernel_report() const;
+  bool wants_kernel_report() const;
+  void write_profile();
+  nlohmann::json check_accuracy();
+  std::map<std::string,double> get_phase_totals() const;
+
+  // same results for any thread count and on every run
+  void set_reproducible(const bool);
+  bool is_reproducible() const;
+  // random features called from this thread draw their seeds from this simulation
+  void claim_random_seeds();
+  // keep each thread on one cpu and its arrays on that socket: "none", "compact" or "spread"
+  bool set_thread_pinning(const std::string);
+  std::string get_thread_pinning() const;
+
+  // memory accounting, and the most this simulation may plan to use (0 for most of the node)
+  void set_memory_budget(const size_t);
+  size_t get_memory_budget() const;
+  bool has_memory_budget() const;
+  size_t get_peak_memory() const;
+  void update_memory();
+  std::string check_memory();
+
+  // images drawn without OpenGL
+  void set_png_output(const bool);
+  bool using_png_output() const;
+  std::string write_png(RenderParams const&);
+
+  // gridded vorticity, velocity, and streamfunction
+  void set_grid_output(const nlohmann::json);
+  nlohmann::json get_grid_output() const;
+  bool using_grid_output() const;
+  // tracers moving with velocities interpolated from the particles', see TracerInterp
+  void set_tracer_velocity(const nlohmann::json);
+  nlohmann::json get_tracer_velocity() const;
+  bool using_tracer_interp() const;
+  std::string write_grid();
+
+  // lossy output
+  void set_output_error(const ErrorBound);
+  ErrorBound get_output_error() const;
+
+  // checkpoint/restart
+  void set_checkpoint_file_name(const std::string);
+  std::string get_checkpoint_file_name() const;
+  void set_checkpoint_interval(const size_t);
+  size_t get_checkpoint_interval() const;
+  bool is_checkpoint_step() const;
+  void write_checkpoint();
+  void read_checkpoint(const std::string);
+
   // get runtime status
   size_t get_npanels();
   size_t get_nparts();
   size_t get_nfldpts();
 
+  // execution environment (convection and BEM) and diffusion method
+  ExecEnv get_exec_env() const;
+  void set_exec_env(ExecEnv const&);
+  std::string get_diffusion_method() const;
+  bool set_diffusion_method(const std::string);
+
   // inviscid case needs this
   void set_re_for_ips(float);
 
@@ -94,8 +175,11 @@ public:
   void add_particles(std::vector<float>);
   void add_fldpts(std::vector<float>, const bool);
   void add_boundary(std::shared_ptr<Body>, ElementPacket<float>);
-  void add_elements(const ElementPacket<float>, const elem_t, const move_t, std::shared_ptr<Body>);
-  void file_elements(std::vector<Collection>&, const ElementPacket<float>, const elem_t, const move_t, std::shared_ptr<Body>);
+  // tracers can ask for new velocities only every few steps
+  void add_elements(const ElementPacket<float>, const elem_t, const move_t, std::shared_ptr<Body>,
+                    const size_t _update_every = 1);
+  void file_elements(std::vector<Collection>&, const ElementPacket<float>, const elem_t, const move_t,
+                     std::shared_ptr<Body>, const size_t _update_every = 1);
 
   // access body list
   void add_body(std::shared_ptr<Body>);
@@ -133,6 +217,12 @@ public:
   bool test_vs_stop();
   bool test_vs_stop_async();
 
+  void write_series();
+
+  // background output
+  void flush_output();
+  std::string output_report();
+
   // read to and write from a json object
   void flow_from_json(const nlohmann::json);
   nlohmann::json flow_to_json() const;
@@ -150,6 +240,11 @@ public:
 #endif
 
 private:
+  // update velocities on everything before output
+  void update_output_vels(const bool, const bool, const bool);
+  // boundary strengths for the current particles, solved at most once per output step
+  void solve_bem_for_output();
+
   // primary simulation params
   float re;
   float dt;
@@ -172,6 +267,8 @@ private:
   // The need to solve for the unknown strengths of reactive elements inside both the
   //   diffusion and convection steps necessitates a BEM object here
   BEM<STORE,Int> bem;
+  // the step, time and freestream of the last solve for output, cleared when elements change
+  std::optional<std::array<double,4>> output_bem_key;
 
   // Diffusion will resolve exchange of strength among particles and between panels and particles
   // Note that NNLS needs doubles for its compute type or else it will fail
@@ -185,9 +282,51 @@ private:
   // Note that with Vc, the storage and accumulator classes have to be the same
   Convection<STORE,ACCUM,Int> conv;
 
+  // phase timers for this simulation, on the stepping and output threads
+  Profiler prof;
+  std::string trace_file;
+  bool kernel_report;
+
+  // bytes held by each part of this simulation
+  MemoryTracker mem;
+  size_t memory_budget;
+
+  // reproducible-run switch and the random seeds used so far
+  Reproducible repro;
+
+  // background thread for vtk and status file output, must be declared after the collections
+  //   so that it drains (and drops its snapshots) before they are destroyed
+  OutputWriter writer;
+
   // status file
   StatusFile sf;
 
+  // impulse at the last status file entry, for the force calculation
+  double last_force_time;
+  std::array<float,Dimensions> last_impulse;
+
+  // time series, only ever touched by the writer thread once created
+  std::string series_file;
+  bool series_compress;
+  std::shared_ptr<TimeSeriesWriter> series;
+
+  // software-rendered frames, written at output steps if enabled
+  bool png_output;
+
+  // where output files go, so that several simulations can run in one process
+  std::string output_dir;
+
+  // rasterized fields, written at output steps if enabled
+  GridOutput grid;
+
+  // error bound for vtk and time series output, off by default
+  ErrorBound output_error;
+  size_t start_step;			// first step of this run, after a reset or restart
+
+  // checkpoints
+  std::string checkpoint_file;
+  size_t checkpoint_steps;		// 0 means only write on demand
+
   // state
   std::string description;
   double time;
@@ -202,6 +341,8 @@ private:
   bool sim_is_initialized;
   bool step_has_started;
   bool step_is_finished;
+  bool stop_reported;		// so the async stop test only speaks once
+  bool vort_split;		// does each MPI rank hold only its own vortons
   std::future<void> stepfuture;  // this future needs to be listed after the big four: diff, conv, ...
 };
 
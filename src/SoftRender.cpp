@@ -0,0 +1,223 @@
+/*
+ * SoftRender.cpp - Draw particles and panels to an image without OpenGL
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "SoftRender.h"
+#include "Points.h"
+#include "Surfaces.h"
+#include "ThreadPool.h"
+#include "miniz.h"
+
+#ifdef _WIN32
+  #include <ciso646>
+#endif
+
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+
+SoftwareRenderer::SoftwareRenderer(RenderParams const& _rp)
+  : rp(_rp),
+    width(std::max(_rp.width, 1)),
+    height(std::max(_rp.height, 1)),
+    ppu(0.5f * width / _rp.vsize),
+    accum()
+  {}
+
+void
+SoftwareRenderer::clear() {
+  accum.assign(3*width*height, 0.0f);
+}
+
+//
+// call _fn(first, last) for bands of rows, a few per thread so uneven rows balance out
+//
+void
+SoftwareRenderer::for_row_bands(std::function<void(const int32_t, const int32_t)> const& _fn) const {
+  const int32_t nbands = std::min(height, 4 * (int32_t)ThreadPool::get().get_num_threads());
+  TaskGroup bands;
+  for (int32_t b=0; b<nbands; ++b) {
+    const int32_t j0 = (int32_t)(((int64_t)height * b) / nbands);
+    const int32_t j1 = (int32_t)(((int64_t)height * (b+1)) / nbands);
+    bands.run([&_fn, j0, j1]() { _fn(j0, j1); });
+  }
+  bands.wait();
+}
+
+//
+// same as the particle and point fragment shaders: a soft blob that reaches zero
+//   a bit inside the edge of its quad, and each fragment clamped to [0,1]
+//
+void
+SoftwareRenderer::draw_splats(std::vector<Splat>& _splats) {
+  if (_splats.empty()) return;
+
+  // sort by row, then each row finds the splats that reach it
+  std::sort(_splats.begin(), _splats.end(), [](Splat const& a, Splat const& b) { return a.cy < b.cy; });
+  std::vector<float> ys(_splats.size());
+  float maxrad = 0.0f;
+  for (size_t i=0; i<_splats.size(); ++i) {
+    ys[i] = _splats[i].cy;
+    maxrad = std::max(maxrad, _splats[i].rad);
+  }
+
+  for_row_bands([&](const int32_t _j0, const int32_t _j1) {
+    for (int32_t j=_j0; j<_j1; ++j) {
+      const float py = j + 0.5f;
+      float* row = accum.data() + 3*j*width;
+      auto first = std::lower_bound(ys.begin(), ys.end(), py - maxrad);
+      auto last = std::upper_bound(ys.begin(), ys.end(), py + maxrad);
+      for (auto it = first; it != last; ++it) {
+        Splat const& sp = _splats[it - ys.begin()];
+        const float ty = (py - sp.cy) / sp.rad;
+        if (std::abs(ty) >= 1.0f) continue;
+        const int32_t i0 = std::max(0, (int32_t)std::ceil(sp.cx - sp.rad - 0.5f));
+        const int32_t i1 = std::min(width-1, (int32_t)std::floor(sp.cx + sp.rad - 0.5f));
+        const float oor = 1.0f / sp.rad;
+        for (int32_t i=i0; i<=i1; ++i) {
+          const float tx = (i + 0.5f - sp.cx) * oor;
+          const float rs = tx*tx + ty*ty;
+          const float s = 1.0f/(1.0f+16.0f*rs*rs*rs) - 0.06f;
+          if (s <= 0.0f) continue;
+          for (int c=0; c<3; ++c) row[3*i+c] += std::min(1.0f, s * sp.color[c]);
+        }
+      }
+    }
+  });
+}
+
+//
+// a 2-pixel wide line, like glLineWidth(2.0)
+//
+void
+SoftwareRenderer::draw_segment(const float _x0, const float _y0, const float _x1, const float _y1,
+                               float const* _color) {
+  const float hw = 1.0f;
+  const int32_t i0 = std::max(0, (int32_t)std::floor(std::min(_x0, _x1) - hw));
+  const int32_t i1 = std::min(width-1, (int32_t)std::ceil(std::max(_x0, _x1) + hw));
+  const int32_t j0 = std::max(0, (int32_t)std::floor(std::min(_y0, _y1) - hw));
+  const int32_t j1 = std::min(height-1, (int32_t)std::ceil(std::max(_y0, _y1) + hw));
+  const float dx = _x1 - _x0;
+  const float dy = _y1 - _y0;
+  const float len2 = dx*dx + dy*dy;
+
+  for (int32_t j=j0; j<=j1; ++j) {
+    for (int32_t i=i0; i<=i1; ++i) {
+      const float px = i + 0.5f - _x0;
+      const float py = j + 0.5f - _y0;
+      const float t = (len2 > 0.0f) ? std::clamp((px*dx + py*dy) / len2, 0.0f, 1.0f) : 0.0f;
+      const float ex = px - t*dx;
+      const float ey = py - t*dy;
+      if (ex*ex + ey*ey > hw*hw) continue;
+      float* pix = accum.data() + 3*(j*width+i);
+      for (int c=0; c<3; ++c) pix[c] += _color[c];
+    }
+  }
+}
+
+//
+// draw everything in a list of collections
+//
+void
+SoftwareRenderer::draw(std::vector<Collection> const& _coll, const float _vdelta, const float _tracer_size) {
+
+  for (auto const& coll : _coll) {
+    if (std::holds_alternative<Points<float>>(coll)) {
+      Points<float> const& pts = std::get<Points<float>>(coll);
+      if (pts.get_n() == 0) continue;
+      const auto& x = pts.get_pos();
+      std::vector<Splat> splats;
+      splats.reserve(pts.get_n());
+
+      if (pts.is_inert()) {
+        // tracers are small dots of the default color
+        const float rad = 2.5f * _tracer_size * ppu;
+        for (size_t i=0; i<pts.get_n(); ++i) {
+          splats.push_back({to_px(x[0][i]), to_py(x[1][i]), rad,
+                            {rp.default_color[0], rp.default_color[1], rp.default_color[2]}});
+        }
+
+      } else {
+        // vortons are colored by sign, and brightness is circulation per area
+        const auto& r = pts.get_rad();
+        const auto& s = pts.get_str();
+        // the smoothed peak is -1 before its first update and 0 for new or unstrengthened
+        //   vortons, so fall back to this frame's peak, and never divide by zero
+        float peak = pts.get_max_strength();
+        if (not (peak > 0.0f)) {
+          peak = 0.0f;
+          for (size_t i=0; i<pts.get_n(); ++i) peak = std::max(peak, std::abs(s[i]));
+        }
+        peak = std::max(peak, std::numeric_limits<float>::min());
+        const float str_scale = rp.circ_density * std::pow(_vdelta/rp.vorton_scale, 2) / peak;
+        for (size_t i=0; i<pts.get_n(); ++i) {
+          float const* base = (s[i] >= 0.0f) ? rp.pos_circ_color : rp.neg_circ_color;
+          const float inten = str_scale * std::abs(s[i]) / (r[i]*r[i]);
+          splats.push_back({to_px(x[0][i]), to_py(x[1][i]), 2.5f * r[i] * rp.vorton_scale * ppu,
+                            {inten*base[0], inten*base[1], inten*base[2]}});
+        }
+      }
+
+      draw_splats(splats);
+
+    } else if (std::holds_alternative<Surfaces<float>>(coll)) {
+      Surfaces<float> const& surf = std::get<Surfaces<float>>(coll);
+      const auto& x = surf.get_pos();
+      const auto& idx = surf.get_idx();
+      for (size_t i=0; i<surf.get_npanels(); ++i) {
+        const size_t i0 = idx[2*i];
+        const size_t i1 = idx[2*i+1];
+        draw_segment(to_px(x[0][i0]), to_py(x[1][i0]), to_px(x[0][i1]), to_py(x[1][i1]), rp.default_color);
+      }
+    }
+  }
+}
+
+//
+// background plus everything drawn, saturated like an 8-bit framebuffer
+//
+std::vector<uint8_t>
+SoftwareRenderer::get_rgb() const {
+  std::vector<uint8_t> rgb(3*width*height);
+  for_row_bands([&](const int32_t _j0, const int32_t _j1) {
+    for (int32_t k=_j0*width; k<_j1*width; ++k) {
+      for (int c=0; c<3; ++c) {
+        const float v = std::clamp(rp.clear_color[c] + accum[3*k+c], 0.0f, 1.0f);
+        rgb[3*k+c] = (uint8_t)std::lround(255.0f * v);
+      }
+    }
+  });
+  return rgb;
+}
+
+bool
+SoftwareRenderer::write_png(const std::string _fn, const int _level) const {
+  return write_png(_fn, get_rgb(), width, height, _level);
+}
+
+bool
+SoftwareRenderer::write_png(const std::string _fn, std::vector<uint8_t> const& _rgb,
+                            const int _width, const int _height, const int _level) {
+  size_t png_data_size = 0;
+  void *pPNG_data = tdefl_write_image_to_png_file_in_memory_ex(_rgb.data(), _width, _height, 3,
+                                                               &png_data_size, _level, MZ_FALSE);
+  if (not pPNG_data) {
+    std::fprintf(stderr, "tdefl_write_image_to_png_file_in_memory_ex() failed!\n");
+    return false;
+  }
+
+  std::FILE *pFile = std::fopen(_fn.c_str(), "wb");
+  bool good = (pFile != nullptr);
+  if (good) {
+    good = (std::fwrite(pPNG_data, 1, png_data_size, pFile) == png_data_size);
+    std::fclose(pFile);
+  }
+  mz_free(pPNG_data);
+  return good;
+}
@@ -0,0 +1,67 @@
+/*
+ * SoftRender.h - Draw particles and panels to an image without OpenGL
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include "Omega2D.h"
+#include "Collection.h"
+#include "RenderParams.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+//
+// A software rasterizer that reproduces what the GUI draws: vortons as soft blobs
+//   colored by the sign of their circulation, tracers as small dots, and panels as
+//   2-pixel lines, all blended additively over the background color, so that batch
+//   runs on machines with no display can still make movie frames
+//
+// Bands of image rows are tasks on the task pool, and each row gathers from the elements
+//   that reach it, so no two tasks ever write to the same pixel.
+//
+class SoftwareRenderer {
+public:
+  explicit SoftwareRenderer(RenderParams const&);
+
+  // start a frame with the background color
+  void clear();
+
+  // blend in every collection; vdelta and the tracer size are as the GUI uses them
+  void draw(std::vector<Collection> const&, const float, const float);
+
+  // convert to 8-bit RGB (top row first) and save
+  std::vector<uint8_t> get_rgb() const;
+  bool write_png(const std::string, const int) const;
+  // encode and save pixels from get_rgb, which needs no renderer, so it can be done later
+  static bool write_png(const std::string, std::vector<uint8_t> const&, const int, const int, const int);
+
+  int get_width() const { return width; }
+  int get_height() const { return height; }
+
+private:
+  // one fuzzy quad: center and half-size in pixels, and color
+  struct Splat {
+    float cx, cy, rad;
+    float color[3];
+  };
+  void draw_splats(std::vector<Splat>&);
+  void for_row_bands(std::function<void(const int32_t, const int32_t)> const&) const;
+  void draw_segment(const float, const float, const float, const float, float const*);
+
+  RenderParams rp;
+  int width, height;
+  float ppu;		// pixels per world unit
+
+  // world to pixel coordinates
+  float to_px(const float _x) const { return (_x - rp.vcx) * ppu + 0.5f*width; }
+  float to_py(const float _y) const { return 0.5f*height - (_y - rp.vcy) * ppu; }
+
+  // additive color, 3 per pixel
+  std::vector<float> accum;
+};
@@ -13,6 +13,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <cassert>
 
 // are we even using the status file?
@@ -34,6 +35,11 @@ StatusFile::get_filename() {
   return fn;
 }
 
+void
+StatusFile::set_prefix(const std::string _pfx) {
+  prefix = _pfx;
+}
+
 // begin writing a new data set to the file
 void
 StatusFile::reset_sim() {
@@ -52,34 +58,75 @@ StatusFile::append_value(const int _val) {
   vals.push_back(_val);
 }
 
+// write free text, each line marked as a comment so plotting tools skip it
+void
+StatusFile::write_comment(const std::string _text) {
+  if (not use_it) return;
+  assert(not fn.empty() && "Filename is blank");
+
+  std::istringstream in(_text);
+  std::ostringstream outline;
+  std::string line;
+  while (std::getline(in, line)) outline << "# " << line << std::endl;
+
+  auto append = [thisfn=prefix+fn, text=outline.str()]() {
+    std::ofstream outfile;
+    outfile.open(thisfn, std::ios::app);
+    outfile << text;
+  };
+  if (writer) {
+    writer->submit(append);
+  } else {
+    append();
+  }
+}
+
+// hand file i/o to a background writer (or nullptr to write in this thread)
+void
+StatusFile::set_writer(OutputWriter* _w) {
+  writer = _w;
+}
+
 // write a line
 void
 StatusFile::write_line() {
   if (use_it) {
-    std::ofstream outfile;
     assert(not fn.empty() && "Filename is blank");
-    outfile.open(fn, std::ios::app);
+
+    // compose the text now, so the values can be cleared
+    std::ostringstream outline;
 
     // is this a new data set?
     if (num_lines == 0) {
-      if (num_sims > 0) outfile << std::endl;
-      outfile << "# new run" << std::endl;
+      if (num_sims > 0) outline << std::endl;
+      outline << "# new run" << std::endl;
       num_sims++;
     }
 
     // write data line
     for (auto &val : vals) {
-      std::visit([&outfile](const auto& v) { outfile << v; }, val);
+      std::visit([&outline](const auto& v) { outline << v; }, val);
       if (val == vals.back()) {
-        outfile << std::endl;
+        outline << std::endl;
       } else {
-        outfile << " ";
+        outline << " ";
       }
     }
     num_lines++;
+
+    // append it to the file, here or in the background
+    auto append = [thisfn=prefix+fn, text=outline.str()]() {
+      std::ofstream outfile;
+      outfile.open(thisfn, std::ios::app);
+      outfile << text;
+    };
+    if (writer) {
+      writer->submit(append);
+    } else {
+      append();
+    }
   }
 
   // empty the vector
   vals.clear();
 }
-
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include "OutputWriter.h"
+
 #include <variant>
 #include <string>
 #include <vector>
@@ -24,23 +26,30 @@ public:
     num_sims(0),
     num_lines(0),
     fn(""),
-    vals()
+    prefix(""),
+    vals(),
+    writer(nullptr)
   {}
 
   // functions
   bool is_active();
   void set_filename(const std::string);
   std::string get_filename();
+  void set_prefix(const std::string);
   void reset_sim();
   void append_value(const float);
   void append_value(const int);
   void write_line();
+  void write_comment(const std::string);
+  void set_writer(OutputWriter*);
 
   // member variables
   bool use_it;
   int num_sims;				// number of data sets in this file
   int num_lines;			// number of data lines in this set
   std::string fn;			// the status file name
+  std::string prefix;			// prepended to fn when writing, usually a directory
   std::vector<StatusValue> vals;	// values to write at each step
+  OutputWriter* writer;			// if set, do the file i/o on its thread
 };
 
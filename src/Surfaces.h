@@ -10,6 +10,7 @@
 #include "Omega2D.h"
 #include "VectorHelper.h"
 #include "ElementBase.h"
+#include "ThreadPool.h"
 
 #ifdef USE_GL
 #include "GlState.h"
@@ -88,7 +89,7 @@ public:
     assert(_x.size() % Dimensions == 0 && "Position array is not an even multiple of dimensions");
     const size_t nnodes = _x.size() / Dimensions;
 
-    std::cout << "  new collection with " << nsurfs << " panels and " << nnodes << " nodes" << std::endl;
+    TaskGroup::out() << "  new collection with " << nsurfs << " panels and " << nnodes << " nodes" << std::endl;
 
     // pull out the node locations, they go in the base class
     for (size_t d=0; d<Dimensions; ++d) {
@@ -163,13 +164,13 @@ public:
 
     // debug print
     if (false) {
-      std::cout << "Nodes" << std::endl;
+      TaskGroup::out() << "Nodes" << std::endl;
       for (size_t i=0; i<nnodes; ++i) {
-        std::cout << "  " << i << " " << this->x[0][i] << " " << this->x[1][i] << std::endl;
+        TaskGroup::out() << "  " << i << " " << this->x[0][i] << " " << this->x[1][i] << std::endl;
       }
-      std::cout << "Segments" << std::endl;
+      TaskGroup::out() << "Segments" << std::endl;
       for (size_t i=0; i<nsurfs; ++i) {
-        std::cout << "  " << i << " " << idx[2*i] << " " << idx[2*i+1] << std::endl;
+        TaskGroup::out() << "  " << i << " " << idx[2*i] << " " << idx[2*i+1] << std::endl;
       }
     }
 
@@ -233,9 +234,9 @@ public:
     // pop off the "unknown" rotation rate and save it
     if (is_augmented()) {
       solved_omega = _in.back();
-      std::cout << "    solved rotation rate is " << solved_omega << std::endl;
+      TaskGroup::out() << "    solved rotation rate is " << solved_omega << std::endl;
       omega_error = solved_omega - this->B->get_rotvel();
-      std::cout << "    error in rotation rate is " << omega_error << std::endl;
+      TaskGroup::out() << "    error in rotation rate is " << omega_error << std::endl;
       _in.pop_back();
     }
 
@@ -320,7 +321,7 @@ public:
     assert(_x.size() % Dimensions == 0 && "Position array is not an even multiple of dimensions");
     const size_t nnodes = _x.size() / Dimensions;
 
-    std::cout << "  adding " << nsurfs << " new surface panels and " << nnodes << " new points to collection..." << std::endl;
+    TaskGroup::out() << "  adding " << nsurfs << " new surface panels and " << nnodes << " new points to collection..." << std::endl;
 
     // DON'T call the method in the base class, because we do things differently here
     //ElementBase<S>::add_new(_in);
@@ -397,13 +398,13 @@ public:
 
     // debug print
     if (false) {
-      std::cout << "Nodes" << std::endl;
+      TaskGroup::out() << "Nodes" << std::endl;
       for (size_t i=0; i<nnold+nnodes; ++i) {
-        std::cout << "  " << i << " " << this->x[0][i] << " " << this->x[1][i] << std::endl;
+        TaskGroup::out() << "  " << i << " " << this->x[0][i] << " " << this->x[1][i] << std::endl;
       }
-      std::cout << "Segments" << std::endl;
+      TaskGroup::out() << "Segments" << std::endl;
       for (size_t i=0; i<neold+nsurfs; ++i) {
-        std::cout << "  " << i << " " << idx[2*i] << " " << idx[2*i+1] << std::endl;
+        TaskGroup::out() << "  " << i << " " << idx[2*i] << " " << idx[2*i+1] << std::endl;
       }
     }
 
@@ -558,7 +559,7 @@ public:
 
       // debug print
       if (std::abs(_rotvel) > 0.0 and false) {
-        std::cout << "  panel " << i << " at " << dx << " " << dy << " adds to vortex str "
+        TaskGroup::out() << "  panel " << i << " at " << dx << " " << dy << " adds to vortex str "
                   << new_vort << " and source str " << new_src << std::endl;
       }
     }
@@ -571,7 +572,7 @@ public:
     assert(this->B && "Body pointer has not been set");
     assert(this->ux && "Untransformed positions have not been set");
 
-    std::cout << "  inside Surfaces::set_geom_center with " << get_npanels() << " panels" << std::endl;
+    TaskGroup::out() << "  inside Surfaces::set_geom_center with " << get_npanels() << " panels" << std::endl;
 
     // iterate over panels, accumulating area and CM
     S asum = 0.0;
@@ -605,7 +606,7 @@ public:
     utc[0] = xsum/vol;
     utc[1] = ysum/vol;
 
-    std::cout << "    geom center is " << utc[0] << " " << utc[1] << " and area is " << vol << std::endl;
+    TaskGroup::out() << "    geom center is " << utc[0] << " " << utc[1] << " and area is " << vol << std::endl;
   }
 
   // need to maintain the 2x2 set of basis vectors for each panel
@@ -948,7 +949,7 @@ public:
               float*              _defcolor) {
 
     //std::cout << "inside Surfaces.initGL" << std::endl;
-    std::cout << "inside Surfaces.initGL with E=" << this->E << " and M=" << this->M << std::endl;
+    TaskGroup::out() << "inside Surfaces.initGL with E=" << this->E << " and M=" << this->M << std::endl;
 
     // generate the opengl state object with space for 4 vbos and 1 shader program
     mgl = std::make_shared<GlState>(4,1);
@@ -1096,6 +1097,79 @@ public:
   }
 #endif
 
+  // checkpoint every panel-wise array and the body-related scalars
+  void write_checkpoint(CheckpointWriter& _cw, nlohmann::json& _j, const std::string _pfx) const {
+    ElementBase<S>::write_checkpoint(_cw, _j, _pfx);
+    _j["np"] = np;
+    _cw.add(_pfx + "idx", idx);
+    _cw.add(_pfx + "area", area);
+    for (size_t i=0; i<Dimensions; ++i) {
+      const std::string is = std::to_string(i);
+      for (size_t d=0; d<Dimensions; ++d) _cw.add(_pfx + "b" + is + std::to_string(d), b[i][d]);
+      _cw.add(_pfx + "pu" + is, pu[i]);
+      if (ps[i]) _cw.add(_pfx + "ps" + is, *ps[i]);
+      if (bc[i]) _cw.add(_pfx + "bc" + is, *bc[i]);
+    }
+    _j["sourceIsUnknown"] = source_str_is_unknown;
+    _j["istart"] = istart;
+    _j["vol"] = vol;
+    _j["utc"] = utc;
+    _j["tc"] = tc;
+    _j["solvedOmega"] = solved_omega;
+    _j["omegaError"] = omega_error;
+    _j["thisOmega"] = this_omega;
+    _j["reabsorbedGamma"] = reabsorbed_gamma;
+  }
+
+  void read_checkpoint(CheckpointReader const& _cr, nlohmann::json const& _j, const std::string _pfx) {
+    ElementBase<S>::read_checkpoint(_cr, _j, _pfx);
+    np = _j["np"].get<size_t>();
+    _cr.get(_pfx + "idx", idx);
+    _cr.get(_pfx + "area", area);
+    assert(idx.size() == 2*np && "Checkpoint panel index array has wrong size");
+    for (size_t i=0; i<Dimensions; ++i) {
+      const std::string is = std::to_string(i);
+      for (size_t d=0; d<Dimensions; ++d) _cr.get(_pfx + "b" + is + std::to_string(d), b[i][d]);
+      _cr.get(_pfx + "pu" + is, pu[i]);
+      if (_cr.has(_pfx + "ps" + is)) {
+        Vector<S> newps;
+        _cr.get(_pfx + "ps" + is, newps);
+        ps[i] = std::move(newps);
+      } else {
+        ps[i].reset();
+      }
+      if (_cr.has(_pfx + "bc" + is)) {
+        Vector<S> newbc;
+        _cr.get(_pfx + "bc" + is, newbc);
+        bc[i] = std::move(newbc);
+      } else {
+        bc[i].reset();
+      }
+    }
+    source_str_is_unknown = _j["sourceIsUnknown"].get<bool>();
+    istart = _j["istart"].get<Int>();
+    vol = _j["vol"].get<S>();
+    utc = _j["utc"].get<std::array<S,Dimensions>>();
+    tc = _j["tc"].get<std::array<S,Dimensions>>();
+    solved_omega = _j["solvedOmega"].get<double>();
+    omega_error = _j["omegaError"].get<double>();
+    this_omega = _j["thisOmega"].get<double>();
+    reabsorbed_gamma = _j["reabsorbedGamma"].get<S>();
+  }
+
+  size_t get_bytes() const {
+    size_t bytes = ElementBase<S>::get_bytes() + idx.capacity() * sizeof(Int) + area.capacity() * sizeof(S);
+    for (size_t i=0; i<Dimensions; ++i) {
+      for (size_t d=0; d<Dimensions; ++d) bytes += b[i][d].capacity() * sizeof(S);
+      bytes += pu[i].capacity() * sizeof(S);
+    }
+    for (size_t i=0; i<2; ++i) {
+      if (ps[i]) bytes += ps[i]->capacity() * sizeof(S);
+      if (bc[i]) bytes += bc[i]->capacity() * sizeof(S);
+    }
+    return bytes;
+  }
+
   std::string to_string() const {
     std::string retstr = " " + std::to_string(get_npanels()) + ElementBase<S>::to_string() + " Panels";
     return retstr;
@@ -0,0 +1,286 @@
+/*
+ * ThreadPool.cpp - A work-stealing pool of threads, and groups of tasks to run on it
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "ThreadPool.h"
+#include "Numa.h"
+
+#ifdef _WIN32
+  #include <ciso646>
+#endif
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+
+// which worker of which pool the calling thread is, if any
+static thread_local ThreadPool const* my_pool = nullptr;
+static thread_local size_t my_index = 0;
+
+// where the task running on this thread prints, or nullptr outside of tasks
+static thread_local std::ostream* task_text = nullptr;
+
+ThreadPool&
+ThreadPool::get() {
+  static ThreadPool pool;
+  return pool;
+}
+
+ThreadPool::ThreadPool()
+  : layout(),
+    queues(),
+    workers(),
+    nthreads(0),
+    sleep_mtx(),
+    wake(),
+    pending(0),
+    stopping(false)
+  {
+  start(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+ThreadPool::~ThreadPool() {
+  std::unique_lock<std::shared_mutex> lock(layout);
+  stop();
+}
+
+void
+ThreadPool::set_num_threads(const size_t _n) {
+  const size_t n = std::max((size_t)1, _n);
+
+  std::unique_lock<std::shared_mutex> lock(layout);
+  if (n == nthreads) return;
+
+  // keep whatever is queued, and give it to the new workers
+  stop();
+  std::deque<Task> saved;
+  for (auto& q : queues) {
+    std::move(q->tasks.begin(), q->tasks.end(), std::back_inserter(saved));
+  }
+  start(n);
+  queues.back()->tasks = std::move(saved);
+}
+
+// make the queues and workers, call with the layout held uniquely
+void
+ThreadPool::start(const size_t _n) {
+  nthreads = _n;
+  queues.clear();
+  for (size_t i=0; i<_n; ++i) queues.push_back(std::make_unique<Queue>());
+  {
+    std::lock_guard<std::mutex> lock(sleep_mtx);
+    stopping = false;
+  }
+  // the last queue is the shared one, so there are _n-1 workers
+  for (size_t i=0; i+1<_n; ++i) workers.emplace_back(&ThreadPool::work, this, i);
+}
+
+// join the workers, call with the layout held uniquely; queued tasks stay queued
+void
+ThreadPool::stop() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mtx);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto& w : workers) w.join();
+  workers.clear();
+}
+
+void
+ThreadPool::push(Task _task) {
+  // count it first, so a fast taker never counts below zero
+  {
+    std::lock_guard<std::mutex> lock(sleep_mtx);
+    pending++;
+  }
+  {
+    std::shared_lock<std::shared_mutex> lock(layout);
+    Queue& q = (my_pool == this) ? *queues[my_index] : *queues.back();
+    std::lock_guard<std::mutex> qlock(q.mtx);
+    q.tasks.push_back(std::move(_task));
+  }
+  wake.notify_one();
+}
+
+// take a task for the thread that owns queue _me: its own newest, else anyone's oldest
+bool
+ThreadPool::pop(const size_t _me, Task& _task) {
+  const size_t nq = queues.size();
+  for (size_t k=0; k<nq; ++k) {
+    const size_t i = (_me + k) % nq;
+    Queue& q = *queues[i];
+    std::lock_guard<std::mutex> qlock(q.mtx);
+    if (q.tasks.empty()) continue;
+    if (k == 0) {
+      _task = std::move(q.tasks.back());
+      q.tasks.pop_back();
+    } else {
+      _task = std::move(q.tasks.front());
+      q.tasks.pop_front();
+    }
+    std::lock_guard<std::mutex> lock(sleep_mtx);
+    pending--;
+    return true;
+  }
+  return false;
+}
+
+bool
+ThreadPool::run_one() {
+  Task task;
+  {
+    std::shared_lock<std::shared_mutex> lock(layout);
+    const size_t me = (my_pool == this) ? my_index : queues.size()-1;
+    if (not pop(me, task)) return false;
+  }
+  task();
+  return true;
+}
+
+void
+ThreadPool::work(const size_t _index) {
+  my_pool = this;
+  my_index = _index;
+  size_t pinned = 0;
+
+  while (true) {
+    // follow any change of pinning before taking more work
+    if (pinned != Numa::generation()) {
+      pinned = Numa::generation();
+      Numa::pin_pool_thread(_index);
+    }
+
+    Task task;
+    bool got = false;
+    {
+      std::shared_lock<std::shared_mutex> lock(layout, std::try_to_lock);
+      // a resize holds the layout while it joins us, so look at the flag instead
+      if (lock.owns_lock()) got = pop(_index, task);
+    }
+    if (got) {
+      task();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleep_mtx);
+    wake.wait(lock, [this]{ return stopping or pending > 0; });
+    if (stopping) break;
+  }
+
+  my_pool = nullptr;
+}
+
+
+//
+// groups of tasks
+//
+
+TaskGroup::~TaskGroup() {
+  // a task may still refer to the group, so never leave before they finish
+  try { wait(); } catch (...) {}
+}
+
+void
+TaskGroup::run(ThreadPool::Task _task) {
+
+  // with no other threads, just do it now
+  if (pool.get_num_threads() < 2) {
+    try { _task(); }
+    catch (...) {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (not error) error = std::current_exception();
+    }
+    return;
+  }
+
+  // where and with what the task should think it runs
+  const Profiler::Context ctx = Profiler::get_context();
+  MemoryTracker* mem = MemoryTracker::get_current();
+  Reproducible* repro = Reproducible::get_current();
+#ifdef _OPENMP
+  // tasks share this thread's OpenMP threads among the pool's
+  const int share = std::max(1, omp_get_max_threads() / (int)pool.get_num_threads());
+#endif
+
+  // a place for what it prints, kept in the order the tasks were made
+  std::ostream* text = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    texts.emplace_back();
+    text = &texts.back();
+  }
+
+  remaining++;
+  pool.push([=, task=std::move(_task)]() {
+    const Profiler::Context prev_ctx = Profiler::set_context(ctx);
+    MemoryTracker* prev_mem = MemoryTracker::get_current();
+    MemoryTracker::set_current(mem);
+    Reproducible* prev_repro = Reproducible::get_current();
+    Reproducible::set_current(repro);
+    std::ostream* prev_text = task_text;
+    task_text = text;
+#ifdef _OPENMP
+    const int prev_share = omp_get_max_threads();
+    omp_set_num_threads(share);
+#endif
+
+    std::exception_ptr err;
+    try { task(); }
+    catch (...) { err = std::current_exception(); }
+
+#ifdef _OPENMP
+    omp_set_num_threads(prev_share);
+#endif
+    task_text = prev_text;
+    Reproducible::set_current(prev_repro);
+    MemoryTracker::set_current(prev_mem);
+    (void) Profiler::set_context(prev_ctx);
+    finish(err);
+  });
+}
+
+void
+TaskGroup::finish(std::exception_ptr _err) {
+  std::lock_guard<std::mutex> lock(mtx);
+  if (_err and not error) error = _err;
+  if (--remaining == 0) done.notify_all();
+}
+
+void
+TaskGroup::wait() {
+  // help with anything queued, ours or not, then sleep until ours are done
+  while (remaining > 0) {
+    if (pool.run_one()) continue;
+    std::unique_lock<std::mutex> lock(mtx);
+    done.wait_for(lock, std::chrono::microseconds(200), [this]{ return remaining == 0; });
+  }
+
+  std::exception_ptr err;
+  std::deque<std::ostringstream> printed;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::swap(err, error);
+    std::swap(printed, texts);
+  }
+
+  // this thread prints what the tasks did, which nests it in its own task's, if any
+  std::ostream& dest = out();
+  for (auto const& text : printed) dest << text.str();
+  if (not printed.empty()) dest << std::flush;
+
+  if (err) std::rethrow_exception(err);
+}
+
+std::ostream&
+TaskGroup::out() {
+  return task_text ? *task_text : std::cout;
+}
@@ -0,0 +1,120 @@
+/*
+ * ThreadPool.h - A work-stealing pool of threads, and groups of tasks to run on it
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "Reproducible.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+//
+// One pool of threads for the whole process, for coarse tasks like a collection pair
+//
+// Each worker keeps its own deque of tasks: it takes the newest from its own, and when
+//   that is empty it steals the oldest from the others. Tasks pushed from threads outside
+//   the pool go to a shared deque that anyone can take from. Threads waiting on a
+//   TaskGroup run tasks too, so a task may itself make and wait on a group.
+//
+// This works with or without OpenMP. The number of threads counts the one that waits,
+//   so a pool of 1 has no workers, and every task runs right where it was made.
+//
+class ThreadPool {
+public:
+  using Task = std::function<void()>;
+
+  // the pool, started on first use with one thread per core
+  static ThreadPool& get();
+
+  ~ThreadPool();
+  ThreadPool(ThreadPool const&) = delete;
+  ThreadPool& operator=(ThreadPool const&) = delete;
+
+  // total threads, including the caller; this joins the workers, so call it only while
+  //   no tasks run (once, before any simulation exists)
+  void set_num_threads(const size_t);
+  size_t get_num_threads() const { return nthreads; }
+
+  // queue a task, to the calling worker's own deque if it is one
+  void push(Task);
+
+  // run one queued task on the calling thread, false if there were none
+  bool run_one();
+
+private:
+  ThreadPool();
+
+  struct Queue {
+    std::mutex mtx;
+    std::deque<Task> tasks;
+  };
+
+  void start(const size_t);
+  void stop();
+  void work(const size_t);
+  bool pop(const size_t, Task&);
+
+  // guards the layout of queues and workers: shared to use them, unique to change them
+  mutable std::shared_mutex layout;
+  std::vector<std::unique_ptr<Queue>> queues;	// one per worker, then the shared one
+  std::vector<std::thread> workers;
+  std::atomic<size_t> nthreads;
+
+  std::mutex sleep_mtx;
+  std::condition_variable wake;
+  size_t pending;				// queued and not yet taken, under sleep_mtx
+  bool stopping;
+};
+
+
+//
+// Tasks that belong together, and a wait for all of them
+//
+// Every task runs with the profiler, memory tracker, reproducible-run settings, and
+//   OpenMP share of the thread that gave it, so its timers nest under the phase it was
+//   made in. What a task prints to out() is kept, and wait() prints it all, in the order
+//   the tasks were made, from the waiting thread. The first exception thrown by any task
+//   is thrown again from wait().
+//
+class TaskGroup {
+public:
+  explicit TaskGroup(ThreadPool& _pool = ThreadPool::get()) : pool(_pool) {}
+  ~TaskGroup();
+  TaskGroup(TaskGroup const&) = delete;
+  TaskGroup& operator=(TaskGroup const&) = delete;
+
+  void run(ThreadPool::Task);
+  void wait();
+
+  // where code that may run in a task prints: the task's own text, or std::cout outside
+  static std::ostream& out();
+
+private:
+  void finish(std::exception_ptr);
+
+  ThreadPool& pool;
+  std::atomic<size_t> remaining{0};
+  std::mutex mtx;
+  std::condition_variable done;
+  std::exception_ptr error;
+  std::deque<std::ostringstream> texts;	// what each task printed, under mtx
+};
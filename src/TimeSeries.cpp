@@ -0,0 +1,428 @@
+/*
+ * TimeSeries.cpp - Append-only single-file container for many output steps
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "TimeSeries.h"
+#include "miniz.h"
+
+#ifdef _WIN32
+  #include <ciso646>
+#endif
+
+#include <cstdio>
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+static const char series_magic[8] = {'O','2','D','S','E','R','I','S'};
+static const char frame_magic[8]  = {'O','2','D','F','R','A','M','E'};
+static const char index_magic[8]  = {'O','2','D','I','N','D','E','X'};
+static const uint32_t series_endian = 0x01020304;
+static const size_t series_header_size = 32;
+static const size_t frame_header_size = 40;
+
+// arrays smaller than this are never worth compressing
+static const size_t min_compress_bytes = 1024;
+
+
+//
+// Turn a frame into its on-disk form: header, json, then the (possibly compressed) arrays
+//
+std::vector<char>
+TimeSeriesFrame::encode(const bool _compress, const int _level, ArraySizes* _sizes) const {
+
+  // make a flat list of all arrays, so that they can be compressed in parallel
+  struct Work {
+    size_t ic;
+    std::string const* name;
+    std::vector<char> const* raw;
+    std::vector<char> stored;
+    bool compressed;
+    double bound;
+    bool delta;
+    bool quantized;
+  };
+  std::vector<Work> work;
+  for (size_t ic=0; ic<data.size(); ++ic) {
+    nlohmann::json const& arrays = meta["collections"][ic]["arrays"];
+    for (auto const& nb : data[ic]) {
+      nlohmann::json const& a = arrays[nb.first];
+      const double bound = (a.count("bound") > 0) ? a["bound"].get<double>() : 0.0;
+      const bool delta = (a.count("delta") > 0) ? a["delta"].get<bool>() : false;
+      work.push_back({ic, &nb.first, &nb.second, std::vector<char>(), false, bound, delta, false});
+    }
+  }
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int i=0; i<(int)work.size(); ++i) {
+    Work& w = work[i];
+    if (w.bound > 0.0) {
+      // lossy arrays are entropy-coded either way, and fall back to the lossless path
+      //   if the bound can not be met
+      w.stored = quantize_encode((const float*)w.raw->data(), w.raw->size()/sizeof(float),
+                                 w.bound, w.delta, _level);
+      if (not w.stored.empty() and w.stored.size() < w.raw->size()) {
+        w.quantized = true;
+        continue;
+      }
+    }
+    if (_compress and w.raw->size() >= min_compress_bytes) {
+      mz_ulong csize = mz_compressBound(w.raw->size());
+      w.stored.resize(csize);
+      const int status = mz_compress2((unsigned char*)w.stored.data(), &csize,
+                                      (const unsigned char*)w.raw->data(), w.raw->size(), _level);
+      // keep it only if it helped
+      if (status == MZ_OK and csize < w.raw->size()) {
+        w.stored.resize(csize);
+        w.compressed = true;
+      }
+    }
+  }
+
+  // now we know all sizes, so complete the json
+  nlohmann::json jout = meta;
+  uint64_t data_size = 0;
+  for (auto const& w : work) {
+    nlohmann::json& a = jout["collections"][w.ic]["arrays"][*w.name];
+    const size_t ssize = (w.compressed or w.quantized) ? w.stored.size() : w.raw->size();
+    a["offset"] = data_size;
+    a["stored"] = ssize;
+    a["compressed"] = w.compressed;
+    if (w.quantized) a["codec"] = "quantized";
+    data_size += ssize;
+    if (_sizes) {
+      auto& entry = (*_sizes)[jout["collections"][w.ic]["list"].get<std::string>() + "." + *w.name];
+      entry.first += w.raw->size();
+      entry.second += ssize;
+    }
+  }
+  const std::string json_str = jout.dump();
+  const uint64_t json_size = json_str.size();
+
+  // and assemble
+  std::vector<char> out(frame_header_size + json_size + data_size);
+  char* ptr = out.data();
+  const uint64_t ustep = step;
+  std::memcpy(ptr, frame_magic, 8);
+  std::memcpy(ptr+8, &ustep, 8);
+  std::memcpy(ptr+16, &time, 8);
+  std::memcpy(ptr+24, &json_size, 8);
+  std::memcpy(ptr+32, &data_size, 8);
+  ptr += frame_header_size;
+  std::memcpy(ptr, json_str.data(), json_size);
+  ptr += json_size;
+  for (auto const& w : work) {
+    std::vector<char> const& src = (w.compressed or w.quantized) ? w.stored : *w.raw;
+    if (not src.empty()) std::memcpy(ptr, src.data(), src.size());
+    ptr += src.size();
+  }
+
+  return out;
+}
+
+//
+// And back again
+//
+TimeSeriesFrame
+TimeSeriesFrame::decode(const char* _buf, const size_t _len) {
+
+  if (_len < frame_header_size or std::memcmp(_buf, frame_magic, 8) != 0) {
+    throw std::runtime_error("Bad frame header in time series");
+  }
+  uint64_t ustep, json_size, data_size;
+  double ftime;
+  std::memcpy(&ustep, _buf+8, 8);
+  std::memcpy(&ftime, _buf+16, 8);
+  std::memcpy(&json_size, _buf+24, 8);
+  std::memcpy(&data_size, _buf+32, 8);
+  if (frame_header_size + json_size + data_size > _len) throw std::runtime_error("Truncated frame in time series");
+
+  TimeSeriesFrame frame(ustep, ftime);
+  frame.meta = nlohmann::json::parse(_buf+frame_header_size, _buf+frame_header_size+json_size);
+  const char* dptr = _buf + frame_header_size + json_size;
+
+  // make space for and list all arrays
+  struct Work {
+    nlohmann::json const* a;
+    std::vector<char>* out;
+  };
+  std::vector<Work> work;
+  const size_t ncoll = frame.meta["collections"].size();
+  frame.data.resize(ncoll);
+  for (size_t ic=0; ic<ncoll; ++ic) {
+    nlohmann::json const& arrays = frame.meta["collections"][ic]["arrays"];
+    frame.data[ic].reserve(arrays.size());
+    for (auto it = arrays.begin(); it != arrays.end(); ++it) {
+      frame.data[ic].emplace_back(it.key(), std::vector<char>());
+    }
+    size_t ia = 0;
+    for (auto it = arrays.begin(); it != arrays.end(); ++it) {
+      work.push_back({&it.value(), &frame.data[ic][ia++].second});
+    }
+  }
+
+  int nbad = 0;
+  #pragma omp parallel for schedule(dynamic) reduction(+:nbad)
+  for (int i=0; i<(int)work.size(); ++i) {
+    nlohmann::json const& a = *work[i].a;
+    const std::string type = a["type"].get<std::string>();
+    const size_t esize = (type == "Float64") ? 8 : (type == "UInt8") ? 1 : (type == "UInt16") ? 2 : 4;
+    const size_t nbytes = a["count"].get<size_t>() * esize;
+    const size_t off = a["offset"].get<size_t>();
+    const size_t ssize = a["stored"].get<size_t>();
+    if (off + ssize > data_size) { nbad++; continue; }
+
+    std::vector<char>& out = *work[i].out;
+    out.resize(nbytes);
+    if (a.count("codec") > 0 and a["codec"].get<std::string>() == "quantized") {
+      if (type != "Float32" or
+          not quantize_decode(dptr+off, ssize, (float*)out.data(), nbytes/sizeof(float))) nbad++;
+    } else if (a["compressed"].get<bool>()) {
+      mz_ulong usize = nbytes;
+      const int status = mz_uncompress((unsigned char*)out.data(), &usize,
+                                       (const unsigned char*)(dptr+off), ssize);
+      if (status != MZ_OK or usize != nbytes) nbad++;
+    } else {
+      if (ssize != nbytes) nbad++;
+      else if (nbytes > 0) std::memcpy(out.data(), dptr+off, nbytes);
+    }
+  }
+  if (nbad > 0) throw std::runtime_error("Corrupt arrays in time series frame at step " + std::to_string(ustep));
+
+  return frame;
+}
+
+
+//
+// Writer
+//
+TimeSeriesWriter::TimeSeriesWriter(const std::string _fn, const bool _compress, const int _level)
+  : fn(_fn),
+    use_zlib(_compress),
+    level(_level),
+    is_open(false),
+    nframes(0),
+    nbytes(0)
+  {}
+
+void
+TimeSeriesWriter::open(const size_t _restart_step) {
+
+  const std::string idxfn = fn + ".idx";
+  std::vector<TimeSeriesIndex> keep;
+  uint64_t keep_size = series_header_size;
+
+  // when continuing a run, keep the frames up to the restart step
+  if (_restart_step > 0 and std::filesystem::exists(fn)) {
+    try {
+      TimeSeriesReader reader(fn);
+      keep_size = reader.get_valid_size();
+      for (auto const& entry : reader.get_index()) {
+        if (entry.step > _restart_step) {
+          keep_size = entry.offset;
+          break;
+        }
+        keep.push_back(entry);
+      }
+      std::filesystem::resize_file(fn, keep_size);
+      std::cout << "Continuing time series " << fn << " after " << keep.size() << " frames" << std::endl;
+    } catch (std::exception const& e) {
+      std::cout << "Could not continue time series " << fn << " (" << e.what() << "), starting over" << std::endl;
+      keep.clear();
+    }
+  }
+
+  if (keep.empty()) {
+    // start a new file
+    std::FILE* fp = std::fopen(fn.c_str(), "wb");
+    if (not fp) throw std::runtime_error("Could not open time series file " + fn);
+    char header[series_header_size] = {0};
+    std::memcpy(header, series_magic, 8);
+    std::memcpy(header+8, &timeseries_version, 4);
+    std::memcpy(header+12, &series_endian, 4);
+    std::fwrite(header, 1, series_header_size, fp);
+    std::fclose(fp);
+  }
+
+  // the index always gets rewritten
+  std::FILE* ip = std::fopen(idxfn.c_str(), "wb");
+  if (not ip) throw std::runtime_error("Could not open time series index " + idxfn);
+  std::fwrite(index_magic, 1, 8, ip);
+  for (auto const& entry : keep) {
+    std::fwrite(&entry.step, 8, 1, ip);
+    std::fwrite(&entry.time, 8, 1, ip);
+    std::fwrite(&entry.offset, 8, 1, ip);
+  }
+  std::fclose(ip);
+
+  nframes = keep.size();
+  is_open = true;
+}
+
+void
+TimeSeriesWriter::append(TimeSeriesFrame const& _frame) {
+  if (not is_open) open(0);
+
+  const std::vector<char> bytes = _frame.encode(use_zlib, level, &sizes);
+
+  // the frame goes first, then its index entry, so the index never points at a partial frame
+  const uint64_t offset = std::filesystem::file_size(fn);
+  std::FILE* fp = std::fopen(fn.c_str(), "ab");
+  if (not fp) throw std::runtime_error("Could not open time series file " + fn);
+  const bool good = (std::fwrite(bytes.data(), 1, bytes.size(), fp) == bytes.size());
+  std::fclose(fp);
+  if (not good) throw std::runtime_error("Error writing to time series file " + fn);
+
+  const std::string idxfn = fn + ".idx";
+  std::FILE* ip = std::fopen(idxfn.c_str(), "ab");
+  if (not ip) throw std::runtime_error("Could not open time series index " + idxfn);
+  const uint64_t ustep = _frame.get_step();
+  const double ftime = _frame.get_time();
+  std::fwrite(&ustep, 8, 1, ip);
+  std::fwrite(&ftime, 8, 1, ip);
+  std::fwrite(&offset, 8, 1, ip);
+  std::fclose(ip);
+
+  nframes++;
+  nbytes += bytes.size();
+}
+
+
+//
+// Compression ratio of each array, summed over all frames written so far
+//
+std::string
+TimeSeriesWriter::report() const {
+  std::ostringstream out;
+  out << "Time series " << fn << ": " << nframes << " frames";
+  for (auto const& entry : sizes) {
+    const double ratio = (entry.second.second > 0) ? (double)entry.second.first / (double)entry.second.second : 0.0;
+    out << std::endl << "  " << std::setw(10) << entry.first << "  " << std::setw(12) << entry.second.second
+        << " of " << std::setw(12) << entry.second.first << " bytes, ratio " << std::fixed << std::setprecision(2) << ratio;
+  }
+  return out.str();
+}
+
+
+//
+// Reader
+//
+TimeSeriesReader::TimeSeriesReader(const std::string _fn)
+  : fn(_fn),
+    index(),
+    valid_size(series_header_size)
+{
+  std::ifstream in(fn, std::ios::binary);
+  if (not in) throw std::runtime_error("Could not open time series file " + fn);
+  const uint64_t fsize = std::filesystem::file_size(fn);
+
+  char header[series_header_size];
+  in.read(header, series_header_size);
+  if (not in or std::memcmp(header, series_magic, 8) != 0) {
+    throw std::runtime_error("File " + fn + " is not an Omega2D time series");
+  }
+  uint32_t version, endian;
+  std::memcpy(&version, header+8, 4);
+  std::memcpy(&endian, header+12, 4);
+  if (endian != series_endian) throw std::runtime_error("Time series " + fn + " has a different byte order");
+  if (version > timeseries_version) throw std::runtime_error("Time series " + fn + " is a newer version");
+
+  // read the index, keeping only entries that point inside the file
+  std::ifstream idx(fn + ".idx", std::ios::binary);
+  char imagic[8];
+  if (idx and idx.read(imagic, 8) and std::memcmp(imagic, index_magic, 8) == 0) {
+    TimeSeriesIndex entry;
+    while (idx.read((char*)&entry.step, 8) and idx.read((char*)&entry.time, 8) and idx.read((char*)&entry.offset, 8)) {
+      if (entry.offset + frame_header_size > fsize) break;
+      index.push_back(entry);
+    }
+  }
+
+  // scan from the end of the last indexed frame for complete frames that never made it into the index
+  uint64_t pos = series_header_size;
+  auto frame_end = [&](const uint64_t _pos, TimeSeriesIndex& _entry) -> uint64_t {
+    char fh[frame_header_size];
+    in.clear();
+    in.seekg(_pos);
+    if (not in.read(fh, frame_header_size) or std::memcmp(fh, frame_magic, 8) != 0) return 0;
+    uint64_t json_size, data_size;
+    std::memcpy(&_entry.step, fh+8, 8);
+    std::memcpy(&_entry.time, fh+16, 8);
+    std::memcpy(&json_size, fh+24, 8);
+    std::memcpy(&data_size, fh+32, 8);
+    _entry.offset = _pos;
+    const uint64_t end = _pos + frame_header_size + json_size + data_size;
+    return (end <= fsize) ? end : 0;
+  };
+
+  // the last indexed frame must be complete, too
+  while (not index.empty()) {
+    TimeSeriesIndex entry;
+    pos = frame_end(index.back().offset, entry);
+    if (pos > 0) break;
+    index.pop_back();
+  }
+  if (index.empty()) pos = series_header_size;
+
+  size_t nfound = 0;
+  while (pos < fsize) {
+    TimeSeriesIndex entry;
+    const uint64_t next = frame_end(pos, entry);
+    if (next == 0) break;
+    index.push_back(entry);
+    pos = next;
+    nfound++;
+  }
+  valid_size = pos;
+  if (nfound > 0) std::cout << "  found " << nfound << " frames missing from the index of " << fn << std::endl;
+}
+
+size_t
+TimeSeriesReader::find_step(const size_t _step) const {
+  // steps only ever increase, so a binary search works
+  auto it = std::lower_bound(index.begin(), index.end(), _step,
+                             [](TimeSeriesIndex const& a, const size_t s) { return a.step < s; });
+  if (it == index.end() or it->step != _step) {
+    throw std::runtime_error("Time series has no frame at step " + std::to_string(_step));
+  }
+  return it - index.begin();
+}
+
+size_t
+TimeSeriesReader::find_time(const double _time) const {
+  if (index.empty()) throw std::runtime_error("Time series is empty");
+  auto it = std::lower_bound(index.begin(), index.end(), _time,
+                             [](TimeSeriesIndex const& a, const double t) { return a.time < t; });
+  if (it == index.end()) return index.size() - 1;
+  if (it == index.begin()) return 0;
+  // pick the closer of the two neighbors
+  const size_t i = it - index.begin();
+  return (std::abs(index[i].time - _time) < std::abs(index[i-1].time - _time)) ? i : i-1;
+}
+
+TimeSeriesFrame
+TimeSeriesReader::read_frame(const size_t _i) const {
+  if (_i >= index.size()) throw std::runtime_error("Time series frame index out of range");
+
+  std::ifstream in(fn, std::ios::binary);
+  in.seekg(index[_i].offset);
+  char fh[frame_header_size];
+  if (not in.read(fh, frame_header_size)) throw std::runtime_error("Could not read time series frame");
+  uint64_t json_size, data_size;
+  std::memcpy(&json_size, fh+24, 8);
+  std::memcpy(&data_size, fh+32, 8);
+
+  std::vector<char> buf(frame_header_size + json_size + data_size);
+  std::memcpy(buf.data(), fh, frame_header_size);
+  if (not in.read(buf.data()+frame_header_size, json_size+data_size)) {
+    throw std::runtime_error("Could not read time series frame");
+  }
+  return TimeSeriesFrame::decode(buf.data(), buf.size());
+}
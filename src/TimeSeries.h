@@ -0,0 +1,327 @@
+/*
+ * TimeSeries.h - Append-only single-file container for many output steps
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include "Omega2D.h"
+#include "Collection.h"
+#include "Checkpoint.h"		// for CheckpointType
+#include "Quantize.h"
+#include "json/json.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <type_traits>
+#include <stdexcept>
+
+//
+// Instead of one .vtu file per collection per output step, all steps go into one
+//   growing file, with a small index file alongside it.
+//
+// Series file (name.o2ts), all little-endian:
+//   file header: magic "O2DSERIS", uint32 version, uint32 0x01020304, 16 bytes reserved
+//   then one frame per output step:
+//     frame header: magic "O2DFRAME", uint64 step, float64 time,
+//                   uint64 json size, uint64 data size
+//     json: the collections in this frame, and for each, its arrays
+//           (name, type, count, offset into the data block, stored size, compressed?)
+//     data: the arrays, each raw, zlib-compressed, or quantized to an error bound
+//
+// Index file (name.o2ts.idx): magic "O2DINDEX", then one record per frame:
+//   uint64 step, float64 time, uint64 offset of the frame header in the series file
+//
+// Frames are self-describing, so a missing or short index is rebuilt by scanning the
+//   series file; a frame cut short by a crash is ignored.
+//
+const uint32_t timeseries_version = 1;
+
+// one entry in the per-step index
+struct TimeSeriesIndex {
+  uint64_t step;
+  double time;
+  uint64_t offset;
+};
+
+
+// raw and stored bytes, keyed by list and array name, for reporting compression ratios
+using ArraySizes = std::map<std::string, std::pair<uint64_t,uint64_t>>;
+
+//
+// One output step: a list of collections, each with named arrays
+//
+class TimeSeriesFrame {
+public:
+  TimeSeriesFrame(const size_t _step = 0, const double _time = 0.0)
+    : step(_step), time(_time), meta(), data() {
+    meta["collections"] = nlohmann::json::array();
+  }
+
+  size_t get_step() const { return step; }
+  double get_time() const { return time; }
+  size_t get_num_collections() const { return meta["collections"].size(); }
+
+  // describe a new collection, returns its index
+  size_t add_collection(nlohmann::json _desc) {
+    _desc["arrays"] = nlohmann::json::object();
+    meta["collections"].push_back(_desc);
+    data.emplace_back();
+    return meta["collections"].size() - 1;
+  }
+  nlohmann::json const& get_collection(const size_t _ic) const { return meta["collections"][_ic]; }
+
+  // add an array to a collection (the frame keeps a copy); a float array with a
+  //   positive bound may be stored lossily, differenced from its neighbor if _delta
+  template <class T, class Alloc>
+  void add(const size_t _ic, const std::string _name, std::vector<T,Alloc> const& _vec,
+           const double _bound = 0.0, const bool _delta = false) {
+    const size_t nbytes = _vec.size()*sizeof(T);
+    std::vector<char> bytes(nbytes);
+    if (nbytes > 0) std::memcpy(bytes.data(), _vec.data(), nbytes);
+    meta["collections"][_ic]["arrays"][_name] = { {"type", CheckpointType<T>::name}, {"count", _vec.size()} };
+    if (_bound > 0.0 and std::is_same<T,float>::value) {
+      meta["collections"][_ic]["arrays"][_name]["bound"] = _bound;
+      meta["collections"][_ic]["arrays"][_name]["delta"] = _delta;
+    }
+    data[_ic].emplace_back(_name, std::move(bytes));
+  }
+
+  bool has(const size_t _ic, const std::string _name) const {
+    return get_collection(_ic)["arrays"].count(_name) > 0;
+  }
+
+  // copy an array out of a collection
+  template <class T, class Alloc>
+  void get(const size_t _ic, const std::string _name, std::vector<T,Alloc>& _vec) const {
+    if (not has(_ic, _name)) throw std::runtime_error("Frame has no array " + _name);
+    nlohmann::json const& a = get_collection(_ic)["arrays"][_name];
+    if (a["type"].get<std::string>() != CheckpointType<T>::name) {
+      throw std::runtime_error("Frame array " + _name + " is not " + CheckpointType<T>::name);
+    }
+    for (auto const& nb : data[_ic]) {
+      if (nb.first == _name) {
+        _vec.resize(a["count"].get<size_t>());
+        if (nb.second.size() != _vec.size()*sizeof(T)) throw std::runtime_error("Frame array " + _name + " has wrong size");
+        if (not _vec.empty()) std::memcpy(_vec.data(), nb.second.data(), nb.second.size());
+        return;
+      }
+    }
+  }
+
+  // encode to bytes (arrays compressed in parallel), optionally accumulating the raw and
+  //   stored size of each array by list and name, and decode
+  std::vector<char> encode(const bool, const int, ArraySizes* = nullptr) const;
+  static TimeSeriesFrame decode(const char*, const size_t);
+
+private:
+  size_t step;
+  double time;
+  nlohmann::json meta;
+  std::vector<std::vector<std::pair<std::string, std::vector<char>>>> data;
+};
+
+
+//
+// Appends frames to a series file and its index
+//
+class TimeSeriesWriter {
+public:
+  TimeSeriesWriter(const std::string, const bool _compress = true, const int _level = 1);
+
+  // start writing; when restarting from a step, frames after it (from the stopped run) are dropped
+  void open(const size_t);
+  void append(TimeSeriesFrame const&);
+  bool is_opened() const { return is_open; }
+  std::string get_filename() const { return fn; }
+  size_t get_num_frames() const { return nframes; }
+  uint64_t get_bytes_written() const { return nbytes; }
+  std::string report() const;
+
+private:
+  std::string fn;
+  bool use_zlib;
+  int level;
+  bool is_open;
+  size_t nframes;
+  uint64_t nbytes;
+  ArraySizes sizes;
+};
+
+
+//
+// Reads the index, and any frame by position, step, or time
+//
+class TimeSeriesReader {
+public:
+  explicit TimeSeriesReader(const std::string);
+
+  size_t get_num_frames() const { return index.size(); }
+  std::vector<TimeSeriesIndex> const& get_index() const { return index; }
+  uint64_t get_valid_size() const { return valid_size; }
+
+  // position in the index of a given step (throws if it's not there) or nearest time
+  size_t find_step(const size_t) const;
+  size_t find_time(const double) const;
+
+  TimeSeriesFrame read_frame(const size_t) const;
+
+private:
+  std::string fn;
+  std::vector<TimeSeriesIndex> index;
+  uint64_t valid_size;		// end of the last complete frame
+};
+
+
+//
+// Pack a set of collections into a frame, with just what is needed to visualize them
+//
+// With an error bound, particles are stored in Morton order and every array is
+//   quantized and differenced along that order; panels are always kept exact.
+//
+template <class S>
+void add_to_frame(TimeSeriesFrame& _frame, std::vector<Collection> const& _coll, const std::string _list,
+                  ErrorBound const& _eb = ErrorBound()) {
+  for (auto const& c : _coll) {
+    if (std::holds_alternative<Points<S>>(c)) {
+      Points<S> const& pts = std::get<Points<S>>(c);
+      if (pts.get_n() == 0) continue;
+      const size_t ic = _frame.add_collection({ {"list", _list}, {"type", "points"},
+                                                {"elem", pts.get_elemt()}, {"move", pts.get_movet()} });
+      if (_eb.is_enabled()) {
+        const std::vector<uint32_t> order = morton_order(pts.get_pos());
+        auto add_sorted = [&](const std::string _name, Vector<S> const& _vec) {
+          Vector<S> sorted = permute(_vec, order);
+          const double bound = _eb.for_array(sorted);
+          _frame.add(ic, _name, sorted, bound, true);
+        };
+        for (size_t d=0; d<Dimensions; ++d) {
+          add_sorted("x" + std::to_string(d), pts.get_pos()[d]);
+          add_sorted("u" + std::to_string(d), pts.get_vel()[d]);
+        }
+        if (not pts.is_inert()) {
+          add_sorted("s", pts.get_str());
+          add_sorted("r", pts.get_rad());
+        }
+        continue;
+      }
+      for (size_t d=0; d<Dimensions; ++d) {
+        _frame.add(ic, "x" + std::to_string(d), pts.get_pos()[d]);
+        _frame.add(ic, "u" + std::to_string(d), pts.get_vel()[d]);
+      }
+      if (not pts.is_inert()) {
+        _frame.add(ic, "s", pts.get_str());
+        _frame.add(ic, "r", pts.get_rad());
+      }
+
+    } else if (std::holds_alternative<Surfaces<S>>(c)) {
+      Surfaces<S> const& surf = std::get<Surfaces<S>>(c);
+      if (surf.get_npanels() == 0) continue;
+      const size_t ic = _frame.add_collection({ {"list", _list}, {"type", "surfaces"},
+                                                {"elem", surf.get_elemt()}, {"move", surf.get_movet()} });
+      for (size_t d=0; d<Dimensions; ++d) {
+        _frame.add(ic, "x" + std::to_string(d), surf.get_pos()[d]);
+        _frame.add(ic, "u" + std::to_string(d), surf.get_vel()[d]);
+      }
+      _frame.add(ic, "idx", surf.get_idx());
+      if (not surf.is_inert()) {
+        _frame.add(ic, "vs", surf.get_vort_str());
+        if (surf.have_src_str()) _frame.add(ic, "ss", surf.get_src_str());
+
+        // panels on a body also carry the strength of its rotation while velocities are
+        //   found, which needs the body; keep that part on its own, for replays
+        if (surf.get_body_ptr() and surf.have_src_str()) {
+          Surfaces<S> rot = surf;
+          rot.zero_strengths();
+          rot.add_solved_rot_strengths(1.0);
+          _frame.add(ic, "vsRot", rot.get_vort_str());
+          _frame.add(ic, "ssRot", rot.get_src_str());
+        }
+      }
+    }
+  }
+}
+
+//
+// Rebuild stand-alone collections from one list in a frame, enough to write .vtu files
+//
+// The rebuilt panels have no body, so to find velocities from them, ask for the strength
+//   of each body's rotation to be added in now; frames from before that was saved can
+//   not give it, so panels on a body in them are an error then.
+//
+template <class S>
+std::vector<Collection> collections_from_frame(TimeSeriesFrame const& _frame, const std::string _list,
+                                               const bool _with_rotation = false) {
+  std::vector<Collection> coll;
+
+  for (size_t ic=0; ic<_frame.get_num_collections(); ++ic) {
+    nlohmann::json const& jc = _frame.get_collection(ic);
+    if (jc["list"].get<std::string>() != _list) continue;
+    const elem_t e = jc["elem"].get<elem_t>();
+
+    std::array<Vector<S>,Dimensions> x, u;
+    for (size_t d=0; d<Dimensions; ++d) {
+      _frame.get(ic, "x" + std::to_string(d), x[d]);
+      _frame.get(ic, "u" + std::to_string(d), u[d]);
+    }
+    const size_t n = x[0].size();
+
+    if (jc["type"].get<std::string>() == "points") {
+      // Points takes (x,y) or (x,y,s,r) packed together
+      Vector<S> s, r;
+      if (e != inert) {
+        _frame.get(ic, "s", s);
+        _frame.get(ic, "r", r);
+      }
+      const size_t nper = (e == inert) ? 2 : 4;
+      std::vector<S> packed(nper*n);
+      for (size_t i=0; i<n; ++i) {
+        packed[nper*i+0] = x[0][i];
+        packed[nper*i+1] = x[1][i];
+        if (e != inert) {
+          packed[nper*i+2] = s[i];
+          packed[nper*i+3] = r[i];
+        }
+      }
+      Points<S> pts(packed, e, fixed, nullptr);
+      pts.get_vel() = u;
+      coll.push_back(std::move(pts));
+
+    } else {
+      std::vector<Int> idx;
+      _frame.get(ic, "idx", idx);
+      std::vector<S> packed(Dimensions*n);
+      for (size_t i=0; i<n; ++i) {
+        for (size_t d=0; d<Dimensions; ++d) packed[Dimensions*i+d] = x[d][i];
+      }
+      std::vector<S> zeros(idx.size()/Dimensions, 0.0);
+      Surfaces<S> surf(packed, idx, zeros, e, fixed, nullptr);
+      surf.get_vel() = u;
+      if (_frame.has(ic, "vs")) _frame.get(ic, "vs", surf.get_vort_str());
+      if (_frame.has(ic, "ss") and surf.have_src_str()) _frame.get(ic, "ss", surf.get_src_str());
+
+      if (_with_rotation and _frame.has(ic, "vsRot") and surf.have_src_str()) {
+        Vector<S> vsrot, ssrot;
+        _frame.get(ic, "vsRot", vsrot);
+        _frame.get(ic, "ssRot", ssrot);
+        for (size_t i=0; i<vsrot.size(); ++i) {
+          surf.get_vort_str()[i] += vsrot[i];
+          surf.get_src_str()[i] += ssrot[i];
+        }
+      } else if (_with_rotation and _frame.has(ic, "ss") and jc["move"].get<move_t>() == bodybound) {
+        throw std::runtime_error("Frame at step " + std::to_string(_frame.get_step())
+                                 + " has panels on a body, but not the strength of its rotation;"
+                                 + " write the series again with this version");
+      }
+      coll.push_back(std::move(surf));
+    }
+  }
+
+  return coll;
+}
+
@@ -0,0 +1,287 @@
+/*
+ * TracerInterp.cpp - Tracer velocities interpolated from nearby particle velocities
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "TracerInterp.h"
+#include "nanoflann.hpp"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "ThreadPool.h"
+
+#include <Eigen/Dense>
+
+#ifdef _WIN32
+  #include <ciso646>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <variant>
+
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, 2> PosMatType;
+typedef nanoflann::KDTreeEigenMatrixAdaptor< PosMatType > PosTreeType;
+typedef PosMatType::Index PosIndexType;
+
+void
+TracerInterp::from_json(const nlohmann::json j) {
+  enabled = (j.value("method", std::string("direct")) == "interpolate");
+  neighbors = j.value("neighbors", neighbors);
+  max_radius = j.value("maxRadius", max_radius);
+  body_distance = j.value("bodyDistance", body_distance);
+  check_every = j.value("checkEvery", check_every);
+  check_samples = j.value("checkSamples", check_samples);
+  tolerance = j.value("tolerance", tolerance);
+  if (neighbors < 6 or not (max_radius > 0.0f)) {
+    TaskGroup::out() << "  tracer interpolation needs 6 or more neighbors and maxRadius > 0, disabling" << std::endl;
+    enabled = false;
+  }
+}
+
+nlohmann::json
+TracerInterp::to_json() const {
+  nlohmann::json j;
+  j["method"] = enabled ? "interpolate" : "direct";
+  j["neighbors"] = neighbors;
+  j["maxRadius"] = max_radius;
+  j["bodyDistance"] = body_distance;
+  j["checkEvery"] = check_every;
+  j["checkSamples"] = check_samples;
+  j["tolerance"] = tolerance;
+  return j;
+}
+
+//
+// make a subset of inert points from some of the points of one target
+//
+static void
+add_subset(TracerInterp::Subset& _sub, const size_t _t, Points<float> const& _pts,
+           std::vector<size_t>&& _idx) {
+  if (_idx.empty()) return;
+  std::vector<float> xy(2*_idx.size());
+  for (size_t i=0; i<_idx.size(); ++i) {
+    xy[2*i]   = _pts.get_pos()[0][_idx[i]];
+    xy[2*i+1] = _pts.get_pos()[1][_idx[i]];
+  }
+  _sub.pts.push_back(Points<float>(xy, inert, fixed, nullptr));
+  _sub.target.push_back(_t);
+  _sub.idx.push_back(std::move(_idx));
+}
+
+TracerInterp::Subset
+TracerInterp::interpolate(std::vector<Collection> const& _vort,
+                          std::vector<Collection> const& _bdry,
+                          std::vector<Collection>&       _targets,
+                          const float                    _ips) {
+
+  ScopedTimer timer("tracer interpolation");
+  const bool checking = (check_every > 0) and (recheck or (ncalls % check_every == 0));
+  ncalls++;
+  recheck = false;
+  pending = Subset();
+
+  // every particle position and its velocity
+  size_t nsrc = 0;
+  for (auto const& coll : _vort) {
+    if (not std::holds_alternative<Points<float>>(coll)) continue;
+    Points<float> const& pts = std::get<Points<float>>(coll);
+    if (not pts.is_inert()) nsrc += pts.get_n();
+  }
+  PosMatType xp(nsrc, 2);
+  std::array<Vector<float>,Dimensions> up;
+  for (size_t d=0; d<Dimensions; ++d) up[d].resize(nsrc);
+  size_t isrc = 0;
+  for (auto const& coll : _vort) {
+    if (not std::holds_alternative<Points<float>>(coll)) continue;
+    Points<float> const& pts = std::get<Points<float>>(coll);
+    if (pts.is_inert()) continue;
+    for (size_t i=0; i<pts.get_n(); ++i, ++isrc) {
+      for (size_t d=0; d<Dimensions; ++d) {
+        xp(isrc,d) = pts.get_pos()[d][i];
+        up[d][isrc] = pts.get_vel()[d][i];
+      }
+    }
+  }
+
+  // every panel node, and how far from one a tracer may be and still be near the panels
+  size_t nnode = 0;
+  float max_panel = 0.0f;
+  for (auto const& coll : _bdry) {
+    if (not std::holds_alternative<Surfaces<float>>(coll)) continue;
+    Surfaces<float> const& surf = std::get<Surfaces<float>>(coll);
+    nnode += surf.get_n();
+    for (auto const& a : surf.get_area()) max_panel = std::max(max_panel, a);
+  }
+  PosMatType xb(nnode, 2);
+  size_t inode = 0;
+  for (auto const& coll : _bdry) {
+    if (not std::holds_alternative<Surfaces<float>>(coll)) continue;
+    Surfaces<float> const& surf = std::get<Surfaces<float>>(coll);
+    for (size_t i=0; i<surf.get_n(); ++i, ++inode) {
+      for (size_t d=0; d<Dimensions; ++d) xb(inode,d) = surf.get_pos()[d][i];
+    }
+  }
+  const float near_body = body_distance * _ips + 0.5f * max_panel;
+  const float max_dist = max_radius * _ips;
+
+  // too few particles to fit anything: everything is direct
+  const size_t nnear = neighbors;
+  Subset rest;
+  if (nsrc < nnear) {
+    for (size_t t=0; t<_targets.size(); ++t) {
+      if (not std::holds_alternative<Points<float>>(_targets[t])) continue;
+      Points<float> const& pts = std::get<Points<float>>(_targets[t]);
+      std::vector<size_t> all(pts.get_n());
+      for (size_t i=0; i<all.size(); ++i) all[i] = i;
+      add_subset(rest, t, pts, std::move(all));
+    }
+    return rest;
+  }
+
+  PosTreeType src_tree(Dimensions, std::cref(xp));
+  std::unique_ptr<PosTreeType> node_tree;
+  if (nnode > 0) node_tree = std::make_unique<PosTreeType>(Dimensions, std::cref(xb));
+  MemoryTracker::note("tracer kd-trees", (xp.size() + xb.size() + 2*nsrc)*sizeof(float)
+                                         + src_tree.index->usedMemory(*src_tree.index));
+
+  size_t ninterp = 0, ntotal = 0;
+  for (size_t t=0; t<_targets.size(); ++t) {
+    // every target should be tracers, but anything else gets the direct sum
+    if (not std::holds_alternative<Points<float>>(_targets[t])) continue;
+    Points<float>& pts = std::get<Points<float>>(_targets[t]);
+    const size_t n = pts.get_n();
+    std::array<Vector<float>,Dimensions> const& x = pts.get_pos();
+    std::array<Vector<float>,Dimensions>& u = pts.get_vel();
+
+    // each tracer is on its own, so this is the same for any thread count
+    std::vector<uint8_t> done(n, 0);
+    #pragma omp parallel
+    {
+      std::vector<PosIndexType> sidx(nnear);
+      std::vector<float> sdist(nnear);
+      #pragma omp for
+      for (int32_t i=0; i<(int32_t)n; ++i) {
+        const float q[2] = {x[0][i], x[1][i]};
+        PosIndexType nidx[1];
+        float ndist[1];
+
+        // panels make the velocity change too fast near a body
+        if (node_tree) {
+          node_tree->query(q, 1, nidx, ndist);
+          if (ndist[0] < near_body*near_body) continue;
+        }
+
+        // the nearest particles, looking no farther than they may be
+        nanoflann::KNNResultSet<float,PosIndexType> found(nnear);
+        found.init(sidx.data(), sdist.data());
+        sdist[nnear-1] = max_dist*max_dist;
+        src_tree.index->findNeighbors(found, q, nanoflann::SearchParams());
+        if (found.size() < nnear) continue;
+        const float h = std::sqrt(sdist[nnear-1]) * 1.01f;
+        if (not (h > 0.0f)) continue;
+
+        // weighted least-squares fit of u to a quadratic in dx and dy, scaled by h
+        Eigen::Matrix<double,6,6> m = Eigen::Matrix<double,6,6>::Zero();
+        Eigen::Matrix<double,6,Dimensions> b = Eigen::Matrix<double,6,Dimensions>::Zero();
+        for (size_t j=0; j<nnear; ++j) {
+          const double qq = 1.0 - sdist[j] / (h*h);
+          const double w = qq*qq;
+          const double dx = (xp(sidx[j],0)-q[0]) / h;
+          const double dy = (xp(sidx[j],1)-q[1]) / h;
+          Eigen::Matrix<double,6,1> p;
+          p << 1.0, dx, dy, dx*dx, dx*dy, dy*dy;
+          m += w * p * p.transpose();
+          for (size_t d=0; d<Dimensions; ++d) b.col(d) += w * up[d][sidx[j]] * p;
+        }
+
+        // neighbors in a line or on a curve can not be fit
+        const Eigen::LDLT<Eigen::Matrix<double,6,6>> ldlt(m);
+        if (ldlt.info() != Eigen::Success or
+            not (ldlt.vectorD().minCoeff() > 1.e-7 * ldlt.vectorD().maxCoeff())) continue;
+        const Eigen::Matrix<double,6,Dimensions> a = ldlt.solve(b);
+        // the fit at dx=dy=0
+        for (size_t d=0; d<Dimensions; ++d) u[d][i] = (float)a(0,d);
+        done[i] = 1;
+      }
+    }
+
+    // the rest go to the direct sum, and a few of the others are checked
+    std::vector<size_t> left, fitted;
+    for (size_t i=0; i<n; ++i) {
+      if (done[i]) fitted.push_back(i);
+      else left.push_back(i);
+    }
+    ninterp += fitted.size();
+    ntotal += n;
+    add_subset(rest, t, pts, std::move(left));
+
+    if (checking and not fitted.empty()) {
+      const size_t ns = std::max((size_t)1, check_samples);
+      const size_t stride = (fitted.size() + ns - 1) / ns;
+      std::vector<size_t> sample;
+      for (size_t i=stride/2; i<fitted.size(); i+=stride) sample.push_back(fitted[i]);
+      add_subset(pending, t, pts, std::move(sample));
+    }
+  }
+
+  TaskGroup::out() << "  Interpolated velocities on " << ninterp << " of " << ntotal << " tracers" << std::endl;
+  return rest;
+}
+
+void
+TracerInterp::scatter(Subset const& _sub, std::vector<Collection>& _targets) {
+  for (size_t s=0; s<_sub.pts.size(); ++s) {
+    Points<float> const& from = std::get<Points<float>>(_sub.pts[s]);
+    Points<float>& to = std::get<Points<float>>(_targets[_sub.target[s]]);
+    std::vector<size_t> const& idx = _sub.idx[s];
+    for (size_t d=0; d<Dimensions; ++d) {
+      for (size_t i=0; i<idx.size(); ++i) to.get_vel()[d][idx[i]] = from.get_vel()[d][i];
+    }
+  }
+}
+
+TracerInterp::Subset
+TracerInterp::check_sample() {
+  return std::move(pending);
+}
+
+bool
+TracerInterp::compare(Subset const& _direct, std::vector<Collection> const& _targets) {
+  double sumerr = 0.0, sumspeed = 0.0, maxerr = 0.0;
+  size_t nsample = 0;
+  for (size_t s=0; s<_direct.pts.size(); ++s) {
+    Points<float> const& dir = std::get<Points<float>>(_direct.pts[s]);
+    Points<float> const& interp = std::get<Points<float>>(_targets[_direct.target[s]]);
+    std::vector<size_t> const& idx = _direct.idx[s];
+    for (size_t i=0; i<idx.size(); ++i) {
+      double errsq = 0.0, speedsq = 0.0;
+      for (size_t d=0; d<Dimensions; ++d) {
+        const double ud = dir.get_vel()[d][i];
+        errsq += std::pow(interp.get_vel()[d][idx[i]] - ud, 2);
+        speedsq += ud*ud;
+      }
+      sumerr += errsq;
+      sumspeed += speedsq;
+      maxerr = std::max(maxerr, errsq);
+    }
+    nsample += idx.size();
+  }
+  if (nsample == 0 or not (sumspeed > 0.0)) return true;
+
+  const double rmsrel = std::sqrt(sumerr / sumspeed);
+  const double maxrel = std::sqrt(maxerr * nsample / sumspeed);
+  TaskGroup::out() << "  tracer interpolation error rms " << rmsrel << ", max " << maxrel
+                   << " (relative), over " << nsample << " samples" << std::endl;
+  if (rmsrel <= tolerance) return true;
+
+  // check again next time, until it is good enough
+  TaskGroup::out() << "  tracer interpolation error is above " << tolerance << ", finding all directly" << std::endl;
+  recheck = true;
+  return false;
+}
@@ -0,0 +1,79 @@
+/*
+ * TracerInterp.h - Tracer velocities interpolated from nearby particle velocities
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#pragma once
+
+#include "Omega2D.h"
+#include "Collection.h"
+#include "json/json.hpp"
+
+#include <vector>
+
+//
+// Find tracer velocities from the particles' velocities instead of from all of the sources
+//
+// The vortex particles' velocities are always found first, so a tracer among them can
+//   take a moving-least-squares fit (quadratic, with a compact quartic weight) of the
+//   velocities of its nearest few particles, found with a kd-tree. That is O(log N) per
+//   tracer instead of O(N), which matters when there are many more tracers than particles.
+//
+// Tracers whose neighbors are too far away (in sparse or irrotational regions), too near
+//   a body (where the panels make the velocity change too fast), or in a line (where the
+//   fit is singular) are returned for a direct sum. Every few calls, a sample of the
+//   interpolated tracers is also found directly; if the error is too large, that call
+//   finds all of them directly instead.
+//
+class TracerInterp {
+public:
+  TracerInterp()
+    : enabled(false),
+      neighbors(16),
+      max_radius(3.0f),
+      body_distance(3.0f),
+      check_every(20),
+      check_samples(1000),
+      tolerance(0.01f),
+      ncalls(0),
+      recheck(false),
+      pending()
+    {}
+
+  bool is_enabled() const { return enabled; }
+  void from_json(const nlohmann::json);
+  nlohmann::json to_json() const;
+
+  // some of the points of some target collections, as collections of their own
+  struct Subset {
+    std::vector<Collection> pts;
+    std::vector<size_t> target;			// which target each one came from
+    std::vector<std::vector<size_t>> idx;	// and which of its points
+  };
+
+  // set velocities on every tracer that can be interpolated, return the rest
+  Subset interpolate(std::vector<Collection> const&, std::vector<Collection> const&,
+                     std::vector<Collection>&, const float);
+  // copy the velocities found for a subset back into its targets
+  static void scatter(Subset const&, std::vector<Collection>&);
+
+  // interpolated tracers to check this time, if a check is due
+  Subset check_sample();
+  // compare the direct velocities to the interpolated ones, false if too far apart
+  bool compare(Subset const&, std::vector<Collection> const&);
+
+private:
+  bool enabled;
+  size_t neighbors;	// particles in each fit
+  float max_radius;	// farthest of them, in particle spacings, else direct
+  float body_distance;	// closer than this to a panel node, in particle spacings, is direct
+  size_t check_every;	// calls between accuracy checks, 0 for none
+  size_t check_samples;	// tracers in each check
+  float tolerance;	// largest rms error, relative to the rms speed
+
+  size_t ncalls;
+  bool recheck;
+  Subset pending;
+};
@@ -14,6 +14,9 @@
 #include "simplex.h"
 #endif
 #include "nnls.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "ThreadPool.h"
 
 #include <Eigen/Dense>
 
@@ -26,6 +29,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
+#include <limits>
 #include <vector>
 
 enum SolverType { nnls, simplex };
@@ -51,12 +55,16 @@ public:
   const bool get_simplex() const { return (use_solver==simplex); }
 
   // all-to-all diffuse; can change array sizes
+  // particles from the given count on are only neighbours, and do not diffuse; relative
+  //   thresholds use the last value if it is stronger than any particle here
   void diffuse_all(std::array<Vector<ST>,2>&,
                    Vector<ST>&,
                    Vector<ST>&,
                    const ST,
                    const CoreType,
-                   const ST);
+                   const ST,
+                   const size_t _nown = std::numeric_limits<size_t>::max(),
+                   const ST _peak = 0.0);
 
   // other functions to eventually support:
   // two-to-one merge (when particles are close to each other)
@@ -153,7 +161,7 @@ void VRM<ST,CT,MAXMOM>::initialize_sites() {
     }
 
   } else {
-    std::cout << "Creating two rings of " << num_sites << " insertion sites" << std::endl;
+    TaskGroup::out() << "Creating two rings of " << num_sites << " insertion sites" << std::endl;
     const size_t nring = num_sites/2;
 
     // to solve for 3rd-4th moments stably, we need more points
@@ -227,7 +235,9 @@ void VRM<ST,CT,MAXMOM>::diffuse_all(std::array<Vector<ST>,2>& pos,
                                     Vector<ST>& rad,
                                     const ST h_nu,
                                     const CoreType core_func,
-                                    const ST particle_overlap) {
+                                    const ST particle_overlap,
+                                    const size_t _nown,
+                                    const ST _peak) {
 
   // make sure all vector sizes are identical
   assert(pos[0].size()==pos[1].size() && "Input arrays are not uniform size");
@@ -235,10 +245,10 @@ void VRM<ST,CT,MAXMOM>::diffuse_all(std::array<Vector<ST>,2>& pos,
   assert(str.size()==rad.size() && "Input arrays are not uniform size");
   size_t n = rad.size();
 
-  std::cout << "  Running VRM with n " << n << std::endl;
+  TaskGroup::out() << "  Running VRM with n " << n << std::endl;
 
   // start timer
-  auto start = std::chrono::system_clock::now();
+  ScopedTimer timer("vrm");
 
   // reference or generate the local set of vectors
   Vector<ST>& x = pos[0];
@@ -265,7 +275,7 @@ void VRM<ST,CT,MAXMOM>::diffuse_all(std::array<Vector<ST>,2>& pos,
   // what is maximum strength of all particles?
   const ST maxStr = s[std::max_element(s.begin(), s.end()) - s.begin()];
   const ST minStr = s[std::min_element(s.begin(), s.end()) - s.begin()];
-  const ST maxAbsStr = std::max(maxStr, -1.f*minStr);
+  const ST maxAbsStr = std::max({maxStr, -1.f*minStr, _peak});
   //std::cout << "maxAbsStr " << maxAbsStr << std::endl;
 
   // convert particle positions into something nanoflann can understand
@@ -279,7 +289,11 @@ void VRM<ST,CT,MAXMOM>::diffuse_all(std::array<Vector<ST>,2>& pos,
   typedef typename EigenMatType::Index EigenIndexType;
   typedef nanoflann::KDTreeEigenMatrixAdaptor< EigenMatType >  my_kd_tree_t;
   my_kd_tree_t mat_index(Dimensions, std::cref(xp));
-  if (use_tree) mat_index.index->buildIndex();
+  if (use_tree) {
+    ScopedTimer ttimer("tree");
+    mat_index.index->buildIndex();
+    MemoryTracker::note("kd-tree", xp.size()*sizeof(ST) + mat_index.index->usedMemory(*mat_index.index));
+  }
 
   std::vector<std::pair<EigenIndexType,ST> > ret_matches;
   ret_matches.reserve(max_near);
@@ -291,13 +305,16 @@ void VRM<ST,CT,MAXMOM>::diffuse_all(std::array<Vector<ST>,2>& pos,
 
   // for each particle (can parallelize this part)
   const size_t initial_n = n;
+  const size_t nown = std::min(_nown, initial_n);
   size_t nsolved = 0;
   size_t nneibs = 0;
   //size_t ntooclose = 0;
   size_t minneibs = 999999;
   size_t maxneibs = 0;
+  // per-particle work is too fine to time as phases, so sum it here and report once
+  std::chrono::duration<double> search_time(0.0), solve_time(0.0);
   // note that an OpenMP loop here will need to use int32_t as the counter variable type
-  for (size_t i=0; i<initial_n; ++i) {
+  for (size_t i=0; i<nown; ++i) {
 
     // find the nearest neighbor particles
     //std::cout << "\nDiffusing particle " << i << " with strength " << s[i] << std::endl;
@@ -318,6 +335,7 @@ void VRM<ST,CT,MAXMOM>::diffuse_all(std::array<Vector<ST>,2>& pos,
 
     // initialize vector of indexes of nearest particles
     std::vector<int32_t> inear;
+    auto tstart = std::chrono::steady_clock::now();
 
     // switch on search method
     if (use_tree) {
@@ -355,6 +373,8 @@ void VRM<ST,CT,MAXMOM>::diffuse_all(std::array<Vector<ST>,2>& pos,
 
     }
     //std::cout << "  found " << inear.size() << " particles close to particle " << i << std::endl;
+    auto tsearch = std::chrono::steady_clock::now();
+    search_time += tsearch - tstart;
     //std::cout << " :";
     //for (size_t j=0; j<inear.size(); ++j) std::cout << " " << inear[j];
     //std::cout << std::endl;
@@ -448,15 +468,17 @@ void VRM<ST,CT,MAXMOM>::diffuse_all(std::array<Vector<ST>,2>& pos,
 
     // did we eventually reach a solution?
     if (numNewParts >= maxNewParts) {
-      std::cout << "Something went wrong" << std::endl;
-      std::cout << "  at " << x[i] << " " << y[i] << std::endl;
-      std::cout << "  with " << inear.size() << " near neibs" << std::endl;
-      std::cout << "  needed numNewParts= " << numNewParts << std::endl;
+      TaskGroup::out() << "Something went wrong" << std::endl;
+      TaskGroup::out() << "  at " << x[i] << " " << y[i] << std::endl;
+      TaskGroup::out() << "  with " << inear.size() << " near neibs" << std::endl;
+      TaskGroup::out() << "  needed numNewParts= " << numNewParts << std::endl;
       // ideally, in this situation, we would create 6 new particles around the original particle with optimal fractions,
       //   ignoring every other nearby particle - let merge take care of the higher density later
       exit(0);
     }
 
+    solve_time += std::chrono::steady_clock::now() - tsearch;
+
     nneibs += inear.size();
     if (inear.size() < minneibs) minneibs = inear.size();
     if (inear.size() > maxneibs) maxneibs = inear.size();
@@ -476,9 +498,17 @@ void VRM<ST,CT,MAXMOM>::diffuse_all(std::array<Vector<ST>,2>& pos,
 
   } // end loop over all current particles
 
-  std::cout << "    neighbors: min/avg/max " << minneibs << "/" << ((ST)nneibs / (ST)nsolved) << "/" << maxneibs << std::endl;
+  // the new radii and strength changes, sized for every particle made above
+  MemoryTracker::note("vrm workspace", (newr.capacity() + ds.capacity()) * sizeof(ST));
+
+  if (Profiler* prof = Profiler::get_current()) {
+    prof->add("search", search_time.count(), nsolved);
+    prof->add("solve", solve_time.count(), nsolved);
+  }
+
+  TaskGroup::out() << "    neighbors: min/avg/max " << minneibs << "/" << ((ST)nneibs / (ST)nsolved) << "/" << maxneibs << std::endl;
   //std::cout << "  number of close pairs " << (ntooclose/2) << std::endl;
-  std::cout << "    after VRM, n is " << n << std::endl;
+  TaskGroup::out() << "    after VRM, n is " << n << std::endl;
 
   // apply the changes to the master vectors
   assert(n==s.size() and ds.size()==s.size() && "Array size mismatch in VRM");
@@ -489,9 +519,7 @@ void VRM<ST,CT,MAXMOM>::diffuse_all(std::array<Vector<ST>,2>& pos,
   }
 
   // finish timer and report
-  auto end = std::chrono::system_clock::now();
-  std::chrono::duration<double> elapsed_seconds = end-start;
-  printf("    vrm.diffuse_all:\t[%.4f] seconds\n", (float)elapsed_seconds.count());
+  timer.report("vrm.diffuse_all");
 }
 
 //
@@ -511,9 +539,10 @@ bool VRM<ST,CT,MAXMOM>::attempt_solution(const int32_t idiff,
   bool haveSolution = false;
 
   // the matricies that we will repeatedly work on
-  static Eigen::Matrix<CT, num_rows, Eigen::Dynamic, 0, num_rows, max_near> A;
-  static Eigen::Matrix<CT, num_rows, 1> b;
-  static Eigen::Matrix<CT, Eigen::Dynamic, 1, 0, max_near, 1> fractions;
+  //   (one set per thread, so that simulations can run concurrently)
+  static thread_local Eigen::Matrix<CT, num_rows, Eigen::Dynamic, 0, num_rows, max_near> A;
+  static thread_local Eigen::Matrix<CT, num_rows, 1> b;
+  static thread_local Eigen::Matrix<CT, Eigen::Dynamic, 1, 0, max_near, 1> fractions;
 
   // second moment in each direction
   // one dt should generate 4 hnu^2 of second moment, or when distances
@@ -675,12 +704,12 @@ void VRM<ST,CT,MAXMOM>::from_json(const nlohmann::json simj) {
 
     if (j.find("ignoreBelow") != j.end()) {
       ignore_thresh = j["ignoreBelow"];
-      std::cout << "  setting ignore_thresh= " << ignore_thresh << std::endl;
+      TaskGroup::out() << "  setting ignore_thresh= " << ignore_thresh << std::endl;
     }
 
     if (j.find("relativeThresholds") != j.end()) {
       thresholds_are_relative = j["relativeThresholds"];
-      std::cout << "  setting thresholds_are_relative= " << thresholds_are_relative << std::endl;
+      TaskGroup::out() << "  setting thresholds_are_relative= " << thresholds_are_relative << std::endl;
     }
   }
 }
@@ -12,40 +12,191 @@
 #include "Collection.h"
 #include "Points.h"
 #include "Surfaces.h"
+#include "Quantize.h"
 
 #include "tinyxml2.h"
 #include "cppcodec/base64_rfc4648.hpp"
+#include "miniz.h"
 
 #include <vector>
+#include <atomic>
 #include <cstdint>	// for uint32_t
 #include <cstdio>	// for FILE
+#include <cstring>	// for memcpy
 #include <string>	// for string
 #include <sstream>	// for stringstream
 #include <iomanip>	// for setfill, setw
+#include <stdexcept>	// for runtime_error
 
 
 //
-// compress a byte stream - TO DO
+// Hold all arrays destined for the AppendedData section of one vtk file
 //
+// Arrays are added first, then compressed all at once (every block of every array is an
+//   independent work item), and only then is the XML written, because each DataArray
+//   element needs to know its byte offset into the appended section.
+//
+// Each array is preceded by a header of UInt64 values (so header_type must be UInt64):
+//   uncompressed: [nbytes]
+//   compressed:   [nblocks][block size][size of partial last block, or 0][csize of each block]
+// which is the layout that vtkZLibDataCompressor expects.
+//
+class VtkAppendedData {
+public:
+  VtkAppendedData(const bool _compress,
+                  const int _level = MZ_BEST_SPEED,
+                  const size_t _blocksize = 32768)
+    : use_zlib(_compress),
+      level(_level),
+      blocksize(_blocksize),
+      blobs()
+    {}
+
+  // copy a flat array in, return its index
+  template <class S>
+  size_t add(Vector<S> const & _data) {
+    blobs.emplace_back();
+    std::vector<uint8_t>& raw = blobs.back().raw;
+    raw.resize(sizeof(S)*_data.size());
+    if (raw.size() > 0) std::memcpy(raw.data(), _data.data(), raw.size());
+    return blobs.size()-1;
+  }
+
+  // interleave 2 arrays into 3-component vectors (vtk has no 2-component points)
+  template <class S>
+  size_t add(std::array<Vector<S>,2> const & _data) {
+    Vector<S> newvec(3 * _data[0].size());
+    for (size_t i=0; i<_data[0].size(); ++i) {
+      newvec[3*i+0] = _data[0][i];
+      newvec[3*i+1] = _data[1][i];
+      newvec[3*i+2] = 0.0;
+    }
+    return add(newvec);
+  }
+
+  // compress (if requested) and find the offsets of every array
+  void finalize() {
+
+    // build the list of every block of every array
+    std::vector<std::pair<size_t,size_t>> work;
+    for (size_t i=0; i<blobs.size(); ++i) {
+      const size_t nbytes = blobs[i].raw.size();
+      const size_t nblocks = use_zlib ? (nbytes + blocksize - 1) / blocksize : 0;
+      blobs[i].blocks.resize(nblocks);
+      for (size_t j=0; j<nblocks; ++j) work.emplace_back(i,j);
+    }
+
+    // compress them all independently
+    std::atomic<bool> failed(false);
+    #pragma omp parallel for schedule(dynamic)
+    for (int32_t k=0; k<(int32_t)work.size(); ++k) {
+      Blob& thisb = blobs[work[k].first];
+      const size_t j = work[k].second;
+      const size_t first = j*blocksize;
+      const size_t nbytes = std::min(blocksize, thisb.raw.size()-first);
+      std::vector<uint8_t>& out = thisb.blocks[j];
+      mz_ulong clen = mz_compressBound((mz_ulong)nbytes);
+      out.resize(clen);
+      const int retval = mz_compress2(out.data(), &clen, thisb.raw.data()+first, (mz_ulong)nbytes, level);
+      if (retval != MZ_OK) failed = true;
+      out.resize(clen);
+    }
+    if (failed) throw std::runtime_error("Could not compress appended data block");
+
+    // build the headers and find the offsets
+    uint64_t offset = 0;
+    for (auto& thisb : blobs) {
+      const uint64_t nbytes = thisb.raw.size();
+      thisb.header.clear();
+      if (use_zlib) {
+        thisb.header.push_back(thisb.blocks.size());
+        thisb.header.push_back(blocksize);
+        thisb.header.push_back(nbytes % blocksize);
+        for (auto& blk : thisb.blocks) thisb.header.push_back(blk.size());
+      } else {
+        thisb.header.push_back(nbytes);
+      }
+      thisb.offset = offset;
+      offset += sizeof(uint64_t)*thisb.header.size() + thisb.stored_size();
+    }
+  }
+
+  // within an open DataArray element, point to the given array
+  void push_attributes(tinyxml2::XMLPrinter& _p, const size_t _idx) const {
+    assert(_idx < blobs.size() && "Appended array index out of range");
+    _p.PushAttribute( "format", "appended" );
+    _p.PushAttribute( "offset", std::to_string(blobs[_idx].offset).c_str() );
+  }
+
+  // write the AppendedData element itself, must follow the closing Piece and *Grid
+  void write(tinyxml2::XMLPrinter& _p, std::FILE* _fp) const {
+    _p.OpenElement( "AppendedData" );
+    _p.PushAttribute( "encoding", "raw" );
+    // this closes the opening tag and writes the mandatory underscore
+    _p.PushText( "_" );
+    for (auto& thisb : blobs) {
+      std::fwrite(thisb.header.data(), sizeof(uint64_t), thisb.header.size(), _fp);
+      if (use_zlib) {
+        for (auto& blk : thisb.blocks) std::fwrite(blk.data(), 1, blk.size(), _fp);
+      } else {
+        std::fwrite(thisb.raw.data(), 1, thisb.raw.size(), _fp);
+      }
+    }
+    _p.CloseElement();	// AppendedData
+  }
+
+  // raw and stored bytes of one array, for reporting
+  size_t get_raw_size(const size_t _idx) const { return blobs[_idx].raw.size(); }
+  size_t get_stored_size(const size_t _idx) const { return blobs[_idx].stored_size(); }
+
+  // total raw and stored bytes, for reporting
+  size_t get_raw_size() const {
+    size_t n = 0;
+    for (auto& thisb : blobs) n += thisb.raw.size();
+    return n;
+  }
+  size_t get_stored_size() const {
+    size_t n = 0;
+    for (auto& thisb : blobs) n += thisb.stored_size();
+    return n;
+  }
+
+private:
+  struct Blob {
+    std::vector<uint8_t> raw;
+    std::vector<std::vector<uint8_t>> blocks;
+    std::vector<uint64_t> header;
+    uint64_t offset;
+
+    size_t stored_size() const {
+      if (blocks.empty()) return raw.size();
+      size_t n = 0;
+      for (auto& blk : blocks) n += blk.size();
+      return n;
+    }
+  };
+
+  bool use_zlib;
+  int level;
+  size_t blocksize;
+  std::vector<Blob> blobs;
+};
+
 
 
 //
-// write vector to the vtk file
+// write vector inline in the vtk file, for the small arrays; the large ones go in the
+//   compressed appended section through VtkAppendedData
 //
 // why would you ever want to use base64 for floats and such? so wasteful.
 //
 template <class S>
 void write_DataArray (tinyxml2::XMLPrinter& _p,
                       Vector<S> const & _data,
-                      bool _compress = false,
                       bool _asbase64 = false) {
 
   using base64 = cppcodec::base64_rfc4648;
 
-  if (_compress) {
-    // not yet implemented
-  }
-
   if (_asbase64) {
     _p.PushAttribute( "format", "binary" );
 
@@ -92,7 +243,6 @@ void write_DataArray (tinyxml2::XMLPrinter& _p,
 template <class S>
 void write_DataArray (tinyxml2::XMLPrinter& _p,
                       std::array<Vector<S>,2> const & _data,
-                      bool _compress = false,
                       bool _asbase64 = false) {
 
   // interleave the two vectors into a new one
@@ -105,7 +255,7 @@ void write_DataArray (tinyxml2::XMLPrinter& _p,
   }
 
   // pass it on to write
-  write_DataArray<S>(_p, newvec, _compress, _asbase64);
+  write_DataArray<S>(_p, newvec, _asbase64);
 }
 
 
@@ -115,7 +265,6 @@ void write_DataArray (tinyxml2::XMLPrinter& _p,
 template <class S>
 void write_DataArray (tinyxml2::XMLPrinter& _p,
                       std::array<Vector<S>,3> const & _data,
-                      bool _compress = false,
                       bool _asbase64 = false) {
 
   // interleave the three vectors into a new one
@@ -128,9 +277,31 @@ void write_DataArray (tinyxml2::XMLPrinter& _p,
   }
 
   // pass it on to write
-  write_DataArray<S>(_p, newvec, _compress, _asbase64);
+  write_DataArray<S>(_p, newvec, _asbase64);
+}
+
+
+
+//
+// generate the name of the .vtu file for one collection, the prefix is usually a directory
+//
+template <class S>
+std::string vtu_file_name(Points<S> const& pts, const size_t file_idx, const size_t frameno,
+                          const std::string _prefix = "") {
+  std::stringstream vtkfn;
+  vtkfn << _prefix << (pts.is_inert() ? "fldpt_" : "part_");
+  vtkfn << std::setfill('0') << std::setw(2) << file_idx << "_" << std::setw(5) << frameno << ".vtu";
+  return vtkfn.str();
 }
 
+template <class S>
+std::string vtu_file_name(Surfaces<S> const&, const size_t file_idx, const size_t frameno,
+                          const std::string _prefix = "") {
+  std::stringstream vtkfn;
+  vtkfn << _prefix << "panel_";
+  vtkfn << std::setfill('0') << std::setw(2) << file_idx << "_" << std::setw(5) << frameno << ".vtu";
+  return vtkfn.str();
+}
 
 
 //
@@ -152,32 +323,76 @@ void write_DataArray (tinyxml2::XMLPrinter& _p,
 //        <DataArray type="Float64" Name="TimeValue" NumberOfTuples="1">1.24
 //        </DataArray>
 //      </FieldData>
-
+//
+// all large arrays go into a raw AppendedData section, optionally zlib-compressed
+//
+// with an error bound, the points are written in Morton order and every float array
+//   is snapped to its quantization grid first, which zlib then packs much more tightly
 //
 template <class S>
 std::string write_vtu_points(Points<S> const& pts, const size_t file_idx,
-                             const size_t frameno, const double time) {
+                             const size_t frameno, const double time,
+                             ErrorBound const& _eb = ErrorBound(),
+                             const std::string _prefix = "") {
 
   assert(pts.get_n() > 0 && "Inside write_vtu_points with no points");
 
-  const bool compress = false;
-  const bool asbase64 = true;
+  const bool use_zlib = true;
 
   bool has_radii = true;
   bool has_strengths = true;
-  std::string prefix = "part_";
   if (pts.is_inert()) {
     has_strengths = false;
     has_radii = false;
-    prefix = "fldpt_";
   }
 
   // generate file name
-  std::stringstream vtkfn;
-  vtkfn << prefix << std::setfill('0') << std::setw(2) << file_idx << "_" << std::setw(5) << frameno << ".vtu";
+  const std::string vtkfn = vtu_file_name(pts, file_idx, frameno, _prefix);
+
+  // sort and quantize copies of the float arrays, if asked
+  std::vector<uint32_t> order;
+  if (_eb.is_enabled()) order = morton_order(pts.get_pos());
+  auto lossy = [&](Vector<S> const& _vec) {
+    Vector<S> out = permute(_vec, order);
+    snap_to_bound(out, _eb.for_array(out));
+    return out;
+  };
+  auto lossy2 = [&](std::array<Vector<S>,2> const& _vec) {
+    return std::array<Vector<S>,2>({lossy(_vec[0]), lossy(_vec[1])});
+  };
+
+  // gather all of the arrays first, so they can be compressed together
+  VtkAppendedData app(use_zlib);
+  const size_t ipos = _eb.is_enabled() ? app.add(lossy2(pts.get_pos())) : app.add(pts.get_pos());
+
+  // https://discourse.paraview.org/t/cannot-open-vtu-files-with-paraview-5-8/3759
+  // apparently the Vtk format documents indicate that connectivities and offsets
+  //   must be in Int32, not UIntAnything. Okay...
+  size_t iconn, ioffs, itype;
+  {
+    Vector<int32_t> v(pts.get_n());
+    std::iota(v.begin(), v.end(), 0);
+    iconn = app.add(v);
+    std::iota(v.begin(), v.end(), 1);
+    ioffs = app.add(v);
+  }
+  // except these, they can be chars
+  {
+    Vector<uint8_t> v(pts.get_n());
+    std::fill(v.begin(), v.end(), 1);
+    itype = app.add(v);
+  }
+  size_t istr = 0, irad = 0;
+  if (has_strengths) istr = _eb.is_enabled() ? app.add(lossy(pts.get_str())) : app.add(pts.get_str());
+  if (has_radii) irad = _eb.is_enabled() ? app.add(lossy(pts.get_rad())) : app.add(pts.get_rad());
+  const size_t ivel = _eb.is_enabled() ? app.add(lossy2(pts.get_vel())) : app.add(pts.get_vel());
+
+  // compress everything at once
+  app.finalize();
 
   // prepare file pointer and printer
-  std::FILE* fp = std::fopen(vtkfn.str().c_str(), "wb");
+  std::FILE* fp = std::fopen(vtkfn.c_str(), "wb");
+  if (not fp) throw std::runtime_error("Could not open vtk file " + vtkfn);
   tinyxml2::XMLPrinter printer( fp );
 
   // write <?xml version="1.0"?>
@@ -186,10 +401,11 @@ std::string write_vtu_points(Points<S> const& pts, const size_t file_idx,
   printer.OpenElement( "VTKFile" );
   printer.PushAttribute( "type", "UnstructuredGrid" );
   //printer.PushAttribute( "type", "PolyData" );
-  printer.PushAttribute( "version", "0.1" );
+  printer.PushAttribute( "version", "1.0" );
   printer.PushAttribute( "byte_order", "LittleEndian" );
   // note this is still unsigned even though all indices later are signed!
-  printer.PushAttribute( "header_type", "UInt32" );
+  printer.PushAttribute( "header_type", "UInt64" );
+  if (use_zlib) printer.PushAttribute( "compressor", "vtkZLibDataCompressor" );
 
   // push comment with sim time?
 
@@ -205,7 +421,7 @@ std::string write_vtu_points(Points<S> const& pts, const size_t file_idx,
   printer.PushAttribute( "NumberOfTuples", "1" );
   {
     Vector<double> time_vec = {time};
-    write_DataArray (printer, time_vec, false, false);
+    write_DataArray (printer, time_vec, false);
   }
   printer.CloseElement();	// DataArray
   printer.CloseElement();	// FieldData
@@ -219,44 +435,28 @@ std::string write_vtu_points(Points<S> const& pts, const size_t file_idx,
   printer.PushAttribute( "NumberOfComponents", "3" );
   printer.PushAttribute( "Name", "position" );
   printer.PushAttribute( "type", "Float32" );
-  write_DataArray (printer, pts.get_pos(), compress, asbase64);
+  app.push_attributes(printer, ipos);
   printer.CloseElement();	// DataArray
   printer.CloseElement();	// Points
 
   printer.OpenElement( "Cells" );
 
-  // https://discourse.paraview.org/t/cannot-open-vtu-files-with-paraview-5-8/3759
-  // apparently the Vtk format documents indicate that connectivities and offsets
-  //   must be in Int32, not UIntAnything. Okay...
   printer.OpenElement( "DataArray" );
   printer.PushAttribute( "Name", "connectivity" );
   printer.PushAttribute( "type", "Int32" );
-  {
-    Vector<int32_t> v(pts.get_n());
-    std::iota(v.begin(), v.end(), 0);
-    write_DataArray (printer, v, compress, asbase64);
-  }
+  app.push_attributes(printer, iconn);
   printer.CloseElement();	// DataArray
 
   printer.OpenElement( "DataArray" );
   printer.PushAttribute( "Name", "offsets" );
   printer.PushAttribute( "type", "Int32" );
-  {
-    Vector<int32_t> v(pts.get_n());
-    std::iota(v.begin(), v.end(), 1);
-    write_DataArray (printer, v, compress, asbase64);
-  }
+  app.push_attributes(printer, ioffs);
   printer.CloseElement();	// DataArray
 
-  // except these, they can be chars
   printer.OpenElement( "DataArray" );
   printer.PushAttribute( "Name", "types" );
   printer.PushAttribute( "type", "UInt8" );
-  {
-    Vector<uint8_t> v(pts.get_n());
-    std::fill(v.begin(), v.end(), 1);
-    write_DataArray (printer, v, compress, asbase64);
-  }
+  app.push_attributes(printer, itype);
   printer.CloseElement();	// DataArray
 
   printer.CloseElement();	// Cells
@@ -283,7 +483,7 @@ std::string write_vtu_points(Points<S> const& pts, const size_t file_idx,
     printer.OpenElement( "DataArray" );
     printer.PushAttribute( "Name", "circulation" );
     printer.PushAttribute( "type", "Float32" );
-    write_DataArray (printer, pts.get_str(), compress, asbase64);
+    app.push_attributes(printer, istr);
     printer.CloseElement();	// DataArray
   }
 
@@ -291,7 +491,7 @@ std::string write_vtu_points(Points<S> const& pts, const size_t file_idx,
     printer.OpenElement( "DataArray" );
     printer.PushAttribute( "Name", "radius" );
     printer.PushAttribute( "type", "Float32" );
-    write_DataArray (printer, pts.get_rad(), compress, asbase64);
+    app.push_attributes(printer, irad);
     printer.CloseElement();	// DataArray
   }
 
@@ -299,7 +499,7 @@ std::string write_vtu_points(Points<S> const& pts, const size_t file_idx,
   printer.PushAttribute( "NumberOfComponents", "3" );
   printer.PushAttribute( "Name", "velocity" );
   printer.PushAttribute( "type", "Float32" );
-  write_DataArray (printer, pts.get_vel(), compress, asbase64);
+  app.push_attributes(printer, ivel);
   printer.CloseElement();	// DataArray
 
   printer.CloseElement();	// PointData
@@ -307,38 +507,27 @@ std::string write_vtu_points(Points<S> const& pts, const size_t file_idx,
   //printer.OpenElement( "CellData" );
   //printer.CloseElement();	// CellData
 
-  // here's the problem: ParaView's VTK/XML reader is not able to read "raw" bytestreams
-  // it parses each character and inevitably sees a > or <, so complains about mismatched
-  //   tags, and doesn't seem to point to the right place
-  // everyone who complains about raw data in the AppendedData section makes the mistake
-  //   of forgetting the 4-byte length - I've got that
-  // it's VTK's fault here
-  // Jesus, for how inefficient saving 2D particle data is, it's compounded by having to 
-  //   do it all in ascii!!! VTK just sucks. That's really what my 6 hours of wasted work
-  //   has taught me. It just sucks. Don't use it. Not that anything else is better.
-/*
-  printer.OpenElement( "AppendedData" );
-  printer.PushAttribute( "encoding", "raw" );
-  printer.PushText( " " );
-  printer.PushText( "_" );
-  uint32_t arry_len = s.size() * sizeof(s[0]);
-  char* ptr = (char*)(&arry_len);
-  std::cout << "  writing " << arry_len << " bytes to appended data" << std::endl;
-  //std::fwrite(&arry_len, sizeof(uint32_t), 1, fp);
-  std::fwrite(ptr, sizeof(uint32_t), 1, fp);
-  std::fwrite(s.data(), sizeof(s[0]), s.size(), fp);
-  printer.PushText( " " );
-  printer.CloseElement();	// AppendedData
-*/
-
   printer.CloseElement();	// Piece
   printer.CloseElement();	// PolyData or UnstructuredGrid
+
+  // ParaView's reader is happy with raw bytes here, as long as every array carries its
+  //   header and the offsets in the DataArray elements are exact
+  app.write(printer, fp);
+
   printer.CloseElement();	// VTKFile
 
   std::fclose(fp);
 
-  std::cout << "Wrote " << pts.get_n() << " points to " << vtkfn.str() << std::endl;
-  return vtkfn.str();
+  std::cout << "Wrote " << pts.get_n() << " points to " << vtkfn
+            << " (" << app.get_stored_size() << " of " << app.get_raw_size() << " bytes)" << std::endl;
+  if (_eb.is_enabled()) {
+    auto ratio = [&app](const size_t _i) { return (float)app.get_raw_size(_i) / (float)app.get_stored_size(_i); };
+    std::cout << "  compression ratios: position " << ratio(ipos) << ", velocity " << ratio(ivel);
+    if (has_strengths) std::cout << ", circulation " << ratio(istr);
+    if (has_radii) std::cout << ", radius " << ratio(irad);
+    std::cout << std::endl;
+  }
+  return vtkfn;
 }
 
 
@@ -347,27 +536,57 @@ std::string write_vtu_points(Points<S> const& pts, const size_t file_idx,
 //
 template <class S>
 std::string write_vtu_panels(Surfaces<S> const& surf, const size_t file_idx,
-                             const size_t frameno, const double time) {
+                             const size_t frameno, const double time,
+                             const std::string _prefix = "") {
 
   assert(surf.get_npanels() > 0 && "Inside write_vtu_panels with no panels");
 
-  const bool compress = false;
-  const bool asbase64 = true;
+  const bool use_zlib = true;
 
   bool has_vort_str = false;
   bool has_src_str = false;
-  std::string prefix = "panel_";
   if (not surf.is_inert()) {
     has_vort_str = true;
     has_src_str = surf.have_src_str();
   }
 
   // generate file name
-  std::stringstream vtkfn;
-  vtkfn << prefix << std::setfill('0') << std::setw(2) << file_idx << "_" << std::setw(5) << frameno << ".vtu";
+  const std::string vtkfn = vtu_file_name(surf, file_idx, frameno, _prefix);
+
+  // gather all of the arrays first, so they can be compressed together
+  VtkAppendedData app(use_zlib);
+  const size_t ipos = app.add(surf.get_pos());
+
+  // again, all connectivities and offsets must be Int32!
+  size_t iconn, ioffs, itype;
+  {
+    std::vector<Int> const & idx = surf.get_idx();
+    Vector<int32_t> v(std::begin(idx), std::end(idx));
+    iconn = app.add(v);
+  }
+  {
+    Vector<int32_t> v(surf.get_npanels());
+    std::iota(v.begin(), v.end(), 1);
+    std::transform(v.begin(), v.end(), v.begin(),
+                   std::bind(std::multiplies<int32_t>(), std::placeholders::_1, 2));
+    ioffs = app.add(v);
+  }
+  {
+    Vector<uint8_t> v(surf.get_npanels());
+    std::fill(v.begin(), v.end(), 3);
+    itype = app.add(v);
+  }
+  size_t ivort = 0, isrc = 0;
+  if (has_vort_str) ivort = app.add(surf.get_vort_str());
+  if (has_src_str) isrc = app.add(surf.get_src_str());
+  const size_t ivel = app.add(surf.get_vel());
+
+  // compress everything at once
+  app.finalize();
 
   // prepare file pointer and printer
-  std::FILE* fp = std::fopen(vtkfn.str().c_str(), "wb");
+  std::FILE* fp = std::fopen(vtkfn.c_str(), "wb");
+  if (not fp) throw std::runtime_error("Could not open vtk file " + vtkfn);
   tinyxml2::XMLPrinter printer( fp );
 
   // write <?xml version="1.0"?>
@@ -376,9 +595,10 @@ std::string write_vtu_panels(Surfaces<S> const& surf, const size_t file_idx,
   printer.OpenElement( "VTKFile" );
   printer.PushAttribute( "type", "UnstructuredGrid" );
   //printer.PushAttribute( "type", "PolyData" );
-  printer.PushAttribute( "version", "0.1" );
+  printer.PushAttribute( "version", "1.0" );
   printer.PushAttribute( "byte_order", "LittleEndian" );
-  printer.PushAttribute( "header_type", "UInt32" );
+  printer.PushAttribute( "header_type", "UInt64" );
+  if (use_zlib) printer.PushAttribute( "compressor", "vtkZLibDataCompressor" );
 
   // push comment with sim time?
 
@@ -394,7 +614,7 @@ std::string write_vtu_panels(Surfaces<S> const& surf, const size_t file_idx,
   printer.PushAttribute( "NumberOfTuples", "1" );
   {
     Vector<double> time_vec = {time};
-    write_DataArray (printer, time_vec, false, false);
+    write_DataArray (printer, time_vec, false);
   }
   printer.CloseElement();	// DataArray
   printer.CloseElement();	// FieldData
@@ -408,41 +628,28 @@ std::string write_vtu_panels(Surfaces<S> const& surf, const size_t file_idx,
   printer.PushAttribute( "NumberOfComponents", "3" );	// SEE THIS 3?!?!? It needs to be there.
   printer.PushAttribute( "Name", "position" );
   printer.PushAttribute( "type", "Float32" );
-  write_DataArray (printer, surf.get_pos(), compress, asbase64);
+  app.push_attributes(printer, ipos);
   printer.CloseElement();	// DataArray
   printer.CloseElement();	// Points
 
   printer.OpenElement( "Cells" );
 
-  // again, all connectivities and offsets must be Int32!
   printer.OpenElement( "DataArray" );
   printer.PushAttribute( "Name", "connectivity" );
   printer.PushAttribute( "type", "Int32" );
-  {
-    std::vector<Int> const & idx = surf.get_idx();
-    Vector<int32_t> v(std::begin(idx), std::end(idx));
-    write_DataArray (printer, v, compress, asbase64);
-  }
+  app.push_attributes(printer, iconn);
   printer.CloseElement();	// DataArray
 
   printer.OpenElement( "DataArray" );
   printer.PushAttribute( "Name", "offsets" );
   printer.PushAttribute( "type", "Int32" );
-  {
-    Vector<int32_t> v(surf.get_npanels());
-    std::iota(v.begin(), v.end(), 1);
-    std::transform(v.begin(), v.end(), v.begin(),
-                   std::bind(std::multiplies<int32_t>(), std::placeholders::_1, 2));
-    write_DataArray (printer, v, compress, asbase64);
-  }
+  app.push_attributes(printer, ioffs);
   printer.CloseElement();	// DataArray
 
   printer.OpenElement( "DataArray" );
   printer.PushAttribute( "Name", "types" );
   printer.PushAttribute( "type", "UInt8" );
-  Vector<uint8_t> v(surf.get_npanels());
-  std::fill(v.begin(), v.end(), 3);
-  write_DataArray (printer, v, compress, asbase64);
+  app.push_attributes(printer, itype);
   printer.CloseElement();	// DataArray
 
   printer.CloseElement();	// Cells
@@ -470,7 +677,7 @@ std::string write_vtu_panels(Surfaces<S> const& surf, const size_t file_idx,
     printer.OpenElement( "DataArray" );
     printer.PushAttribute( "Name", "vortex sheet strength" );
     printer.PushAttribute( "type", "Float32" );
-    write_DataArray (printer, surf.get_vort_str(), compress, asbase64);
+    app.push_attributes(printer, ivort);
     printer.CloseElement();	// DataArray
   }
 
@@ -478,7 +685,7 @@ std::string write_vtu_panels(Surfaces<S> const& surf, const size_t file_idx,
     printer.OpenElement( "DataArray" );
     printer.PushAttribute( "Name", "source sheet strength" );
     printer.PushAttribute( "type", "Float32" );
-    write_DataArray (printer, surf.get_src_str(), compress, asbase64);
+    app.push_attributes(printer, isrc);
     printer.CloseElement();	// DataArray
   }
 
@@ -486,7 +693,7 @@ std::string write_vtu_panels(Surfaces<S> const& surf, const size_t file_idx,
   printer.PushAttribute( "NumberOfComponents", "3" );
   printer.PushAttribute( "Name", "velocity" );
   printer.PushAttribute( "type", "Float32" );
-  write_DataArray (printer, surf.get_vel(), compress, asbase64);
+  app.push_attributes(printer, ivel);
   printer.CloseElement();	// DataArray
 
   printer.CloseElement();	// CellData
@@ -494,21 +701,133 @@ std::string write_vtu_panels(Surfaces<S> const& surf, const size_t file_idx,
 
   printer.CloseElement();	// Piece
   printer.CloseElement();	// PolyData or UnstructuredGrid
+
+  app.write(printer, fp);
+
   printer.CloseElement();	// VTKFile
 
   std::fclose(fp);
 
-  std::cout << "Wrote " << surf.get_npanels() << " panels to " << vtkfn.str() << std::endl;
+  std::cout << "Wrote " << surf.get_npanels() << " panels to " << vtkfn
+            << " (" << app.get_stored_size() << " of " << app.get_raw_size() << " bytes)" << std::endl;
+  return vtkfn;
+}
+
+
+//
+// generate the name of the .vti file for the gridded fields
+//
+inline std::string vti_file_name(const size_t frameno, const std::string _prefix = "") {
+  std::stringstream vtkfn;
+  vtkfn << _prefix << "grid_" << std::setfill('0') << std::setw(5) << frameno << ".vti";
   return vtkfn.str();
 }
 
+//
+// write gridded fields to a .vti ImageData file, with the same appended, compressed arrays
+//
+template <class S>
+std::string write_vti_grid(const size_t frameno, const double time,
+                           const size_t nx, const size_t ny,
+                           std::array<float,2> const& origin, const float dx,
+                           Vector<S> const& vort, std::array<Vector<S>,2> const& vel,
+                           Vector<S> const& psi, const std::string _prefix = "") {
+
+  const bool use_zlib = true;
+
+  // generate file name
+  const std::string vtkfn = vti_file_name(frameno, _prefix);
+
+  VtkAppendedData app(use_zlib);
+  const size_t ivort = app.add(vort);
+  const size_t ivel = app.add(vel);
+  const size_t ipsi = app.add(psi);
+  app.finalize();
+
+  std::FILE* fp = std::fopen(vtkfn.c_str(), "wb");
+  if (not fp) throw std::runtime_error("Could not open vtk file " + vtkfn);
+  tinyxml2::XMLPrinter printer( fp );
+  printer.PushHeader(false, true);
+
+  printer.OpenElement( "VTKFile" );
+  printer.PushAttribute( "type", "ImageData" );
+  printer.PushAttribute( "version", "1.0" );
+  printer.PushAttribute( "byte_order", "LittleEndian" );
+  printer.PushAttribute( "header_type", "UInt64" );
+  if (use_zlib) printer.PushAttribute( "compressor", "vtkZLibDataCompressor" );
+
+  const std::string extent = "0 " + std::to_string(nx-1) + " 0 " + std::to_string(ny-1) + " 0 0";
+  std::stringstream orig, spac;
+  orig << std::setprecision(9) << origin[0] << " " << origin[1] << " 0";
+  spac << std::setprecision(9) << dx << " " << dx << " " << dx;
+
+  printer.OpenElement( "ImageData" );
+  printer.PushAttribute( "WholeExtent", extent.c_str() );
+  printer.PushAttribute( "Origin", orig.str().c_str() );
+  printer.PushAttribute( "Spacing", spac.str().c_str() );
+
+  // include simulation time here
+  printer.OpenElement( "FieldData" );
+  printer.OpenElement( "DataArray" );
+  printer.PushAttribute( "type", "Float64" );
+  printer.PushAttribute( "Name", "TimeValue" );
+  printer.PushAttribute( "NumberOfTuples", "1" );
+  {
+    Vector<double> time_vec = {time};
+    write_DataArray (printer, time_vec, false);
+  }
+  printer.CloseElement();	// DataArray
+  printer.CloseElement();	// FieldData
+
+  printer.OpenElement( "Piece" );
+  printer.PushAttribute( "Extent", extent.c_str() );
+
+  printer.OpenElement( "PointData" );
+  printer.PushAttribute( "Vectors", "velocity" );
+  printer.PushAttribute( "Scalars", "vorticity,streamfunction" );
+
+  printer.OpenElement( "DataArray" );
+  printer.PushAttribute( "Name", "vorticity" );
+  printer.PushAttribute( "type", "Float32" );
+  app.push_attributes(printer, ivort);
+  printer.CloseElement();	// DataArray
+
+  printer.OpenElement( "DataArray" );
+  printer.PushAttribute( "NumberOfComponents", "3" );
+  printer.PushAttribute( "Name", "velocity" );
+  printer.PushAttribute( "type", "Float32" );
+  app.push_attributes(printer, ivel);
+  printer.CloseElement();	// DataArray
+
+  printer.OpenElement( "DataArray" );
+  printer.PushAttribute( "Name", "streamfunction" );
+  printer.PushAttribute( "type", "Float32" );
+  app.push_attributes(printer, ipsi);
+  printer.CloseElement();	// DataArray
+
+  printer.CloseElement();	// PointData
+  printer.CloseElement();	// Piece
+  printer.CloseElement();	// ImageData
+
+  app.write(printer, fp);
+
+  printer.CloseElement();	// VTKFile
+
+  std::fclose(fp);
+
+  std::cout << "Wrote " << nx << " x " << ny << " grid to " << vtkfn
+            << " (" << app.get_stored_size() << " of " << app.get_raw_size() << " bytes)" << std::endl;
+  return vtkfn;
+}
+
 
 //
 // write a collection
 //
 template <class S>
 void write_vtk_files(std::vector<Collection> const& coll, const size_t _index, const double _time,
-                     std::vector<std::string>& _files) {
+                     std::vector<std::string>& _files, ErrorBound const& _eb = ErrorBound(),
+                     const std::string _prefix = "") {
 
   size_t idx = 0;
   for (auto &elem : coll) {
@@ -519,14 +838,33 @@ void write_vtk_files(std::vector<Collection> const& coll, const size_t _index, c
     if (std::holds_alternative<Points<S>>(elem)) {
       Points<S> const & pts = std::get<Points<S>>(elem);
       if (pts.get_n() > 0) {
-        _files.emplace_back(write_vtu_points<S>(pts, idx++, _index, _time));
+        _files.emplace_back(write_vtu_points<S>(pts, idx++, _index, _time, _eb, _prefix));
       }
     } else if (std::holds_alternative<Surfaces<S>>(elem)) {
       Surfaces<S> const & surf = std::get<Surfaces<S>>(elem);
       if (surf.get_npanels() > 0) {
-        _files.emplace_back(write_vtu_panels<S>(surf, idx++, _index, _time));
+        _files.emplace_back(write_vtu_panels<S>(surf, idx++, _index, _time, _prefix));
       }
     }
   }
 }
 
+//
+// generate the file names that write_vtk_files would use, without writing anything
+//
+template <class S>
+void vtk_file_names(std::vector<Collection> const& coll, const size_t _index,
+                    std::vector<std::string>& _files, const std::string _prefix = "") {
+
+  size_t idx = 0;
+  for (auto &elem : coll) {
+    if (std::holds_alternative<Points<S>>(elem)) {
+      Points<S> const & pts = std::get<Points<S>>(elem);
+      if (pts.get_n() > 0) _files.emplace_back(vtu_file_name(pts, idx++, _index, _prefix));
+    } else if (std::holds_alternative<Surfaces<S>>(elem)) {
+      Surfaces<S> const & surf = std::get<Surfaces<S>>(elem);
+      if (surf.get_npanels() > 0) _files.emplace_back(vtu_file_name(surf, idx++, _index, _prefix));
+    }
+  }
+}
+
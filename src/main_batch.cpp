@@ -7,12 +7,12 @@
  *                      Blake B Hillier <blakehillier@mac.com>
  */
 
-#include "FlowFeature.h"
-#include "BoundaryFeature.h"
-#include "MeasureFeature.h"
-#include "Simulation.h"
+#include "BatchRunner.h"
+#include "Ensemble.h"
+#include "Replay.h"
 #include "JsonHelper.h"
-#include "RenderParams.h"
+#include "Distributed.h"
+#include "ThreadPool.h"
 
 #ifdef _WIN32
   // for glad
@@ -22,139 +22,80 @@
 #endif
 
 #include <iostream>
-#include <vector>
+#include <csignal>
+#include <stdexcept>
 
 
-// execution starts here
+// set when the scheduler asks us to stop, so we can write a checkpoint first
+static volatile std::sig_atomic_t stop_requested = 0;
 
-int main(int argc, char const *argv[]) {
-  std::cout << std::endl << "Omega2D Batch" << std::endl;
+static void request_stop(int) {
+  stop_requested = 1;
+}
 
-  // Set up vortex particle simulation
-  Simulation sim;
-  std::vector< std::unique_ptr<FlowFeature> > ffeatures;
-  std::vector< std::unique_ptr<BoundaryFeature> > bfeatures;
-  std::vector< std::unique_ptr<MeasureFeature> > mfeatures;
-  RenderParams rparams;
-
-  // a string to hold any error messages
-  std::string sim_err_msg;
-
-  // load a simulation from a JSON file - check command line for file name
-  if (argc == 2) {
-    std::string infile = argv[1];
-    nlohmann::json j = read_json(infile);
-    parse_json(sim, ffeatures, bfeatures, mfeatures, rparams, j);
-  } else {
-    std::cout << std::endl << "Usage:" << std::endl;
-    std::cout << "  " << argv[0] << " filename.json" << std::endl << std::endl;
-    return -1;
-  }
 
+// run whatever the options ask for, and return the exit status
 
-  std::cout << std::endl << "Initializing simulation" << std::endl;
+static int run(BatchOptions& opts) {
+  // load a simulation from a JSON file
+  nlohmann::json j = read_json(opts.input);
 
-  // initialize particle distributions
-  for (auto const& ff: ffeatures) {
-    //if (ff->is_enabled()) sim.add_particles( ff->init_particles(sim.get_ips()) );
-    if (ff->is_enabled()) {
-      ElementPacket<float> newpacket = ff->init_elements(sim.get_ips());
-      // echo any errors
-      /*if (good)*/ sim.add_elements( newpacket, active, lagrangian, ff->get_body() );
-    }
-    //if (ff->is_enabled()) sim.add_elements( ff->init_elements(sim.get_ips()), active, lagrangian, ff->get_body() );
-  }
+  // write a checkpoint and quit cleanly if the job is preempted
+  std::signal(SIGTERM, request_stop);
 
-  // initialize solid objects
-  for (auto const& bf : bfeatures) {
-    //if (bf->is_enabled()) sim.add_boundary( bf->get_body(), bf->init_elements(sim.get_ips()) );
-    if (bf->is_enabled()) {
-      ElementPacket<float> newpacket = bf->init_elements(sim.get_ips());
-      const move_t newmovetype = (bf->get_body() ? bodybound : fixed);
-      sim.add_elements(newpacket, reactive, newmovetype, bf->get_body() );
-    }
+  // only new tracers, through the saved frames of a finished run?
+  if (not opts.replay.empty()) {
+    if (Distributed::is_on()) Distributed::abort("replays run in one process, start them without mpirun");
+    opts.size_pool();
+    const BatchResult res = run_replay(j, opts.replay, opts, &stop_requested);
+    return (res.status == 1) ? 1 : 0;
   }
 
-  // initialize measurement features
-  for (auto const& mf: mfeatures) {
-    //if (mf->is_enabled()) sim.add_fldpts( mf->init_particles(rparams.tracer_scale*sim.get_ips()), mf->moves() );
-    if (mf->is_enabled()) {
-      const move_t newMoveType = (mf->get_is_lagrangian() ? lagrangian : fixed);
-      sim.add_elements( mf->init_elements(rparams.tracer_scale*sim.get_ips()), inert, newMoveType, mf->get_body() );
-    }
+  // many simulations at once?
+  if (Ensemble::is_ensemble(j)) {
+    if (Distributed::is_on()) Distributed::abort("ensembles run in one process, start them without mpirun");
+    if (not opts.restart.empty()) throw std::runtime_error("An ensemble can not start from a checkpoint");
+    Ensemble ens;
+    ens.from_json(j, opts.input);
+    // the cases share one task pool, sized for all of them
+    ThreadPool::get().set_num_threads(ens.get_num_threads(opts));
+    const int nfail = ens.run(opts, &stop_requested);
+    return (nfail > 0) ? 1 : 0;
   }
 
-  sim.set_initialized();
+  // or just one, optionally restarted from a checkpoint
+  opts.size_pool();
+  const BatchResult res = run_batch(j, "", opts, &stop_requested);
+  return (res.status == 1) ? 1 : 0;
+}
 
-  // check init for blow-up or errors
-  sim_err_msg = sim.check_initialization();
 
-  if (not sim_err_msg.empty()) {
-    // the initialization had some difficulty
-    std::cout << std::endl << "ERROR: " << sim_err_msg;
-    // stop the run
-    return 1;
-  }
+// execution starts here
 
+int main(int argc, char const *argv[]) {
+  // if started by mpirun, all ranks run one simulation together
+  Distributed::init();
+  std::cout << std::endl << "Omega2D Batch" << std::endl;
 
-  //
-  // Main loop
-  //
-
-  while (true) {
-
-    // check flow for blow-up or errors
-    sim_err_msg = sim.check_simulation();
-
-    if (sim_err_msg.empty()) {
-      // the last simulation step was fine, OK to continue
-      // generate new particles from emitters
-      for (auto const& ff: ffeatures) {
-        if (ff->is_enabled()) {
-          ElementPacket<float> newpacket = ff->step_elements(sim.get_ips());
-          // echo any errors
-          sim.add_elements( newpacket, active, lagrangian, ff->get_body() );
-        }
-      }
-
-      for (auto const& mf: mfeatures) {
-        //if (mf->is_enabled()) sim.add_fldpts( mf->init_particles(rparams.tracer_scale*sim.get_ips()), mf->moves() );
-        if (mf->is_enabled()) {
-          const move_t newMoveType = (mf->get_is_lagrangian() ? lagrangian : fixed);
-          sim.add_elements( mf->step_elements(rparams.tracer_scale*sim.get_ips()), inert, newMoveType, mf->get_body() );
-        }
-      }
-
-      // begin a new dynamic step: convection and diffusion
-      sim.step();
-    } else {
-      // the last step had some difficulty
-      std::cout << std::endl << "ERROR: " << sim_err_msg;
-
-      // stop the run
-      break;
+  // the input file, and anything that should override it
+  BatchOptions opts;
+  const std::string argerr = opts.parse(argc, argv);
+  int status = 0;
+  if (not argerr.empty()) {
+    if (argerr != "help") std::cout << std::endl << "ERROR: " << argerr << std::endl;
+    std::cout << BatchOptions::usage(argv[0]) << std::endl;
+    status = (argerr == "help") ? 0 : -1;
+  } else {
+    try {
+      status = run(opts);
+    } catch (std::exception const& e) {
+      std::cout << std::endl << "ERROR: " << e.what() << std::endl;
+      status = 1;
     }
-
-    // export data files at this step?
-
-    // check vs. stopping conditions
-    if (sim.test_vs_stop()) break;
-
-  } // end step
-
-
-  // Save final step if desired
-  if (false) {
-    // just make up a file name and write it
-    std::string outfile = "output.json";
-    // write and echo
-    write_json(sim, ffeatures, bfeatures, mfeatures, rparams, outfile);
-    std::cout << std::endl << "Wrote simulation to " << outfile << std::endl;
+    std::cout << "Quitting" << std::endl;
   }
 
-  sim.reset();
-  std::cout << "Quitting" << std::endl;
-
-  return 0;
+  // every way out comes through here, so MPI is always finished
+  Distributed::finalize();
+  return status;
 }
-
@@ -0,0 +1,130 @@
+/*
+ * main_bench.cpp - Driver code for the Omega2D benchmark suite
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "Benchmark.h"
+#include "JsonHelper.h"
+
+#ifdef _WIN32
+  // for glad
+  #define APIENTRY __stdcall
+  // for C++11 stuff
+  #include <ciso646>
+#endif
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+
+static void usage(const std::string _exe) {
+  std::cout << std::endl << "Usage:" << std::endl;
+  std::cout << "  " << _exe << " [options]" << std::endl << std::endl;
+  std::cout << "Options:" << std::endl;
+  std::cout << "  --full                 larger problem sizes" << std::endl;
+  std::cout << "  --only TEXT            run only cases with this in their name" << std::endl;
+  std::cout << "  --output-dir DIR       where each case writes, default bench" << std::endl;
+  std::cout << "  --results FILE         machine-readable results, default bench_results.json" << std::endl;
+  std::cout << "  --baseline FILE        compare against these earlier results" << std::endl;
+  std::cout << "  --tolerance X          allowed slowdown before flagging, default 0.2" << std::endl;
+  std::cout << "  --save-baseline FILE   also write the results here, as a new baseline" << std::endl;
+  std::cout << "  --summation, --accel, --threads, --diffusion, --reproducible  as in the batch version" << std::endl;
+  std::cout << "  --help" << std::endl << std::endl;
+}
+
+// execution starts here
+
+int main(int argc, char const *argv[]) {
+  std::cout << std::endl << "Omega2D Benchmark" << std::endl;
+
+  bool full = false;
+  std::string only;
+  std::string outdir = "bench";
+  std::string results_file = "bench_results.json";
+  std::string baseline_file;
+  std::string save_file;
+  double tol = 0.2;
+
+  // our options first, anything else goes to the batch option parser (which
+  //   needs an input file name, though the benchmark makes its own inputs)
+  std::vector<char const*> batch_args = { argv[0], "benchmark" };
+  for (int i=1; i<argc; ++i) {
+    const std::string arg = argv[i];
+    const bool has_val = (i+1 < argc);
+    if (arg == "--help") { usage(argv[0]); return 0; }
+    else if (arg == "--full") full = true;
+    else if (arg == "--only" and has_val) only = argv[++i];
+    else if (arg == "--output-dir" and has_val) outdir = argv[++i];
+    else if (arg == "--results" and has_val) results_file = argv[++i];
+    else if (arg == "--baseline" and has_val) baseline_file = argv[++i];
+    else if (arg == "--save-baseline" and has_val) save_file = argv[++i];
+    else if (arg == "--tolerance" and has_val) tol = std::stod(argv[++i]);
+    else batch_args.push_back(argv[i]);
+  }
+
+  BatchOptions opts;
+  const std::string argerr = opts.parse((int)batch_args.size(), batch_args.data());
+  if (not argerr.empty()) {
+    std::cout << std::endl << "ERROR: " << argerr << std::endl;
+    usage(argv[0]);
+    return -1;
+  }
+
+  // read the baseline before spending any time
+  nlohmann::json baseline;
+  if (not baseline_file.empty()) {
+    if (std::filesystem::exists(baseline_file)) {
+      baseline = read_json(baseline_file);
+    } else {
+      std::cout << "No baseline at " << baseline_file << ", run with --save-baseline to make one" << std::endl;
+    }
+  }
+
+  Benchmark bench;
+  bench.make_cases(full, outdir);
+  bench.select(only);
+  if (bench.get_num_cases() == 0) {
+    std::cout << std::endl << "ERROR: no cases match " << only << std::endl;
+    return -1;
+  }
+
+  opts.size_pool();
+  const int nfail = bench.run(opts);
+  const nlohmann::json results = bench.get_results();
+
+  {
+    std::ofstream out(results_file);
+    out << std::setw(2) << results << std::endl;
+    std::cout << std::endl << "Wrote " << results_file << std::endl;
+  }
+  if (not save_file.empty()) {
+    std::ofstream out(save_file);
+    out << std::setw(2) << results << std::endl;
+    std::cout << "Wrote baseline " << save_file << std::endl;
+  }
+
+  // the short version of every case
+  std::cout << std::endl << "Benchmark summary" << std::endl;
+  for (auto const& c : results["cases"]) {
+    std::cout << "  " << std::left << std::setw(16) << c["name"].get<std::string>() << std::right
+              << std::setw(6) << c["status"].get<std::string>()
+              << "  parts " << std::setw(8) << c["particles"].get<size_t>()
+              << "  panels " << std::setw(6) << c["panels"].get<size_t>()
+              << "  tracers " << std::setw(7) << c["fieldPoints"].get<size_t>()
+              << std::fixed << std::setprecision(3)
+              << "  step s " << std::setw(9) << c["stepSeconds"].get<double>()
+              << "  Mpart-steps/s " << std::setw(8) << 1.e-6*c["particleStepsPerSecond"].get<double>()
+              << "  peak MB " << std::setw(8) << c["peakMemoryMB"].get<double>()
+              << std::defaultfloat << std::setprecision(6) << std::endl;
+  }
+
+  int nworse = 0;
+  if (not baseline.is_null()) nworse = Benchmark::compare(results, baseline, tol);
+
+  return (nfail > 0 or nworse > 0) ? 1 : 0;
+}
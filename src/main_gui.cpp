@@ -32,8 +32,8 @@
 // header-only immediate-mode GUI
 #include "GuiHelper.h"
 
-// header-only png writing
-#include "miniz/FrameBufferToImage.h"
+// png writing off of the render thread
+#include "FrameExporter.h"
 
 //#include <GL/gl3w.h>    // This example is using gl3w to access OpenGL
 // functions (because it is small). You may use glew/glad/glLoadGen/etc.
@@ -59,6 +59,7 @@ int main(int argc, char const *argv[]) {
   FeatureDraw fdraw;
   FeatureDraw mdraw;
   size_t nframes = 0;
+  sim.claim_random_seeds();
   static bool sim_is_running = false;
   static bool begin_single_step = false;
 
@@ -159,6 +160,7 @@ int main(int argc, char const *argv[]) {
   bool export_png_when_ready = false;	// write frame to png as soon as its done
   bool write_png_immediately = false;	// write frame to png right now
   std::string png_out_file;		// the name of the recently-written png
+  FrameExporter exporter;		// reads back and writes frames asynchronously
   bool show_stats_window = true;
   bool show_welcome_window = true;
   bool show_terminal_window = false;
@@ -231,7 +233,7 @@ int main(int argc, char const *argv[]) {
         if (mf->is_enabled()) {
           ElementPacket<float> newpacket = mf->init_elements(rparams.tracer_scale*sim.get_ips());
           const move_t newMoveType = (mf->get_is_lagrangian() ? lagrangian : fixed);
-          sim.add_elements(newpacket, inert, newMoveType, mf->get_body() );
+          sim.add_elements(newpacket, inert, newMoveType, mf->get_body(), mf->get_update_every() );
         }
       }
 
@@ -329,7 +331,8 @@ int main(int argc, char const *argv[]) {
           //if (mf->is_enabled()) sim.add_fldpts( mf->init_particles(rparams.tracer_scale*sim.get_ips()), mf->moves() );
           if (mf->is_enabled()) {
             const move_t newMoveType = (mf->get_is_lagrangian() ? lagrangian : fixed);
-            sim.add_elements( mf->step_elements(rparams.tracer_scale*sim.get_ips()), inert, newMoveType, mf->get_body() );
+            sim.add_elements( mf->step_elements(rparams.tracer_scale*sim.get_ips()), inert, newMoveType, mf->get_body(),
+                              mf->get_update_every() );
           }
         }
 
@@ -1078,14 +1081,16 @@ int main(int argc, char const *argv[]) {
       mdraw.drawGL(gl_projection, rparams, true);
     }
 
+    // pass along any earlier frames that the GPU has finished copying out
+    exporter.poll();
+
     // here is where we write the buffer to a file
     if ((is_ready and export_png_when_ready) or write_png_immediately) {
       static int frameno = 0;
       std::stringstream pngfn;
       pngfn << "img_" << std::setfill('0') << std::setw(5) << frameno << ".png";
       png_out_file = pngfn.str();
-      (void) saveFramePNG(png_out_file);
-      std::cout << "Wrote screenshot to " << png_out_file << std::endl;
+      exporter.request(png_out_file);
       frameno++;
       // no need to tell the user every frame
       if (export_png_when_ready) png_out_file.clear();
@@ -1123,6 +1128,7 @@ int main(int argc, char const *argv[]) {
 
   // Cleanup
   std::cout << "Starting shutdown procedure" << std::endl;
+  exporter.finish();
   sim.reset();
   std::cout << "Quitting" << std::endl;
   ImGui_ImplOpenGL3_Shutdown();
@@ -0,0 +1,476 @@
+/*
+ * main_kernels.cpp - Time the inner influence kernels alone, outside of a simulation
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "VectorHelper.h"
+#include "Kernels.h"
+
+#ifdef _WIN32
+  // for C++11 stuff
+  #include <ciso646>
+#endif
+
+#ifdef USE_VC
+  #include <Vc/Vc>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+
+// the compiled-in core function, chosen in CoreFunc.h
+static const char* core_func_name() {
+#if defined(USE_RM_KERNEL)
+  return "Rosenhead-Moore";
+#elif defined(USE_EXPONENTIAL_KERNEL)
+  return "exponential";
+#elif defined(USE_WL_KERNEL)
+  return "Winckelmans-Leonard";
+#elif defined(USE_V2_KERNEL)
+  return "Vatistas n=2";
+#elif defined(USE_V3_KERNEL)
+  return "Vatistas n=3";
+#else
+  return "unknown";
+#endif
+}
+
+// results are summed into this, so the compiler can not drop the loops
+static volatile double sink = 0.0;
+
+// shortest time for one measurement, and how many to take the best of
+static constexpr double min_seconds = 0.1;
+static constexpr int num_trials = 3;
+
+//
+// best seconds per call of _f, repeating it enough times to be measurable
+//
+static double time_best(std::function<double()> const& _f) {
+  size_t reps = 1;
+  double best = 1.e+30;
+  for (int trial=0; trial<num_trials; ) {
+    const auto start = std::chrono::steady_clock::now();
+    double sum = 0.0;
+    for (size_t r=0; r<reps; ++r) sum += _f();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    sink = sink + sum;
+    if (elapsed.count() < min_seconds) {
+      // too short to trust, try more repetitions
+      reps *= 2;
+      continue;
+    }
+    best = std::min(best, elapsed.count() / (double)reps);
+    ++trial;
+  }
+  return best;
+}
+
+//
+// particles scattered over a unit square, with radii and strengths like a real run
+//
+template <class S>
+struct BenchPoints {
+  Vector<S> x, y, r, s;
+  explicit BenchPoints(const size_t _n, const unsigned int _seed) : x(_n), y(_n), r(_n), s(_n) {
+    std::mt19937 gen(_seed);
+    std::uniform_real_distribution<S> pos(-0.5, 0.5);
+    std::uniform_real_distribution<S> str(-1.0, 1.0);
+    const S rad = 1.5 / std::sqrt((S)_n);
+    for (size_t i=0; i<_n; ++i) {
+      x[i] = pos(gen);
+      y[i] = pos(gen);
+      r[i] = rad;
+      s[i] = str(gen) / (S)_n;
+    }
+  }
+  size_t size() const { return x.size(); }
+};
+
+//
+// short panels with random orientations, each stored with both of its end points
+//
+template <class S>
+struct BenchPanels {
+  Vector<S> x0, y0, x1, y1, vs, ss;
+  explicit BenchPanels(const size_t _n, const unsigned int _seed)
+    : x0(_n), y0(_n), x1(_n), y1(_n), vs(_n), ss(_n) {
+    std::mt19937 gen(_seed);
+    std::uniform_real_distribution<S> pos(-0.5, 0.5);
+    std::uniform_real_distribution<S> ang(0.0, 6.2831853);
+    std::uniform_real_distribution<S> str(-1.0, 1.0);
+    const S len = 1.0 / std::sqrt((S)_n);
+    for (size_t i=0; i<_n; ++i) {
+      x0[i] = pos(gen);
+      y0[i] = pos(gen);
+      const S theta = ang(gen);
+      x1[i] = x0[i] + len*std::cos(theta);
+      y1[i] = y0[i] + len*std::sin(theta);
+      vs[i] = str(gen);
+      ss[i] = str(gen);
+    }
+  }
+  size_t size() const { return x0.size(); }
+};
+
+//
+// one line of the report
+//
+static void report(const std::string _kernel, const std::string _types, const std::string _isa,
+                   const std::string _size, const size_t _nsrc, const size_t _ntarg,
+                   const double _secs, const size_t _flops) {
+  const double pairs = (double)_nsrc * (double)_ntarg;
+  printf("  %-10s %-14s %-7s %-7s %9ld %7ld %10.2f %9.3f %9.3f\n", _kernel.c_str(), _types.c_str(),
+         _isa.c_str(), _size.c_str(), (long)_nsrc, (long)_ntarg,
+         1.e-6 * pairs / _secs, 1.e+9 * _secs / pairs, 1.e-9 * pairs * (double)_flops / _secs);
+  fflush(stdout);
+}
+
+//
+// scalar (and whatever the compiler auto-vectorizes) loops, as in Influence.h
+//
+template <class S, class A>
+void bench_scalar(const std::string _types, const std::string _size, const size_t _nsrc, const size_t _ntarg,
+                  std::string const& _only) {
+
+  const BenchPoints<S> sp(_nsrc, 1);
+  const BenchPoints<S> tp(_ntarg, 2);
+  const BenchPanels<S> sb(_nsrc, 3);
+  auto want = [&](const char* _k) { return _only.empty() or std::string(_k).find(_only) != std::string::npos; };
+
+  if (want("core_0p")) {
+    const double secs = time_best([&]() {
+      A sum = 0.0;
+      for (size_t i=0; i<_ntarg; ++i) {
+        const S d0 = tp.x[i]*tp.x[i];
+        for (size_t j=0; j<_nsrc; ++j) sum += core_func<S>(d0 + sp.x[j]*sp.x[j], sp.r[j]);
+      }
+      return (double)sum;
+    });
+    report("core_0p", _types, "x86", _size, _nsrc, _ntarg, secs, 3 + flops_tp_nograds<S>());
+  }
+
+  if (want("core_0v")) {
+    const double secs = time_best([&]() {
+      A sum = 0.0;
+      for (size_t i=0; i<_ntarg; ++i) {
+        const S d0 = tp.x[i]*tp.x[i];
+        for (size_t j=0; j<_nsrc; ++j) sum += core_func<S>(d0 + sp.x[j]*sp.x[j], sp.r[j], tp.r[i]);
+      }
+      return (double)sum;
+    });
+    report("core_0v", _types, "x86", _size, _nsrc, _ntarg, secs, 3 + flops_tv_nograds<S>());
+  }
+
+  if (want("0v_0p")) {
+    const double secs = time_best([&]() {
+      double sum = 0.0;
+      for (size_t i=0; i<_ntarg; ++i) {
+        A accumu = 0.0;
+        A accumv = 0.0;
+        for (size_t j=0; j<_nsrc; ++j) {
+          kernel_0v_0p<S,A>(sp.x[j], sp.y[j], sp.r[j], sp.s[j], tp.x[i], tp.y[i], &accumu, &accumv);
+        }
+        sum += accumu + accumv;
+      }
+      return sum;
+    });
+    report("0v_0p", _types, "x86", _size, _nsrc, _ntarg, secs, flops_0v_0p<S,A>());
+  }
+
+  if (want("0v_0v")) {
+    const double secs = time_best([&]() {
+      double sum = 0.0;
+      for (size_t i=0; i<_ntarg; ++i) {
+        A accumu = 0.0;
+        A accumv = 0.0;
+        for (size_t j=0; j<_nsrc; ++j) {
+          kernel_0v_0v<S,A>(sp.x[j], sp.y[j], sp.r[j], sp.s[j], tp.x[i], tp.y[i], tp.r[i], &accumu, &accumv);
+        }
+        sum += accumu + accumv;
+      }
+      return sum;
+    });
+    report("0v_0v", _types, "x86", _size, _nsrc, _ntarg, secs, flops_0v_0v<S,A>());
+  }
+
+  if (want("1_0v")) {
+    const double secs = time_best([&]() {
+      double sum = 0.0;
+      for (size_t i=0; i<_ntarg; ++i) {
+        A accumu = 0.0, accumv = 0.0;
+        A resultu = 0.0, resultv = 0.0;
+        for (size_t j=0; j<_nsrc; ++j) {
+          kernel_1_0v<S,A>(sb.x0[j], sb.y0[j], sb.x1[j], sb.y1[j], sb.vs[j], tp.x[i], tp.y[i],
+                           &resultu, &resultv);
+          accumu += resultu;
+          accumv += resultv;
+        }
+        sum += accumu + accumv;
+      }
+      return sum;
+    });
+    report("1_0v", _types, "x86", _size, _nsrc, _ntarg, secs, flops_1_0v<S,A>());
+  }
+
+  if (want("1_0vs")) {
+    const double secs = time_best([&]() {
+      double sum = 0.0;
+      for (size_t i=0; i<_ntarg; ++i) {
+        A accumu = 0.0, accumv = 0.0;
+        A resultu = 0.0, resultv = 0.0;
+        for (size_t j=0; j<_nsrc; ++j) {
+          kernel_1_0vs<S,A>(sb.x0[j], sb.y0[j], sb.x1[j], sb.y1[j], sb.vs[j], sb.ss[j], tp.x[i], tp.y[i],
+                            &resultu, &resultv);
+          accumu += resultu;
+          accumv += resultv;
+        }
+        sum += accumu + accumv;
+      }
+      return sum;
+    });
+    report("1_0vs", _types, "x86", _size, _nsrc, _ntarg, secs, flops_1_0vs<S,A>());
+  }
+
+  if (want("1_0vps")) {
+    const double secs = time_best([&]() {
+      double sum = 0.0;
+      for (size_t i=0; i<_ntarg; ++i) {
+        A vu = 0.0, vv = 0.0, su = 0.0, sv = 0.0;
+        A accum = 0.0;
+        for (size_t j=0; j<_nsrc; ++j) {
+          kernel_1_0vps<S,A>(sb.x0[j], sb.y0[j], sb.x1[j], sb.y1[j], sb.vs[j], sb.ss[j], tp.x[i], tp.y[i],
+                             &vu, &vv, &su, &sv);
+          accum += vu + vv + su + sv;
+        }
+        sum += accum;
+      }
+      return sum;
+    });
+    report("1_0vps", _types, "x86", _size, _nsrc, _ntarg, secs, flops_1_0vps<S,A>());
+  }
+}
+
+#ifdef USE_VC
+//
+// the same with Vc vectors over the sources, as in the Vc branches of Influence.h
+//
+template <class S, class A>
+void bench_vc(const std::string _types, const std::string _size, const size_t _nsrc, const size_t _ntarg,
+              std::string const& _only) {
+
+  typedef Vc::Vector<S> StoreVec;
+  typedef Vc::SimdArray<A, Vc::Vector<S>::size()> AccumVec;
+
+  const BenchPoints<S> sp(_nsrc, 1);
+  const BenchPoints<S> tp(_ntarg, 2);
+  const BenchPanels<S> sb(_nsrc, 3);
+  auto want = [&](const char* _k) { return _only.empty() or std::string(_k).find(_only) != std::string::npos; };
+
+  // padding gets zero strength, and a radius and length that are safe to divide by
+  const Vc::Memory<StoreVec> sxv = stdvec_to_vcvec<S>(sp.x, 0.0);
+  const Vc::Memory<StoreVec> syv = stdvec_to_vcvec<S>(sp.y, 0.0);
+  const Vc::Memory<StoreVec> srv = stdvec_to_vcvec<S>(sp.r, 1.0);
+  const Vc::Memory<StoreVec> ssv = stdvec_to_vcvec<S>(sp.s, 0.0);
+  const Vc::Memory<StoreVec> bx0 = stdvec_to_vcvec<S>(sb.x0, 0.0);
+  const Vc::Memory<StoreVec> by0 = stdvec_to_vcvec<S>(sb.y0, 0.0);
+  const Vc::Memory<StoreVec> bx1 = stdvec_to_vcvec<S>(sb.x1, 1.0);
+  const Vc::Memory<StoreVec> by1 = stdvec_to_vcvec<S>(sb.y1, 0.0);
+  const Vc::Memory<StoreVec> bvs = stdvec_to_vcvec<S>(sb.vs, 0.0);
+  const Vc::Memory<StoreVec> bss = stdvec_to_vcvec<S>(sb.ss, 0.0);
+
+  if (want("core_0p")) {
+    const double secs = time_best([&]() {
+      StoreVec sum(0.0);
+      for (size_t i=0; i<_ntarg; ++i) {
+        const StoreVec d0 = tp.x[i]*tp.x[i];
+        for (size_t j=0; j<sxv.vectorsCount(); ++j) {
+          sum += core_func<StoreVec>(d0 + sxv.vector(j)*sxv.vector(j), srv.vector(j));
+        }
+      }
+      return (double)sum.sum();
+    });
+    report("core_0p", _types, "Vc", _size, _nsrc, _ntarg, secs, 3 + flops_tp_nograds<StoreVec>());
+  }
+
+  if (want("core_0v")) {
+    const double secs = time_best([&]() {
+      StoreVec sum(0.0);
+      for (size_t i=0; i<_ntarg; ++i) {
+        const StoreVec d0 = tp.x[i]*tp.x[i];
+        const StoreVec tr = tp.r[i];
+        for (size_t j=0; j<sxv.vectorsCount(); ++j) {
+          sum += core_func<StoreVec>(d0 + sxv.vector(j)*sxv.vector(j), srv.vector(j), tr);
+        }
+      }
+      return (double)sum.sum();
+    });
+    report("core_0v", _types, "Vc", _size, _nsrc, _ntarg, secs, 3 + flops_tv_nograds<StoreVec>());
+  }
+
+  if (want("0v_0p")) {
+    const double secs = time_best([&]() {
+      double sum = 0.0;
+      for (size_t i=0; i<_ntarg; ++i) {
+        const StoreVec txv = tp.x[i];
+        const StoreVec tyv = tp.y[i];
+        AccumVec accumu = 0.0;
+        AccumVec accumv = 0.0;
+        for (size_t j=0; j<sxv.vectorsCount(); ++j) {
+          kernel_0v_0p<StoreVec,AccumVec>(sxv.vector(j), syv.vector(j), srv.vector(j), ssv.vector(j),
+                                          txv, tyv, &accumu, &accumv);
+        }
+        sum += accumu.sum() + accumv.sum();
+      }
+      return sum;
+    });
+    report("0v_0p", _types, "Vc", _size, _nsrc, _ntarg, secs, flops_0v_0p<StoreVec,AccumVec>());
+  }
+
+  if (want("0v_0v")) {
+    const double secs = time_best([&]() {
+      double sum = 0.0;
+      for (size_t i=0; i<_ntarg; ++i) {
+        const StoreVec txv = tp.x[i];
+        const StoreVec tyv = tp.y[i];
+        const StoreVec trv = tp.r[i];
+        AccumVec accumu = 0.0;
+        AccumVec accumv = 0.0;
+        for (size_t j=0; j<sxv.vectorsCount(); ++j) {
+          kernel_0v_0v<StoreVec,AccumVec>(sxv.vector(j), syv.vector(j), srv.vector(j), ssv.vector(j),
+                                          txv, tyv, trv, &accumu, &accumv);
+        }
+        sum += accumu.sum() + accumv.sum();
+      }
+      return sum;
+    });
+    report("0v_0v", _types, "Vc", _size, _nsrc, _ntarg, secs, flops_0v_0v<StoreVec,AccumVec>());
+  }
+
+  if (want("1_0v")) {
+    const double secs = time_best([&]() {
+      double sum = 0.0;
+      for (size_t i=0; i<_ntarg; ++i) {
+        const StoreVec vtx = tp.x[i];
+        const StoreVec vty = tp.y[i];
+        AccumVec accumu(0.0), accumv(0.0);
+        AccumVec resultu(0.0), resultv(0.0);
+        for (size_t j=0; j<bx0.vectorsCount(); ++j) {
+          kernel_1_0v<StoreVec,AccumVec>(bx0.vector(j), by0.vector(j), bx1.vector(j), by1.vector(j),
+                                         bvs.vector(j), vtx, vty, &resultu, &resultv);
+          accumu += resultu;
+          accumv += resultv;
+        }
+        sum += accumu.sum() + accumv.sum();
+      }
+      return sum;
+    });
+    report("1_0v", _types, "Vc", _size, _nsrc, _ntarg, secs, flops_1_0v<StoreVec,AccumVec>());
+  }
+
+  if (want("1_0vs")) {
+    const double secs = time_best([&]() {
+      double sum = 0.0;
+      for (size_t i=0; i<_ntarg; ++i) {
+        const StoreVec vtx = tp.x[i];
+        const StoreVec vty = tp.y[i];
+        AccumVec accumu(0.0), accumv(0.0);
+        AccumVec resultu(0.0), resultv(0.0);
+        for (size_t j=0; j<bx0.vectorsCount(); ++j) {
+          kernel_1_0vs<StoreVec,AccumVec>(bx0.vector(j), by0.vector(j), bx1.vector(j), by1.vector(j),
+                                          bvs.vector(j), bss.vector(j), vtx, vty, &resultu, &resultv);
+          accumu += resultu;
+          accumv += resultv;
+        }
+        sum += accumu.sum() + accumv.sum();
+      }
+      return sum;
+    });
+    report("1_0vs", _types, "Vc", _size, _nsrc, _ntarg, secs, flops_1_0vs<StoreVec,AccumVec>());
+  }
+
+  if (want("1_0vps")) {
+    const double secs = time_best([&]() {
+      double sum = 0.0;
+      for (size_t i=0; i<_ntarg; ++i) {
+        const StoreVec vtx = tp.x[i];
+        const StoreVec vty = tp.y[i];
+        StoreVec vu, vv, su, sv;
+        StoreVec accum(0.0);
+        for (size_t j=0; j<bx0.vectorsCount(); ++j) {
+          kernel_1_0vps<StoreVec,StoreVec>(bx0.vector(j), by0.vector(j), bx1.vector(j), by1.vector(j),
+                                           bvs.vector(j), bss.vector(j), vtx, vty, &vu, &vv, &su, &sv);
+          accum += vu + vv + su + sv;
+        }
+        sum += accum.sum();
+      }
+      return sum;
+    });
+    report("1_0vps", _types, "Vc", _size, _nsrc, _ntarg, secs, flops_1_0vps<StoreVec,StoreVec>());
+  }
+}
+#endif
+
+//
+// every instruction set this binary has, for one pair of storage and accumulator types
+//
+template <class S, class A>
+void bench_types(const std::string _types, const bool _quick, std::string const& _only) {
+  // sources that fit in L1 with room to spare, and sources that must come from memory
+  bench_scalar<S,A>(_types, "cache", 1024, 512, _only);
+#ifdef USE_VC
+  bench_vc<S,A>(_types, "cache", 1024, 512, _only);
+#endif
+  if (_quick) return;
+  bench_scalar<S,A>(_types, "stream", 1<<22, 8, _only);
+#ifdef USE_VC
+  bench_vc<S,A>(_types, "stream", 1<<22, 8, _only);
+#endif
+}
+
+
+// execution starts here
+
+int main(int argc, char const *argv[]) {
+  std::cout << std::endl << "Omega2D kernel timings" << std::endl;
+
+  bool quick = false;
+  std::string only;
+  for (int i=1; i<argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--quick") quick = true;
+    else if (arg == "--help") {
+      std::cout << std::endl << "Usage:" << std::endl;
+      std::cout << "  " << argv[0] << " [--quick] [kernel]" << std::endl << std::endl;
+      std::cout << "  --quick    only sources that fit in cache" << std::endl;
+      std::cout << "  kernel     only those whose names contain this, like 0v_0p or 1_0" << std::endl << std::endl;
+      return 0;
+    } else only = arg;
+  }
+
+  std::cout << "  core function " << core_func_name() << ", one thread";
+#ifdef USE_VC
+  std::cout << ", Vc " << Vc::float_v::size() << " floats wide";
+#endif
+  std::cout << std::endl << std::endl;
+
+  printf("  %-10s %-14s %-7s %-7s %9s %7s %10s %9s %9s\n", "kernel", "store/accum", "isa", "size",
+         "sources", "targets", "Mpairs/s", "ns/pair", "GFLOP/s");
+
+  bench_types<float,float>("float/float", quick, only);
+  bench_types<float,double>("float/double", quick, only);
+  bench_types<double,double>("double/double", quick, only);
+
+  // so nothing above is optimized away
+  if (sink == 12345.6789) std::cout << sink << std::endl;
+
+  return 0;
+}
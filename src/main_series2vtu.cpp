@@ -0,0 +1,122 @@
+/*
+ * main_series2vtu.cpp - Convert an Omega2D time series file to .vtu files and a .pvd index
+ *
+ * (c)2020 Applied Scientific Research, Inc.
+ *         Written by Mark J Stock <markjstock@gmail.com>
+ */
+
+#include "TimeSeries.h"
+#include "VtkXmlHelper.h"
+
+#ifdef _WIN32
+  #include <ciso646>
+#endif
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <stdexcept>
+
+
+// execution starts here
+
+int main(int argc, char const *argv[]) {
+  std::cout << std::endl << "Omega2D time series to vtu" << std::endl;
+
+  // what to convert
+  std::string infile;
+  bool use_step = false;
+  size_t one_step = 0;
+  bool use_time = false;
+  double one_time = 0.0;
+
+  if (argc == 2) {
+    infile = argv[1];
+  } else if (argc == 4 and std::string(argv[2]) == "--step") {
+    infile = argv[1];
+    use_step = true;
+    one_step = std::stoul(argv[3]);
+  } else if (argc == 4 and std::string(argv[2]) == "--time") {
+    infile = argv[1];
+    use_time = true;
+    one_time = std::stod(argv[3]);
+  } else {
+    std::cout << std::endl << "Usage:" << std::endl;
+    std::cout << "  " << argv[0] << " file.o2ts                 convert all frames" << std::endl;
+    std::cout << "  " << argv[0] << " file.o2ts --step N        convert the frame at step N" << std::endl;
+    std::cout << "  " << argv[0] << " file.o2ts --time T        convert the frame nearest time T" << std::endl << std::endl;
+    return -1;
+  }
+
+  try {
+    TimeSeriesReader reader(infile);
+    std::cout << "  " << infile << " has " << reader.get_num_frames() << " frames" << std::endl;
+
+    // pick the frames
+    std::vector<size_t> frames;
+    if (use_step) {
+      frames.push_back(reader.find_step(one_step));
+    } else if (use_time) {
+      frames.push_back(reader.find_time(one_time));
+    } else {
+      for (size_t i=0; i<reader.get_num_frames(); ++i) frames.push_back(i);
+    }
+
+    // write each, keeping track of the files and times for the pvd
+    std::vector<std::pair<double,std::string>> pvd_entries;
+    for (const size_t ifr : frames) {
+      TimeSeriesFrame frame = reader.read_frame(ifr);
+
+      // same file names and order as Simulation::write_vtk
+      std::vector<std::string> files;
+      for (const std::string list : {"vort", "fldpt", "bdry"}) {
+        std::vector<Collection> coll = collections_from_frame<float>(frame, list);
+        write_vtk_files<float>(coll, frame.get_step(), frame.get_time(), files);
+      }
+      for (auto const& f : files) pvd_entries.emplace_back(frame.get_time(), f);
+    }
+
+    // the pvd file lets ParaView load the whole sequence with proper times,
+    //   and it goes in the current directory, with the vtu files
+    std::string pvdfn = infile;
+    const size_t slash = pvdfn.find_last_of("/\\");
+    if (slash != std::string::npos) pvdfn.erase(0, slash+1);
+    const size_t dot = pvdfn.find_last_of('.');
+    if (dot != std::string::npos) pvdfn.erase(dot);
+    pvdfn += ".pvd";
+
+    std::FILE* fp = std::fopen(pvdfn.c_str(), "wb");
+    if (not fp) throw std::runtime_error("Could not open pvd file " + pvdfn);
+    tinyxml2::XMLPrinter printer( fp );
+    printer.PushHeader(false, true);
+    printer.OpenElement( "VTKFile" );
+    printer.PushAttribute( "type", "Collection" );
+    printer.PushAttribute( "version", "0.1" );
+    printer.PushAttribute( "byte_order", "LittleEndian" );
+    printer.OpenElement( "Collection" );
+    for (auto const& entry : pvd_entries) {
+      // the two-digit collection index in the name becomes the part number
+      const std::string& f = entry.second;
+      const size_t us = f.find('_');
+      const std::string part = (us != std::string::npos) ? std::to_string(std::stoi(f.substr(us+1, 2))) : "0";
+      printer.OpenElement( "DataSet" );
+      printer.PushAttribute( "timestep", entry.first );
+      printer.PushAttribute( "group", f.substr(0, us).c_str() );
+      printer.PushAttribute( "part", part.c_str() );
+      printer.PushAttribute( "file", f.c_str() );
+      printer.CloseElement();	// DataSet
+    }
+    printer.CloseElement();	// Collection
+    printer.CloseElement();	// VTKFile
+    std::fclose(fp);
+
+    std::cout << "Wrote " << pvd_entries.size() << " files to " << pvdfn << std::endl;
+
+  } catch (std::exception const& e) {
+    std::cout << std::endl << "ERROR: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}